@@ -1,11 +1,40 @@
 #include "Client.hpp"
 #include "Connection.hpp"
+#include "Compression.hpp"
 
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include <algorithm>
 #include <iostream>
+#include <optional>
+#include <utility>
+
+namespace {
+    /**
+     * Chatroom ID and sequence number of the chat message:
+     * @code
+     * {"chatroom":{"id":N,"seq":S},...}
+     * @endcode
+     */
+    std::optional<std::pair<std::uint64_t, std::uint64_t>> ReadSequence(const Internal::Response& response) {
+        rapidjson::Document doc;
+        doc.Parse(response.m_attachment.c_str());
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("chatroom") 
+            || !doc["chatroom"].IsObject()
+        ) {
+            return std::nullopt;
+        }
+        const auto& chatroom = doc["chatroom"];
+        if (chatroom.HasMember("id") && chatroom["id"].IsUint64()
+            && chatroom.HasMember("seq") && chatroom["seq"].IsUint64()
+        ) {
+            return std::make_pair(chatroom["id"].GetUint64(), chatroom["seq"].GetUint64());
+        }
+        return std::nullopt;
+    }
+}
 
 Client::Client(
     std::shared_ptr<boost::asio::io_context> io
@@ -30,6 +59,10 @@ Client::~Client() {
 }
 
 void Client::Connect(std::string_view path, std::string_view port) {
+    if (const auto events { std::atomic_load(&m_events) }; events) {
+        // the messages missed since the gap are replayed on resume
+        events->m_hasGap = false;
+    }
     m_connection = std::make_shared<client::Connection_t>(this->weak_from_this(), m_io, m_sslContext);
     m_connection->Connect(path, port);
 }
@@ -38,9 +71,145 @@ void Client::Write(std::string text) {
     m_connection->Write(std::move(text));
 }
 
-void Client::SetState(State state) noexcept {
+std::uint64_t Client::Send(Internal::Request request, ResponseHandler handler) {
+    bool isClosed { false };
+    { // Block
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        request.m_id = ++m_lastRequestId;
+        isClosed = m_state == State::CLOSED;
+        if (!isClosed) {
+            // registered before the write, so the reply can't come first
+            m_pending.emplace(request.m_id, std::move(handler));
+        }
+    } // Release
+    if (isClosed) {
+        // nobody would complete it later
+        Internal::Response response {};
+        response.m_id = request.m_id;
+        response.m_error = "Connection is closed";
+        if (handler) {
+            handler(response);
+        }
+        return request.m_id;
+    }
+    std::string serialized;
+    request.Write(serialized);
+    this->Write(std::move(serialized));
+    return request.m_id;
+}
+
+std::future<Internal::Response> Client::Send(Internal::Request request) {
+    auto promise { std::make_shared<std::promise<Internal::Response>>() };
+    auto future { promise->get_future() };
+    this->Send(std::move(request), [promise](const Internal::Response& response) {
+        promise->set_value(response);
+    });
+    return future;
+}
+
+void Client::SetMessageHandler(ResponseHandler handler) {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_messageHandler = std::move(handler);
+}
+
+std::size_t Client::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_pending.size();
+}
+
+void Client::RequestCompression() {
+    Internal::Request syn{};
+    syn.m_query = Internal::QueryType::SYN;
+    syn.m_timestamp = Utils::GetTimestamp();
+    syn.m_timeout = 1000;
+    syn.m_attachment = "{\"compression\":[\"" + Internal::DEFLATE + "\"]}";
+    std::string serialized;
+    syn.Write(serialized);
+    this->Write(std::move(serialized));
+}
+
+void Client::RequestPresence() {
+    Internal::Request syn{};
+    syn.m_query = Internal::QueryType::SYN;
+    syn.m_timestamp = Utils::GetTimestamp();
+    syn.m_timeout = 1000;
+    syn.m_attachment = "{\"presence\":true}";
+    std::string serialized;
+    syn.Write(serialized);
+    this->Write(std::move(serialized));
+}
+
+void Client::RequestResume() {
+    // {"resume":{"token":"...","chatrooms":[{"id":N,"seq":S},...]}}
+    rapidjson::Document attachment(rapidjson::kObjectType);
+    auto& alloc = attachment.GetAllocator();
+    rapidjson::Value resume(rapidjson::kObjectType);
+    { // Block
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        resume.AddMember("token", rapidjson::Value(m_resumeToken.c_str(), alloc), alloc);
+        rapidjson::Value chatrooms(rapidjson::kArrayType);
+        for (const auto& [id, sequence]: m_sequences) {
+            rapidjson::Value chatroom(rapidjson::kObjectType);
+            chatroom.AddMember("id", id, alloc);
+            chatroom.AddMember("seq", sequence, alloc);
+            chatrooms.PushBack(chatroom, alloc);
+        }
+        resume.AddMember("chatrooms", chatrooms, alloc);
+    } // Release
+    attachment.AddMember("resume", resume, alloc);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    attachment.Accept(writer);
+
+    Internal::Request syn{};
+    syn.m_query = Internal::QueryType::SYN;
+    syn.m_timestamp = Utils::GetTimestamp();
+    syn.m_timeout = 1000;
+    syn.m_attachment.assign(buffer.GetString(), buffer.GetSize());
+    std::string serialized;
+    syn.Write(serialized);
+    this->Write(std::move(serialized));
+}
+
+std::string Client::GetResumeToken() const {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_resumeToken;
+}
+
+std::uint64_t Client::GetLastSequence(std::uint64_t chatroomId) const {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    const auto it = m_sequences.find(chatroomId);
+    return it != m_sequences.end()? it->second: 0;
+}
+
+bool Client::IsCompressionEnabled() const noexcept {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_isCompressionEnabled;
+}
+
+bool Client::IsPresenceEnabled() const noexcept {
     std::lock_guard<std::mutex> lock{ m_mutex };
-    m_state = state;
+    return m_isPresenceEnabled;
+}
+
+void Client::SetState(State state) noexcept {
+    std::unordered_map<std::uint64_t, ResponseHandler> abandoned;
+    { // Block
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_state = state;
+        if (state == State::CLOSED) {
+            abandoned.swap(m_pending);
+        }
+    } // Release
+    // the replies won't come anymore
+    for (auto& [id, handler]: abandoned) {
+        Internal::Response response {};
+        response.m_id = id;
+        response.m_error = "Connection is closed";
+        if (handler) {
+            handler(response);
+        }
+    }
 }
 
 Client::State Client::GetState() const noexcept {
@@ -57,21 +226,165 @@ Internal::Response Client::GetLastResponse() const noexcept {
     return m_response;
 }
 
+std::size_t Client::GetResponseCount() const noexcept {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    return m_responseCount;
+}
+
 void Client::HandleMessage(Internal::Response&& response) {
-    m_response = std::move(response);
-    std::lock_guard<std::mutex> lock{ m_mutex };
+    ResponseHandler handler { nullptr };
+    std::shared_ptr<EventQueue> events { nullptr };
+    std::optional<std::pair<std::uint64_t, std::uint64_t>> sequence { std::nullopt };
+    { // Block
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        ++m_responseCount;
+        this->UpdateState(response);
+        if (m_state == State::RECEIVE_ACK && response.m_query == Internal::QueryType::CHAT_MESSAGE) {
+            sequence = ::ReadSequence(response);
+        }
+        if (response.m_id) {
+            if (auto it = m_pending.find(response.m_id); it != m_pending.end()) {
+                handler = std::move(it->second);
+                m_pending.erase(it);
+            }
+        }
+        else if (response.m_query == Internal::QueryType::CHAT_MESSAGE 
+            || response.m_query == Internal::QueryType::DIRECT_MESSAGE
+            || response.m_query == Internal::QueryType::PRESENCE
+        ) {
+            handler = m_messageHandler;
+        }
+        events = std::atomic_load(&m_events);
+        if (sequence && (handler || !events)) {
+            // a queued message is counted only once it's queued (see below)
+            this->RecordSequence(sequence->first, sequence->second);
+        }
+        if (!events) {
+            // the last response is kept for the callers which poll
+            if (!handler) {
+                m_response = std::move(response);
+                return;
+            }
+            m_response = response;
+        }
+    } // Release
+    // called without the lock, the handler may send the next request
+    if (handler) {
+        handler(response);
+    }
+    else if (this->QueueEvent(*events, std::move(response)) && sequence) {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        this->RecordSequence(sequence->first, sequence->second);
+    }
+}
+
+void Client::RecordSequence(std::uint64_t chatroomId, std::uint64_t sequence) {
+    auto& last = m_sequences[chatroomId];
+    last = std::max(last, sequence);
+}
+
+bool Client::QueueEvent(EventQueue& events, Internal::Response&& response) {
+    events.m_received.fetch_add(1, std::memory_order_relaxed);
+    if (events.m_hasGap.load(std::memory_order_acquire)) {
+        // nothing after the dropped message is queued until the client resumes
+        events.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (events.m_ring.TryPush(response)) {
+        return true;
+    }
+    events.m_overflows.fetch_add(1, std::memory_order_relaxed);
+    switch (events.m_policy) {
+        case OverflowPolicy::DROP_OLDEST: {
+            Internal::Response oldest {};
+            do {
+                if (events.m_ring.TryPop(oldest)) {
+                    events.m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            } while (!events.m_ring.TryPush(response));
+        } return true;
+        case OverflowPolicy::DISCONNECT: {
+            // the client resumes the session and gets the missed messages replayed
+            events.m_dropped.fetch_add(1, std::memory_order_relaxed);
+            events.m_hasGap.store(true, std::memory_order_release);
+            m_connection->Close();
+        } break;
+        case OverflowPolicy::DROP_NEWEST: 
+        default: {
+            events.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        } break;
+    }
+    return false;
+}
+
+void Client::EnableEventQueue(std::size_t capacity, OverflowPolicy policy) {
+    std::atomic_store(&m_events, std::make_shared<EventQueue>(capacity, policy));
+}
+
+std::size_t Client::PollEvents(std::vector<Internal::Response>& batch, std::size_t limit) {
+    const auto events { std::atomic_load(&m_events) };
+    return events? events->m_ring.PopBatch(batch, limit): 0U;
+}
+
+Client::EventStats Client::GetEventStats() const {
+    const auto events { std::atomic_load(&m_events) };
+    EventStats stats {};
+    if (events) {
+        stats.m_received = events->m_received.load(std::memory_order_relaxed);
+        stats.m_dropped = events->m_dropped.load(std::memory_order_relaxed);
+        stats.m_overflows = events->m_overflows.load(std::memory_order_relaxed);
+        stats.m_queued = events->m_ring.GetSize();
+        stats.m_capacity = events->m_ring.GetCapacity();
+    }
+    return stats;
+}
+
+void Client::UpdateState(const Internal::Response& response) {
     switch(m_state) {
         case State::WAIT_ACK: {
         } break;
         case State::RECEIVE_ACK: {
             // TODO: send to gui or smth
-            switch(m_response.m_query) {
-                case Internal::QueryType::ACK:
+            switch(response.m_query) {
+                case Internal::QueryType::ACK: {
+                    // {"compression":{"algorithm":"deflate","threshold":N}}
+                    rapidjson::Document doc;
+                    doc.Parse(response.m_attachment.c_str());
+                    if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("compression") 
+                        && doc["compression"].IsObject()
+                    ) {
+                        const auto& compression = doc["compression"];
+                        if (compression.HasMember("threshold") && compression["threshold"].IsUint64()
+                            && compression.HasMember("algorithm") && compression["algorithm"].IsString()
+                            && compression["algorithm"].GetString() == Internal::DEFLATE
+                        ) {
+                            m_connection->EnableCompression(compression["threshold"].GetUint64());
+                            m_isCompressionEnabled = true;
+                        }
+                    }
+                    // {"resume":{"token":"...",...}}
+                    if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("resume") 
+                        && doc["resume"].IsObject() && doc["resume"].HasMember("token") 
+                        && doc["resume"]["token"].IsString()
+                    ) {
+                        m_resumeToken = doc["resume"]["token"].GetString();
+                    }
+                    // {"presence":{"limit":N}}
+                    if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("presence") 
+                        && doc["presence"].IsObject()
+                    ) {
+                        m_isPresenceEnabled = true;
+                    }
+                } break;
+                case Internal::QueryType::CHAT_MESSAGE:
+                    // the sequence number is recorded once the message is handled or queued
                 case Internal::QueryType::LIST_CHATROOM:
                 case Internal::QueryType::JOIN_CHATROOM:
                 case Internal::QueryType::CREATE_CHATROOM:
                 case Internal::QueryType::LEAVE_CHATROOM:
-                case Internal::QueryType::CHAT_MESSAGE:;
+                case Internal::QueryType::DIRECT_MESSAGE:
+                case Internal::QueryType::PRESENCE:
+                case Internal::QueryType::LIST_MEMBERS:;
                 default: break;
             }
         } break;
@@ -5,18 +5,29 @@
 #include <string_view>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
 
 #include "Message.hpp"
 #include "Utility.hpp"
+#include "RingBuffer.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
-// #ifndef UNIT_TESTS
+#ifdef CHAT_LOOPBACK_TRANSPORT
+#include "MockStream.hpp"
+#endif
+
+#ifndef CHAT_LOOPBACK_TRANSPORT
 using Stream_t = boost::asio::ip::tcp::socket;
-// #else
-// using Stream_t = MockAsyncStream;
-// #endif
+#else
+using Stream_t = MockSocket;
+#endif
 
 namespace client {
     template<class Stream>
@@ -56,6 +67,45 @@ public:
         COUNT
     };
 
+ 
+    /**
+     * Called with the reply to the request or with the message pushed by the server.
+     */
+    using ResponseHandler = std::function<void(const Internal::Response&)>;
+
+    /**
+     * What happens to a message when the event queue is full.
+     */
+    enum class OverflowPolicy {
+        /**
+         * The new message is dropped.
+         */
+        DROP_NEWEST,
+        /**
+         * The oldest queued messages are dropped to make room.
+         */
+        DROP_OLDEST,
+        /**
+         * The connection is closed, so nothing is lost silently: 
+         * the client reconnects and resumes the session (`RequestResume`).
+         */
+        DISCONNECT
+    };
+
+    struct EventStats {
+        /**
+         * Messages offered to the queue.
+         */
+        std::uint64_t m_received { 0 };
+        std::uint64_t m_dropped { 0 };
+        /**
+         * Times the queue was full.
+         */
+        std::uint64_t m_overflows { 0 };
+        std::size_t m_queued { 0 };
+        std::size_t m_capacity { 0 };
+    };
+
 public:
 
     Client(
@@ -91,6 +141,88 @@ public:
      *  Message in string format 
      */
     void Write(std::string text);
+
+    /**
+     * Send @request tagged by a new ID without waiting for the previous replies. 
+     * @handler is called (on the io thread) with the reply of the same ID. 
+     * If the connection is closed first, it's called with a reply 
+     * which has zero status and the error (right away if it's already closed).
+     * @return 
+     *  ID of the request.
+     */
+    std::uint64_t Send(Internal::Request request, ResponseHandler handler);
+
+    /**
+     * Send @request tagged by a new ID (see above).
+     * @return 
+     *  Future of the reply.
+     */
+    std::future<Internal::Response> Send(Internal::Request request);
+
+    /**
+     * Set @handler of the messages pushed by the server 
+     * (chat and direct messages of the other users), i.e. the responses 
+     * which don't match any request sent by `Send`.
+     */
+    void SetMessageHandler(ResponseHandler handler);
+
+    /**
+     * Number of the requests sent by `Send` which wait for their replies.
+     */
+    std::size_t GetPendingCount() const;
+
+    /**
+     * Queue every received message without a handler (pushed messages and 
+     * replies to the requests not sent by `Send`) in a lock-free ring of 
+     * @capacity messages, which the consumer thread drains by `PollEvents`. 
+     * `GetLastResponse` isn't updated then.
+     * @note
+     *  Call it before `Connect`.
+     */
+    void EnableEventQueue(std::size_t capacity, OverflowPolicy policy = OverflowPolicy::DROP_NEWEST);
+
+    /**
+     * Move up to @limit queued messages to the end of @batch, oldest first.
+     * Doesn't lock, it's meant for a single consumer thread.
+     * @return 
+     *  Number of the moved messages.
+     */
+    std::size_t PollEvents(std::vector<Internal::Response>& batch, std::size_t limit = 256);
+
+    EventStats GetEventStats() const;
+
+    /**
+     * Send SYN offering compression of the large frames.
+     * It's enabled on both sides when the server accepts it in ACK.
+     */
+    void RequestCompression();
+
+    bool IsCompressionEnabled() const noexcept;
+
+    /**
+     * Send SYN asking for the coalesced membership changes (`PRESENCE`) 
+     * of the subscribed chatrooms. It's enabled when the server accepts it in ACK.
+     */
+    void RequestPresence();
+
+    bool IsPresenceEnabled() const noexcept;
+
+    /**
+     * Send SYN presenting the resume token of the previous connection 
+     * and the last sequence number received from each chatroom. 
+     * The server restores the chatrooms and replays the missed messages.
+     */
+    void RequestResume();
+
+    /**
+     * Token given by the server in the last ACK. Empty if there was none.
+     */
+    std::string GetResumeToken() const;
+
+    /**
+     * Sequence number of the last message received from the chatroom.
+     */
+    std::uint64_t GetLastSequence(std::uint64_t chatroomId) const;
     
     void SetState(State state) noexcept;
 
@@ -98,7 +230,52 @@ public:
 
     Internal::Response GetLastResponse() const noexcept;
 
+    /**
+     * Number of responses received since the connection was established.
+     */
+    std::size_t GetResponseCount() const noexcept;
+
 private:
+    /**
+     * Keep @response as the last one and apply what it negotiates (ACK).
+     * @note
+     *  Require `m_mutex` to be locked.
+     */
+    void UpdateState(const Internal::Response& response);
+
+    struct EventQueue {
+        EventQueue(std::size_t capacity, OverflowPolicy policy) 
+            : m_ring { capacity }
+            , m_policy { policy }
+        {}
+
+        rt::RingBuffer<Internal::Response> m_ring;
+        const OverflowPolicy m_policy;
+        std::atomic<std::uint64_t> m_received { 0 };
+        std::atomic<std::uint64_t> m_dropped { 0 };
+        std::atomic<std::uint64_t> m_overflows { 0 };
+        /**
+         * A message was dropped by `OverflowPolicy::DISCONNECT`.
+         * The following ones aren't queued until the client connects again.
+         */
+        std::atomic<bool> m_hasGap { false };
+    };
+
+    /**
+     * Push @response to the queue applying the overflow policy.
+     * @return 
+     *  Whether @response was queued.
+     */
+    bool QueueEvent(EventQueue& events, Internal::Response&& response);
+
+    /**
+     * Remember the last message of the chatroom the client got, 
+     * it's where the replay starts on resume (see `RequestResume`).
+     * @note
+     *  Require `m_mutex` to be locked.
+     */
+    void RecordSequence(std::uint64_t chatroomId, std::uint64_t sequence);
+
     std::shared_ptr<boost::asio::io_context>    m_io { nullptr };
     std::shared_ptr<boost::asio::ssl::context>  m_sslContext { nullptr };
     std::shared_ptr<client::Connection_t>       m_connection { nullptr };
@@ -107,6 +284,24 @@ private:
     Internal::Response m_response;
     // TODO: maybe use atomic
     State m_state { State::CLOSED };
+    std::size_t m_responseCount { 0 };
+    bool m_isCompressionEnabled { false };
+    bool m_isPresenceEnabled { false };
+    std::string m_resumeToken {};
+    /**
+     * Handlers of the requests in flight by their IDs.
+     */
+    std::unordered_map<std::uint64_t, ResponseHandler> m_pending;
+    std::uint64_t m_lastRequestId { 0 };
+    ResponseHandler m_messageHandler { nullptr };
+    /**
+     * Queue of the received messages. Accessed atomically.
+     */
+    std::shared_ptr<EventQueue> m_events { nullptr };
+    /**
+     * Last sequence number received from each chatroom.
+     */
+    std::unordered_map<std::uint64_t, std::uint64_t> m_sequences;
     mutable std::mutex m_mutex;
 };
 
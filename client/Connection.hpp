@@ -6,8 +6,12 @@
 #include <cstdint>
 #include <cstddef>
 #include <functional>
+#include <type_traits>
 
 #include "DoubleBuffer.hpp"
+#include "HandlerAllocator.hpp"
+#include "Compression.hpp"
+#include "FrameLayer.hpp"
 #include "Message.hpp"
 #include "Log.hpp"
 #include "Client.hpp"
@@ -17,11 +21,11 @@
 
 
 /** TODO: implement these functions for Stream
- * - [ ] close
- * - [ ] shutdown
- * - [ ] async_connect
- * - [ ] remote_endpoint
- * - [ ] constructor
+ * - [x] close
+ * - [x] shutdown
+ * - [x] async_connect
+ * - [x] remote_endpoint
+ * - [x] constructor
  * - [x] async_write_some
  * - [x] async_read_some
 */
@@ -56,6 +60,12 @@ public:
 
     void Write(std::string text);
 
+    /**
+     * Compress outgoing frames of at least @threshold bytes
+     * (the delimiter included) once the server accepted it.
+     */
+    void EnableCompression(std::size_t threshold);
+
     void Close();
 
 private:
@@ -106,6 +116,21 @@ private:
     bool m_isWriting { false };
     boost::asio::streambuf m_inbox;
     Buffers m_outbox;
+
+    /**
+     * Recycled memory of the handshake & read operations 
+     * and of the write operations respectively.
+     */
+    Internal::HandlerMemory m_readMemory;
+    Internal::HandlerMemory m_writeMemory;
+
+    std::unique_ptr<Internal::FrameDeflater> m_deflater { nullptr };
+    std::size_t m_compressionThreshold { 0 };
+    /**
+     * Created with the first compressed frame from the server.
+     */
+    std::unique_ptr<Internal::FrameInflater> m_inflater { nullptr };
+    std::string m_decompressed;
 };
 
 template<class Stream>
@@ -157,17 +182,26 @@ void Connection<Stream>::Connect(std::string_view path, std::string_view port) {
         this->Close();
     }
     else {
-        boost::asio::async_connect(
-            m_stream.lowest_layer(),
-            endpoints, 
-            std::bind(&Connection::OnConnect, this->shared_from_this(), _1, _2)
-        );
+        if constexpr (std::is_same_v<Stream, boost::asio::ip::tcp::socket>) {
+            boost::asio::async_connect(
+                m_stream.lowest_layer(),
+                endpoints, 
+                std::bind(&Connection::OnConnect, this->shared_from_this(), _1, _2)
+            );
+        }
+        else {
+            // in-memory stream provides own connect operation
+            m_stream.lowest_layer().async_connect(
+                endpoints, 
+                std::bind(&Connection::OnConnect, this->shared_from_this(), _1, _2)
+            );
+        }
     }
 }
 
 template<class Stream>
 void Connection<Stream>::Handshake() {
-    m_stream.async_handshake(boost::asio::ssl::stream_base::client,
+    auto onHandshake = Internal::MakeAllocatingHandler(m_readMemory, 
         [self = this->shared_from_this()] (const boost::system::error_code& error) {
             if (!error) {
                 if(auto model = self->m_client.lock(); model) {
@@ -180,8 +214,13 @@ void Connection<Stream>::Handshake() {
             else {
                 self->m_logger.Write(LogType::error, "Handshake failed:", error.message(), "\n");
             }
-        }
-    );
+        });
+#ifdef CHAT_LOOPBACK_PLAINTEXT
+    // nothing to negotiate over the plaintext loopback
+    boost::asio::post(m_strand, std::bind(std::move(onHandshake), boost::system::error_code {}));
+#else
+    m_stream.async_handshake(boost::asio::ssl::stream_base::client, std::move(onHandshake));
+#endif
 }
 
 template<class Stream>
@@ -233,15 +272,17 @@ void Connection<Stream>::Close() {
 template<class Stream>
 void Connection<Stream>::Read() {
     boost::asio::async_read_until(
-        m_stream,
+        net::GetFrameLayer(m_stream),
         m_inbox,
         Internal::MESSAGE_DELIMITER,
         boost::asio::bind_executor(
             m_strand,
-            std::bind(&Connection::OnRead, 
-                this->shared_from_this(), 
-                std::placeholders::_1, 
-                std::placeholders::_2
+            Internal::MakeAllocatingHandler(m_readMemory, 
+                std::bind(&Connection::OnRead, 
+                    this->shared_from_this(), 
+                    std::placeholders::_1, 
+                    std::placeholders::_2
+                )
             )
         )
     );
@@ -252,14 +293,16 @@ void Connection<Stream>::Write() {
     m_isWriting = true;
     m_outbox.SwapBuffers();
     boost::asio::async_write(
-        m_stream,
+        net::GetFrameLayer(m_stream),
         m_outbox.GetBufferSequence(),
         boost::asio::bind_executor(
             m_strand,
-            std::bind(&Connection::OnWrite, 
-                this->shared_from_this(), 
-                std::placeholders::_1, 
-                std::placeholders::_2
+            Internal::MakeAllocatingHandler(m_writeMemory, 
+                std::bind(&Connection::OnWrite, 
+                    this->shared_from_this(), 
+                    std::placeholders::_1, 
+                    std::placeholders::_2
+                )
             )
         )
     );
@@ -270,6 +313,15 @@ void Connection<Stream>::Write(std::string text) {
     // using strand we prevent concurrent access to variables and 
     // concurrent writing to socket. 
     boost::asio::post(m_strand, [text = std::move(text), self = this->shared_from_this()]() mutable {
+        if (self->m_deflater && text.size() >= self->m_compressionThreshold) {
+            std::string frame;
+            const std::string_view payload { 
+                text.data(), text.size() - Internal::MESSAGE_DELIMITER.size() 
+            };
+            if (self->m_deflater->Compress(payload, frame)) {
+                text = std::move(frame);
+            }
+        }
         self->m_outbox.Enque(std::move(text));
         if (!self->m_isWriting) {
             self->Write();
@@ -277,6 +329,16 @@ void Connection<Stream>::Write(std::string text) {
     });
 }
 
+template<class Stream>
+void Connection<Stream>::EnableCompression(std::size_t threshold) {
+    boost::asio::post(m_strand, [threshold, self = this->shared_from_this()]() {
+        if (!self->m_deflater) {
+            self->m_deflater = std::make_unique<Internal::FrameDeflater>();
+        }
+        self->m_compressionThreshold = threshold;
+    });
+}
+
 template<class Stream>
 void Connection<Stream>::OnRead(
     const boost::system::error_code& error, 
@@ -293,6 +355,17 @@ void Connection<Stream>::OnRead(
         m_inbox.consume(transferredBytes);
         
         Internal::Response incomingResponse;
+        if (Internal::IsCompressedFrame(received)) {
+            if (!m_inflater) {
+                m_inflater = std::make_unique<Internal::FrameInflater>();
+            }
+            if (!m_inflater->Decompress(received, m_decompressed)) {
+                m_logger.Write(LogType::error, "Connection failed to decompress frame\n");
+                this->Close();
+                return;
+            }
+            received.swap(m_decompressed);
+        }
         incomingResponse.Read(received);
         
         boost::system::error_code error; 
@@ -0,0 +1,117 @@
+#ifndef INTERNAL_COMPRESSION_HPP
+#define INTERNAL_COMPRESSION_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Internal {
+
+    /**
+     * Name of the only supported algorithm used during negotiation (SYN/ACK).
+     */
+    const std::string DEFLATE { "deflate" };
+
+    /**
+     * Compressed frames start with this mark instead of '{':
+     * @code
+     * ~<base64 of the deflated json>\r\n\r\n
+     * @endcode
+     * Base64 keeps the MESSAGE_DELIMITER out of the compressed bytes.
+     */
+    constexpr char COMPRESSED_FRAME_MARK { '~' };
+
+    inline bool IsCompressedFrame(std::string_view frame) noexcept {
+        return !frame.empty() && frame.front() == COMPRESSED_FRAME_MARK;
+    }
+
+    /**
+     * Compress outgoing frames of a single connection.
+     * The deflate stream is never reset: each frame is flushed 
+     * and the next one can refer to the data of the previous frames.
+     * That's why frames must be decompressed in the same order 
+     * by a single `FrameInflater`.
+     * 
+     * Not thread safe. 
+     */
+    class FrameDeflater final {
+    public:
+        /**
+         * @param level
+         *  zlib compression level [1, 9]
+         */
+        explicit FrameDeflater(int level = 6);
+
+        ~FrameDeflater();
+
+        FrameDeflater(const FrameDeflater&) = delete;
+        FrameDeflater& operator=(const FrameDeflater&) = delete;
+
+        /**
+         * @param payload
+         *  A serialized message without the MESSAGE_DELIMITER.
+         * @param[out] frame
+         *  Compressed frame ready to be written (with the delimiter).
+         * @return
+         *  Whether the payload was compressed.
+         */
+        bool Compress(std::string_view payload, std::string& frame);
+
+    private:
+        struct Stream;
+
+        std::unique_ptr<Stream> m_stream;
+
+        /**
+         * Deflated bytes of the last frame (reused).
+         */
+        std::string m_buffer;
+    };
+
+    /**
+     * Decompress incoming frames compressed by `FrameDeflater`.
+     * 
+     * Not thread safe. 
+     */
+    class FrameInflater final {
+    public:
+        FrameInflater();
+
+        ~FrameInflater();
+
+        FrameInflater(const FrameInflater&) = delete;
+        FrameInflater& operator=(const FrameInflater&) = delete;
+
+        /**
+         * @param frame
+         *  A compressed frame without the MESSAGE_DELIMITER.
+         * @param[out] payload
+         *  The original serialized message.
+         * @param limit
+         *  Maximum size of the payload. Zero means no limit.
+         * @return
+         *  Whether the frame was decompressed. 
+         *  The stream is broken if it failed.
+         */
+        bool Decompress(std::string_view frame, std::string& payload, std::size_t limit = 0);
+
+        /**
+         * Whether the last `Decompress` failed because the payload was over the limit.
+         */
+        bool IsOverLimit() const noexcept;
+
+    private:
+        struct Stream;
+
+        std::unique_ptr<Stream> m_stream;
+
+        /**
+         * Decoded base64 of the last frame (reused).
+         */
+        std::string m_buffer;
+    };
+
+}
+
+#endif // INTERNAL_COMPRESSION_HPP
\ No newline at end of file
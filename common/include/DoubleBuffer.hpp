@@ -35,6 +35,33 @@ public:
         return m_buffers[m_activeBuffer ^ 1].size();
     } 
 
+    /**
+     * Number of bytes queued to the passive buffer, i.e. waiting for the next write.
+     */
+    std::size_t GetQueueBytes() const noexcept {
+        return m_queuedBytes;
+    }
+
+    /**
+     * Number of bytes held by both buffers: queued and being written (or just written).
+     */
+    std::size_t GetHeldBytes() const noexcept {
+        return m_queuedBytes + m_activeBytes;
+    }
+
+    /**
+     * Drop all queued data but keep the capacity of the buffers.
+     */
+    void Clear();
+
+    /**
+     * Approximate number of bytes reserved by the buffer sequences.
+     */
+    std::size_t GetReservedBytes() const noexcept {
+        return (m_buffers[0].capacity() + m_buffers[1].capacity()) * sizeof(std::string)
+            + m_bufferSequence.capacity() * sizeof(asio::const_buffer);
+    }
+
     const std::vector<asio::const_buffer>& GetBufferSequence() const noexcept {
         return m_bufferSequence;
     }
@@ -56,6 +83,10 @@ private:
     std::vector<asio::const_buffer> m_bufferSequence;
     
     std::size_t m_activeBuffer { 0 };
+
+    std::size_t m_queuedBytes { 0 };
+
+    std::size_t m_activeBytes { 0 };
 };
 
 #endif // DOUBLE_BUFFER_HPP
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef FRAME_LAYER_HPP
+#define FRAME_LAYER_HPP
+
+namespace net {
+
+    /**
+     * Layer of the TLS @stream the frames are read from and written to: 
+     * the stream itself, or its socket when the loopback transport is plaintext 
+     * (no handshake either). Shared by the server and the client.
+     */
+    template<class TlsStream>
+    auto& GetFrameLayer(TlsStream& stream) noexcept {
+#ifdef CHAT_LOOPBACK_PLAINTEXT
+        return stream.next_layer();
+#else
+        return stream;
+#endif
+    }
+
+} // namespace net
+
+#endif // FRAME_LAYER_HPP
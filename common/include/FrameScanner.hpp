@@ -0,0 +1,78 @@
+#ifndef INTERNAL_FRAME_SCANNER_HPP
+#define INTERNAL_FRAME_SCANNER_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <string_view>
+
+#include "Message.hpp"
+
+namespace Internal {
+
+    /**
+     * Find the first MESSAGE_DELIMITER in @data starting from @from.
+     * Candidates are located with `memchr` (vectorized by the C library),
+     * only then the rest of the delimiter is compared.
+     * @return
+     *  Offset of the delimiter or `std::string_view::npos`.
+     */
+    inline std::size_t FindDelimiter(std::string_view data, std::size_t from = 0) noexcept {
+        const std::string_view delimiter { MESSAGE_DELIMITER };
+        const char * const begin { data.data() };
+        const char * const end { begin + data.size() };
+        const char * cursor { begin + from };
+        while (static_cast<std::size_t>(end - cursor) >= delimiter.size()) {
+            const auto rest { static_cast<std::size_t>(end - cursor) - delimiter.size() + 1 };
+            cursor = static_cast<const char*>(std::memchr(cursor, delimiter.front(), rest));
+            if (!cursor) {
+                break;
+            }
+            if (std::memcmp(cursor, delimiter.data(), delimiter.size()) == 0) {
+                return static_cast<std::size_t>(cursor - begin);
+            }
+            ++cursor;
+        }
+        return std::string_view::npos;
+    }
+
+    /**
+     * Extract every complete frame from @data, which is an inbox growing between the calls.
+     * @param scanned
+     *  Length of the partial frame searched by the previous call (zero at first), 
+     *  the search resumes near its end instead of rescanning the whole partial frame. 
+     *  Set to the length of the partial frame left in @data.
+     * @param callback
+     *  Invoked as `callback(std::string_view frame)` for each frame
+     *  in the order of arrival. The frame doesn't include the delimiter.
+     * @return
+     *  Number of bytes occupied by the complete frames.
+     *  The rest is a partial frame which must be kept for the next read.
+     */
+    template<class Callback>
+    std::size_t ExtractFrames(std::string_view data, std::size_t& scanned, Callback&& callback) {
+        // the delimiter may have started at the end of the searched part
+        const std::size_t overlap { MESSAGE_DELIMITER.size() - 1 };
+        const std::size_t from { scanned > overlap? std::min(scanned - overlap, data.size()): 0 };
+        std::size_t consumed { 0 };
+        for (auto pos = FindDelimiter(data, from); pos != std::string_view::npos; pos = FindDelimiter(data, consumed)) {
+            callback(data.substr(consumed, pos - consumed));
+            consumed = pos + MESSAGE_DELIMITER.size();
+        }
+        scanned = data.size() - consumed;
+        return consumed;
+    }
+
+    /**
+     * Extract every complete frame from @data searching it from the beginning.
+     * @see ExtractFrames(std::string_view, std::size_t&, Callback&&)
+     */
+    template<class Callback>
+    std::size_t ExtractFrames(std::string_view data, Callback&& callback) {
+        std::size_t scanned { 0 };
+        return ExtractFrames(data, scanned, std::forward<Callback>(callback));
+    }
+}
+
+#endif // INTERNAL_FRAME_SCANNER_HPP
\ No newline at end of file
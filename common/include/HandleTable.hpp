@@ -0,0 +1,282 @@
+#ifndef RT_HANDLE_TABLE_HPP
+#define RT_HANDLE_TABLE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace rt {
+
+/**
+ * Slot map: objects are addressed by 64-bit handles {generation, index}.
+ * Allocation, release and lookup don't take a lock: the free slots are kept 
+ * in a tagged lock-free stack, the slots are allocated in chunks which are never freed.
+ * A released slot gets the next generation, so a stale handle is detected 
+ * by one comparison and never resolves to the object which reused the slot.
+ * 
+ * The generation of a live slot is odd, so a valid handle is never zero.
+ */
+template<class T>
+class HandleTable final {
+public:
+    using Handle = std::uint64_t;
+
+    /**
+     * Never returned by `Allocate`.
+     */
+    static constexpr Handle NONE { 0 };
+
+    static constexpr std::size_t CHUNK_SIZE { 4096 };
+
+    static constexpr std::size_t MAX_CHUNKS { 1024 };
+
+    static constexpr std::size_t MAX_SIZE { CHUNK_SIZE * MAX_CHUNKS };
+
+    HandleTable() = default;
+
+    HandleTable(const HandleTable&) = delete;
+    HandleTable& operator=(const HandleTable&) = delete;
+
+    ~HandleTable() {
+        for (auto& chunk: m_chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    static std::uint32_t GetIndex(Handle handle) noexcept {
+        return static_cast<std::uint32_t>(handle);
+    }
+
+    static std::uint32_t GetGeneration(Handle handle) noexcept {
+        return static_cast<std::uint32_t>(handle >> 32U);
+    }
+
+    /**
+     * Reserve a slot. It's empty until `Set` is called.
+     * @return
+     *  NONE if all MAX_SIZE slots are in use.
+     */
+    Handle Allocate() {
+        std::uint32_t index { 0 };
+        if (!this->PopFree(index)) {
+            const auto fresh { m_used.fetch_add(1U, std::memory_order_relaxed) };
+            if (fresh >= MAX_SIZE) {
+                m_used.fetch_sub(1U, std::memory_order_relaxed);
+                return NONE;
+            }
+            index = static_cast<std::uint32_t>(fresh);
+            this->MakeChunk(index / CHUNK_SIZE);
+        }
+        auto& slot { this->GetSlot(index) };
+        // the slot is owned by this thread until the handle is published
+        const auto generation { slot.m_generation.load(std::memory_order_relaxed) + 1U };
+        slot.m_generation.store(generation, std::memory_order_release);
+        m_size.fetch_add(1U, std::memory_order_relaxed);
+        return MakeHandle(generation, index);
+    }
+
+    /**
+     * Reserve the slot of @handle issued by another table, 
+     * e.g. the one of the previous server. It's empty until `Set` is called.
+     * The slots before it are left free.
+     * @return
+     *  False if the slot was taken from the chunks already: 
+     *  adopt the handles in order of their indexes before any `Allocate`.
+     * @note
+     *  Thread-safety: NOT-safe, nothing else may use the table meanwhile.
+     */
+    bool Adopt(Handle handle) {
+        const auto index { GetIndex(handle) };
+        const auto generation { GetGeneration(handle) };
+        if (generation % 2U == 0U || index >= MAX_SIZE 
+            || index < m_used.load(std::memory_order_relaxed)
+        ) {
+            return false;
+        }
+        for (auto fresh = m_used.load(std::memory_order_relaxed); fresh <= index; fresh++) {
+            this->MakeChunk(fresh / CHUNK_SIZE);
+            if (fresh != index) {
+                this->PushFree(static_cast<std::uint32_t>(fresh));
+            }
+        }
+        m_used.store(static_cast<std::size_t>(index) + 1U, std::memory_order_relaxed);
+        this->GetSlot(index).m_generation.store(generation, std::memory_order_release);
+        m_size.fetch_add(1U, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Put @value into the slot of @handle.
+     * @return
+     *  False if the handle is stale.
+     */
+    bool Set(Handle handle, std::shared_ptr<T> value) {
+        auto *slot { this->FindSlot(handle) };
+        if (!slot) {
+            return false;
+        }
+        std::atomic_store_explicit(&slot->m_value, std::move(value), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @return
+     *  nullptr if the handle is stale (released) or nothing was set yet.
+     */
+    std::shared_ptr<T> Find(Handle handle) const {
+        const auto *slot { this->FindSlot(handle) };
+        if (!slot) {
+            return nullptr;
+        }
+        auto value { std::atomic_load_explicit(&slot->m_value, std::memory_order_acquire) };
+        // the slot could be released (and reused) while the value was loaded
+        if (slot->m_generation.load(std::memory_order_acquire) != GetGeneration(handle)) {
+            return nullptr;
+        }
+        return value;
+    }
+
+    bool IsValid(Handle handle) const noexcept {
+        return this->FindSlot(handle) != nullptr;
+    }
+
+    /**
+     * Drop the value and invalidate @handle. The slot is reused with the next generation.
+     * @return
+     *  False if the handle was already stale.
+     */
+    bool Release(Handle handle) {
+        auto *slot { const_cast<Slot*>(this->FindSlot(handle)) };
+        if (!slot) {
+            return false;
+        }
+        auto generation { GetGeneration(handle) };
+        // only one of the concurrent releases succeeds
+        if (!slot->m_generation.compare_exchange_strong(generation, generation + 1U, std::memory_order_acq_rel)) {
+            return false;
+        }
+        std::atomic_store_explicit(&slot->m_value, std::shared_ptr<T>{}, std::memory_order_release);
+        m_size.fetch_sub(1U, std::memory_order_relaxed);
+        this->PushFree(GetIndex(handle));
+        return true;
+    }
+
+    /**
+     * Number of allocated handles.
+     */
+    std::size_t GetSize() const noexcept {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<std::uint32_t> m_generation { 0 };
+        /**
+         * Index + 1 of the next free slot, 0 terminates the list.
+         */
+        std::atomic<std::uint32_t> m_next { 0 };
+        std::shared_ptr<T> m_value { nullptr };
+    };
+
+    static Handle MakeHandle(std::uint32_t generation, std::uint32_t index) noexcept {
+        return (static_cast<Handle>(generation) << 32U) | index;
+    }
+
+    Slot& GetSlot(std::uint32_t index) const noexcept {
+        return m_chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+    }
+
+    /**
+     * @return
+     *  The live slot of @handle or nullptr.
+     */
+    const Slot* FindSlot(Handle handle) const noexcept {
+        const auto generation { GetGeneration(handle) };
+        const auto index { GetIndex(handle) };
+        if (generation % 2U == 0U || index / CHUNK_SIZE >= MAX_CHUNKS) {
+            return nullptr;
+        }
+        const auto *chunk { m_chunks[index / CHUNK_SIZE].load(std::memory_order_acquire) };
+        if (!chunk) {
+            return nullptr;
+        }
+        const auto& slot { chunk[index % CHUNK_SIZE] };
+        if (slot.m_generation.load(std::memory_order_acquire) != generation) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    Slot* FindSlot(Handle handle) noexcept {
+        return const_cast<Slot*>(static_cast<const HandleTable&>(*this).FindSlot(handle));
+    }
+
+    void MakeChunk(std::size_t chunk) {
+        if (m_chunks[chunk].load(std::memory_order_acquire)) {
+            return;
+        }
+        Slot *expected { nullptr };
+        auto *slots { new Slot[CHUNK_SIZE] };
+        if (!m_chunks[chunk].compare_exchange_strong(expected, slots, std::memory_order_acq_rel)) {
+            // another thread was first
+            delete[] slots;
+        }
+    }
+
+    /**
+     * The head of the free list keeps a tag in its upper half, 
+     * so a slot popped and pushed back in the meantime fails the CAS (ABA).
+     */
+    void PushFree(std::uint32_t index) {
+        auto& slot { this->GetSlot(index) };
+        auto head { m_free.load(std::memory_order_relaxed) };
+        do {
+            slot.m_next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+        } while (!m_free.compare_exchange_weak(head, 
+            NextTag(head) | (static_cast<std::uint64_t>(index) + 1U), 
+            std::memory_order_release, std::memory_order_relaxed
+        ));
+    }
+
+    bool PopFree(std::uint32_t& index) {
+        auto head { m_free.load(std::memory_order_acquire) };
+        for (;;) {
+            const auto top { static_cast<std::uint32_t>(head) };
+            if (top == 0U) {
+                return false;
+            }
+            // the slots are never freed, so reading a popped slot is harmless: the CAS fails
+            const auto next { this->GetSlot(top - 1U).m_next.load(std::memory_order_relaxed) };
+            if (m_free.compare_exchange_weak(head, NextTag(head) | next, 
+                std::memory_order_acquire, std::memory_order_acquire
+            )) {
+                index = top - 1U;
+                return true;
+            }
+        }
+    }
+
+    static std::uint64_t NextTag(std::uint64_t head) noexcept {
+        return ((head >> 32U) + 1U) << 32U;
+    }
+
+    mutable std::array<std::atomic<Slot*>, MAX_CHUNKS> m_chunks {};
+
+    /**
+     * {tag, index + 1} of the first free slot.
+     */
+    std::atomic<std::uint64_t> m_free { 0 };
+
+    /**
+     * Slots taken from the chunks so far (free or not).
+     */
+    std::atomic<std::size_t> m_used { 0 };
+
+    std::atomic<std::size_t> m_size { 0 };
+};
+
+} // namespace rt
+
+#endif // RT_HANDLE_TABLE_HPP
\ No newline at end of file
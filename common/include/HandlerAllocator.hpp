@@ -0,0 +1,138 @@
+#ifndef INTERNAL_HANDLER_ALLOCATOR_HPP
+#define INTERNAL_HANDLER_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Internal {
+
+    /**
+     * A single block of memory recycled between completion handlers
+     * of one chain of asynchronous operations (e.g. reads of a connection).
+     * Asio frees the memory of an operation before it invokes the handler,
+     * so the next operation initiated by this handler reuses the same block.
+     * 
+     * Not thread safe: at most one operation of the chain can be outstanding.
+     */
+    class HandlerMemory final {
+    public:
+        HandlerMemory() = default;
+
+        HandlerMemory(const HandlerMemory&) = delete;
+        HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+        void* Allocate(std::size_t size) {
+            if (!m_isUsed && size <= sizeof(m_storage)) {
+                m_isUsed = true;
+                return &m_storage;
+            }
+            // the block is busy or too small
+            return ::operator new(size);
+        }
+
+        void Deallocate(void *pointer) noexcept {
+            if (pointer == &m_storage) {
+                m_isUsed = false;
+            }
+            else {
+                ::operator delete(pointer);
+            }
+        }
+
+    private:
+        /**
+         * Enough for an ssl operation composed with a strand.
+         */
+        static constexpr std::size_t SIZE { 1024 };
+
+        std::aligned_storage_t<SIZE, alignof(std::max_align_t)> m_storage;
+
+        bool m_isUsed { false };
+    };
+
+    /**
+     * Minimal allocator over the `HandlerMemory`.
+     */
+    template<class T>
+    class HandlerAllocator {
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemory& memory) noexcept
+            : m_memory { &memory }
+        {
+        }
+
+        template<class U>
+        HandlerAllocator(const HandlerAllocator<U>& other) noexcept
+            : m_memory { other.m_memory }
+        {
+        }
+
+        bool operator==(const HandlerAllocator& rhs) const noexcept {
+            return m_memory == rhs.m_memory;
+        }
+
+        bool operator!=(const HandlerAllocator& rhs) const noexcept {
+            return m_memory != rhs.m_memory;
+        }
+
+        T* allocate(std::size_t n) const {
+            return static_cast<T*>(m_memory->Allocate(sizeof(T) * n));
+        }
+
+        void deallocate(T *pointer, std::size_t /* n */) const noexcept {
+            m_memory->Deallocate(pointer);
+        }
+
+    private:
+        template<class> friend class HandlerAllocator;
+
+        HandlerMemory *m_memory;
+    };
+
+    /**
+     * Wrap a completion handler to associate `HandlerAllocator` with it.
+     * Asio finds it through `associated_allocator`, 
+     * which is forwarded by `bind_executor` and composed operations, 
+     * so it must be the innermost wrapper:
+     * `bind_executor(strand, MakeAllocatingHandler(memory, handler))`.
+     */
+    template<class Handler>
+    class AllocatingHandler {
+    public:
+        using allocator_type = HandlerAllocator<Handler>;
+
+        AllocatingHandler(HandlerMemory& memory, Handler&& handler)
+            : m_memory { &memory }
+            , m_handler { std::move(handler) }
+        {
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type{ *m_memory };
+        }
+
+        template<class ...Args>
+        void operator()(Args&& ...args) {
+            m_handler(std::forward<Args>(args)...);
+        }
+
+    private:
+        HandlerMemory *m_memory;
+        Handler m_handler;
+    };
+
+    template<class Handler>
+    AllocatingHandler<std::decay_t<Handler>> MakeAllocatingHandler(
+        HandlerMemory& memory, 
+        Handler&& handler
+    ) {
+        return { memory, std::decay_t<Handler>{ std::forward<Handler>(handler) } };
+    }
+
+} // namespace Internal
+
+#endif // INTERNAL_HANDLER_ALLOCATOR_HPP
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef RT_INSTANCE_COUNTER_HPP
+#define RT_INSTANCE_COUNTER_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace rt {
+
+/**
+ * Count live objects of @T. Derive @T from `InstanceCounter<T>`:
+ * `T::GetLiveCount()` then tells how many of them exist right now.
+ * Used by the soak test to see whether the objects are leaked.
+ */
+template<class T>
+class InstanceCounter {
+public:
+    static std::size_t GetLiveCount() noexcept {
+        return m_live.load(std::memory_order_relaxed);
+    }
+
+protected:
+    InstanceCounter() noexcept {
+        m_live.fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    InstanceCounter(const InstanceCounter&) noexcept {
+        m_live.fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    InstanceCounter& operator=(const InstanceCounter&) noexcept = default;
+
+    ~InstanceCounter() {
+        m_live.fetch_sub(1U, std::memory_order_relaxed);
+    }
+
+private:
+    inline static std::atomic<std::size_t> m_live { 0 };
+};
+
+} // namespace rt
+
+#endif // RT_INSTANCE_COUNTER_HPP
\ No newline at end of file
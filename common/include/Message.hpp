@@ -53,6 +53,12 @@ namespace Internal {
          * is valid and can be processed.
          */
         std::uint64_t m_timeout { 0 };
+
+        /**
+         * ID assigned by the client to match the reply with the request. 
+         * Zero means the request isn't tracked. It isn't serialized then.
+         */
+        std::uint64_t m_id { 0 };
         
         /**
          * This is a data required for the choosen query type.
@@ -105,6 +111,12 @@ namespace Internal {
          */
         std::string m_error {};
 
+        /**
+         * ID of the request this is the reply to. 
+         * Zero for the messages pushed by the server (e.g. chat messages of the other users).
+         */
+        std::uint64_t m_id { 0 };
+
         /**
          * This is a data required for the choosen query type.
          * It's given in JSON format - serialized json object with fields.  
@@ -127,6 +139,17 @@ namespace Internal {
          */
         void Write(std::string& json) const override;
 
+        /**
+         * Serialize this instance with the given attachment instead of 
+         * m_attachment. It lets a large shared attachment (e.g. the cached 
+         * chatroom list) be written into the frame without copying it first.
+         * @param[out] json
+         *  String which will hold serialized value. 
+         * @param attachment
+         *  Serialized json object, ignored if empty.
+         */
+        void Write(std::string& json, const std::string& attachment) const;
+
     };
 
 }
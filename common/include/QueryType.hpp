@@ -19,6 +19,15 @@ namespace Internal {
         CREATE_CHATROOM,
         LIST_CHATROOM,
         CHAT_MESSAGE,
+        DIRECT_MESSAGE,
+
+        // membership of the chatroom: 
+        // deltas pushed by the server and the member list on demand
+        PRESENCE,
+        LIST_MEMBERS,
+
+        // server-to-server link
+        FEDERATION,
 
         COUNT
     };
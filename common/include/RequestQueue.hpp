@@ -3,6 +3,7 @@
 
 #include <queue>
 #include <mutex>
+#include <vector>
 
 #include "Message.hpp"
 
@@ -35,6 +36,16 @@ public:
         m_queue.emplace(std::move(request));
     }
 
+    /**
+     * Push all requests extracted from a single read under one lock.
+     */
+    void Push(std::vector<Internal::Request>&& batch) {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        for (auto& request: batch) {
+            m_queue.emplace(std::move(request));
+        }
+    }
+
     void Pop() {
         std::lock_guard<std::mutex> lock{ m_mutex };
         m_queue.pop();
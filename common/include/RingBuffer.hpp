@@ -0,0 +1,156 @@
+#ifndef RT_RING_BUFFER_HPP
+#define RT_RING_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rt {
+
+/**
+ * Bounded lock-free queue (D. Vyukov's ring): each cell has a sequence number 
+ * which tells the producers and the consumers whose turn it is.
+ * Any number of threads may push and pop; neither side takes a lock 
+ * and the elements are never allocated after construction.
+ */
+template<class T>
+class RingBuffer final {
+public:
+    /**
+     * @param capacity
+     *  Rounded up to the power of two (at least 2).
+     */
+    explicit RingBuffer(std::size_t capacity) 
+        : m_mask { RoundUp(capacity) - 1U }
+        , m_cells { std::make_unique<Cell[]>(m_mask + 1U) }
+    {
+        for (std::size_t i = 0; i <= m_mask; i++) {
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /**
+     * Move @value to the tail of the queue.
+     * @return 
+     *  False if the queue is full, @value is left intact then.
+     */
+    bool TryPush(T& value) {
+        auto position { m_tail.load(std::memory_order_relaxed) };
+        Cell* cell { nullptr };
+        for (;;) {
+            cell = &m_cells[position & m_mask];
+            const auto sequence { cell->m_sequence.load(std::memory_order_acquire) };
+            const auto diff { static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position) };
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->m_value = std::move(value);
+        cell->m_sequence.store(position + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Move the head of the queue to @value.
+     * @return 
+     *  False if the queue is empty.
+     */
+    bool TryPop(T& value) {
+        auto position { m_head.load(std::memory_order_relaxed) };
+        Cell* cell { nullptr };
+        for (;;) {
+            cell = &m_cells[position & m_mask];
+            const auto sequence { cell->m_sequence.load(std::memory_order_acquire) };
+            const auto diff { static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1U) };
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->m_value);
+        // the cell is free for the producer of the next lap
+        cell->m_sequence.store(position + m_mask + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Move up to @limit elements from the head of the queue to the end of @batch.
+     * @return 
+     *  Number of the moved elements.
+     */
+    std::size_t PopBatch(std::vector<T>& batch, std::size_t limit) {
+        std::size_t count { 0 };
+        T value {};
+        while (count < limit && this->TryPop(value)) {
+            batch.push_back(std::move(value));
+            count++;
+        }
+        return count;
+    }
+
+    std::size_t GetCapacity() const noexcept {
+        return m_mask + 1U;
+    }
+
+    /**
+     * Number of the queued elements. It's approximate while the queue is used.
+     */
+    std::size_t GetSize() const noexcept {
+        const auto tail { m_tail.load(std::memory_order_acquire) };
+        const auto head { m_head.load(std::memory_order_acquire) };
+        return tail > head? tail - head: 0U;
+    }
+
+private:
+    static std::size_t RoundUp(std::size_t capacity) noexcept {
+        std::size_t rounded { 2 };
+        while (rounded < capacity) {
+            rounded <<= 1U;
+        }
+        return rounded;
+    }
+
+    struct Cell {
+        std::atomic<std::size_t> m_sequence { 0 };
+        T m_value {};
+    };
+
+    const std::size_t m_mask;
+
+    const std::unique_ptr<Cell[]> m_cells;
+
+    /**
+     * Position of the next push. Kept apart from the head, 
+     * so producers and consumers don't share the cache line.
+     */
+    alignas(64) std::atomic<std::size_t> m_tail { 0 };
+
+    /**
+     * Position of the next pop.
+     */
+    alignas(64) std::atomic<std::size_t> m_head { 0 };
+};
+
+} // namespace rt
+
+#endif // RT_RING_BUFFER_HPP
\ No newline at end of file
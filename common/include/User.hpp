@@ -1,6 +1,7 @@
 #ifndef CHAT_USER_HPP
 #define CHAT_USER_HPP
 
+#include <atomic>
 #include <string>
 #include <cstdint>
 
@@ -23,7 +24,10 @@ namespace Internal {
     private:
         User(std::uint64_t id);
 
-        inline static std::uint64_t m_instance { 0 }; 
+        /**
+         * Users are created by several threads (each accepted session has one).
+         */
+        inline static std::atomic<std::uint64_t> m_instance { 0 }; 
     };
 }
 
@@ -0,0 +1,204 @@
+#include "Compression.hpp"
+#include "Message.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include <zlib.h>
+
+namespace {
+
+    constexpr char BASE64_ALPHABET[] { 
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" 
+    };
+
+    constexpr std::array<std::int8_t, 256> MakeBase64Table() {
+        std::array<std::int8_t, 256> table {};
+        for (auto& value: table) {
+            value = -1;
+        }
+        for (std::int8_t i = 0; i < 64; i++) {
+            table[static_cast<unsigned char>(BASE64_ALPHABET[i])] = i;
+        }
+        return table;
+    }
+
+    constexpr auto BASE64_TABLE { MakeBase64Table() };
+
+    void AppendBase64(std::string_view bytes, std::string& out) {
+        out.reserve(out.size() + (bytes.size() + 2) / 3 * 4);
+        std::size_t i = 0;
+        for (; i + 2 < bytes.size(); i += 3) {
+            const std::uint32_t triple = 
+                static_cast<unsigned char>(bytes[i]) << 16 
+                | static_cast<unsigned char>(bytes[i + 1]) << 8 
+                | static_cast<unsigned char>(bytes[i + 2]);
+            out += BASE64_ALPHABET[(triple >> 18) & 0x3F];
+            out += BASE64_ALPHABET[(triple >> 12) & 0x3F];
+            out += BASE64_ALPHABET[(triple >> 6) & 0x3F];
+            out += BASE64_ALPHABET[triple & 0x3F];
+        }
+        if (const auto rest = bytes.size() - i; rest) {
+            std::uint32_t triple = static_cast<unsigned char>(bytes[i]) << 16;
+            if (rest == 2) {
+                triple |= static_cast<unsigned char>(bytes[i + 1]) << 8;
+            }
+            out += BASE64_ALPHABET[(triple >> 18) & 0x3F];
+            out += BASE64_ALPHABET[(triple >> 12) & 0x3F];
+            out += rest == 2? BASE64_ALPHABET[(triple >> 6) & 0x3F] : '=';
+            out += '=';
+        }
+    }
+
+    bool DecodeBase64(std::string_view text, std::string& out) {
+        out.clear();
+        if (text.size() % 4) {
+            return false;
+        }
+        out.reserve(text.size() / 4 * 3);
+        for (std::size_t i = 0; i < text.size(); i += 4) {
+            std::uint32_t quad = 0;
+            std::size_t padding = 0;
+            for (std::size_t j = 0; j < 4; j++) {
+                const char symbol = text[i + j];
+                if (symbol == '=' && i + 4 == text.size() && j >= 2) {
+                    ++padding;
+                    quad <<= 6;
+                    continue;
+                }
+                const auto value = BASE64_TABLE[static_cast<unsigned char>(symbol)];
+                if (value < 0 || padding) {
+                    return false;
+                }
+                quad = quad << 6 | static_cast<std::uint32_t>(value);
+            }
+            out += static_cast<char>((quad >> 16) & 0xFF);
+            if (padding < 2) {
+                out += static_cast<char>((quad >> 8) & 0xFF);
+            }
+            if (padding < 1) {
+                out += static_cast<char>(quad & 0xFF);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Raw deflate (no zlib header): both sides know the format.
+     */
+    constexpr int WINDOW_BITS { -15 };
+
+    constexpr std::size_t OUTPUT_CHUNK { 4 * 1024 };
+}
+
+namespace Internal {
+
+    struct FrameDeflater::Stream {
+        z_stream m_zstream {};
+        bool m_isBroken { false };
+    };
+
+    FrameDeflater::FrameDeflater(int level) 
+        : m_stream { std::make_unique<Stream>() }
+    {
+        if (deflateInit2(&m_stream->m_zstream, level, Z_DEFLATED, WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            m_stream->m_isBroken = true;
+        }
+    }
+
+    FrameDeflater::~FrameDeflater() {
+        if (!m_stream->m_isBroken) {
+            deflateEnd(&m_stream->m_zstream);
+        }
+    }
+
+    bool FrameDeflater::Compress(std::string_view payload, std::string& frame) {
+        if (m_stream->m_isBroken) {
+            return false;
+        }
+        auto& zstream { m_stream->m_zstream };
+        zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data()));
+        zstream.avail_in = static_cast<uInt>(payload.size());
+        std::size_t produced = 0;
+        do {
+            m_buffer.resize(produced + OUTPUT_CHUNK + payload.size() / 2);
+            zstream.next_out = reinterpret_cast<Bytef*>(m_buffer.data() + produced);
+            zstream.avail_out = static_cast<uInt>(m_buffer.size() - produced);
+            // the sync flush ends the frame on a byte boundary without resetting the history
+            if (deflate(&zstream, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+                m_stream->m_isBroken = true;
+                deflateEnd(&zstream);
+                return false;
+            }
+            produced = m_buffer.size() - zstream.avail_out;
+        } while (zstream.avail_out == 0);
+
+        frame.clear();
+        frame += COMPRESSED_FRAME_MARK;
+        AppendBase64({ m_buffer.data(), produced }, frame);
+        frame += MESSAGE_DELIMITER;
+        return true;
+    }
+
+    struct FrameInflater::Stream {
+        z_stream m_zstream {};
+        bool m_isBroken { false };
+        bool m_isOverLimit { false };
+    };
+
+    FrameInflater::FrameInflater() 
+        : m_stream { std::make_unique<Stream>() }
+    {
+        if (inflateInit2(&m_stream->m_zstream, WINDOW_BITS) != Z_OK) {
+            m_stream->m_isBroken = true;
+        }
+    }
+
+    FrameInflater::~FrameInflater() {
+        if (!m_stream->m_isBroken) {
+            inflateEnd(&m_stream->m_zstream);
+        }
+    }
+
+    bool FrameInflater::Decompress(std::string_view frame, std::string& payload, std::size_t limit) {
+        m_stream->m_isOverLimit = false;
+        if (m_stream->m_isBroken || !IsCompressedFrame(frame)) {
+            return false;
+        }
+        frame.remove_prefix(1);
+        if (!DecodeBase64(frame, m_buffer)) {
+            return false;
+        }
+        auto& zstream { m_stream->m_zstream };
+        zstream.next_in = reinterpret_cast<Bytef*>(m_buffer.data());
+        zstream.avail_in = static_cast<uInt>(m_buffer.size());
+        payload.clear();
+        std::size_t produced = 0;
+        do {
+            payload.resize(produced + OUTPUT_CHUNK + m_buffer.size() * 4);
+            zstream.next_out = reinterpret_cast<Bytef*>(payload.data() + produced);
+            zstream.avail_out = static_cast<uInt>(payload.size() - produced);
+            const auto code { inflate(&zstream, Z_SYNC_FLUSH) };
+            if (code != Z_OK && code != Z_BUF_ERROR) {
+                m_stream->m_isBroken = true;
+                inflateEnd(&zstream);
+                return false;
+            }
+            produced = payload.size() - zstream.avail_out;
+            if (limit && produced > limit) {
+                // a small frame must not inflate into an unbounded buffer
+                m_stream->m_isBroken = true;
+                m_stream->m_isOverLimit = true;
+                inflateEnd(&zstream);
+                return false;
+            }
+        } while (zstream.avail_out == 0);
+        payload.resize(produced);
+        return zstream.avail_in == 0;
+    }
+
+    bool FrameInflater::IsOverLimit() const noexcept {
+        return m_stream->m_isOverLimit;
+    }
+
+}
@@ -7,6 +7,7 @@ Buffers::Buffers(std::size_t reserved) {
 }
 
 void Buffers::Enque(std::string&& data) {
+    m_queuedBytes += data.size();
     m_buffers[m_activeBuffer ^ 1].emplace_back(std::move(data));
 }
 
@@ -15,8 +16,19 @@ void Buffers::SwapBuffers() {
 
     m_buffers[m_activeBuffer].clear();
     m_activeBuffer ^= 1;
+    m_activeBytes = m_queuedBytes;
+    m_queuedBytes = 0;
 
     for (const auto& buf: m_buffers[m_activeBuffer]) {
         m_bufferSequence.emplace_back(asio::const_buffer(buf.c_str(), buf.size()));
     }
 }
+
+void Buffers::Clear() {
+    m_buffers[0].clear();
+    m_buffers[1].clear();
+    m_bufferSequence.clear();
+    m_activeBuffer = 0;
+    m_queuedBytes = 0;
+    m_activeBytes = 0;
+}
@@ -17,6 +17,10 @@ namespace {
             { Internal::QueryType::CREATE_CHATROOM,   "create-chatroom" },
             { Internal::QueryType::LIST_CHATROOM,     "list-chatroom" },
             { Internal::QueryType::CHAT_MESSAGE,      "chat-message" },
+            { Internal::QueryType::DIRECT_MESSAGE,    "direct-message" },
+            { Internal::QueryType::PRESENCE,          "presence" },
+            { Internal::QueryType::LIST_MEMBERS,      "list-members" },
+            { Internal::QueryType::FEDERATION,        "federation" },
             { Internal::QueryType::SYN,               "syn" },
             { Internal::QueryType::ACK,               "ack" }
         };
@@ -31,6 +35,10 @@ namespace {
             { "create-chatroom",    Internal::QueryType::CREATE_CHATROOM },
             { "list-chatroom",      Internal::QueryType::LIST_CHATROOM },
             { "chat-message",       Internal::QueryType::CHAT_MESSAGE },
+            { "direct-message",     Internal::QueryType::DIRECT_MESSAGE },
+            { "presence",           Internal::QueryType::PRESENCE },
+            { "list-members",       Internal::QueryType::LIST_MEMBERS },
+            { "federation",         Internal::QueryType::FEDERATION },
             { "syn",                Internal::QueryType::SYN },
             { "ack",                Internal::QueryType::ACK }
         };
@@ -47,6 +55,12 @@ namespace Internal {
         m_query = ::AsQueryType(doc["query"].GetString());
         m_timestamp = doc["timestamp"].GetInt64();
         m_timeout = doc["timeout"].GetUint64();
+        if (auto it = doc.FindMember("id"); it != doc.MemberEnd() && it->value.IsUint64()) {
+            m_id = it->value.GetUint64();
+        }
+        else {
+            m_id = 0;
+        }
 
         if (doc.HasMember("attachment")) {
             rapidjson::StringBuffer buffer;
@@ -73,6 +87,11 @@ namespace Internal {
         value.SetUint64(m_timeout);
         doc.AddMember("timeout", value, alloc);
 
+        if (m_id) {
+            value.SetUint64(m_id);
+            doc.AddMember("id", value, alloc);
+        }
+
         // read to string:
         rapidjson::StringBuffer buffer;
         rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -102,6 +121,13 @@ namespace Internal {
         else {
             m_error.clear();
         }
+
+        if (auto it = doc.FindMember("id"); it != doc.MemberEnd() && it->value.IsUint64()) {
+            m_id = it->value.GetUint64();
+        }
+        else {
+            m_id = 0;
+        }
         
         if (doc.HasMember("attachment")) {
             rapidjson::StringBuffer buffer;
@@ -112,6 +138,10 @@ namespace Internal {
     }
 
     void Response::Write(std::string& json) const {
+        this->Write(json, m_attachment);
+    }
+
+    void Response::Write(std::string& json, const std::string& attachment) const {
         rapidjson::Document doc;
         auto& alloc = doc.GetAllocator();
         doc.SetObject();
@@ -133,16 +163,23 @@ namespace Internal {
             doc.AddMember("error", value, alloc);
         }
 
+        if (m_id) {
+            value.SetUint64(m_id);
+            doc.AddMember("id", value, alloc);
+        }
+
         // read to string:
         rapidjson::StringBuffer buffer;
         rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
         doc.Accept(writer);
 
-        json = std::string(buffer.GetString(), buffer.GetSize());
-        if (!m_attachment.empty()) {
+        json.clear();
+        json.reserve(buffer.GetSize() + attachment.size() + sizeof(",\"attachment\":") + MESSAGE_DELIMITER.size());
+        json.append(buffer.GetString(), buffer.GetSize());
+        if (!attachment.empty()) {
             json.pop_back(); // remove '}'
             json += ",\"attachment\":";
-            json += m_attachment;
+            json += attachment;
             json += "}";
         }
         json += MESSAGE_DELIMITER;
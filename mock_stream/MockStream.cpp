@@ -1,5 +1,7 @@
 #include "MockStream.hpp"
 
+#include <cassert>
+
 MockAsyncWriteStream::MockAsyncWriteStream(
     boost::asio::io_context::executor_type& ex
     , std::byte * buffer
@@ -16,4 +18,208 @@ MockAsyncReadStream::MockAsyncReadStream(
 )
     : m_executor { ex }
     , m_buffer { buffer }
-{}
\ No newline at end of file
+{}
+
+void MockPipe::Read(std::unique_ptr<PendingRead>&& operation) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    assert(!m_reader && "Only one read operation can be pending");
+    if (m_data.size()) {
+        operation->Complete({}, m_data);
+    }
+    else if (m_isClosed) {
+        operation->Complete(boost::asio::error::eof, m_data);
+    }
+    else {
+        m_reader = std::move(operation);
+    }
+}
+
+void MockPipe::Close() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_isClosed = true;
+    if (m_reader) {
+        // pending reader means there is no data left
+        auto reader = std::move(m_reader);
+        reader->Complete(boost::asio::error::eof, m_data);
+    }
+}
+
+void MockPipe::Cancel() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_reader) {
+        auto reader = std::move(m_reader);
+        reader->Complete(boost::asio::error::operation_aborted, m_data);
+    }
+}
+
+MockSocket::MockSocket(boost::asio::io_context& context)
+    : m_executor { context.get_executor() }
+{}
+
+MockSocket::MockSocket(const executor_type& executor)
+    : m_executor { executor }
+{}
+
+MockSocket& MockSocket::operator=(MockSocket&& rhs) {
+    if (this != &rhs) {
+        this->close();
+        m_executor = rhs.m_executor;
+        m_inbound = std::move(rhs.m_inbound);
+        m_outbound = std::move(rhs.m_outbound);
+        m_port = rhs.m_port;
+    }
+    return *this;
+}
+
+MockSocket::~MockSocket() {
+    if (this->is_open()) {
+        this->close();
+    }
+}
+
+std::pair<MockSocket, MockSocket> MockSocket::CreatePair(boost::asio::io_context& context) {
+    std::pair<MockSocket, MockSocket> pair { MockSocket{ context }, MockSocket{ context } };
+    auto forward { std::make_shared<MockPipe>() };
+    auto backward { std::make_shared<MockPipe>() };
+    pair.first.m_outbound = pair.second.m_inbound = forward;
+    pair.first.m_inbound = pair.second.m_outbound = backward;
+    return pair;
+}
+
+MockSocket::endpoint_type MockSocket::remote_endpoint(boost::system::error_code& error) const {
+    if (!this->is_open()) {
+        error = boost::asio::error::not_connected;
+        return {};
+    }
+    error.clear();
+    return { boost::asio::ip::address_v4::loopback(), m_port };
+}
+
+MockSocket::endpoint_type MockSocket::local_endpoint(boost::system::error_code& error) const {
+    return this->remote_endpoint(error);
+}
+
+void MockSocket::shutdown(boost::asio::socket_base::shutdown_type what, boost::system::error_code& error) {
+    if (!this->is_open()) {
+        error = boost::asio::error::not_connected;
+        return;
+    }
+    error.clear();
+    if (what == boost::asio::socket_base::shutdown_send || what == boost::asio::socket_base::shutdown_both) {
+        m_outbound->Close();
+    }
+    if (what == boost::asio::socket_base::shutdown_receive || what == boost::asio::socket_base::shutdown_both) {
+        m_inbound->Close();
+    }
+}
+
+void MockSocket::close(boost::system::error_code& error) {
+    error.clear();
+    if (m_inbound) {
+        m_inbound->Cancel();
+        m_inbound->Close();
+        m_inbound.reset();
+    }
+    if (m_outbound) {
+        m_outbound->Close();
+        m_outbound.reset();
+    }
+}
+
+void MockSocket::close() {
+    boost::system::error_code ignored;
+    this->close(ignored);
+}
+
+boost::system::error_code MockSocket::Connect(const endpoint_type& endpoint) {
+    const auto listener { MockAcceptor::FindListener(endpoint.port()) };
+    if (!listener) {
+        return boost::asio::error::connection_refused;
+    }
+
+    MockSocket peer { listener->m_executor };
+    auto forward { std::make_shared<MockPipe>() };
+    auto backward { std::make_shared<MockPipe>() };
+    peer.m_inbound = forward;
+    peer.m_outbound = backward;
+    peer.m_port = endpoint.port();
+
+    std::lock_guard<std::mutex> lock { listener->m_mutex };
+    if (listener->m_isClosed) {
+        return boost::asio::error::connection_refused;
+    }
+    this->close();
+    m_inbound = backward;
+    m_outbound = forward;
+    m_port = endpoint.port();
+    if (!listener->m_acceptors.empty()) {
+        auto acceptor = std::move(listener->m_acceptors.front());
+        listener->m_acceptors.pop_front();
+        acceptor->Complete({}, std::move(peer));
+    }
+    else {
+        listener->m_backlog.emplace_back(std::move(peer));
+    }
+    return {};
+}
+
+MockAcceptor::MockAcceptor(
+    boost::asio::io_context& context
+    , const boost::asio::ip::tcp::endpoint& endpoint
+)
+    : m_executor { context.get_executor() }
+    , m_listener { std::make_shared<Listener>(m_executor) }
+    , m_port { endpoint.port() }
+{
+    std::lock_guard<std::mutex> lock { m_registryMutex };
+    if (auto it = m_registry.find(m_port); it != m_registry.end() && !it->second.expired()) {
+        throw boost::system::system_error(boost::asio::error::address_in_use, "bind");
+    }
+    m_registry[m_port] = m_listener;
+}
+
+MockAcceptor::~MockAcceptor() {
+    this->close();
+}
+
+bool MockAcceptor::is_open() const noexcept {
+    std::lock_guard<std::mutex> lock { m_listener->m_mutex };
+    return !m_listener->m_isClosed;
+}
+
+void MockAcceptor::close(boost::system::error_code& error) {
+    error.clear();
+    std::deque<MockSocket> backlog;
+    {
+        std::lock_guard<std::mutex> lock { m_listener->m_mutex };
+        if (m_listener->m_isClosed) {
+            return;
+        }
+        m_listener->m_isClosed = true;
+        for (auto& acceptor: m_listener->m_acceptors) {
+            acceptor->Complete(boost::asio::error::operation_aborted, MockSocket { m_executor });
+        }
+        m_listener->m_acceptors.clear();
+        backlog.swap(m_listener->m_backlog);
+    }
+    // not accepted connections are closed: remote peers get `eof`
+    backlog.clear();
+
+    std::lock_guard<std::mutex> lock { m_registryMutex };
+    if (auto it = m_registry.find(m_port); it != m_registry.end() && it->second.lock() == m_listener) {
+        m_registry.erase(it);
+    }
+}
+
+void MockAcceptor::close() {
+    boost::system::error_code ignored;
+    this->close(ignored);
+}
+
+std::shared_ptr<MockAcceptor::Listener> MockAcceptor::FindListener(std::uint16_t port) {
+    std::lock_guard<std::mutex> lock { m_registryMutex };
+    if (auto it = m_registry.find(port); it != m_registry.end()) {
+        return it->second.lock();
+    }
+    return nullptr;
+}
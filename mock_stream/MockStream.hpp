@@ -4,6 +4,14 @@
 #include <boost/asio.hpp>
 #include <boost/asio/error.hpp>
 #include <array>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <cstdint>
+#include <unordered_map>
+#include <type_traits>
+
+#include "NetworkConditions.hpp"
 
 /**
  * Stream concept requirements:
@@ -16,6 +24,11 @@ struct MockAsyncWriteStream {
     boost::asio::io_context::executor_type m_executor;
     std::byte *m_buffer { nullptr };
     size_t m_size { 0 };
+    /**
+     * Emulated network. If set, completion handlers are delayed 
+     * by the virtual clock instead of being posted immediately.
+     */
+    std::shared_ptr<NetworkLink> m_link { nullptr };
     
     MockAsyncWriteStream(
         boost::asio::io_context::executor_type& ex
@@ -27,6 +40,10 @@ struct MockAsyncWriteStream {
         return m_executor;
     }
 
+    void SetNetworkConditions(VirtualClock& clock, const NetworkConditions& conditions) {
+        m_link = std::make_shared<NetworkLink>(clock, conditions);
+    }
+
     template<class ConstBufferSequence, class WriteHandler>
     void async_write_some(const ConstBufferSequence & buffers, WriteHandler && handler);
 };
@@ -36,6 +53,11 @@ struct MockAsyncReadStream {
 
     boost::asio::io_context::executor_type m_executor;
     boost::asio::const_buffer m_buffer;
+    /**
+     * Emulated network. If set, completion handlers are delayed 
+     * by the virtual clock instead of being posted immediately.
+     */
+    std::shared_ptr<NetworkLink> m_link { nullptr };
     
     MockAsyncReadStream(
         boost::asio::io_context::executor_type& ex
@@ -46,14 +68,233 @@ struct MockAsyncReadStream {
         return m_executor;
     }
 
+    void SetNetworkConditions(VirtualClock& clock, const NetworkConditions& conditions) {
+        m_link = std::make_shared<NetworkLink>(clock, conditions);
+    }
+
     template<class MutableBufferSequence, class WriteHandler>
-    void async_read_some(MutableBufferSequence & buffers, WriteHandler && handler);
+    void async_read_some(const MutableBufferSequence & buffers, WriteHandler && handler);
+};
+
+/**
+ * One direction of the in-memory loopback connection:
+ * bytes written by one peer are queued here until the other peer reads them.
+ *
+ * Thread-safe.
+ */
+class MockPipe final {
+public:
+    /**
+     * Type erased read operation waiting for the data.
+     */
+    struct PendingRead {
+        virtual ~PendingRead() = default;
+
+        /**
+         * Copy available data (if any) and post the completion handler.
+         * Called under the pipe's lock.
+         */
+        virtual void Complete(const boost::system::error_code& error, boost::asio::streambuf& data) = 0;
+    };
+
+    template<class ConstBufferSequence>
+    std::size_t Write(const ConstBufferSequence& buffers, boost::system::error_code& error);
+
+    void Read(std::unique_ptr<PendingRead>&& operation);
+
+    /**
+     * Stop accepting data. Pending reader is completed
+     * with `eof` once everything queued is read.
+     */
+    void Close();
+
+    /**
+     * Abort the pending read (if any) with `operation_aborted`.
+     */
+    void Cancel();
+
+private:
+    std::mutex m_mutex;
+    boost::asio::streambuf m_data;
+    std::unique_ptr<PendingRead> m_reader { nullptr };
+    bool m_isClosed { false };
+};
+
+class MockAcceptor;
+
+/**
+ * In-memory replacement of the `tcp::socket`.
+ * Satisfies AsyncReadStream and AsyncWriteStream so it can be wrapped
+ * by `asio::ssl::stream` and used by `async_read_until`/`async_write`.
+ * Two sockets are connected through a pair of `MockPipe`s:
+ * either by `MockSocket::CreatePair` or by connecting to a `MockAcceptor`.
+ */
+class MockSocket final {
+public:
+    using executor_type = boost::asio::io_context::executor_type;
+    using lowest_layer_type = MockSocket;
+    using endpoint_type = boost::asio::ip::tcp::endpoint;
+
+    explicit MockSocket(boost::asio::io_context& context);
+
+    explicit MockSocket(const executor_type& executor);
+
+    MockSocket(MockSocket&&) = default;
+
+    MockSocket& operator=(MockSocket&& rhs);
+
+    ~MockSocket();
+
+    static std::pair<MockSocket, MockSocket> CreatePair(boost::asio::io_context& context);
+
+    executor_type get_executor() noexcept {
+        return m_executor;
+    }
+
+    lowest_layer_type& lowest_layer() noexcept {
+        return *this;
+    }
+
+    const lowest_layer_type& lowest_layer() const noexcept {
+        return *this;
+    }
+
+    bool is_open() const noexcept {
+        return m_inbound != nullptr;
+    }
+
+    endpoint_type remote_endpoint(boost::system::error_code& error) const;
+
+    endpoint_type local_endpoint(boost::system::error_code& error) const;
+
+    void shutdown(boost::asio::socket_base::shutdown_type what, boost::system::error_code& error);
+
+    void close(boost::system::error_code& error);
+
+    void close();
+
+    /**
+     * Connect to the `MockAcceptor` listening on the port of the first endpoint.
+     * Handler signature: void(const boost::system::error_code&, const endpoint_type&)
+     */
+    template<class EndpointSequence, class ConnectHandler>
+    auto async_connect(const EndpointSequence& endpoints, ConnectHandler&& handler);
+
+    template<class ConstBufferSequence, class WriteHandler>
+    auto async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler);
+
+    template<class MutableBufferSequence, class ReadHandler>
+    auto async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler);
+
+private:
+    friend class MockAcceptor;
+
+    template<class MutableBufferSequence, class Handler>
+    class ReadOperation;
+
+    boost::system::error_code Connect(const endpoint_type& endpoint);
+
+    executor_type m_executor;
+    std::shared_ptr<MockPipe> m_inbound { nullptr };
+    std::shared_ptr<MockPipe> m_outbound { nullptr };
+    std::uint16_t m_port { 0 };
+};
+
+/**
+ * In-memory replacement of the `tcp::acceptor`.
+ * Registered by port in the process-wide table so `MockSocket::async_connect`
+ * can find it. No real socket or port is used.
+ */
+class MockAcceptor final {
+public:
+    using executor_type = boost::asio::io_context::executor_type;
+
+    MockAcceptor(boost::asio::io_context& context, const boost::asio::ip::tcp::endpoint& endpoint);
+
+    ~MockAcceptor();
+
+    MockAcceptor(const MockAcceptor&) = delete;
+    MockAcceptor& operator=(const MockAcceptor&) = delete;
+
+    executor_type get_executor() noexcept {
+        return m_executor;
+    }
+
+    template<class Option>
+    void set_option(const Option&) noexcept {
+        // socket options have no meaning for the in-memory transport
+    }
+
+    bool is_open() const noexcept;
+
+    void close(boost::system::error_code& error);
+
+    void close();
+
+    /**
+     * Several accepts may be pending at once, they take connections in order.
+     * Handler signature: void(const boost::system::error_code&)
+     */
+    template<class AcceptHandler>
+    auto async_accept(MockSocket& peer, AcceptHandler&& handler);
+
+private:
+    friend class MockSocket;
+
+    struct PendingAccept {
+        virtual ~PendingAccept() = default;
+        virtual void Complete(const boost::system::error_code& error, MockSocket&& socket) = 0;
+    };
+
+    struct Listener {
+        std::mutex m_mutex;
+        std::deque<MockSocket> m_backlog;
+        std::deque<std::unique_ptr<PendingAccept>> m_acceptors;
+        executor_type m_executor;
+        bool m_isClosed { false };
+
+        explicit Listener(const executor_type& executor)
+            : m_executor { executor }
+        {}
+    };
+
+    static std::shared_ptr<Listener> FindListener(std::uint16_t port);
+
+    inline static std::mutex m_registryMutex {};
+    inline static std::unordered_map<std::uint16_t, std::weak_ptr<Listener>> m_registry {};
+
+    executor_type m_executor;
+    std::shared_ptr<Listener> m_listener { nullptr };
+    std::uint16_t m_port { 0 };
 };
 
 /**
  *  == IMPLEMENTATION ==
  */  
 
+namespace mock_detail {
+    /**
+     * Post the completion at the virtual time the emulated link 
+     * finishes transmission of the @bytes.
+     */
+    template<class Executor, class Handler>
+    void ScheduleCompletion(
+        NetworkLink& link, 
+        const Executor& executor, 
+        Handler&& handler, 
+        const boost::system::error_code& error, 
+        std::size_t bytes
+    ) {
+        auto completion = std::make_shared<std::decay_t<Handler>>(std::forward<Handler>(handler));
+        link.GetClock().Schedule(link.Transmit(bytes), [executor, completion, error, bytes]() {
+            boost::asio::post(boost::asio::bind_executor(
+                executor, 
+                std::bind(std::move(*completion), error, bytes))
+            );
+        });
+    }
+}
+
 template<class ConstBufferSequence, class WriteHandler>
 void MockAsyncWriteStream::async_write_some(
     const ConstBufferSequence & buffers, 
@@ -64,12 +305,21 @@ void MockAsyncWriteStream::async_write_some(
     if (boost::asio::buffer_size(buffers) > 0) {
         // initiates an asynchronous operation to write one or more bytes of data 
         // to the stream a from the buffer sequence cb. 
-        bytes = boost::asio::buffer_copy(boost::asio::buffer(m_buffer, m_size), buffers);
+        auto size { m_size };
+        if (m_link) {
+            // partial write
+            size = m_link->Limit(size);
+        }
+        bytes = boost::asio::buffer_copy(boost::asio::buffer(m_buffer, size), buffers);
         m_buffer += bytes; m_size -= bytes;
         if (!bytes) {
             error = make_error_code(boost::asio::stream_errc::eof);
         }
     }
+    if (m_link) {
+        mock_detail::ScheduleCompletion(*m_link, m_executor, std::forward<WriteHandler>(handler), error, bytes);
+        return;
+    }
     boost::asio::post(boost::asio::bind_executor(
         m_executor, 
         std::bind(std::forward<WriteHandler>(handler), error, bytes))
@@ -77,22 +327,31 @@ void MockAsyncWriteStream::async_write_some(
 }
 
 /**
- * @param buffer must have size >= m_buffer.size()
+ * Read from the source buffer until it's exhausted, then complete with `eof`.
  */
 template<class MutableBufferSequence, class ReadHandler>
 void MockAsyncReadStream::async_read_some(
-    MutableBufferSequence & buffer, 
+    const MutableBufferSequence & buffer, 
     ReadHandler && handler
 ) {
     boost::system::error_code error;
     size_t bytes { 0 };
-    if (boost::asio::buffer_size(m_buffer) > 0) {
-        bytes = boost::asio::buffer_copy(buffer, m_buffer);
+    if (boost::asio::buffer_size(buffer) > 0) {
+        auto source { m_buffer };
+        if (m_link) {
+            // partial read
+            source = boost::asio::buffer(source, m_link->Limit(source.size()));
+        }
+        bytes = boost::asio::buffer_copy(buffer, source);
         m_buffer += bytes;
         if (!bytes) {
             error = make_error_code(boost::asio::stream_errc::eof);
         }
     }
+    if (m_link) {
+        mock_detail::ScheduleCompletion(*m_link, m_executor, std::forward<ReadHandler>(handler), error, bytes);
+        return;
+    }
     boost::asio::post(boost::asio::bind_executor(
         m_executor, 
         std::bind(std::forward<ReadHandler>(handler), error, bytes))
@@ -100,4 +359,159 @@ void MockAsyncReadStream::async_read_some(
 
 }
 
+namespace mock_detail {
+    /**
+     * Post the handler through it's associated executor
+     * (e.g. a strand it was bound to) or the fallback one.
+     */
+    template<class Executor, class Handler, class ...Args>
+    void PostCompletion(const Executor& fallback, Handler&& handler, Args ...args) {
+        auto executor = boost::asio::get_associated_executor(handler, fallback);
+        boost::asio::post(executor,
+            [handler = std::forward<Handler>(handler), args...]() mutable {
+                handler(args...);
+            }
+        );
+    }
+}
+
+template<class ConstBufferSequence>
+std::size_t MockPipe::Write(const ConstBufferSequence& buffers, boost::system::error_code& error) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_isClosed) {
+        error = boost::asio::error::broken_pipe;
+        return 0;
+    }
+    const auto size { boost::asio::buffer_size(buffers) };
+    m_data.commit(boost::asio::buffer_copy(m_data.prepare(size), buffers));
+    if (m_reader && size) {
+        auto reader = std::move(m_reader);
+        reader->Complete({}, m_data);
+    }
+    return size;
+}
+
+template<class MutableBufferSequence, class Handler>
+class MockSocket::ReadOperation final : public MockPipe::PendingRead {
+public:
+    ReadOperation(const MutableBufferSequence& buffers, Handler&& handler, const executor_type& executor)
+        : m_buffers { buffers }
+        , m_handler { std::move(handler) }
+        , m_work { executor }
+    {}
+
+    void Complete(const boost::system::error_code& error, boost::asio::streambuf& data) override {
+        std::size_t bytes { 0 };
+        if (!error) {
+            bytes = boost::asio::buffer_copy(m_buffers, data.data());
+            data.consume(bytes);
+        }
+        mock_detail::PostCompletion(m_work.get_executor(), std::move(m_handler), error, bytes);
+        m_work.reset();
+    }
+
+private:
+    MutableBufferSequence m_buffers;
+    Handler m_handler;
+    boost::asio::executor_work_guard<executor_type> m_work;
+};
+
+template<class ConstBufferSequence, class WriteHandler>
+auto MockSocket::async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+    return boost::asio::async_initiate<WriteHandler, void(boost::system::error_code, std::size_t)>(
+        [this](auto&& handler, const ConstBufferSequence& buffers) {
+            boost::system::error_code error;
+            std::size_t bytes { 0 };
+            if (!m_outbound) {
+                error = boost::asio::error::not_connected;
+            }
+            else {
+                bytes = m_outbound->Write(buffers, error);
+            }
+            mock_detail::PostCompletion(m_executor, std::move(handler), error, bytes);
+        }, handler, buffers
+    );
+}
+
+template<class MutableBufferSequence, class ReadHandler>
+auto MockSocket::async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler) {
+    return boost::asio::async_initiate<ReadHandler, void(boost::system::error_code, std::size_t)>(
+        [this](auto&& handler, const MutableBufferSequence& buffers) {
+            using Handler = std::decay_t<decltype(handler)>;
+            if (!m_inbound) {
+                mock_detail::PostCompletion(m_executor, std::move(handler)
+                    , boost::system::error_code(boost::asio::error::bad_descriptor), std::size_t { 0 });
+            }
+            else if (boost::asio::buffer_size(buffers) == 0) {
+                mock_detail::PostCompletion(m_executor, std::move(handler)
+                    , boost::system::error_code {}, std::size_t { 0 });
+            }
+            else {
+                m_inbound->Read(std::make_unique<ReadOperation<MutableBufferSequence, Handler>>(
+                    buffers, std::move(handler), m_executor
+                ));
+            }
+        }, handler, buffers
+    );
+}
+
+template<class EndpointSequence, class ConnectHandler>
+auto MockSocket::async_connect(const EndpointSequence& endpoints, ConnectHandler&& handler) {
+    return boost::asio::async_initiate<ConnectHandler, void(boost::system::error_code, endpoint_type)>(
+        [this](auto&& handler, const EndpointSequence& endpoints) {
+            boost::system::error_code error { boost::asio::error::host_not_found };
+            endpoint_type endpoint {};
+            for (const auto& entry: endpoints) {
+                endpoint = entry;
+                error = this->Connect(endpoint);
+                if (!error) break;
+            }
+            mock_detail::PostCompletion(m_executor, std::move(handler), error, endpoint);
+        }, handler, endpoints
+    );
+}
+
+template<class AcceptHandler>
+auto MockAcceptor::async_accept(MockSocket& peer, AcceptHandler&& handler) {
+    return boost::asio::async_initiate<AcceptHandler, void(boost::system::error_code)>(
+        [this, &peer](auto&& handler) {
+            using Handler = std::decay_t<decltype(handler)>;
+
+            struct Operation final : PendingAccept {
+                Operation(MockSocket& peer, Handler&& handler, const executor_type& executor)
+                    : m_peer { peer }
+                    , m_handler { std::move(handler) }
+                    , m_work { executor }
+                {}
+
+                void Complete(const boost::system::error_code& error, MockSocket&& socket) override {
+                    if (!error) {
+                        m_peer = std::move(socket);
+                    }
+                    mock_detail::PostCompletion(m_work.get_executor(), std::move(m_handler), error);
+                    m_work.reset();
+                }
+
+                MockSocket& m_peer;
+                Handler m_handler;
+                boost::asio::executor_work_guard<executor_type> m_work;
+            };
+
+            auto operation = std::make_unique<Operation>(peer, std::move(handler), m_executor);
+            std::lock_guard<std::mutex> lock { m_listener->m_mutex };
+            if (m_listener->m_isClosed) {
+                operation->Complete(boost::asio::error::operation_aborted, MockSocket { m_executor });
+            }
+            else if (!m_listener->m_backlog.empty()) {
+                auto socket = std::move(m_listener->m_backlog.front());
+                m_listener->m_backlog.pop_front();
+                operation->Complete({}, std::move(socket));
+            }
+            else {
+                m_listener->m_acceptors.push_back(std::move(operation));
+            }
+        }, handler
+    );
+}
+
 #endif // MOCK_STREAM_HPP__
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "NetworkConditions.hpp"
+
+#include <algorithm>
+
+void VirtualClock::Schedule(Time at, Event&& event) {
+    m_events.emplace(std::make_pair(std::max(at, m_now), m_sequence++), std::move(event));
+}
+
+void VirtualClock::Advance(Time ms) {
+    const Time target { m_now + ms };
+    while (!m_events.empty() && m_events.begin()->first.first <= target) {
+        auto node = m_events.extract(m_events.begin());
+        m_now = node.key().first;
+        // event may schedule new events
+        node.mapped()();
+    }
+    m_now = target;
+}
+
+NetworkLink::NetworkLink(VirtualClock& clock, const NetworkConditions& conditions)
+    : m_clock { &clock }
+    , m_conditions { conditions }
+    , m_random { conditions.m_seed }
+{
+}
+
+std::size_t NetworkLink::Limit(std::size_t requested) const noexcept {
+    if (m_conditions.m_maxChunk) {
+        return std::min(requested, m_conditions.m_maxChunk);
+    }
+    return requested;
+}
+
+bool NetworkLink::IsStalled(VirtualClock::Time time) const noexcept {
+    if (!m_conditions.m_stallPeriod || !m_conditions.m_stallDuration) {
+        return false;
+    }
+    const auto phase { time % m_conditions.m_stallPeriod };
+    return phase >= m_conditions.m_stallPeriod - m_conditions.m_stallDuration;
+}
+
+VirtualClock::Time NetworkLink::Transmit(std::size_t bytes) {
+    auto start { std::max(m_clock->Now(), m_busyUntil) };
+    if (this->IsStalled(start)) {
+        // wait till the end of the current period
+        start += m_conditions.m_stallPeriod - start % m_conditions.m_stallPeriod;
+    }
+    VirtualClock::Time duration { 0 };
+    if (m_conditions.m_bandwidth) {
+        duration = (bytes + m_conditions.m_bandwidth - 1) / m_conditions.m_bandwidth;
+    }
+    m_busyUntil = start + duration;
+
+    VirtualClock::Time delay { m_conditions.m_latency };
+    if (m_conditions.m_jitter) {
+        // modulo keeps the sequence identical across standard libraries
+        delay += m_random() % (m_conditions.m_jitter + 1);
+    }
+    return m_busyUntil + delay;
+}
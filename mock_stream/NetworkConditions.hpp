@@ -0,0 +1,121 @@
+#ifndef MOCK_NETWORK_CONDITIONS_HPP__
+#define MOCK_NETWORK_CONDITIONS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <utility>
+
+/**
+ * Deterministic time source for the network emulation.
+ * Time is measured in virtual milliseconds and moves only by `Advance`,
+ * so the same test always observes the same sequence of events.
+ *
+ * Not thread safe.
+ */
+class VirtualClock final {
+public:
+    using Time = std::uint64_t;
+    using Event = std::function<void()>;
+
+    Time Now() const noexcept {
+        return m_now;
+    }
+
+    /**
+     * Queue @event to be executed when the clock reaches @at.
+     * Events with the same time are executed in the order they were scheduled.
+     */
+    void Schedule(Time at, Event&& event);
+
+    /**
+     * Move the clock forward by @ms executing all events which became due.
+     * `Advance(0)` only executes the events which are already due.
+     */
+    void Advance(Time ms);
+
+    bool HasPendingEvents() const noexcept {
+        return !m_events.empty();
+    }
+
+private:
+    Time m_now { 0 };
+    std::uint64_t m_sequence { 0 };
+    std::multimap<std::pair<Time, std::uint64_t>, Event> m_events;
+};
+
+struct NetworkConditions final {
+    /**
+     * Number of bytes the link can transmit per virtual millisecond.
+     * 0 means unlimited.
+     */
+    std::size_t m_bandwidth { 0 };
+
+    /**
+     * Constant delay (ms) added to every completed operation.
+     */
+    VirtualClock::Time m_latency { 0 };
+
+    /**
+     * Upper bound (ms) of the pseudo-random delay added to the latency.
+     */
+    VirtualClock::Time m_jitter { 0 };
+
+    /**
+     * Max number of bytes transferred by a single `*_some` operation.
+     * 0 means unlimited, i.e. no partial writes/reads.
+     */
+    std::size_t m_maxChunk { 0 };
+
+    /**
+     * The link stalls for the last `m_stallDuration` ms of every `m_stallPeriod` ms.
+     * Operations started during a stall wait for its end.
+     */
+    VirtualClock::Time m_stallPeriod { 0 };
+    VirtualClock::Time m_stallDuration { 0 };
+
+    /**
+     * Seed of the jitter generator: the same seed gives the same delays.
+     */
+    std::uint32_t m_seed { 1 };
+};
+
+/**
+ * One direction of the emulated link. It keeps track when the link
+ * becomes free so the consecutive operations are serialized at the given bandwidth.
+ *
+ * Not thread safe.
+ */
+class NetworkLink final {
+public:
+    NetworkLink(VirtualClock& clock, const NetworkConditions& conditions);
+
+    /**
+     * @return 
+     *  Number of bytes the single operation can transfer out of @requested.
+     */
+    std::size_t Limit(std::size_t requested) const noexcept;
+
+    /**
+     * Occupy the link to transmit @bytes.
+     * @return 
+     *  Virtual time when the operation completes.
+     */
+    VirtualClock::Time Transmit(std::size_t bytes);
+
+    VirtualClock& GetClock() noexcept {
+        return *m_clock;
+    }
+
+private:
+    bool IsStalled(VirtualClock::Time time) const noexcept;
+
+    VirtualClock * const m_clock;
+    const NetworkConditions m_conditions;
+    std::minstd_rand m_random;
+    VirtualClock::Time m_busyUntil { 0 };
+};
+
+#endif // MOCK_NETWORK_CONDITIONS_HPP__
@@ -0,0 +1,192 @@
+#include "Admission.hpp"
+
+#include <algorithm>
+
+namespace net {
+
+/**
+ * Keeps the connection slot (and the parent's one) while it's alive.
+ */
+class Admission::Ticket final {
+public:
+    Ticket(std::shared_ptr<Admission> owner, std::shared_ptr<void> parent) 
+        : m_owner { std::move(owner) }
+        , m_parent { std::move(parent) }
+    {}
+
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    ~Ticket() {
+        m_owner->Release();
+    }
+
+private:
+    std::shared_ptr<Admission> m_owner;
+    std::shared_ptr<void> m_parent;
+};
+
+Admission::Admission(Limits limits, std::shared_ptr<Admission> parent) 
+    : m_parent { std::move(parent) }
+    , m_limits { limits }
+{
+}
+
+const std::shared_ptr<Admission>& Admission::Global() {
+    static const std::shared_ptr<Admission> global { std::make_shared<Admission>(Limits {}) };
+    return global;
+}
+
+void Admission::SetLimits(Limits limits) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_limits = limits;
+}
+
+bool Admission::ClaimLimits(Limits limits) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_isClaimed) {
+        return false;
+    }
+    m_limits = limits;
+    m_isClaimed = true;
+    return true;
+}
+
+Admission::Limits Admission::GetLimits() const {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    return m_limits;
+}
+
+std::shared_ptr<void> Admission::Admit() {
+    std::shared_ptr<void> parent { nullptr };
+    if (m_parent) {
+        parent = m_parent->Admit();
+        if (!parent) {
+            std::lock_guard<std::mutex> lock { m_mutex };
+            m_stats.m_refusedConnections++;
+            return nullptr;
+        }
+    }
+    { // Block
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (m_limits.m_maxConnections && m_stats.m_connections >= m_limits.m_maxConnections) {
+            m_stats.m_refusedConnections++;
+            // the parent's slot is released with its ticket
+            return nullptr;
+        }
+        if (m_limits.m_maxHandshakes 
+            && m_stats.m_handshakes >= m_limits.m_maxHandshakes 
+            && m_waiting.size() >= m_limits.m_maxWaitingHandshakes
+        ) {
+            // the handshake would be refused anyway: do it before any session is built
+            m_stats.m_refusedHandshakes++;
+            return nullptr;
+        }
+        m_stats.m_connections++;
+        m_stats.m_admitted++;
+    } // Release
+    return std::make_shared<Ticket>(this->shared_from_this(), std::move(parent));
+}
+
+void Admission::Release() noexcept {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_stats.m_connections--;
+}
+
+bool Admission::BeginHandshake(
+    std::function<void()> start, 
+    Clock::time_point deadline,
+    std::function<void()> expire
+) {
+    std::vector<std::function<void()>> expired;
+    bool isQueued { false };
+    bool isStarted { false };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (m_limits.m_maxHandshakes && m_stats.m_handshakes >= m_limits.m_maxHandshakes) {
+            // the expired ones don't take the room in the queue
+            this->TakeExpired(Clock::now(), expired);
+            if (m_waiting.size() < m_limits.m_maxWaitingHandshakes) {
+                m_waiting.push_back(Waiting { std::move(start), std::move(expire), deadline });
+                m_stats.m_waitingHandshakes = m_waiting.size();
+                m_stats.m_delayedHandshakes++;
+                isQueued = true;
+            }
+            else {
+                m_stats.m_refusedHandshakes++;
+            }
+        }
+        else {
+            m_stats.m_handshakes++;
+            isStarted = true;
+        }
+    } // Release
+    for (auto& drop: expired) {
+        drop();
+    }
+    if (isStarted) {
+        start();
+    }
+    return isStarted || isQueued;
+}
+
+void Admission::FinishHandshake() {
+    std::vector<std::function<void()>> expired;
+    std::function<void()> next { nullptr };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_mutex };
+        this->TakeExpired(Clock::now(), expired);
+        if (m_waiting.empty()) {
+            m_stats.m_handshakes--;
+        }
+        else {
+            // the slot passes to the first waiting handshake
+            next = std::move(m_waiting.front().m_start);
+            m_waiting.pop_front();
+            m_stats.m_waitingHandshakes = m_waiting.size();
+        }
+    } // Release
+    for (auto& drop: expired) {
+        drop();
+    }
+    if (next) {
+        next();
+    }
+}
+
+std::size_t Admission::DropExpiredHandshakes() {
+    std::vector<std::function<void()>> expired;
+    std::size_t count { 0 };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_mutex };
+        count = this->TakeExpired(Clock::now(), expired);
+    } // Release
+    for (auto& drop: expired) {
+        drop();
+    }
+    return count;
+}
+
+std::size_t Admission::TakeExpired(Clock::time_point now, std::vector<std::function<void()>>& expired) {
+    // the waiting order of the rest is kept
+    const auto first { std::stable_partition(m_waiting.begin(), m_waiting.end(), 
+        [now](const Waiting& waiting) { return waiting.m_deadline > now; }
+    ) };
+    const auto count { static_cast<std::size_t>(std::distance(first, m_waiting.end())) };
+    for (auto it = first; it != m_waiting.end(); ++it) {
+        if (it->m_expire) {
+            expired.push_back(std::move(it->m_expire));
+        }
+    }
+    m_waiting.erase(first, m_waiting.end());
+    m_stats.m_waitingHandshakes = m_waiting.size();
+    m_stats.m_expiredHandshakes += count;
+    return count;
+}
+
+Admission::Stats Admission::GetStats() const {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    return m_stats;
+}
+
+} // namespace net
\ No newline at end of file
@@ -0,0 +1,161 @@
+#ifndef NET_ADMISSION_HPP
+#define NET_ADMISSION_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace net {
+
+/**
+ * Limits the number of connections and of the TLS handshakes in progress.
+ * A listener has own instance; it may have a parent (e.g. `Admission::Global()`)
+ * which limits the connections of all listeners together.
+ * 
+ * Thread safe.
+ */
+class Admission final : public std::enable_shared_from_this<Admission> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Limits {
+        /**
+         * Maximum number of the admitted connections. Zero means no limit.
+         */
+        std::size_t m_maxConnections { 0 };
+        /**
+         * Maximum number of the TLS handshakes in progress. Zero means no limit.
+         */
+        std::size_t m_maxHandshakes { 0 };
+        /**
+         * Number of connections which may wait for the handshake slot.
+         * The rest are refused.
+         */
+        std::size_t m_maxWaitingHandshakes { 0 };
+    };
+
+    struct Stats {
+        std::size_t m_connections { 0 };
+        std::size_t m_handshakes { 0 };
+        std::size_t m_waitingHandshakes { 0 };
+        std::uint64_t m_admitted { 0 };
+        /**
+         * Connections refused due to the connection limit (own or parent's).
+         */
+        std::uint64_t m_refusedConnections { 0 };
+        /**
+         * Connections refused as the handshake queue was full.
+         */
+        std::uint64_t m_refusedHandshakes { 0 };
+        /**
+         * Handshakes which had to wait for the slot.
+         */
+        std::uint64_t m_delayedHandshakes { 0 };
+        /**
+         * Waiting handshakes dropped as their deadline passed.
+         */
+        std::uint64_t m_expiredHandshakes { 0 };
+    };
+
+    explicit Admission(Limits limits, std::shared_ptr<Admission> parent = nullptr);
+
+    /**
+     * Process-wide admission, parent of the listeners' ones. Unlimited by default.
+     */
+    static const std::shared_ptr<Admission>& Global();
+
+    void SetLimits(Limits limits);
+
+    /**
+     * Set the limits unless they were claimed already: the first owner keeps them 
+     * (e.g. one of the servers of the process sets the `Global()` limits).
+     * @return 
+     *  The indication whether the limits were set.
+     */
+    bool ClaimLimits(Limits limits);
+
+    Limits GetLimits() const;
+
+    /**
+     * Admit the accepted connection.
+     * @return 
+     *  Return the ticket the connection holds while it's open, 
+     *  nullptr if the connection must be refused: over the connection limit 
+     *  or when there is no room for one more handshake.
+     */
+    std::shared_ptr<void> Admit();
+
+    /**
+     * Run @start right away if there is a free handshake slot, 
+     * or once the slot is released if the connection can wait.
+     * `FinishHandshake` must be called when the started handshake is over.
+     * A waiting handshake whose @deadline passes is dropped from the queue: 
+     * @expire is called instead of @start.
+     * @return 
+     *  The indication whether the handshake was started or queued (otherwise refused).
+     */
+    bool BeginHandshake(
+        std::function<void()> start, 
+        Clock::time_point deadline = Clock::time_point::max(),
+        std::function<void()> expire = nullptr
+    );
+
+    /**
+     * Release the handshake slot. The first waiting handshake is started.
+     */
+    void FinishHandshake();
+
+    /**
+     * Drop the waiting handshakes whose deadline has passed.
+     * @return 
+     *  Number of the dropped handshakes.
+     */
+    std::size_t DropExpiredHandshakes();
+
+    Stats GetStats() const;
+
+private:
+    class Ticket;
+
+    struct Waiting {
+        std::function<void()> m_start;
+        std::function<void()> m_expire;
+        Clock::time_point m_deadline;
+    };
+
+    /**
+     * Release the connection slot. Called by `Ticket`.
+     */
+    void Release() noexcept;
+
+    /**
+     * Remove the waiting handshakes whose deadline isn't after @now, 
+     * their expire callbacks are moved to @expired.
+     * @return 
+     *  Number of the removed handshakes.
+     * @note
+     *  Require `m_mutex` to be locked.
+     */
+    std::size_t TakeExpired(Clock::time_point now, std::vector<std::function<void()>>& expired);
+
+    const std::shared_ptr<Admission> m_parent;
+
+    mutable std::mutex m_mutex;
+
+    Limits m_limits;
+
+    bool m_isClaimed { false };
+
+    Stats m_stats {};
+
+    std::deque<Waiting> m_waiting;
+};
+
+} // namespace net
+
+#endif // NET_ADMISSION_HPP
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include "Chatroom.hpp"
 #include "Session.hpp"
+#include "Fanout.hpp"
+#include "MemoryAccount.hpp"
 
+#include <atomic>
 #include <mutex>
+#include <deque>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
@@ -15,11 +22,11 @@ namespace chat {
 
         Impl(const std::string& name);
 
+        Impl(std::size_t id, const std::string& name);
+
     public:
         /// Data members
 
-        static constexpr std::size_t MAX_CONNECTIONS { 256 };
-
         const std::size_t m_id { 0 };
 
         mutable std::mutex m_mutex;
@@ -28,10 +35,134 @@ namespace chat {
 
         std::size_t m_users { 0 };
 
-        std::array<std::shared_ptr<Session>, MAX_CONNECTIONS> m_sessions;
+        /**
+         * Members the chatroom accepts. Zero means no limit.
+         */
+        std::size_t m_capacity { Chatroom::DEFAULT_CAPACITY };
+
+        /**
+         * Subscribers of the chatroom. It's kept dense, 
+         * so a broadcast visits only the subscribed sessions.
+         */
+        std::vector<std::shared_ptr<Session>> m_sessions;
+
+        using Snapshot = std::shared_ptr<const std::vector<std::shared_ptr<Session>>>;
+
+        /**
+         * Immutable copy of `m_sessions` used for delivery, so the chunks 
+         * of a large room are delivered without the room's lock. 
+         * It's reset on every membership change and built on the next broadcast.
+         */
+        Snapshot m_snapshot { nullptr };
+
+        Fanout m_fanout;
+
+        struct Outgoing {
+            Snapshot m_snapshot;
+            std::shared_ptr<const std::string> m_message;
+            std::function<bool(const Session&)> m_predicate;
+            Relay m_relay;
+            /**
+             * Name of the chatroom when the message was broadcasted.
+             */
+            std::string m_room;
+        };
+
+        /**
+         * Messages waiting for delivery in the order they were broadcasted. 
+         * They're queued under the lock and delivered without it, 
+         * by one thread at a time (see `m_isDelivering`).
+         */
+        std::deque<Outgoing> m_outgoing;
+
+        /**
+         * Some thread is delivering `m_outgoing`, the others only queue.
+         */
+        bool m_isDelivering { false };
+
+        /**
+         * Sequence number of the last published message.
+         */
+        std::uint64_t m_sequence { 0 };
+
+        struct Entry {
+            std::uint64_t m_sequence;
+            std::shared_ptr<const std::string> m_frame;
+        };
+
+        /**
+         * Last published messages, ordered by their sequence numbers.
+         */
+        std::deque<Entry> m_history;
+
+        std::size_t m_historyCapacity { 0 };
+
+        std::size_t m_historyBytes { 0 };
+
+        std::shared_ptr<net::MemoryBudget> m_budget { nullptr };
+
+        struct Change {
+            enum class Kind { JOINED, LEFT, RENAMED } m_kind;
+            std::string m_name;
+        };
+
+        bool m_isPresenceEnabled { false };
+
+        /**
+         * Membership changes by user ID, see `TakePresence`.
+         */
+        std::map<std::uint64_t, Change> m_presence;
+
+        /**
+         * Merge the change into the pending ones.
+         * @note
+         *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+         */
+        void NotePresence(const Session& session, Change::Kind kind);
+
+        /**
+         * Drop the oldest entries, so at most @keep remain.
+         * @note
+         *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+         */
+        void TrimHistory(std::size_t keep);
+
+        /**
+         * Take snapshot of the subscribers for delivery.
+         * @note
+         *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+         */
+        Snapshot TakeSnapshot();
+
+        /**
+         * Queue @message for the subscribers which meet the @predicate 
+         * and for the @relay.
+         * @return
+         *  The indication whether the caller must deliver the queue (see `Deliver`): 
+         *  nobody else is doing it.
+         * @note
+         *  Thread-safety: NOT-safe, require `m_mutex` to be locked: 
+         *  the order of the calls is the order of delivery.
+         */
+        [[nodiscard]] bool Enqueue(
+            std::shared_ptr<const std::string> message, 
+            std::function<bool(const Session&)> predicate,
+            Relay relay
+        );
+
+        /**
+         * Deliver the queued messages until the queue is empty, 
+         * including the ones queued by the other threads meanwhile.
+         * @note
+         *  Thread-safety: safe, require `m_mutex` to be unlocked
+         */
+        void Deliver();
         
     private:
-        inline static std::size_t m_instances { Chatroom::NO_ROOM + 1U };
+        /**
+         * Chatrooms are created by several threads.
+         */
+        inline static std::atomic<std::size_t> m_instances { Chatroom::NO_ROOM + 1U };
     };
 
     Chatroom::Impl::Impl() : 
@@ -45,6 +176,98 @@ namespace chat {
         m_name { name }
     {}
 
+    Chatroom::Impl::Impl(std::size_t id, const std::string& name): 
+        m_id { id },
+        m_name { name }
+    {}
+
+    void Chatroom::Impl::NotePresence(const Session& session, Change::Kind kind) {
+        if (!m_isPresenceEnabled) {
+            return;
+        }
+        const auto& user { session.GetUser() };
+        const auto it { m_presence.find(user.m_id) };
+        if (it == m_presence.end()) {
+            m_presence.emplace(user.m_id, Change { kind, user.m_username });
+            return;
+        }
+        auto& change { it->second };
+        if (kind == Change::Kind::LEFT && change.m_kind == Change::Kind::JOINED) {
+            // nobody has been told about this member yet
+            m_presence.erase(it);
+        }
+        else if (kind == Change::Kind::LEFT) {
+            change = { kind, {} };
+        }
+        else if (change.m_kind == Change::Kind::LEFT) {
+            // left and came back: the others know the member, maybe not its name
+            change = { Change::Kind::RENAMED, user.m_username };
+        }
+        else {
+            change.m_name = user.m_username;
+        }
+    }
+
+    void Chatroom::Impl::TrimHistory(std::size_t keep) {
+        std::size_t released { 0 };
+        while (m_history.size() > keep) {
+            released += m_history.front().m_frame->size();
+            m_history.pop_front();
+        }
+        m_historyBytes -= released;
+        if (m_budget && released) {
+            m_budget->Charge(net::MemoryCategory::HISTORY, -static_cast<std::int64_t>(released));
+        }
+    }
+
+    Chatroom::Impl::Snapshot Chatroom::Impl::TakeSnapshot() {
+        if (!m_snapshot) {
+            m_snapshot = std::make_shared<const std::vector<std::shared_ptr<Session>>>(m_sessions);
+        }
+        return m_snapshot;
+    }
+
+    bool Chatroom::Impl::Enqueue(
+        std::shared_ptr<const std::string> message, 
+        std::function<bool(const Session&)> predicate,
+        Relay relay
+    ) {
+        Outgoing outgoing { this->TakeSnapshot(), std::move(message), std::move(predicate), std::move(relay) };
+        if (outgoing.m_relay) {
+            outgoing.m_room = m_name;
+        }
+        m_outgoing.push_back(std::move(outgoing));
+        if (m_isDelivering) {
+            return false;
+        }
+        m_isDelivering = true;
+        return true;
+    }
+
+    void Chatroom::Impl::Deliver() {
+        std::unique_lock<std::mutex> lock { m_mutex };
+        while (!m_outgoing.empty()) {
+            auto outgoing { std::move(m_outgoing.front()) };
+            m_outgoing.pop_front();
+            lock.unlock();
+            if (outgoing.m_relay) {
+                outgoing.m_relay(outgoing.m_room, *outgoing.m_message);
+            }
+            // large rooms are delivered in chunks by the fan-out executor
+            m_fanout.Run(std::move(outgoing.m_snapshot), 
+                [message = std::move(outgoing.m_message), predicate = std::move(outgoing.m_predicate)](
+                    const std::shared_ptr<Session>& session
+                ) {
+                    if (!session->IsClosed() && std::invoke(predicate, *session)) {
+                        session->Write(*message);
+                    }
+                }
+            );
+            lock.lock();
+        }
+        m_isDelivering = false;
+    }
+
     Chatroom::Chatroom() :
         m_impl { std::make_unique<Impl>() }
     { // default ctor
@@ -55,6 +278,11 @@ namespace chat {
     {
     }
 
+    Chatroom::Chatroom(std::size_t id, const std::string & name) :
+        m_impl { std::make_unique<Impl>(id, name) }
+    {
+    }
+
     Chatroom::Chatroom(Chatroom&&rhs) = default;
 
     Chatroom & Chatroom::operator=(Chatroom&&rhs) = default;
@@ -66,17 +294,18 @@ namespace chat {
             hasUsers = m_impl->m_users > 0U;
         }
         if (!hasUsers) this->Close();
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        m_impl->TrimHistory(0);
     };
 
     void Chatroom::Close() {
         std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
 
         for (auto& session: m_impl->m_sessions) {
-            if (session) { 
-                session->Close();
-                session.reset();
-            }
+            session->Close();
         };
+        m_impl->m_sessions.clear();
+        m_impl->m_snapshot.reset();
         m_impl->m_users = 0U;
     }
 
@@ -97,26 +326,59 @@ namespace chat {
     bool Chatroom::AddSession(const std::shared_ptr<Session>& session) {
         std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
 
-        if (m_impl->m_users >= Chatroom::Impl::MAX_CONNECTIONS) {
+        if (m_impl->m_capacity && m_impl->m_users >= m_impl->m_capacity) {
             return false;
         }
 
-        for (auto& s: m_impl->m_sessions) {
-            if (s == nullptr) {
-                s = session;
-                m_impl->m_users++;
-                break;
+        m_impl->m_sessions.push_back(session);
+        m_impl->m_snapshot.reset();
+        m_impl->m_users++;
+        m_impl->NotePresence(*session, Impl::Change::Kind::JOINED);
+        return true;
+    }
+
+    std::optional<Chatroom::Replay> Chatroom::Rejoin(const std::shared_ptr<Session>& session, std::uint64_t sequence) {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+
+        if (m_impl->m_capacity && m_impl->m_users >= m_impl->m_capacity) {
+            return std::nullopt;
+        }
+
+        m_impl->m_sessions.push_back(session);
+        m_impl->m_snapshot.reset();
+        m_impl->m_users++;
+        m_impl->NotePresence(*session, Impl::Change::Kind::JOINED);
+
+        Replay replay {};
+        replay.m_sequence = m_impl->m_sequence;
+        if (sequence >= m_impl->m_sequence) {
+            return replay;
+        }
+        const auto& history { m_impl->m_history };
+        replay.m_isComplete = !history.empty() && history.front().m_sequence <= sequence + 1;
+        // written under the lock: the following broadcasts are queued after these
+        auto it = std::lower_bound(history.begin(), history.end(), sequence + 1, 
+            [](const Impl::Entry& entry, std::uint64_t value) {
+                return entry.m_sequence < value;
             }
+        );
+        for (; it != history.end(); ++it) {
+            session->Write(*it->m_frame);
         }
-        return true;
+        return replay;
     }
 
     bool Chatroom::RemoveSession(const Session * const session) {
         std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
 
-        for (auto& s: m_impl->m_sessions) {
+        auto& sessions { m_impl->m_sessions };
+        for (auto& s: sessions) {
             if (s.get() == session) {
-                s.reset();
+                m_impl->NotePresence(*session, Impl::Change::Kind::LEFT);
+                // order of subscribers doesn't matter
+                s = std::move(sessions.back());
+                sessions.pop_back();
+                m_impl->m_snapshot.reset();
                 m_impl->m_users--;
                 return true;
             }
@@ -164,31 +426,167 @@ namespace chat {
         m_impl->m_name = name;
     }
 
-    void Chatroom::Broadcast(const std::string& text) {
+    void Chatroom::SetFanoutPolicy(const FanoutPolicy& policy) {
+        m_impl->m_fanout.SetPolicy(policy);
+    }
+
+    void Chatroom::SetCapacity(std::size_t capacity) {
         std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
-        for (auto& session: m_impl->m_sessions) {
-            if (session && session->IsClosed()) {
-                session.reset();
+        m_impl->m_capacity = capacity;
+    }
+
+    void Chatroom::SetHistory(std::size_t capacity, std::shared_ptr<net::MemoryBudget> budget) {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        if (m_impl->m_budget != budget) {
+            const auto bytes { static_cast<std::int64_t>(m_impl->m_historyBytes) };
+            if (m_impl->m_budget) {
+                m_impl->m_budget->Charge(net::MemoryCategory::HISTORY, -bytes);
+            }
+            if (budget) {
+                budget->Charge(net::MemoryCategory::HISTORY, bytes);
+            }
+            m_impl->m_budget = std::move(budget);
+        }
+        m_impl->m_historyCapacity = capacity;
+        m_impl->TrimHistory(capacity);
+    }
+
+    void Chatroom::TrimHistory(std::size_t keep) {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        m_impl->TrimHistory(keep);
+    }
+
+    std::uint64_t Chatroom::GetSequence() const noexcept {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        return m_impl->m_sequence;
+    }
+
+    std::vector<Chatroom::Kept> Chatroom::GetHistory() const {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        std::vector<Kept> history;
+        history.reserve(m_impl->m_history.size());
+        for (const auto& entry: m_impl->m_history) {
+            history.emplace_back(entry.m_sequence, *entry.m_frame);
+        }
+        return history;
+    }
+
+    void Chatroom::RestoreHistory(std::uint64_t sequence, std::vector<Kept> history) {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        m_impl->m_sequence = std::max(m_impl->m_sequence, sequence);
+        if (!m_impl->m_historyCapacity) {
+            return;
+        }
+        std::size_t bytes { 0 };
+        for (auto& [kept, frame]: history) {
+            const bool isOrdered { m_impl->m_history.empty() || m_impl->m_history.back().m_sequence < kept };
+            if (!isOrdered || kept > m_impl->m_sequence) {
+                continue;
+            }
+            bytes += frame.size();
+            m_impl->m_history.push_back({ kept, std::make_shared<const std::string>(std::move(frame)) });
+        }
+        m_impl->m_historyBytes += bytes;
+        if (m_impl->m_budget) {
+            m_impl->m_budget->Charge(net::MemoryCategory::HISTORY, static_cast<std::int64_t>(bytes));
+        }
+        m_impl->TrimHistory(m_impl->m_historyCapacity);
+    }
+
+    void Chatroom::EnablePresence() {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        m_impl->m_isPresenceEnabled = true;
+    }
+
+    void Chatroom::NoteRename(const Session& session) {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        m_impl->NotePresence(session, Impl::Change::Kind::RENAMED);
+    }
+
+    std::optional<Chatroom::Presence> Chatroom::TakePresence() {
+        std::map<std::uint64_t, Impl::Change> changes;
+        Presence presence {};
+        { // Block
+            std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+            if (m_impl->m_presence.empty()) {
+                return std::nullopt;
             }
-            else if (session) {
-                session->Write(text);
+            changes.swap(m_impl->m_presence);
+            presence.m_users = m_impl->m_users;
+        } // Release
+        for (auto& [id, change]: changes) {
+            switch (change.m_kind) {
+                case Impl::Change::Kind::JOINED: {
+                    presence.m_joined.emplace_back(id, std::move(change.m_name));
+                } break;
+                case Impl::Change::Kind::LEFT: {
+                    presence.m_left.push_back(id);
+                } break;
+                case Impl::Change::Kind::RENAMED: {
+                    presence.m_renamed.emplace_back(id, std::move(change.m_name));
+                } break;
             }
         }
+        return presence;
+    }
+
+    std::vector<Chatroom::Member> Chatroom::GetMembers() const {
+        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+        std::vector<Member> members;
+        members.reserve(m_impl->m_sessions.size());
+        for (const auto& session: m_impl->m_sessions) {
+            const auto& user { session->GetUser() };
+            members.emplace_back(user.m_id, user.m_username);
+        }
+        return members;
+    }
+
+    void Chatroom::Broadcast(const std::string& text) {
+        this->Broadcast(text, [](const Session&) { return true; });
     }
 
     void Chatroom::Broadcast(
         const std::string& text, 
-        std::function<bool(const Session&)> predicate
+        std::function<bool(const Session&)> predicate, 
+        Relay relay
     ) {
-        std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
-        for (auto& session: m_impl->m_sessions) {
-            if (session && session->IsClosed()) {
-                session.reset();
-            }
-            else if (session && std::invoke(predicate, *session)) {
-                session->Write(text);
+        auto message { std::make_shared<const std::string>(text) };
+        bool isDeliverer { false };
+        { // Block
+            std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+            isDeliverer = m_impl->Enqueue(std::move(message), std::move(predicate), std::move(relay));
+        } // Release
+        if (isDeliverer) {
+            m_impl->Deliver();
+        }
+    }
+
+    std::string Chatroom::Publish(
+        const FrameBuilder& build, 
+        std::function<bool(const Session&)> predicate, 
+        Relay relay
+    ) {
+        std::shared_ptr<const std::string> frame { nullptr };
+        bool isDeliverer { false };
+        { // Block
+            std::lock_guard<std::mutex> lock{ m_impl->m_mutex };
+            // built and queued under the lock, so the history, the relay 
+            // and every subscriber get the messages in the sequence order
+            frame = std::make_shared<const std::string>(build(++m_impl->m_sequence));
+            if (m_impl->m_historyCapacity) {
+                m_impl->m_history.push_back({ m_impl->m_sequence, frame });
+                m_impl->m_historyBytes += frame->size();
+                if (m_impl->m_budget) {
+                    m_impl->m_budget->Charge(net::MemoryCategory::HISTORY, static_cast<std::int64_t>(frame->size()));
+                }
+                m_impl->TrimHistory(m_impl->m_historyCapacity);
             }
+            isDeliverer = m_impl->Enqueue(frame, std::move(predicate), std::move(relay));
+        } // Release
+        if (isDeliverer) {
+            m_impl->Deliver();
         }
+        return *frame;
     }
 
 } // namespace chat
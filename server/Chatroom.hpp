@@ -5,20 +5,91 @@
 #include <array>
 #include <memory>
 #include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
 #include <cstddef> // std::size_t 
+#include <cstdint>
+
+#include "InstanceCounter.hpp"
 
 class Session;
 
+namespace net {
+    class MemoryBudget;
+}
+
 namespace chat {
 
-    class Chatroom {
+    struct FanoutPolicy;
+
+    class Chatroom : public rt::InstanceCounter<Chatroom> {
     public:
         static constexpr std::size_t NO_ROOM { 0 };
 
+        /**
+         * Members a chatroom accepts unless `SetCapacity` says otherwise.
+         */
+        static constexpr std::size_t DEFAULT_CAPACITY { 256 };
+
+        /**
+         * Builds the broadcasted frame stamped with its sequence number.
+         */
+        using FrameBuilder = std::function<std::string(std::uint64_t sequence)>;
+
+        /**
+         * Pass the broadcasted @frame of the chatroom named @room on, e.g. to the peer nodes. 
+         * It's called in the order of delivery.
+         */
+        using Relay = std::function<void(const std::string& room, const std::string& frame)>;
+
+        /**
+         * Result of the rejoin (see `Rejoin`).
+         */
+        struct Replay {
+            /**
+             * Sequence number of the last message of the chatroom.
+             */
+            std::uint64_t m_sequence { 0 };
+            /**
+             * The history still had every missed message.
+             */
+            bool m_isComplete { true };
+        };
+
+        /**
+         * User ID and name.
+         */
+        using Member = std::pair<std::uint64_t, std::string>;
+
+        /**
+         * Message kept by the history: sequence number and frame.
+         */
+        using Kept = std::pair<std::uint64_t, std::string>;
+
+        /**
+         * Membership changes since the last `TakePresence`, coalesced per user: 
+         * who joined and left in between isn't reported, the last name wins.
+         */
+        struct Presence {
+            std::vector<Member> m_joined;
+            std::vector<std::uint64_t> m_left;
+            std::vector<Member> m_renamed;
+            /**
+             * Number of the members when the changes were taken.
+             */
+            std::size_t m_users { 0 };
+        };
+
         Chatroom();
 
         Chatroom(const std::string & name);
 
+        /**
+         * Chatroom with the given @id (e.g. a handle allocated by `RoomService`).
+         */
+        Chatroom(std::size_t id, const std::string & name);
+
         Chatroom(Chatroom&&chatroom);
 
         Chatroom & operator=(Chatroom&&rhs);
@@ -41,6 +112,14 @@ namespace chat {
          */
         [[nodiscard]] bool AddSession(const std::shared_ptr<Session>& session);
 
+        /**
+         * Add the session and write it the messages after @sequence kept by the history. 
+         * Messages broadcasted later are delivered after the replayed ones.
+         * @return 
+         *      Nothing if the session can't be added.
+         */
+        [[nodiscard]] std::optional<Replay> Rejoin(const std::shared_ptr<Session>& session, std::uint64_t sequence);
+
         [[nodiscard]] bool RemoveSession(const Session * const session);
 
         [[nodiscard]] bool Contains(const Session * const session) const noexcept;
@@ -49,10 +128,91 @@ namespace chat {
 
         void Rename(const std::string& name);
 
+        /**
+         * Define when a broadcast is delivered in parallel chunks.
+         */
+        void SetFanoutPolicy(const FanoutPolicy& policy);
+
+        /**
+         * Accept at most @capacity members. Zero means no limit. 
+         * The members beyond it aren't removed.
+         */
+        void SetCapacity(std::size_t capacity);
+
+        /**
+         * Keep the last @capacity broadcasted messages for the resumed sessions. 
+         * Their bytes are charged to the @budget if it's given.
+         */
+        void SetHistory(std::size_t capacity, std::shared_ptr<net::MemoryBudget> budget);
+
+        /**
+         * Drop the oldest messages of the history, so at most @keep remain.
+         */
+        void TrimHistory(std::size_t keep);
+
+        /**
+         * Sequence number of the last broadcasted message. Zero if there were none.
+         */
+        [[nodiscard]] std::uint64_t GetSequence() const noexcept;
+
+        /**
+         * @return
+         *      Messages kept by the history, the oldest first.
+         */
+        [[nodiscard]] std::vector<Kept> GetHistory() const;
+
+        /**
+         * Continue numbering after @sequence and keep the @history 
+         * (e.g. handed over by the previous server) as far as the capacity allows. 
+         * The history must be ordered and end at @sequence at most.
+         */
+        void RestoreHistory(std::uint64_t sequence, std::vector<Kept> history);
+
+        /**
+         * Start collecting membership changes (see `TakePresence`). 
+         * The hall doesn't do it.
+         */
+        void EnablePresence();
+
+        /**
+         * The member has changed its name.
+         */
+        void NoteRename(const Session& session);
+
+        /**
+         * @return 
+         *      Changes collected since the last call, nothing if there were none.
+         */
+        [[nodiscard]] std::optional<Presence> TakePresence();
+
+        [[nodiscard]] std::vector<Member> GetMembers() const;
+
         /// Chat functions:
+        /**
+         * Messages are delivered in the order of the calls, but not under the 
+         * chatroom's lock: the caller only queues the message while another 
+         * thread is delivering the previous ones, that thread delivers it too.
+         * The @relay (if any) gets the message right before the members.
+         */
         void Broadcast(const std::string& text);
 
-        void Broadcast(const std::string& text, std::function<bool(const Session&)> predicate);
+        void Broadcast(
+            const std::string& text, 
+            std::function<bool(const Session&)> predicate, 
+            Relay relay = nullptr
+        );
+
+        /**
+         * Broadcast the frame made by @build with the next sequence number 
+         * and keep it in the history.
+         * @return 
+         *      The frame.
+         */
+        std::string Publish(
+            const FrameBuilder& build, 
+            std::function<bool(const Session&)> predicate, 
+            Relay relay = nullptr
+        );
 
     private:
         struct Impl;
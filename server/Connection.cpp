@@ -1,54 +1,170 @@
 #include "Connection.hpp"
 
+#include <algorithm>
 #include <utility>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "Message.hpp"
+#include "FrameScanner.hpp"
+#include "Compression.hpp"
 #include "RequestQueue.hpp"
+#include "ConnectionPool.hpp"
+#include "MemoryAccount.hpp"
+#include "KernelTLS.hpp"
 
 #include "Session.hpp"
 
+#include <openssl/ssl.h>
+
+#ifdef CHAT_USE_COROUTINES
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
 namespace net {
 
 Connection::Connection( 
     std::uint64_t id
-    , asio::ip::tcp::socket && socket
+    , Socket_t && socket
     , asio::io_context * const context
     , asio::ssl::context * const sslContext
-    , std::shared_ptr<rt::RequestQueue> incommingRequests
+    , std::shared_ptr<IOBuffers> buffers
+    , std::shared_ptr<Log> logger
 )   
-    : m_socket { std::move(socket), *sslContext }
-    , m_strand { *context }
+    : m_logger { std::move(logger) }
+    , m_socket { std::move(socket), *sslContext }
+    , m_strand { asio::make_strand(*context) }
+    , m_frameTimer { m_strand }
     , m_timer { *context }
-    , m_incommingRequests { incommingRequests }
+#ifdef CHAT_USE_COROUTINES
+    , m_writeSignal { m_strand, asio::steady_timer::time_point::max() }
+#endif
+    , m_incommingRequests { buffers, &buffers->m_requests }
+    , m_buffers { std::move(buffers) }
+    , m_outbox { m_buffers->m_outbox }
+    , m_inbox { m_buffers->m_inbox }
 { 
-    std::stringstream ss;
-    ss << "connection_" << m_id << "_log.txt";
-    m_logger = std::make_shared<Log>(ss.str().c_str());
+    if (!m_logger) {
+        std::stringstream ss;
+        ss << "connection_" << m_id << "_log.txt";
+        m_logger = std::make_shared<Log>(ss.str().c_str());
+    }
 }
 
 Connection::~Connection() {
     if (m_state != State::CLOSED) {
-        this->Close();
+        // `Close()` can't be posted from here: 
+        // `shared_from_this` throws once the last owner is gone.
+        boost::system::error_code error;
+        m_socket.lowest_layer().close(error);
     }
 }
 
 void Connection::Handshake() {
-    auto callback = [self = this->shared_from_this()](const boost::system::error_code& error) {
+    this->Handshake(0, nullptr);
+}
+
+void Connection::Handshake(std::uint64_t ms, TimerCallback&& done, asio::any_io_executor executor) {
+    if (executor) {
+        m_handshakeStrand = asio::make_strand(executor);
+    }
+    else {
+        m_handshakeStrand = m_strand;
+    }
+    m_isHandshaking = true;
+    if (ms) {
+        // a client which doesn't finish the handshake in time loses its slot
+        m_timer.expires_from_now(boost::posix_time::milliseconds(ms));
+        m_timer.async_wait(asio::bind_executor(m_handshakeStrand, 
+            [self = this->shared_from_this()](const boost::system::error_code& error) {
+                if (!error && self->m_isHandshaking) {
+                    self->AddLog(LogType::warning, "Handshake timed out\n");
+                    boost::system::error_code ignore;
+                    self->m_socket.lowest_layer().close(ignore);
+                }
+            })
+        );
+    }
+    auto callback = [self = this->shared_from_this(), done = std::move(done)](const boost::system::error_code& error) {
+        if (done) {
+            done(error);
+        }
         if (!error) {
             self->m_logger->Write(LogType::info, "Handshake successed\n");
+            if (!self->OffloadTLS()) {
+                return;
+            }
             if (auto subscriber = self->m_subscriber.lock(); subscriber) {
                 subscriber->AcknowledgeClient();
             }
+#ifdef CHAT_USE_COROUTINES
+            asio::co_spawn(self->m_strand, self->ReadLoop(self), asio::detached);
+            asio::co_spawn(self->m_strand, self->WriteLoop(self), asio::detached);
+#else
             self->Read();
+#endif
         }
         else {
             self->m_logger->Write(LogType::error, "Handshake failed", error.message(), "\n");
             self->Close();
         }
     };
-    m_socket.async_handshake(boost::asio::ssl::stream_base::server, callback);
+    // OpenSSL does its work in the handlers of the handshake's reads,
+    // so they run on the handshake strand; the socket stays in the reactor 
+    // and the connection continues on its strand.
+    auto handoff = [self = this->shared_from_this(), callback = std::move(callback)](
+        const boost::system::error_code& error
+    ) mutable {
+        self->m_isHandshaking = false;
+        boost::system::error_code ignore;
+        self->m_timer.cancel(ignore);
+        asio::dispatch(self->m_strand, std::bind(std::move(callback), error));
+    };
+#ifdef CHAT_LOOPBACK_PLAINTEXT
+    // nothing to negotiate: frames go through the socket itself
+    m_isOffloaded = true;
+    asio::post(m_handshakeStrand, std::bind(std::move(handoff), boost::system::error_code {}));
+#else
+    m_socket.async_handshake(
+        boost::asio::ssl::stream_base::server, 
+        asio::bind_executor(
+            m_handshakeStrand, 
+            Internal::MakeAllocatingHandler(m_readMemory, std::move(handoff))
+        )
+    );
+#endif
+}
+
+bool Connection::OffloadTLS() {
+#ifdef CHAT_HAS_KERNEL_TLS
+    SSL * const ssl = m_socket.native_handle();
+    if (!IsKernelTlsEnabled(ssl)) {
+        return true;
+    }
+    // asio's engine talks to OpenSSL through a memory BIO pair, 
+    // so the keys are installed here rather than by OpenSSL
+    std::string reason;
+    switch (InstallKernelTls(m_socket.lowest_layer().native_handle(), ssl, reason)) {
+        case KernelTls::OFFLOADED: {
+            m_isOffloaded = true;
+            this->AddLog(LogType::info, "kTLS offload is active\n");
+        } break;
+        case KernelTls::USER_SPACE: {
+            this->AddLog(LogType::warning, "kTLS isn't engaged (", reason, "), fall back to user space TLS\n");
+        } break;
+        case KernelTls::BROKEN: {
+            this->AddLog(LogType::error, "kTLS failed (", reason, "), close connection\n");
+            this->Close();
+            return false;
+        }
+    }
+#endif
+    return true;
 }
 
 void Connection::Publish() {
@@ -63,6 +179,19 @@ void Connection::AddSubscriber(std::weak_ptr<Session> session) {
 
 void Connection::Close() {
     boost::asio::post(m_strand, [self = this->shared_from_this()]() {
+        if (self->m_isHandshaking) {
+            // abort the handshake on its strand: the failed handshake closes the connection
+            asio::post(self->m_handshakeStrand, [self]() {
+                if (self->m_isHandshaking) {
+                    boost::system::error_code ignore;
+                    self->m_socket.lowest_layer().close(ignore);
+                }
+                else {
+                    self->Close();
+                }
+            });
+            return;
+        }
         if (self->m_state != State::CLOSED) {
             boost::system::error_code error;
             self->m_socket.lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both, error);
@@ -85,8 +214,16 @@ void Connection::Close() {
                 subscriber->RemoveFromService();
             }
             self->m_state = State::CLOSED;
+            self->m_frameTimer.cancel();
+            if (self->m_memory) {
+                self->m_memory->Clear();
+            }
             // unsubscribe
             self->m_subscriber.reset();
+#ifdef CHAT_USE_COROUTINES
+            // let the write loop finish
+            self->m_writeSignal.cancel();
+#endif
         }
     });
 }
@@ -100,22 +237,39 @@ void Connection::Read(std::uint64_t ms, TimerCallback&& callback) {
 }
 
 
+void Connection::EnableCompression(std::size_t threshold) {
+    asio::post(m_strand, [threshold, self = shared_from_this()]() {
+        if (!self->m_deflater) {
+            self->m_deflater = std::make_unique<Internal::FrameDeflater>();
+        }
+        self->m_compressionThreshold = threshold;
+    });
+}
+
 void Connection::Write(std::string&& text) {
     asio::post(m_strand, [text = std::move(text), self = shared_from_this()]() mutable {
+        if (self->m_state == State::CLOSED) {
+            // nobody reads it anymore, don't charge the released account again
+            return;
+        }
+        self->Compress(text);
         self->m_outbox.Enque(std::move(text));
+        self->UpdateMemory();
+#ifdef CHAT_USE_COROUTINES
+        // wake up the write loop if it's waiting
+        self->m_writeSignal.cancel();
+#else
         if (self->m_state != State::WRITING) {
             self->Write();
         }
+#endif
     });
 }
 
 void Connection::Read() {
-    asio::async_read_until(
-        m_socket,
-        m_inbox,
-        Internal::MESSAGE_DELIMITER,
-        asio::bind_executor(
-            m_strand, 
+    auto handler = asio::bind_executor(
+        m_strand, 
+        Internal::MakeAllocatingHandler(m_readMemory, 
             std::bind(&Connection::ReadSomeHandler, 
                 this->shared_from_this(), 
                 std::placeholders::_1, 
@@ -123,6 +277,12 @@ void Connection::Read() {
             )
         )
     );
+    if (m_isOffloaded) {
+        m_socket.next_layer().async_read_some(m_inbox.prepare(READ_CHUNK_SIZE), std::move(handler));
+    }
+    else {
+        m_socket.async_read_some(m_inbox.prepare(READ_CHUNK_SIZE), std::move(handler));
+    }
 }
 
 void Connection::Write() {
@@ -130,11 +290,9 @@ void Connection::Write() {
     m_outbox.SwapBuffers();
     // initiate write operation
     m_state = State::WRITING;
-    asio::async_write(
-        m_socket,
-        m_outbox.GetBufferSequence(),
-        asio::bind_executor(
-            m_strand,
+    auto handler = asio::bind_executor(
+        m_strand,
+        Internal::MakeAllocatingHandler(m_writeMemory, 
             std::bind(&Connection::WriteSomeHandler, 
                 this->shared_from_this(), 
                 std::placeholders::_1, 
@@ -142,6 +300,12 @@ void Connection::Write() {
             )
         )
     );
+    if (m_isOffloaded) {
+        asio::async_write(m_socket.next_layer(), m_outbox.GetBufferSequence(), std::move(handler));
+    }
+    else {
+        asio::async_write(m_socket, m_outbox.GetBufferSequence(), std::move(handler));
+    }
 }
 
 void Connection::WriteSomeHandler(
@@ -160,6 +324,7 @@ void Connection::WriteSomeHandler(
         else {
             m_state = State::DEFAULT;
         }
+        this->UpdateMemory();
     } 
     else /* if (error == boost::asio::error::eof) */ {
         // Connection was closed by the remote peer 
@@ -179,31 +344,265 @@ void Connection::ReadSomeHandler(
         this->AddLog(LogType::info, 
             "Connection just recive:", transferredBytes, "bytes.\n"
         );
-        const auto data { m_inbox.data() };
-        std::string received {
-            asio::buffers_begin(data), 
-            asio::buffers_begin(data) + transferredBytes - Internal::MESSAGE_DELIMITER.size()
-        };
-        m_inbox.consume(transferredBytes);
-        
-        boost::system::error_code ec; 
-        this->AddLog(LogType::info, 
-            m_socket.lowest_layer().remote_endpoint(ec), ':', received, '\n'
-        );
-
-        // Handle exceptions
-        Internal::Request request{};
-        request.Read(received);
-        m_incommingRequests->Push(std::move(request));
-        this->Publish();
+        m_inbox.commit(transferredBytes);
+        if (!this->ChargeInbound(transferredBytes)) {
+            return;
+        }
+        // Extract all complete frames and publish them as a single batch.
+        std::vector<Internal::Request> batch;
+        if (!this->ExtractRequests(batch)) {
+            return;
+        }
+        const bool hasExtracted { !batch.empty() };
+        if (hasExtracted) {
+            if (m_memory) {
+                std::int64_t bytes { 0 };
+                for (const auto& request: batch) {
+                    bytes += MemoryAccount::SizeOf(request);
+                }
+                // released by the session once handled
+                m_memory->Add(MemoryCategory::REQUESTS, bytes);
+            }
+            m_incommingRequests->Push(std::move(batch));
+            this->Publish();
+        }
+        if (!this->CheckPartialFrame(hasExtracted)) {
+            return;
+        }
+        this->UpdateMemory();
         this->Read();
     } 
     else {
         this->AddLog(LogType::error, 
             "Connection trying to read invoked error:", error.message(), '\n'
         );
+        // the remote peer is gone: free its place in the hall or chatrooms
+        this->Close();
     }
 }
 
+bool Connection::ExtractRequests(std::vector<Internal::Request>& batch) {
+    const std::size_t limit { m_inboundPolicy? m_inboundPolicy->m_maxFrameSize: 0 };
+    bool isOversized { false };
+    bool isCorrupted { false };
+    const auto data { m_inbox.data() };
+    const std::string_view received { 
+        static_cast<const char*>(data.data()), data.size() 
+    };
+    boost::system::error_code ec; 
+    const auto remote { m_socket.lowest_layer().remote_endpoint(ec) };
+    // A partial frame stays in the inbox until the next read.
+    const auto consumed = Internal::ExtractFrames(received, m_scanned, [&](std::string_view frame) {
+        if (isOversized || isCorrupted) {
+            return;
+        }
+        if (limit && frame.size() > limit) {
+            isOversized = true;
+            return;
+        }
+        this->AddLog(LogType::info, remote, ':', frame, '\n');
+        // Handle exceptions
+        Internal::Request request{};
+        if (Internal::IsCompressedFrame(frame)) {
+            if (!m_inflater) {
+                m_inflater = std::make_unique<Internal::FrameInflater>();
+            }
+            if (!m_inflater->Decompress(frame, m_decompressed, limit)) {
+                // the inflate stream is broken, the following frames can't be read
+                isOversized = m_inflater->IsOverLimit();
+                isCorrupted = !isOversized;
+                return;
+            }
+            request.Read(m_decompressed);
+        }
+        else {
+            request.Read(std::string{ frame });
+        }
+        batch.emplace_back(std::move(request));
+    });
+    m_inbox.consume(consumed);
+    if (isOversized) {
+        this->Reject(m_inboundPolicy->m_oversizedFrames, "Frame is over the size limit");
+        return false;
+    }
+    if (isCorrupted) {
+        this->AddLog(LogType::error, "Connection failed to decompress frame, close connection\n");
+        this->Close();
+        return false;
+    }
+    return true;
+}
+
+bool Connection::ChargeInbound(std::size_t bytes) {
+    if (!m_inboundPolicy || !m_inboundPolicy->m_byteRate) {
+        return true;
+    }
+    // token bucket: refilled at the rate, holds a second worth of bytes
+    // (or a whole frame if it's larger)
+    const auto rate { static_cast<double>(m_inboundPolicy->m_byteRate) };
+    const auto capacity { std::max(rate, static_cast<double>(m_inboundPolicy->m_maxFrameSize)) };
+    const auto now { std::chrono::steady_clock::now() };
+    if (m_budgetUpdate == std::chrono::steady_clock::time_point{}) {
+        m_inboundBudget = capacity;
+    }
+    else {
+        const std::chrono::duration<double> elapsed { now - m_budgetUpdate };
+        m_inboundBudget = std::min(capacity, m_inboundBudget + elapsed.count() * rate);
+    }
+    m_budgetUpdate = now;
+    m_inboundBudget -= static_cast<double>(bytes);
+    if (m_inboundBudget < 0.0) {
+        this->Reject(m_inboundPolicy->m_exceededBudgets, "Inbound byte budget is exceeded");
+        return false;
+    }
+    return true;
+}
+
+bool Connection::CheckPartialFrame(bool hasExtracted) {
+    if (!m_inboundPolicy) {
+        return true;
+    }
+    const auto pending { m_inbox.size() };
+    if (m_inboundPolicy->m_maxFrameSize && pending > m_inboundPolicy->m_maxFrameSize) {
+        this->Reject(m_inboundPolicy->m_oversizedFrames, "Partial frame is over the size limit");
+        return false;
+    }
+    if (!m_inboundPolicy->m_frameTimeout) {
+        return true;
+    }
+    if (!pending) {
+        if (m_isFrameTimerArmed) {
+            m_isFrameTimerArmed = false;
+            m_frameGeneration++;
+            m_frameTimer.cancel();
+        }
+        return true;
+    }
+    if (m_isFrameTimerArmed && !hasExtracted) {
+        // the same frame is still coming
+        return true;
+    }
+    m_isFrameTimerArmed = true;
+    const auto generation { ++m_frameGeneration };
+    m_frameTimer.expires_after(std::chrono::milliseconds(m_inboundPolicy->m_frameTimeout));
+    m_frameTimer.async_wait([self = this->shared_from_this(), generation](const boost::system::error_code& error) {
+        if (!error && self->m_frameGeneration == generation && self->m_state != State::CLOSED) {
+            self->Reject(self->m_inboundPolicy->m_expiredFrames, "Partial frame wasn't completed in time");
+        }
+    });
+    return true;
+}
+
+void Connection::UpdateMemory() noexcept {
+    if (!m_memory || m_state == State::CLOSED) {
+        return;
+    }
+    m_memory->Set(MemoryCategory::INBOX, m_inbox.capacity());
+    m_memory->Set(MemoryCategory::OUTBOX, m_outbox.GetHeldBytes());
+}
+
+void Connection::Reject(std::atomic<std::uint64_t>& counter, const char * reason) {
+    counter++;
+    this->AddLog(LogType::warning, reason, ", close connection\n");
+    this->Close();
+}
+
+void Connection::Compress(std::string& text) {
+    if (!m_deflater || text.size() < m_compressionThreshold) {
+        return;
+    }
+    const std::string_view payload { 
+        text.data(), text.size() - Internal::MESSAGE_DELIMITER.size() 
+    };
+    std::string frame;
+    if (m_deflater->Compress(payload, frame)) {
+        text = std::move(frame);
+    }
+}
+
+#ifdef CHAT_USE_COROUTINES
+asio::awaitable<void> Connection::ReadLoop(std::shared_ptr<Connection> self) {
+    boost::system::error_code error;
+    // reused between reads, so it allocates only when a bigger batch comes
+    std::vector<Internal::Request> batch;
+    for (;;) {
+        const auto transferredBytes = m_isOffloaded
+            ? co_await m_socket.next_layer().async_read_some(
+                m_inbox.prepare(READ_CHUNK_SIZE),
+                asio::redirect_error(asio::use_awaitable, error)
+            )
+            : co_await m_socket.async_read_some(
+                m_inbox.prepare(READ_CHUNK_SIZE),
+                asio::redirect_error(asio::use_awaitable, error)
+            );
+        if (error) {
+            this->AddLog(LogType::error, 
+                "Connection trying to read invoked error:", error.message(), '\n'
+            );
+            // the remote peer is gone: free its place in the hall or chatrooms
+            this->Close();
+            co_return;
+        }
+        this->AddLog(LogType::info, 
+            "Connection just recive:", transferredBytes, "bytes.\n"
+        );
+        m_inbox.commit(transferredBytes);
+        if (!this->ChargeInbound(transferredBytes) || !this->ExtractRequests(batch)) {
+            co_return;
+        }
+        const bool hasExtracted { !batch.empty() };
+        if (hasExtracted) {
+            // No queue and no post: the session handles the batch 
+            // while the strand is held by this loop. 
+            if (auto subscriber = m_subscriber.lock(); subscriber) {
+                subscriber->HandleRequests(std::move(batch));
+            }
+            batch.clear();
+        }
+        if (!this->CheckPartialFrame(hasExtracted)) {
+            co_return;
+        }
+        this->UpdateMemory();
+    }
+}
+
+asio::awaitable<void> Connection::WriteLoop(std::shared_ptr<Connection> self) {
+    boost::system::error_code error;
+    while (m_state != State::CLOSED) {
+        if (!m_outbox.GetQueueSize()) {
+            // `operation_aborted` is the wake up signal
+            m_writeSignal.expires_at(asio::steady_timer::time_point::max());
+            co_await m_writeSignal.async_wait(asio::redirect_error(asio::use_awaitable, error));
+            continue;
+        }
+        // add all text that is queued for write operation to active buffer
+        m_outbox.SwapBuffers();
+        m_state = State::WRITING;
+        const auto transferredBytes = m_isOffloaded
+            ? co_await asio::async_write(
+                m_socket.next_layer(),
+                m_outbox.GetBufferSequence(),
+                asio::redirect_error(asio::use_awaitable, error)
+            )
+            : co_await asio::async_write(
+                m_socket,
+                m_outbox.GetBufferSequence(),
+                asio::redirect_error(asio::use_awaitable, error)
+            );
+        if (error) {
+            this->AddLog(LogType::error, 
+                "Connection has error trying to write:", error.message(), '\n'
+            );
+            this->Close();
+            co_return;
+        }
+        this->AddLog(LogType::info, "Connection sent:", transferredBytes, "bytes.\n");
+        if (m_state == State::WRITING) {
+            m_state = State::DEFAULT;
+        }
+        this->UpdateMemory();
+    }
+}
+#endif
 
 } // net
\ No newline at end of file
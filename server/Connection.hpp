@@ -1,38 +1,61 @@
 #ifndef NET_CONNECTION_HPP
 #define NET_CONNECTION_HPP
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
 #include "DoubleBuffer.hpp"
+#include "HandlerAllocator.hpp"
 #include "Log.hpp"
+#include "Transport.hpp"
+#include "InboundPolicy.hpp"
+#include "InstanceCounter.hpp"
 
 namespace rt {
     class RequestQueue;
 }
 
+namespace net {
+    struct IOBuffers;
+    class MemoryAccount;
+}
+
+namespace Internal {
+    struct Request;
+    class FrameDeflater;
+    class FrameInflater;
+}
+
 class Session;
 
 namespace net {
 
 namespace asio = boost::asio;
 
-class Connection final : public std::enable_shared_from_this<Connection> {
+class Connection final : 
+    public std::enable_shared_from_this<Connection>, 
+    public rt::InstanceCounter<Connection> 
+{
 public:
 
     using TimerCallback = std::function<void(const boost::system::error_code&)>;
 
     Connection(
         std::uint64_t id
-        , asio::ip::tcp::socket&& socket
+        , Socket_t&& socket
         , asio::io_context * const context
         , asio::ssl::context * const sslContext
-        , std::shared_ptr<rt::RequestQueue> incommingRequests
+        , std::shared_ptr<IOBuffers> buffers
+        , std::shared_ptr<Log> logger = nullptr
     );
 
     ~Connection();
@@ -41,6 +64,20 @@ public:
 
     void Handshake();
 
+    /**
+     * Initiate handshake which must complete within @ms milliseconds 
+     * (zero means no deadline), otherwise the socket is closed.
+     * @done is called on the strand once the handshake is over, successful or not.
+     * @executor runs the handshake's handlers, i.e. the key exchange. 
+     * Established connections aren't delayed by it when it's a separate pool.
+     * The connection's strand is used if it's empty.
+     */
+    void Handshake(
+        std::uint64_t ms, 
+        TimerCallback&& done, 
+        asio::any_io_executor executor = {}
+    );
+
     /**
      * Read with timeout
      */
@@ -53,6 +90,29 @@ public:
      */
     void Write(std::string&& text);
 
+    /**
+     * Compress outgoing frames of at least @threshold bytes
+     * (the delimiter included) from now on.
+     * Compressed incoming frames are always accepted.
+     */
+    void EnableCompression(std::size_t threshold);
+
+    /**
+     * Apply the limits of the data read from the remote peer. 
+     * Must be set before the handshake. No limits by default.
+     */
+    void SetInboundPolicy(std::shared_ptr<InboundPolicy> policy) noexcept {
+        m_inboundPolicy = std::move(policy);
+    }
+
+    /**
+     * Report the bytes held by the inbox, the outbox and the request queue to @account.
+     * Must be set before the handshake.
+     */
+    void SetMemoryAccount(std::shared_ptr<MemoryAccount> account) noexcept {
+        m_memory = std::move(account);
+    }
+
     /**
      * Shutdown Session and close the socket  
      */
@@ -66,6 +126,14 @@ private:
     
     void Publish();
 
+    /**
+     * Hand the record layer to the kernel (kTLS) once the handshake is done, 
+     * if it's enabled. Otherwise or on failure keep it in user space.
+     * @return
+     *  False if the connection is unusable and closed.
+     */
+    bool OffloadTLS();
+
     /**
      * Read data from the remote connection.
      * At first it's invoked at `Read(ms)` completion handler.
@@ -89,6 +157,62 @@ private:
         std::size_t transferredBytes
     );
 
+    /**
+     * Parse all complete frames of the inbox into @batch
+     * and consume them. A partial frame stays in the inbox.
+     * @return
+     *  False if a frame is over the inbound policy's limit.
+     */
+    bool ExtractRequests(std::vector<Internal::Request>& batch);
+
+    /**
+     * Charge @bytes just read to the inbound byte budget. 
+     * @return
+     *  False if the budget is exceeded.
+     */
+    bool ChargeInbound(std::size_t bytes);
+
+    /**
+     * Check the partial frame left in the inbox after extraction 
+     * and (re)arm its deadline when a new frame started.
+     * @return
+     *  False if the partial frame is already over the limit.
+     */
+    bool CheckPartialFrame(bool hasExtracted);
+
+    /**
+     * Report the current size of the inbox & outbox to the memory account.
+     */
+    void UpdateMemory() noexcept;
+
+    /**
+     * Close the connection violating the inbound policy.
+     */
+    void Reject(std::atomic<std::uint64_t>& counter, const char * reason);
+
+    /**
+     * Replace @text by the compressed frame if compression is enabled
+     * and the frame is large enough.
+     */
+    void Compress(std::string& text);
+
+#ifdef CHAT_USE_COROUTINES
+    /**
+     * Read requests until the socket fails and hand every batch
+     * to the session right on the strand.
+     * @param self
+     *  Keeps the connection alive for the whole loop 
+     *  instead of copying it for each operation.
+     */
+    asio::awaitable<void> ReadLoop(std::shared_ptr<Connection> self);
+
+    /**
+     * Sleep on `m_writeSignal` while the outbox is empty, 
+     * otherwise write everything queued so far.
+     */
+    asio::awaitable<void> WriteLoop(std::shared_ptr<Connection> self);
+#endif
+
     /**
      * Logging the custom message
      */
@@ -122,9 +246,44 @@ private:
     /**
      * It's a socket connected to the remote peer. 
      */
-    asio::ssl::stream<asio::ip::tcp::socket> m_socket;
+    asio::ssl::stream<Socket_t> m_socket;
 
-    asio::io_context::strand m_strand;
+    asio::strand<asio::io_context::executor_type> m_strand;
+
+    /**
+     * Deadline of the partial frame in the inbox.
+     */
+    asio::steady_timer m_frameTimer;
+
+    /**
+     * Incremented each time the frame deadline is armed or disarmed, 
+     * so the stale expiration is ignored.
+     */
+    std::uint64_t m_frameGeneration { 0 };
+
+    bool m_isFrameTimerArmed { false };
+
+    std::shared_ptr<InboundPolicy> m_inboundPolicy { nullptr };
+
+    std::shared_ptr<MemoryAccount> m_memory { nullptr };
+
+    /**
+     * Bytes the remote peer may send right now (see `InboundPolicy::m_byteRate`).
+     */
+    double m_inboundBudget { 0.0 };
+
+    std::chrono::steady_clock::time_point m_budgetUpdate {};
+
+    /**
+     * Strand on which the handshake's handlers run. 
+     * The socket belongs to it until the handshake is over.
+     */
+    asio::any_io_executor m_handshakeStrand;
+
+    /**
+     * Set before the handshake starts, reset on `m_handshakeStrand` when it's over.
+     */
+    std::atomic<bool> m_isHandshaking { false };
 
     /**
      * This is a timer used to set up deadline for the client
@@ -133,22 +292,81 @@ private:
      */
     asio::deadline_timer m_timer;
 
+#ifdef CHAT_USE_COROUTINES
+    /**
+     * Never expires by itself: `Write()` and `Close()` cancel it
+     * to wake up the write loop.
+     */
+    asio::steady_timer m_writeSignal;
+#endif
+
     std::shared_ptr<rt::RequestQueue> m_incommingRequests{ nullptr };
 
     std::weak_ptr<Session> m_subscriber{};
 
-    Buffers m_outbox;
+    /**
+     * Inbox, outbox and the request queue, possibly recycled 
+     * from a closed connection (see `ConnectionPool`).
+     */
+    std::shared_ptr<IOBuffers> m_buffers;
+
+    Buffers& m_outbox;
 
     /**
      * A buffer used for incoming information.
      */
-    asio::streambuf m_inbox;
+    asio::streambuf& m_inbox;
+
+    /**
+     * Length of the partial frame in the inbox which is already searched for the delimiter.
+     */
+    std::size_t m_scanned { 0 };
+
+    /**
+     * Created when the compression is negotiated.
+     */
+    std::unique_ptr<Internal::FrameDeflater> m_deflater { nullptr };
+
+    std::size_t m_compressionThreshold { 0 };
+
+    /**
+     * Created with the first compressed frame from the remote peer.
+     */
+    std::unique_ptr<Internal::FrameInflater> m_inflater { nullptr };
+
+    /**
+     * The last decompressed frame (reused).
+     */
+    std::string m_decompressed;
+
+    /**
+     * Recycled memory of the handshake & read operations.
+     * Only one of them can be outstanding at a time.
+     */
+    Internal::HandlerMemory m_readMemory;
+
+    /**
+     * Recycled memory of the write operations.
+     */
+    Internal::HandlerMemory m_writeMemory;
 
     /**
      * Indicate a socket state
      */
     State m_state { State::DEFAULT };
 
+    /**
+     * The kernel seals the records, or there are none over the plaintext loopback: 
+     * read & write `m_socket.next_layer()`.
+     */
+    bool m_isOffloaded { false };
+
+    /**
+     * Size of the inbox area prepared for each `async_read_some`.
+     * A single read may bring several pipelined requests.
+     */
+    static constexpr std::size_t READ_CHUNK_SIZE { 16 * 1024 };
+
     /**
      * Define hom long the connection can wait for request 
      * from the client. Time is in milliseconds.
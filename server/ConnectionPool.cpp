@@ -0,0 +1,118 @@
+#include "ConnectionPool.hpp"
+
+#include <new>
+
+namespace net {
+
+void IOBuffers::Reset() {
+    m_inbox.consume(m_inbox.size());
+    m_outbox.Clear();
+    if (!m_requests.IsEmpty()) {
+        rt::RequestQueue dropped{};
+        m_requests.Swap(dropped);
+    }
+}
+
+std::size_t IOBuffers::GetRetainedBytes() const noexcept {
+    return m_inbox.capacity() + m_outbox.GetReservedBytes();
+}
+
+ConnectionPool::ConnectionPool(Limits limits, const char *logFile) 
+    : m_limits { limits }
+    , m_logger { std::make_shared<Log>(logFile) }
+{
+    m_idleBuffers.reserve(m_limits.m_maxIdle);
+}
+
+ConnectionPool::~ConnectionPool() {
+    for (auto& [size, blocks]: m_idleBlocks) {
+        for (void *block: blocks) {
+            ::operator delete(block);
+        }
+    }
+}
+
+std::shared_ptr<IOBuffers> ConnectionPool::AcquireBuffers() {
+    std::unique_ptr<IOBuffers> buffers;
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (!m_idleBuffers.empty()) {
+            buffers = std::move(m_idleBuffers.back());
+            m_idleBuffers.pop_back();
+            ++m_reusedBuffers;
+        }
+        else {
+            ++m_createdBuffers;
+        }
+    }
+    if (!buffers) {
+        buffers = std::make_unique<IOBuffers>();
+    }
+    auto self { this->shared_from_this() };
+    // the control block is recycled as well
+    return std::shared_ptr<IOBuffers>(
+        buffers.release(),
+        [pool = self](IOBuffers *released) {
+            pool->Recycle(released);
+        },
+        ShellAllocator<IOBuffers>{ self }
+    );
+}
+
+ConnectionPool::Stats ConnectionPool::GetStats() const {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    Stats stats;
+    stats.m_idleBuffers = m_idleBuffers.size();
+    for (const auto& [size, blocks]: m_idleBlocks) {
+        stats.m_idleBlocks += blocks.size();
+    }
+    stats.m_createdBuffers = m_createdBuffers;
+    stats.m_reusedBuffers = m_reusedBuffers;
+    return stats;
+}
+
+void* ConnectionPool::AllocateBlock(std::size_t size) {
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (auto it = m_idleBlocks.find(size); it != m_idleBlocks.end() && !it->second.empty()) {
+            void *block = it->second.back();
+            it->second.pop_back();
+            return block;
+        }
+    }
+    return ::operator new(size);
+}
+
+void ConnectionPool::ReleaseBlock(void *block, std::size_t size) noexcept {
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (m_limits.m_maxIdle) {
+            try {
+                auto& blocks { m_idleBlocks[size] };
+                if (blocks.size() < m_limits.m_maxIdle) {
+                    blocks.reserve(m_limits.m_maxIdle);
+                    blocks.push_back(block);
+                    return;
+                }
+            }
+            catch (const std::bad_alloc&) {
+                // just release the block
+            }
+        }
+    }
+    ::operator delete(block);
+}
+
+void ConnectionPool::Recycle(IOBuffers *buffers) noexcept {
+    buffers->Reset();
+    if (buffers->GetRetainedBytes() <= m_limits.m_maxRetainedBytes) {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (m_idleBuffers.size() < m_limits.m_maxIdle) {
+            m_idleBuffers.emplace_back(buffers);
+            return;
+        }
+    }
+    delete buffers;
+}
+
+} // namespace net
\ No newline at end of file
@@ -0,0 +1,179 @@
+#ifndef NET_CONNECTION_POOL_HPP
+#define NET_CONNECTION_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "DoubleBuffer.hpp"
+#include "Log.hpp"
+#include "RequestQueue.hpp"
+
+namespace net {
+
+namespace asio = boost::asio;
+
+/**
+ * I/O state of a connection which is worth keeping between 
+ * connection lifetimes: all of the containers retain their capacity.
+ */
+struct IOBuffers final {
+    /**
+     * A buffer used for incoming information.
+     */
+    asio::streambuf m_inbox;
+
+    Buffers m_outbox;
+
+    /**
+     * Requests read by the connection and waiting for the session.
+     */
+    rt::RequestQueue m_requests;
+
+    /**
+     * Drop the content but keep the capacity.
+     */
+    void Reset();
+
+    /**
+     * Approximate number of heap bytes held by the buffers.
+     */
+    std::size_t GetRetainedBytes() const noexcept;
+};
+
+/**
+ * Keeps shells of the closed connections for the next accepted ones:
+ * - `IOBuffers` with their capacity;
+ * - memory blocks of the `Session` and `net::Connection` objects 
+ * (with their control blocks) allocated by `MakeShared`;
+ * - a single log shared by all connections instead of a file per connection.
+ * 
+ * Thread safe. 
+ */
+class ConnectionPool final : public std::enable_shared_from_this<ConnectionPool> {
+public:
+
+    struct Limits {
+        /**
+         * Maximum number of idle buffers and idle blocks of each size.
+         */
+        std::size_t m_maxIdle { 256 };
+        /**
+         * Buffers which grew beyond this size are released instead.
+         */
+        std::size_t m_maxRetainedBytes { 64 * 1024 };
+    };
+
+    struct Stats {
+        std::size_t m_idleBuffers { 0 };
+        std::size_t m_idleBlocks { 0 };
+        std::size_t m_createdBuffers { 0 };
+        std::size_t m_reusedBuffers { 0 };
+    };
+
+    /**
+     * Allocator which takes memory from the pool and returns it back.
+     * Keeps the pool alive while anything allocated by it exists.
+     */
+    template<class T>
+    class ShellAllocator {
+    public:
+        using value_type = T;
+
+        explicit ShellAllocator(std::shared_ptr<ConnectionPool> pool) noexcept
+            : m_pool { std::move(pool) }
+        {
+        }
+
+        template<class U>
+        ShellAllocator(const ShellAllocator<U>& other) noexcept
+            : m_pool { other.m_pool }
+        {
+        }
+
+        bool operator==(const ShellAllocator& rhs) const noexcept {
+            return m_pool == rhs.m_pool;
+        }
+
+        bool operator!=(const ShellAllocator& rhs) const noexcept {
+            return m_pool != rhs.m_pool;
+        }
+
+        T* allocate(std::size_t n) const {
+            return static_cast<T*>(m_pool->AllocateBlock(sizeof(T) * n));
+        }
+
+        void deallocate(T *pointer, std::size_t n) const noexcept {
+            m_pool->ReleaseBlock(pointer, sizeof(T) * n);
+        }
+
+    private:
+        template<class> friend class ShellAllocator;
+
+        std::shared_ptr<ConnectionPool> m_pool;
+    };
+
+    ConnectionPool(Limits limits, const char *logFile = "connections_log.txt");
+
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @return Empty buffers which go back to the pool 
+     *  when the last owner releases them.
+     */
+    std::shared_ptr<IOBuffers> AcquireBuffers();
+
+    /**
+     * Like `std::make_shared` but the memory is recycled by the pool.
+     */
+    template<class T, class ...Args>
+    std::shared_ptr<T> MakeShared(Args&& ...args) {
+        return std::allocate_shared<T>(
+            ShellAllocator<T>{ this->shared_from_this() }, 
+            std::forward<Args>(args)...
+        );
+    }
+
+    std::shared_ptr<Log> GetLogger() const noexcept {
+        return m_logger;
+    }
+
+    Stats GetStats() const;
+
+private:
+
+    void* AllocateBlock(std::size_t size);
+
+    void ReleaseBlock(void *block, std::size_t size) noexcept;
+
+    void Recycle(IOBuffers *buffers) noexcept;
+
+    const Limits m_limits;
+
+    std::shared_ptr<Log> m_logger;
+
+    mutable std::mutex m_mutex;
+
+    std::vector<std::unique_ptr<IOBuffers>> m_idleBuffers;
+
+    /**
+     * Idle memory blocks by their size.
+     */
+    std::unordered_map<std::size_t, std::vector<void*>> m_idleBlocks;
+
+    std::size_t m_createdBuffers { 0 };
+
+    std::size_t m_reusedBuffers { 0 };
+};
+
+} // namespace net
+
+#endif // NET_CONNECTION_POOL_HPP
\ No newline at end of file
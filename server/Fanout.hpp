@@ -0,0 +1,175 @@
+#ifndef CHAT_FANOUT_HPP
+#define CHAT_FANOUT_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <algorithm>
+
+#include <boost/asio.hpp>
+
+namespace chat {
+
+/**
+ * Define when and how a broadcast is split into chunks
+ * delivered in parallel.
+ */
+struct FanoutPolicy {
+    /**
+     * Executor the chunks are posted to: io threads or a dedicated pool.
+     */
+    boost::asio::any_io_executor m_executor {};
+
+    /**
+     * Recipient lists of at least this size are split into chunks. 
+     * Zero disables parallel delivery.
+     */
+    std::size_t m_threshold { 0 };
+
+    /**
+     * Number of recipients handled by one posted chunk.
+     */
+    std::size_t m_chunkSize { 512 };
+
+    /**
+     * Number of strands the recipients are spread over. 
+     * A recipient always goes through the same one.
+     */
+    std::size_t m_lanes { 8 };
+};
+
+/**
+ * Deliver a message to every recipient of an immutable snapshot. 
+ * Small lists are delivered on the calling thread. Large lists are split
+ * into chunks posted to the policy's executor, so the caller only posts.
+ * 
+ * Every recipient is bound to a lane (strand) by its hash, so its position 
+ * in the snapshot doesn't matter: the messages reach it in the order of 
+ * the `Run` calls even when the membership changes. A small list is 
+ * delivered inline only when no chunk is left in the lanes, otherwise 
+ * it's queued behind them. The caller serializes `Run` calls 
+ * (e.g. the chatroom's queue is delivered by one thread at a time), 
+ * that's the order of delivery.
+ */
+class Fanout final {
+public:
+
+    Fanout() = default;
+
+    Fanout(const Fanout&) = delete;
+    Fanout& operator=(const Fanout&) = delete;
+
+    void SetPolicy(FanoutPolicy policy) {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        m_policy = std::move(policy);
+        m_policy.m_chunkSize = std::max<std::size_t>(m_policy.m_chunkSize, 1);
+        m_policy.m_lanes = std::max<std::size_t>(m_policy.m_lanes, 1);
+        m_strands.clear();
+        m_layout.reset();
+    }
+
+    /**
+     * @param recipients
+     *  Snapshot of the recipients. It's kept alive by the posted chunks.
+     * @param deliver
+     *  Copyable callable invoked as `deliver(recipient)`.
+     * @return
+     *  The indication whether delivery was split into chunks.
+     */
+    template<class Recipient, class Deliver>
+    bool Run(std::shared_ptr<const std::vector<Recipient>> recipients, Deliver deliver) {
+        const auto size { recipients->size() };
+        std::unique_lock<std::mutex> lock { m_mutex };
+        const bool isEnabled { m_policy.m_threshold && m_policy.m_executor };
+        if (!isEnabled || (size < m_policy.m_threshold && *m_pending == 0)) {
+            lock.unlock();
+            for (const auto& recipient: *recipients) {
+                deliver(recipient);
+            }
+            return false;
+        }
+
+        while (m_strands.size() < m_policy.m_lanes) {
+            m_strands.emplace_back(boost::asio::make_strand(m_policy.m_executor));
+        }
+        const auto layout { this->GetLayout(recipients) };
+        const auto chunkSize { m_policy.m_chunkSize };
+        auto shared { std::make_shared<const Deliver>(std::move(deliver)) };
+        for (std::size_t lane = 0; lane < layout->size(); lane++) {
+            const auto count { (*layout)[lane].size() };
+            for (std::size_t first = 0; first < count; first += chunkSize) {
+                const auto last { std::min(count, first + chunkSize) };
+                (*m_pending)++;
+                boost::asio::post(m_strands[lane], 
+                    [recipients, layout, shared, pending = m_pending, lane, first, last]() {
+                        const auto& indexes { (*layout)[lane] };
+                        for (auto j = first; j < last; j++) {
+                            (*shared)((*recipients)[indexes[j]]);
+                        }
+                        (*pending)--;
+                    }
+                );
+            }
+        }
+        return true;
+    }
+
+private:
+    /**
+     * Indexes of the snapshot's recipients by their lanes.
+     */
+    using Layout = std::vector<std::vector<std::size_t>>;
+
+    /**
+     * Layout of the @recipients. The last one is reused 
+     * while the snapshot is the same (no membership change).
+     * @note
+     *  Require `m_mutex` to be locked.
+     */
+    template<class Recipient>
+    std::shared_ptr<const Layout> GetLayout(const std::shared_ptr<const std::vector<Recipient>>& recipients) {
+        const bool isSame { 
+            m_layout && !m_snapshot.owner_before(recipients) && !recipients.owner_before(m_snapshot) 
+        };
+        if (isSame) {
+            return m_layout;
+        }
+        auto layout { std::make_shared<Layout>(m_policy.m_lanes) };
+        for (std::size_t i = 0; i < recipients->size(); i++) {
+            // pointers are aligned: take the high bits of the mixed hash
+            const std::uint64_t hash { std::hash<Recipient>{}((*recipients)[i]) };
+            const auto lane { static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ULL) >> 32) % m_policy.m_lanes };
+            (*layout)[lane].push_back(i);
+        }
+        m_snapshot = recipients;
+        m_layout = std::move(layout);
+        return m_layout;
+    }
+
+    std::mutex m_mutex;
+
+    FanoutPolicy m_policy {};
+
+    std::vector<boost::asio::strand<boost::asio::any_io_executor>> m_strands;
+
+    /**
+     * Number of posted chunks which haven't been delivered yet. 
+     * Shared with the chunks, they may outlive the fan-out.
+     */
+    const std::shared_ptr<std::atomic<std::size_t>> m_pending { 
+        std::make_shared<std::atomic<std::size_t>>(0) 
+    };
+
+    std::weak_ptr<const void> m_snapshot;
+
+    std::shared_ptr<const Layout> m_layout { nullptr };
+};
+
+} // namespace chat
+
+#endif // CHAT_FANOUT_HPP
\ No newline at end of file
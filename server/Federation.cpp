@@ -0,0 +1,297 @@
+#include "Federation.hpp"
+
+#include "Message.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+namespace {
+    using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    /**
+     * Wrap @attachment into the FEDERATION request frame.
+     */
+    std::string MakeFrame(const rapidjson::StringBuffer& attachment) {
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::FEDERATION;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_attachment.assign(attachment.GetString(), attachment.GetSize());
+        std::string frame;
+        request.Write(frame);
+        return frame;
+    }
+
+    void WriteString(Writer& writer, const std::string& text) {
+        writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+    }
+
+    void WriteNames(Writer& writer, const char* key, const std::vector<std::string>& names) {
+        writer.Key(key);
+        writer.StartArray();
+        for (const auto& name: names) {
+            ::WriteString(writer, name);
+        }
+        writer.EndArray();
+    }
+
+    std::vector<std::string> ReadNames(const rapidjson::Document& doc, const char* key) {
+        std::vector<std::string> names;
+        if (doc.HasMember(key) && doc[key].IsArray()) {
+            for (const auto& name: doc[key].GetArray()) {
+                if (name.IsString()) {
+                    names.emplace_back(name.GetString(), name.GetStringLength());
+                }
+            }
+        }
+        return names;
+    }
+}
+
+namespace chat {
+
+Federation::Federation(std::string node, std::string secret) 
+    : m_node { std::move(node) }
+    , m_secret { std::move(secret) }
+{
+}
+
+void Federation::SetDelivery(Delivery delivery) {
+    m_delivery = std::move(delivery);
+}
+
+bool Federation::Authenticate(const std::string& secret) const noexcept {
+    if (m_secret.empty()) {
+        return false;
+    }
+    // don't leak the length of the matching prefix
+    unsigned char diff = m_secret.size() != secret.size();
+    for (std::size_t i = 0; i < std::min(m_secret.size(), secret.size()); i++) {
+        diff |= static_cast<unsigned char>(m_secret[i] ^ secret[i]);
+    }
+    return diff == 0;
+}
+
+std::string Federation::MakeHello() const {
+    rapidjson::StringBuffer buffer;
+    Writer writer(buffer);
+    writer.StartObject();
+    writer.Key("type");
+    writer.String("hello");
+    writer.Key("node");
+    ::WriteString(writer, m_node);
+    writer.Key("secret");
+    ::WriteString(writer, m_secret);
+    writer.EndObject();
+    return ::MakeFrame(buffer);
+}
+
+void Federation::AddLink(const std::shared_ptr<FederationLink>& link) {
+    { // Block
+        std::lock_guard<std::mutex> lock { link->m_receiveMutex };
+        link->m_received = 1;
+        link->m_pending.clear();
+    } // Release
+    std::lock_guard<std::mutex> lock { m_mutex };
+    link->m_node.clear();
+    link->m_rooms.clear();
+    link->m_sent = 1;
+    m_links.erase(std::remove_if(m_links.begin(), m_links.end(), [&link](const auto& other) {
+        return other == link || other->IsClosed();
+    }), m_links.end());
+    m_links.push_back(link);
+
+    std::vector<std::string> joined;
+    joined.reserve(m_rooms.size());
+    for (const auto& [name, count]: m_rooms) {
+        joined.push_back(name);
+    }
+    this->Advertise(*link, joined, {});
+    m_logger.Write(LogType::info, "Federation added link, links:", m_links.size(), '\n');
+}
+
+void Federation::Close() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_links.clear();
+}
+
+void Federation::HoldRoom(const std::string& room) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (++m_rooms[room] == 1) {
+        this->Advertise({ room }, {});
+    }
+}
+
+void Federation::ReleaseRoom(const std::string& room) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (const auto it = m_rooms.find(room); it != m_rooms.end() && --it->second == 0) {
+        m_rooms.erase(it);
+        this->Advertise({}, { room });
+    }
+}
+
+void Federation::Relay(const std::string& room, const std::string& frame) {
+    const std::string_view message { 
+        frame.data(), frame.size() - Internal::MESSAGE_DELIMITER.size() 
+    };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    // two links may lead to the same node
+    std::vector<const std::string*> served;
+    for (const auto& link: m_links) {
+        if (link->IsClosed() || !link->m_rooms.count(room) || link->m_node == m_node
+            || std::any_of(served.begin(), served.end(), [&link](const auto node) {
+                return *node == link->m_node; 
+            })
+        ) {
+            continue;
+        }
+        served.push_back(&link->m_node);
+
+        rapidjson::StringBuffer buffer;
+        Writer writer(buffer);
+        writer.StartObject();
+        writer.Key("type");
+        writer.String("relay");
+        writer.Key("sequence");
+        writer.Uint64(link->m_sent++);
+        writer.Key("node");
+        ::WriteString(writer, m_node);
+        writer.Key("chatroom");
+        ::WriteString(writer, room);
+        writer.Key("message");
+        writer.RawValue(message.data(), message.size(), rapidjson::kObjectType);
+        writer.EndObject();
+        link->Send(::MakeFrame(buffer));
+        m_relayed++;
+    }
+}
+
+bool Federation::Receive(FederationLink& link, const std::string& attachment) {
+    rapidjson::Document doc;
+    if (doc.Parse(attachment.c_str()).HasParseError() || !doc.IsObject()
+        || !doc.HasMember("sequence") || !doc["sequence"].IsUint64()
+    ) {
+        return false;
+    }
+    const auto sequence { doc["sequence"].GetUint64() };
+
+    std::lock_guard<std::mutex> lock { link.m_receiveMutex };
+    if (sequence < link.m_received) {
+        // duplicate
+        return true;
+    }
+    if (sequence > link.m_received) {
+        link.m_pending.emplace(sequence, attachment);
+        if (link.m_pending.size() <= MAX_PENDING) {
+            return true;
+        }
+        m_logger.Write(LogType::warning, "Federation skipped frames:", 
+            link.m_received, '-', link.m_pending.begin()->first, '\n'
+        );
+        link.m_received = link.m_pending.begin()->first;
+    }
+    else {
+        this->Apply(link, attachment);
+        link.m_received++;
+    }
+    // apply the frames which were waiting for this one
+    for (auto it = link.m_pending.begin(); 
+        it != link.m_pending.end() && it->first == link.m_received; 
+        it = link.m_pending.erase(it)
+    ) {
+        this->Apply(link, it->second);
+        link.m_received++;
+    }
+    return true;
+}
+
+void Federation::Apply(FederationLink& link, const std::string& attachment) {
+    rapidjson::Document doc;
+    doc.Parse(attachment.c_str());
+    if (!doc.HasMember("type") || !doc["type"].IsString()) {
+        return;
+    }
+    const std::string_view type { doc["type"].GetString(), doc["type"].GetStringLength() };
+    if (type == "rooms") {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        if (doc.HasMember("node") && doc["node"].IsString()) {
+            link.m_node = doc["node"].GetString();
+        }
+        for (auto& name: ::ReadNames(doc, "joined")) {
+            link.m_rooms.insert(std::move(name));
+        }
+        for (const auto& name: ::ReadNames(doc, "left")) {
+            link.m_rooms.erase(name);
+        }
+    }
+    else if (type == "relay") {
+        if (!doc.HasMember("chatroom") || !doc["chatroom"].IsString() 
+            || !doc.HasMember("message") || !doc["message"].IsObject()
+        ) {
+            return;
+        }
+        rapidjson::StringBuffer message;
+        Writer writer(message);
+        doc["message"].Accept(writer);
+        if (m_delivery) {
+            m_delivery(doc["chatroom"].GetString(), { message.GetString(), message.GetSize() });
+            m_delivered++;
+        }
+    }
+}
+
+void Federation::Advertise(const std::vector<std::string>& joined, const std::vector<std::string>& left) {
+    for (const auto& link: m_links) {
+        if (!link->IsClosed()) {
+            this->Advertise(*link, joined, left);
+        }
+    }
+}
+
+void Federation::Advertise(
+    FederationLink& link, 
+    const std::vector<std::string>& joined, 
+    const std::vector<std::string>& left
+) {
+    rapidjson::StringBuffer buffer;
+    Writer writer(buffer);
+    writer.StartObject();
+    writer.Key("type");
+    writer.String("rooms");
+    writer.Key("sequence");
+    writer.Uint64(link.m_sent++);
+    writer.Key("node");
+    ::WriteString(writer, m_node);
+    ::WriteNames(writer, "joined", joined);
+    ::WriteNames(writer, "left", left);
+    writer.EndObject();
+    link.Send(::MakeFrame(buffer));
+}
+
+std::vector<std::string> Federation::GetPeers() const {
+    std::vector<std::string> peers;
+    std::lock_guard<std::mutex> lock { m_mutex };
+    for (const auto& link: m_links) {
+        if (!link->IsClosed()) {
+            peers.push_back(link->m_node);
+        }
+    }
+    return peers;
+}
+
+Federation::Stats Federation::GetStats() const {
+    Stats stats;
+    std::lock_guard<std::mutex> lock { m_mutex };
+    stats.m_links = std::count_if(m_links.begin(), m_links.end(), [](const auto& link) {
+        return !link->IsClosed();
+    });
+    stats.m_relayed = m_relayed;
+    stats.m_delivered = m_delivered;
+    return stats;
+}
+
+} // namespace chat
\ No newline at end of file
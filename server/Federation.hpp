@@ -0,0 +1,234 @@
+#ifndef CHAT_FEDERATION_HPP
+#define CHAT_FEDERATION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Log.hpp"
+
+namespace chat {
+
+/**
+ * One end of a server-to-server link. 
+ * The transport is either the session accepted from the peer 
+ * or the outgoing `PeerLink`; the state below is managed by `Federation`.
+ */
+class FederationLink {
+public:
+    virtual ~FederationLink() = default;
+
+    /**
+     * Queue a complete frame (with delimiter) for the peer.
+     */
+    virtual void Send(std::string frame) = 0;
+
+    virtual bool IsClosed() const noexcept = 0;
+
+private:
+    friend class Federation;
+
+    /// Guarded by `Federation::m_mutex`
+
+    /**
+     * Node ID of the peer. Known after its first "rooms" frame.
+     */
+    std::string m_node {};
+
+    /**
+     * Names of the chatrooms with members on the peer's node.
+     */
+    std::unordered_set<std::string> m_rooms {};
+
+    /**
+     * Sequence number of the next frame sent over the link.
+     */
+    std::uint64_t m_sent { 1 };
+
+    /// Guarded by `m_receiveMutex`
+
+    std::mutex m_receiveMutex;
+
+    /**
+     * Sequence number of the next frame applied from the peer.
+     */
+    std::uint64_t m_received { 1 };
+
+    /**
+     * Frames which came ahead of their turn by their sequence number. 
+     */
+    std::map<std::uint64_t, std::string> m_pending {};
+};
+
+/**
+ * Links chat servers (nodes) into a federation: 
+ * a chatroom is identified across the nodes by its name, 
+ * a broadcast is relayed once per node which has members in this chatroom,
+ * and the node delivers it to the local members.
+ * 
+ * Every frame after the hello carries the link's sequence number
+ * and the peer applies them in this order even if they are handled
+ * by different threads, so messages of a chatroom relayed by one node 
+ * keep their order. Relayed messages aren't forwarded further, 
+ * so nodes which need each other's messages must be linked directly.
+ * 
+ * Frames are FEDERATION requests with the attachment:
+ * @code
+ * {"type":"hello","node":"<id>","secret":"<secret>"}
+ * {"type":"rooms","sequence":N,"node":"<id>","joined":["<name>",...],"left":["<name>",...]}
+ * {"type":"relay","sequence":N,"node":"<id>","chatroom":"<name>","message":{<response>}}
+ * @endcode
+ * 
+ * Thread safe.
+ */
+class Federation final {
+public:
+    /**
+     * Deliver relayed @message (serialized response without delimiter) 
+     * to the local members of the chatrooms named @room.
+     */
+    using Delivery = std::function<void(const std::string& room, const std::string& message)>;
+
+    struct Stats {
+        /**
+         * Number of open links.
+         */
+        std::size_t m_links { 0 };
+        /**
+         * Number of relay frames sent to the peers.
+         */
+        std::uint64_t m_relayed { 0 };
+        /**
+         * Number of relayed messages delivered locally.
+         */
+        std::uint64_t m_delivered { 0 };
+    };
+
+    /**
+     * Frames received ahead of a missing one which are kept at most.
+     * The gap is skipped beyond this limit.
+     */
+    static constexpr std::size_t MAX_PENDING { 4096 };
+
+    Federation(std::string node, std::string secret);
+
+    const std::string& GetNode() const noexcept {
+        return m_node;
+    }
+
+    /**
+     * Set the receiver of relayed messages. Must be called before links are added.
+     */
+    void SetDelivery(Delivery delivery);
+
+    /**
+     * @return
+     *  The indication whether @secret matches this node's one. 
+     *  Nothing matches an empty secret.
+     */
+    bool Authenticate(const std::string& secret) const noexcept;
+
+    /**
+     * Build the frame which opens an outgoing link. 
+     */
+    std::string MakeHello() const;
+
+    /**
+     * Start relaying over the authenticated @link.
+     * The state of the link is reset and the local chatrooms are advertised.
+     */
+    void AddLink(const std::shared_ptr<FederationLink>& link);
+
+    /**
+     * Drop all links. The transports are closed by their owners. 
+     */
+    void Close();
+
+    /**
+     * Chatroom named @room got its first member (among the local chatrooms with this name).
+     * It's advertised to the peers.
+     * @note
+     *  Called under the `RoomService` lock.
+     */
+    void HoldRoom(const std::string& room);
+
+    /**
+     * Chatroom named @room lost its last member (among the local chatrooms with this name).
+     */
+    void ReleaseRoom(const std::string& room);
+
+    /**
+     * Send broadcast @frame of the chatroom named @room to every node 
+     * which has members in this chatroom, once per node.
+     */
+    void Relay(const std::string& room, const std::string& frame);
+
+    /**
+     * Handle a frame with @attachment received from the peer over @link.
+     * @return 
+     *  The indication whether the frame is well formed.
+     */
+    bool Receive(FederationLink& link, const std::string& attachment);
+
+    /**
+     * Node IDs of the peers linked at the moment.
+     */
+    std::vector<std::string> GetPeers() const;
+
+    Stats GetStats() const;
+
+private:
+    /**
+     * Advertise changes of the local chatrooms to all peers.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void Advertise(const std::vector<std::string>& joined, const std::vector<std::string>& left);
+
+    /**
+     * Send the "rooms" frame over the @link.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void Advertise(FederationLink& link, const std::vector<std::string>& joined, const std::vector<std::string>& left);
+
+    /**
+     * Apply the next frame of the link in sequence.
+     * @note
+     *  Thread-safety: require `FederationLink::m_receiveMutex` to be locked
+     */
+    void Apply(FederationLink& link, const std::string& attachment);
+
+    const std::string m_node;
+
+    const std::string m_secret;
+
+    Delivery m_delivery {};
+
+    mutable std::mutex m_mutex;
+
+    std::vector<std::shared_ptr<FederationLink>> m_links;
+
+    /**
+     * Number of the local chatrooms with members by chatroom name.
+     */
+    std::unordered_map<std::string, std::size_t> m_rooms;
+
+    std::uint64_t m_relayed { 0 };
+
+    std::atomic<std::uint64_t> m_delivered { 0 };
+
+    Log m_logger { "federation_log.txt" };
+};
+
+} // namespace chat
+
+#endif // CHAT_FEDERATION_HPP
\ No newline at end of file
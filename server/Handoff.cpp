@@ -0,0 +1,128 @@
+#include "Handoff.hpp"
+
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    /**
+     * Size of the state precedes the state. 
+     */
+    using Header = std::uint32_t;
+
+    /**
+     * The state is expected to be a chatroom list, not more.
+     */
+    constexpr Header MAX_STATE_SIZE { 64 * 1024 * 1024 };
+}
+
+namespace net {
+
+bool SendHandoff(int channel, int listener, const std::string& state) {
+    if (state.size() > MAX_STATE_SIZE) {
+        return false;
+    }
+    Header header { htonl(static_cast<Header>(state.size())) };
+    iovec iov {};
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+
+    // the descriptor goes with the header
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    msghdr message {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr * const cmsg { CMSG_FIRSTHDR(&message) };
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &listener, sizeof(int));
+
+    if (::sendmsg(channel, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(header))) {
+        return false;
+    }
+    for (std::size_t sent = 0; sent < state.size(); ) {
+        const auto bytes { ::send(channel, state.data() + sent, state.size() - sent, MSG_NOSIGNAL) };
+        if (bytes <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(bytes);
+    }
+    return true;
+}
+
+std::optional<Handoff> RequestHandoff(const std::string& path, std::uint64_t timeoutMs) {
+    sockaddr_un address {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return std::nullopt;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    const int channel { ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) };
+    if (channel < 0) {
+        return std::nullopt;
+    }
+    timeval timeout {};
+    timeout.tv_sec = static_cast<time_t>(timeoutMs / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>(timeoutMs % 1000 * 1000);
+    ::setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    Handoff handoff {};
+    auto fail = [&]() -> std::optional<Handoff> {
+        if (handoff.m_listener >= 0) {
+            ::close(handoff.m_listener);
+        }
+        ::close(channel);
+        return std::nullopt;
+    };
+    // nobody is listening: there is no server to take over from
+    if (::connect(channel, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        return fail();
+    }
+
+    Header header { 0 };
+    iovec iov {};
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    msghdr message {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (::recvmsg(channel, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL) != static_cast<ssize_t>(sizeof(header))) {
+        return fail();
+    }
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&handoff.m_listener, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    header = ntohl(header);
+    if (handoff.m_listener < 0 || header > MAX_STATE_SIZE) {
+        return fail();
+    }
+    handoff.m_state.resize(header);
+    for (std::size_t received = 0; received < handoff.m_state.size(); ) {
+        const auto bytes { ::recv(channel, handoff.m_state.data() + received, handoff.m_state.size() - received, 0) };
+        if (bytes <= 0) {
+            return fail();
+        }
+        received += static_cast<std::size_t>(bytes);
+    }
+    ::close(channel);
+    return handoff;
+}
+
+} // namespace net
+
+#endif // CHAT_HAS_SOCKET_HANDOFF
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef NET_HANDOFF_HPP
+#define NET_HANDOFF_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include <boost/asio.hpp>
+
+/**
+ * The listening socket can be passed to another process only 
+ * through a Unix socket (SCM_RIGHTS) and only if it's a real socket.
+ */
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS) && !defined(BOOST_ASIO_WINDOWS) && !defined(CHAT_LOOPBACK_TRANSPORT)
+#define CHAT_HAS_SOCKET_HANDOFF 1
+#endif
+
+namespace net {
+
+/**
+ * What the running server passes to its successor on upgrade.
+ */
+struct Handoff final {
+    /**
+     * Descriptor of the listening socket owned by the receiver.
+     */
+    int m_listener { -1 };
+
+    /**
+     * Serialized server state: the chatrooms with their histories, 
+     * the parked sessions (if resumption is on) and the ticket keys: 
+     * @code
+     * {
+     *  "chatrooms":[{"id":1,"name":"...","seq":N,"history":[{"seq":N,"frame":"..."},...]},...],
+     *  "sessions":[{"token":"...","name":"...","current":1,"remaining":MS,"chatrooms":[{"id":1,"seq":N},...]},...],
+     *  "ticket_keys":"<hex>"
+     * }
+     * @endcode
+     */
+    std::string m_state {};
+};
+
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+
+/**
+ * Send the @listener descriptor and the @state over the connected Unix socket @channel.
+ * The sender keeps its own descriptor of the listener.
+ * @note
+ *  Blocking.
+ */
+bool SendHandoff(int channel, int listener, const std::string& state);
+
+/**
+ * Connect to the server listening for upgrades on @path and receive the handoff.
+ * @return 
+ *  Return nothing if there is no server to take over from or it failed.
+ * @note
+ *  Blocking, gives up after @timeoutMs.
+ */
+std::optional<Handoff> RequestHandoff(const std::string& path, std::uint64_t timeoutMs = 5000);
+
+#endif
+
+} // namespace net
+
+#endif // NET_HANDOFF_HPP
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef NET_INBOUND_POLICY_HPP
+#define NET_INBOUND_POLICY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace net {
+
+/**
+ * Limits of the data a connection accepts from the remote peer.
+ * Shared by the connections of a server: a connection which violates 
+ * a limit is closed and counted here.
+ */
+struct InboundPolicy {
+    /**
+     * Largest frame in bytes, the delimiter excluded. 
+     * The inbox never holds more than this plus one read. Zero means no limit.
+     */
+    std::size_t m_maxFrameSize { 0 };
+
+    /**
+     * Milliseconds the rest of a started frame may take to arrive. 
+     * Zero means no deadline.
+     */
+    std::uint64_t m_frameTimeout { 0 };
+
+    /**
+     * Bytes per second a connection may send on average, 
+     * in bursts of up to a second (or a frame). Zero means no budget.
+     */
+    std::size_t m_byteRate { 0 };
+
+    std::atomic<std::uint64_t> m_oversizedFrames { 0 };
+
+    std::atomic<std::uint64_t> m_expiredFrames { 0 };
+
+    std::atomic<std::uint64_t> m_exceededBudgets { 0 };
+};
+
+} // namespace net
+
+#endif // NET_INBOUND_POLICY_HPP
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "KernelTLS.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+#ifdef CHAT_HAS_KERNEL_TLS
+#include <cerrno>
+
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace {
+    /**
+     * What is kept of a connection until its record layer is handed over.
+     */
+    struct Secrets final {
+        std::vector<unsigned char> m_client {};
+        std::vector<unsigned char> m_server {};
+        /**
+         * Records written & read with the application keys.
+         */
+        std::uint64_t m_written { 0 };
+        std::uint64_t m_read { 0 };
+
+        ~Secrets() {
+            OPENSSL_cleanse(m_client.data(), m_client.size());
+            OPENSSL_cleanse(m_server.data(), m_server.size());
+        }
+    };
+
+    int SecretsIndex() {
+        static const int index { SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, 
+            [](void *, void * ptr, CRYPTO_EX_DATA *, int, long, void *) {
+                delete static_cast<Secrets *>(ptr);
+            }
+        ) };
+        return index;
+    }
+
+    Secrets * GetSecrets(const SSL * ssl, bool create) {
+        auto secrets { static_cast<Secrets *>(SSL_get_ex_data(ssl, SecretsIndex())) };
+        if (!secrets && create) {
+            secrets = new Secrets {};
+            // OpenSSL passes a const connection to the callbacks
+            SSL_set_ex_data(const_cast<SSL *>(ssl), SecretsIndex(), secrets);
+        }
+        return secrets;
+    }
+
+    bool DecodeHex(const std::string& hex, std::vector<unsigned char>& bytes) {
+        if (hex.size() % 2) {
+            return false;
+        }
+        bytes.resize(hex.size() / 2);
+        for (std::size_t i = 0; i < bytes.size(); i++) {
+            const auto high { OPENSSL_hexchar2int(static_cast<unsigned char>(hex[2 * i])) };
+            const auto low { OPENSSL_hexchar2int(static_cast<unsigned char>(hex[2 * i + 1])) };
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            bytes[i] = static_cast<unsigned char>((high << 4) | low);
+        }
+        return true;
+    }
+
+    /**
+     * Key log line: `<label> <client random> <secret>`.
+     * Only the first application traffic secrets are kept.
+     */
+    void KeepSecret(const SSL * ssl, const char * line) {
+        const std::string text { line };
+        const auto first { text.find(' ') };
+        const auto second { text.find(' ', first + 1) };
+        if (first == std::string::npos || second == std::string::npos) {
+            return;
+        }
+        const auto label { text.substr(0, first) };
+        if (label != "CLIENT_TRAFFIC_SECRET_0" && label != "SERVER_TRAFFIC_SECRET_0") {
+            return;
+        }
+        auto secrets { GetSecrets(ssl, true) };
+        auto& secret { label == "CLIENT_TRAFFIC_SECRET_0"? secrets->m_client : secrets->m_server };
+        if (!DecodeHex(text.substr(second + 1), secret)) {
+            secret.clear();
+        }
+    }
+
+    /**
+     * Count the records since each side's Finished message: 
+     * their sequence numbers restart with the application keys.
+     */
+    void CountRecord(
+        int isWrite, int, int contentType, 
+        const void * buffer, std::size_t size, 
+        SSL * ssl, void *
+    ) {
+        auto secrets { GetSecrets(ssl, false) };
+        if (!secrets) {
+            return;
+        }
+        auto& counter { isWrite? secrets->m_written : secrets->m_read };
+        if (contentType == SSL3_RT_HEADER) {
+            counter++;
+        }
+        else if (contentType == SSL3_RT_HANDSHAKE && size
+            && *static_cast<const unsigned char *>(buffer) == SSL3_MT_FINISHED
+        ) {
+            // reported after the header of its own record
+            counter = 0;
+        }
+    }
+
+    /**
+     * HKDF-Expand-Label(@secret, @label, "", @size).
+     */
+    bool ExpandLabel(
+        const EVP_MD * digest,
+        const std::vector<unsigned char>& secret, 
+        const std::string& label, 
+        std::size_t size, 
+        std::vector<unsigned char>& output
+    ) {
+        const std::string fullLabel { "tls13 " + label };
+        std::vector<unsigned char> info;
+        info.push_back(static_cast<unsigned char>(size >> 8));
+        info.push_back(static_cast<unsigned char>(size & 0xFF));
+        info.push_back(static_cast<unsigned char>(fullLabel.size()));
+        info.insert(info.end(), fullLabel.begin(), fullLabel.end());
+        info.push_back(0); // empty context
+
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> context { 
+            EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr), &EVP_PKEY_CTX_free 
+        };
+        output.resize(size);
+        std::size_t length { size };
+        return context
+            && EVP_PKEY_derive_init(context.get()) > 0
+            && EVP_PKEY_CTX_set_hkdf_mode(context.get(), EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+            && EVP_PKEY_CTX_set_hkdf_md(context.get(), digest) > 0
+            && EVP_PKEY_CTX_set1_hkdf_key(context.get(), secret.data(), static_cast<int>(secret.size())) > 0
+            && EVP_PKEY_CTX_add1_hkdf_info(context.get(), info.data(), static_cast<int>(info.size())) > 0
+            && EVP_PKEY_derive(context.get(), output.data(), &length) > 0
+            && length == size;
+    }
+
+    /**
+     * Size of the key of the AEAD suites the kernel supports. 
+     * Zero for the others.
+     */
+    std::size_t GetKeySize(std::uint16_t suite) {
+        switch (suite) {
+            case 0x1301: return 16; // TLS_AES_128_GCM_SHA256
+            case 0x1302: return 32; // TLS_AES_256_GCM_SHA384
+            case 0x1303: return 32; // TLS_CHACHA20_POLY1305_SHA256
+            default: return 0;
+        }
+    }
+
+    /**
+     * The IV of every TLS 1.3 AEAD suite.
+     */
+    constexpr std::size_t IV_SIZE { 12 };
+
+#ifdef CHAT_HAS_KERNEL_TLS
+    template<class Info>
+    bool SetKey(int fd, int direction, std::uint16_t cipher, const net::TrafficKey& key, std::uint64_t sequence) {
+        Info info {};
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = cipher;
+        // the salt is the IV's head, nothing for ChaCha20
+        std::memcpy(info.salt, key.m_iv.data(), sizeof(info.salt));
+        std::memcpy(info.iv, key.m_iv.data() + sizeof(info.salt), sizeof(info.iv));
+        std::memcpy(info.key, key.m_key.data(), sizeof(info.key));
+        for (std::size_t i = 0; i < sizeof(info.rec_seq); i++) {
+            info.rec_seq[sizeof(info.rec_seq) - 1 - i] = static_cast<unsigned char>(sequence >> (8 * i));
+        }
+        const bool isSet { ::setsockopt(fd, SOL_TLS, direction, &info, sizeof(info)) == 0 };
+        OPENSSL_cleanse(&info, sizeof(info));
+        return isSet;
+    }
+
+    bool SetKey(int fd, int direction, std::uint16_t suite, const net::TrafficKey& key, std::uint64_t sequence) {
+        switch (suite) {
+            case 0x1301: 
+                return SetKey<tls12_crypto_info_aes_gcm_128>(fd, direction, TLS_CIPHER_AES_GCM_128, key, sequence);
+            case 0x1302: 
+                return SetKey<tls12_crypto_info_aes_gcm_256>(fd, direction, TLS_CIPHER_AES_GCM_256, key, sequence);
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+            case 0x1303: 
+                return SetKey<tls12_crypto_info_chacha20_poly1305>(fd, direction, TLS_CIPHER_CHACHA20_POLY1305, key, sequence);
+#endif
+            default: 
+                errno = EINVAL;
+                return false;
+        }
+    }
+#endif
+}
+
+namespace net {
+
+TrafficKey::~TrafficKey() {
+    OPENSSL_cleanse(m_key.data(), m_key.size());
+    OPENSSL_cleanse(m_iv.data(), m_iv.size());
+}
+
+bool DeriveTrafficKey(
+    const EVP_MD * digest, 
+    const std::vector<unsigned char>& secret, 
+    std::size_t keySize, 
+    TrafficKey& result
+) {
+    return digest && !secret.empty()
+        && ExpandLabel(digest, secret, "key", keySize, result.m_key)
+        && ExpandLabel(digest, secret, "iv", IV_SIZE, result.m_iv);
+}
+
+bool IsKernelTlsAvailable() {
+#ifdef CHAT_HAS_KERNEL_TLS
+    std::ifstream in("/proc/sys/net/ipv4/tcp_available_ulp");
+    std::string ulp;
+    while (in >> ulp) {
+        if (ulp == "tls") {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+void EnableKernelTls(SSL_CTX * context) {
+    SSL_CTX_set_keylog_callback(context, &KeepSecret);
+    SSL_CTX_set_msg_callback(context, &CountRecord);
+}
+
+bool IsKernelTlsEnabled(const SSL * ssl) {
+    return SSL_CTX_get_keylog_callback(SSL_get_SSL_CTX(ssl)) == &KeepSecret;
+}
+
+bool ExportTrafficKeys(SSL * ssl, TrafficKeys& keys, std::string& reason) {
+    if (SSL_version(ssl) != TLS1_3_VERSION) {
+        reason = "only TLS 1.3 is offloaded";
+        return false;
+    }
+    const auto secrets { GetSecrets(ssl, false) };
+    if (!secrets || secrets->m_client.empty() || secrets->m_server.empty()) {
+        reason = "traffic secrets weren't kept";
+        return false;
+    }
+    const SSL_CIPHER * const cipher { SSL_get_current_cipher(ssl) };
+    keys.m_suite = static_cast<std::uint16_t>(SSL_CIPHER_get_id(cipher) & 0xFFFF);
+    const auto keySize { GetKeySize(keys.m_suite) };
+    if (!keySize) {
+        reason = std::string("cipher suite isn't supported: ") + SSL_CIPHER_get_name(cipher);
+        return false;
+    }
+    if (SSL_has_pending(ssl) || BIO_ctrl_pending(SSL_get_rbio(ssl)) || BIO_ctrl_pending(SSL_get_wbio(ssl))) {
+        // the kernel would miss these records
+        reason = "records are buffered in user space";
+        return false;
+    }
+    const auto digest { SSL_CIPHER_get_handshake_digest(cipher) };
+    const bool isServer { SSL_is_server(ssl) == 1 };
+    const auto& writeSecret { isServer? secrets->m_server : secrets->m_client };
+    const auto& readSecret { isServer? secrets->m_client : secrets->m_server };
+    if (!DeriveTrafficKey(digest, writeSecret, keySize, keys.m_write) 
+        || !DeriveTrafficKey(digest, readSecret, keySize, keys.m_read)
+    ) {
+        reason = "failed to derive traffic keys";
+        return false;
+    }
+    keys.m_writeSequence = secrets->m_written;
+    keys.m_readSequence = secrets->m_read;
+    return true;
+}
+
+#ifdef CHAT_HAS_KERNEL_TLS
+
+KernelTls InstallKernelTls(int fd, SSL * ssl, std::string& reason) {
+    TrafficKeys keys {};
+    if (!ExportTrafficKeys(ssl, keys, reason)) {
+        return KernelTls::USER_SPACE;
+    }
+    if (::setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        reason = std::string("tls ULP isn't attached: ") + std::strerror(errno);
+        return KernelTls::USER_SPACE;
+    }
+    if (!SetKey(fd, TLS_TX, keys.m_suite, keys.m_write, keys.m_writeSequence)) {
+        // the ULP without keys passes the data through
+        reason = std::string("kernel refused the write key: ") + std::strerror(errno);
+        return KernelTls::USER_SPACE;
+    }
+    if (!SetKey(fd, TLS_RX, keys.m_suite, keys.m_read, keys.m_readSequence)) {
+        reason = std::string("kernel refused the read key: ") + std::strerror(errno);
+        return KernelTls::BROKEN;
+    }
+    return KernelTls::OFFLOADED;
+}
+
+#endif
+
+} // namespace net
\ No newline at end of file
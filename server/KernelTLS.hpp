@@ -0,0 +1,116 @@
+#ifndef NET_KERNEL_TLS_HPP
+#define NET_KERNEL_TLS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+/**
+ * The record layer can be handed to the kernel only on Linux 
+ * and only if the connection has a real socket.
+ */
+#if defined(__linux__) && !defined(CHAT_LOOPBACK_TRANSPORT)
+#define CHAT_HAS_KERNEL_TLS 1
+#endif
+
+namespace net {
+
+/**
+ * Key & IV protecting the records of one direction.
+ */
+struct TrafficKey final {
+    std::vector<unsigned char> m_key {};
+    std::vector<unsigned char> m_iv {};
+
+    ~TrafficKey();
+};
+
+/**
+ * State of the record layer of an established TLS 1.3 connection.
+ */
+struct TrafficKeys final {
+    /**
+     * Cipher suite, e.g. 0x1301 for TLS_AES_128_GCM_SHA256.
+     */
+    std::uint16_t m_suite { 0 };
+
+    TrafficKey m_write {};
+
+    TrafficKey m_read {};
+
+    /**
+     * Sequence numbers of the next records.
+     */
+    std::uint64_t m_writeSequence { 0 };
+
+    std::uint64_t m_readSequence { 0 };
+};
+
+/**
+ * Derive the key & IV from the TLS 1.3 traffic @secret
+ * with the suite's @digest (RFC 8446, 7.3).
+ */
+bool DeriveTrafficKey(
+    const EVP_MD * digest, 
+    const std::vector<unsigned char>& secret, 
+    std::size_t keySize, 
+    TrafficKey& result
+);
+
+/**
+ * Check whether the kernel can take over the TLS record layer, 
+ * i.e. the `tls` upper layer protocol is registered (module is loaded).
+ */
+bool IsKernelTlsAvailable();
+
+/**
+ * Keep the traffic secrets and count the records of the @context's connections, 
+ * so their record layer can be handed over after the handshake.
+ */
+void EnableKernelTls(SSL_CTX * context);
+
+bool IsKernelTlsEnabled(const SSL * ssl);
+
+/**
+ * Export the keys and the sequence numbers of the established @ssl connection.
+ * @return
+ *  False and the @reason if the connection isn't TLS 1.3 with an AEAD suite 
+ *  the kernel knows, or some records are still buffered in user space.
+ */
+bool ExportTrafficKeys(SSL * ssl, TrafficKeys& keys, std::string& reason);
+
+#ifdef CHAT_HAS_KERNEL_TLS
+
+enum class KernelTls : std::uint8_t {
+    /**
+     * Nothing has changed, keep using `SSL`.
+     */
+    USER_SPACE,
+    /**
+     * Read & write plain data to the socket, the kernel seals the records.
+     * A record which isn't application data (alert, key update) fails the read.
+     */
+    OFFLOADED,
+    /**
+     * Only the write side is offloaded: the connection must be closed.
+     */
+    BROKEN
+};
+
+/**
+ * Hand the record layer of the established @ssl connection to the kernel (`TCP_ULP` "tls").
+ * @param fd
+ *  The connection's socket.
+ * @param reason
+ *  Why the connection stays in user space or is broken.
+ */
+KernelTls InstallKernelTls(int fd, SSL * ssl, std::string& reason);
+
+#endif
+
+} // namespace net
+
+#endif // NET_KERNEL_TLS_HPP
\ No newline at end of file
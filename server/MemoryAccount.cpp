@@ -0,0 +1,167 @@
+#include "MemoryAccount.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace net {
+
+namespace {
+    constexpr std::size_t Index(MemoryCategory category) noexcept {
+        return static_cast<std::size_t>(category);
+    }
+}
+
+MemoryBudget::MemoryBudget(std::size_t budget) 
+    : m_budget { budget }
+{
+}
+
+void MemoryBudget::SetBudget(std::size_t budget) noexcept {
+    m_budget = budget;
+}
+
+void MemoryBudget::SetTrimmer(Trimmer trimmer) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_trimmer = std::move(trimmer);
+}
+
+std::shared_ptr<MemoryAccount> MemoryBudget::OpenAccount(std::function<void()> shed) {
+    // the account holds the budget, the budget only tracks the account
+    auto account { std::make_shared<MemoryAccount>(this->shared_from_this(), std::move(shed)) };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_accounts.size() == m_accounts.capacity()) {
+        // drop the closed ones before the vector grows
+        m_accounts.erase(std::remove_if(m_accounts.begin(), m_accounts.end(), 
+            [](const auto& weak) { return weak.expired(); }
+        ), m_accounts.end());
+    }
+    m_accounts.push_back(account);
+    return account;
+}
+
+void MemoryBudget::Charge(MemoryCategory category, std::int64_t delta) noexcept {
+    if (delta) {
+        m_bytes[Index(category)] += delta;
+        m_total += delta;
+    }
+}
+
+std::size_t MemoryBudget::GetTotal() const noexcept {
+    return static_cast<std::size_t>(std::max<std::int64_t>(m_total, 0));
+}
+
+bool MemoryBudget::IsOverBudget() const noexcept {
+    const std::size_t budget { m_budget };
+    return budget && this->GetTotal() > budget;
+}
+
+void MemoryBudget::Shed() {
+    if (!this->IsOverBudget()) {
+        return;
+    }
+    Trimmer trimmer { nullptr };
+    std::vector<std::shared_ptr<MemoryAccount>> accounts;
+    { // Block
+        std::lock_guard<std::mutex> lock { m_mutex };
+        trimmer = m_trimmer;
+        accounts.reserve(m_accounts.size());
+        auto& live { m_accounts };
+        live.erase(std::remove_if(live.begin(), live.end(), [&accounts](const auto& weak) {
+            if (auto account = weak.lock(); account) {
+                accounts.push_back(std::move(account));
+                return false;
+            }
+            return true;
+        }), live.end());
+    } // Release
+    if (trimmer) {
+        // history is the cheapest to lose
+        trimmer();
+        m_trims++;
+        if (!this->IsOverBudget()) {
+            return;
+        }
+    }
+    std::sort(accounts.begin(), accounts.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs->Get(MemoryCategory::OUTBOX) > rhs->Get(MemoryCategory::OUTBOX);
+    });
+    auto excess { static_cast<std::int64_t>(this->GetTotal()) - static_cast<std::int64_t>(m_budget.load()) };
+    for (const auto& account: accounts) {
+        const auto outbox { account->Get(MemoryCategory::OUTBOX) };
+        if (excess <= 0 || !outbox) {
+            // idle connections hold only their inbox, keep them
+            break;
+        }
+        excess -= static_cast<std::int64_t>(account->GetTotal());
+        account->m_shed();
+        m_disconnected++;
+    }
+}
+
+MemoryBudget::Stats MemoryBudget::GetStats() const {
+    Stats stats;
+    for (std::size_t i = 0; i < CATEGORIES; i++) {
+        stats.m_bytes[i] = static_cast<std::size_t>(std::max<std::int64_t>(m_bytes[i], 0));
+    }
+    stats.m_total = this->GetTotal();
+    stats.m_budget = m_budget;
+    stats.m_rejectedRequests = m_rejectedRequests;
+    stats.m_trims = m_trims;
+    stats.m_disconnected = m_disconnected;
+    std::lock_guard<std::mutex> lock { m_mutex };
+    stats.m_accounts = static_cast<std::size_t>(std::count_if(m_accounts.begin(), m_accounts.end(), 
+        [](const auto& weak) { return !weak.expired(); }
+    ));
+    return stats;
+}
+
+MemoryAccount::MemoryAccount(std::shared_ptr<MemoryBudget> budget, std::function<void()> shed)
+    : m_budget { std::move(budget) }
+    , m_shed { std::move(shed) }
+{
+}
+
+MemoryAccount::~MemoryAccount() {
+    this->Clear();
+}
+
+void MemoryAccount::Set(MemoryCategory category, std::size_t bytes) noexcept {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_isClosed) {
+        return;
+    }
+    const auto previous { m_bytes[Index(category)].exchange(static_cast<std::int64_t>(bytes)) };
+    m_budget->Charge(category, static_cast<std::int64_t>(bytes) - previous);
+}
+
+void MemoryAccount::Add(MemoryCategory category, std::int64_t delta) noexcept {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (m_isClosed) {
+        return;
+    }
+    m_bytes[Index(category)] += delta;
+    m_budget->Charge(category, delta);
+}
+
+void MemoryAccount::Clear() noexcept {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_isClosed = true;
+    for (std::size_t i = 0; i < MemoryBudget::CATEGORIES; i++) {
+        const auto previous { m_bytes[i].exchange(0) };
+        m_budget->Charge(static_cast<MemoryCategory>(i), -previous);
+    }
+}
+
+std::size_t MemoryAccount::Get(MemoryCategory category) const noexcept {
+    return static_cast<std::size_t>(std::max<std::int64_t>(m_bytes[Index(category)], 0));
+}
+
+std::size_t MemoryAccount::GetTotal() const noexcept {
+    std::int64_t total { 0 };
+    for (const auto& bytes: m_bytes) {
+        total += bytes;
+    }
+    return static_cast<std::size_t>(std::max<std::int64_t>(total, 0));
+}
+
+} // namespace net
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef NET_MEMORY_ACCOUNT_HPP
+#define NET_MEMORY_ACCOUNT_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Message.hpp"
+
+namespace net {
+
+enum class MemoryCategory: std::uint8_t {
+    /**
+     * Streambuf of the incoming data.
+     */
+    INBOX,
+    /**
+     * Frames queued or being written to the remote peer.
+     */
+    OUTBOX,
+    /**
+     * Requests read but not handled yet.
+     */
+    REQUESTS,
+    /**
+     * Messages kept by the chatrooms.
+     */
+    HISTORY,
+    COUNT
+};
+
+class MemoryAccount;
+
+/**
+ * Bytes held by all connections (and chatrooms) of the server.
+ * When it's over budget the server sheds load: 
+ * new chatrooms and joins are refused, history is trimmed 
+ * and the connections with the largest outboxes are closed.
+ * 
+ * Thread safe.
+ */
+class MemoryBudget final : public std::enable_shared_from_this<MemoryBudget> {
+public:
+    static constexpr std::size_t CATEGORIES { static_cast<std::size_t>(MemoryCategory::COUNT) };
+
+    struct Stats {
+        std::array<std::size_t, CATEGORIES> m_bytes {};
+        std::size_t m_total { 0 };
+        /**
+         * Zero means no limit.
+         */
+        std::size_t m_budget { 0 };
+        std::size_t m_accounts { 0 };
+        std::uint64_t m_rejectedRequests { 0 };
+        std::uint64_t m_trims { 0 };
+        std::uint64_t m_disconnected { 0 };
+    };
+
+    /**
+     * Release some history. Called first when the budget is crossed.
+     */
+    using Trimmer = std::function<void()>;
+
+    explicit MemoryBudget(std::size_t budget = 0);
+
+    void SetBudget(std::size_t budget) noexcept;
+
+    void SetTrimmer(Trimmer trimmer);
+
+    /**
+     * Create account of a connection. 
+     * @param shed
+     *  Close the connection to release its memory.
+     */
+    std::shared_ptr<MemoryAccount> OpenAccount(std::function<void()> shed);
+
+    /**
+     * Add @delta bytes (may be negative) of the @category.
+     */
+    void Charge(MemoryCategory category, std::int64_t delta) noexcept;
+
+    std::size_t GetTotal() const noexcept;
+
+    bool IsOverBudget() const noexcept;
+
+    /**
+     * Count a request refused because of the memory pressure.
+     */
+    void CountRejected() noexcept {
+        m_rejectedRequests++;
+    }
+
+    /**
+     * Trim history, then close the connections with the largest outboxes 
+     * until the excess is released. Does nothing under budget.
+     */
+    void Shed();
+
+    Stats GetStats() const;
+
+private:
+    std::array<std::atomic<std::int64_t>, CATEGORIES> m_bytes {};
+
+    std::atomic<std::int64_t> m_total { 0 };
+
+    std::atomic<std::size_t> m_budget { 0 };
+
+    std::atomic<std::uint64_t> m_rejectedRequests { 0 };
+
+    std::atomic<std::uint64_t> m_trims { 0 };
+
+    std::atomic<std::uint64_t> m_disconnected { 0 };
+
+    mutable std::mutex m_mutex;
+
+    Trimmer m_trimmer { nullptr };
+
+    std::vector<std::weak_ptr<MemoryAccount>> m_accounts;
+};
+
+/**
+ * Bytes held by a connection, by category. Every change is charged to the budget.
+ * The bytes are returned to the budget when the account is destroyed.
+ * 
+ * Thread safe.
+ */
+class MemoryAccount final {
+public:
+    MemoryAccount(std::shared_ptr<MemoryBudget> budget, std::function<void()> shed);
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    ~MemoryAccount();
+
+    /**
+     * The @category holds @bytes now.
+     */
+    void Set(MemoryCategory category, std::size_t bytes) noexcept;
+
+    void Add(MemoryCategory category, std::int64_t delta) noexcept;
+
+    /**
+     * Nothing is held anymore (the connection is closed).
+     * The later changes are ignored: e.g. the requests queued before 
+     * the connection was closed are already released.
+     */
+    void Clear() noexcept;
+
+    std::size_t Get(MemoryCategory category) const noexcept;
+
+    std::size_t GetTotal() const noexcept;
+
+    /**
+     * Bytes of the request while it waits in the queue.
+     */
+    static std::size_t SizeOf(const Internal::Request& request) noexcept {
+        return sizeof(Internal::Request) + request.m_attachment.size();
+    }
+
+private:
+    friend class MemoryBudget;
+
+    const std::shared_ptr<MemoryBudget> m_budget;
+
+    const std::function<void()> m_shed;
+
+    std::array<std::atomic<std::int64_t>, MemoryBudget::CATEGORIES> m_bytes {};
+
+    /**
+     * Serialize the changes with `Clear`, so nothing is released twice.
+     */
+    mutable std::mutex m_mutex;
+
+    bool m_isClosed { false };
+};
+
+} // namespace net
+
+#endif // NET_MEMORY_ACCOUNT_HPP
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "PeerLink.hpp"
+
+#include "Message.hpp"
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+namespace chat {
+
+PeerLink::PeerLink(
+    asio::io_context& context,
+    std::shared_ptr<asio::ssl::context> sslContext,
+    std::weak_ptr<Federation> federation,
+    std::string host,
+    std::string port
+) 
+    : m_context { context }
+    , m_sslContext { std::move(sslContext) }
+    , m_federation { std::move(federation) }
+    , m_host { std::move(host) }
+    , m_port { std::move(port) }
+    , m_strand { asio::make_strand(context) }
+    , m_retryTimer { context }
+{
+}
+
+void PeerLink::Connect() {
+    asio::post(m_strand, [self = this->shared_from_this()]() {
+        if (self->m_isStopped) {
+            return;
+        }
+        const auto generation { ++self->m_generation };
+        self->m_stream = std::make_unique<Stream>(self->m_context, *self->m_sslContext);
+        self->m_inbox.consume(self->m_inbox.size());
+        self->m_outbox.Clear();
+        self->m_isWriting = false;
+
+        boost::system::error_code error;
+        asio::ip::tcp::resolver resolver { self->m_context };
+        const auto endpoints { resolver.resolve(self->m_host, self->m_port, error) };
+        if (error || endpoints.empty()) {
+            self->Disconnect(generation, error? error: asio::error::host_not_found);
+            return;
+        }
+        auto callback = asio::bind_executor(self->m_strand, [self, generation](
+            const boost::system::error_code& error, 
+            const asio::ip::tcp::endpoint&
+        ) {
+            self->OnConnect(generation, error);
+        });
+#ifndef CHAT_LOOPBACK_TRANSPORT
+        asio::async_connect(self->m_stream->lowest_layer(), endpoints, std::move(callback));
+#else
+        // in-memory stream provides own connect operation
+        self->m_stream->lowest_layer().async_connect(endpoints, std::move(callback));
+#endif
+    });
+}
+
+void PeerLink::Close() {
+    m_isStopped = true;
+    asio::post(m_strand, [self = this->shared_from_this()]() {
+        self->m_isLinked = false;
+        self->m_generation++;
+        self->m_retryTimer.cancel();
+        if (self->m_stream) {
+            boost::system::error_code error;
+            self->m_stream->lowest_layer().close(error);
+        }
+    });
+}
+
+void PeerLink::Send(std::string frame) {
+    asio::post(m_strand, [frame = std::move(frame), self = this->shared_from_this()]() mutable {
+        // frames of the previous connection are dropped
+        if (!self->m_isLinked) {
+            return;
+        }
+        self->m_outbox.Enque(std::move(frame));
+        if (!self->m_isWriting) {
+            self->Write();
+        }
+    });
+}
+
+void PeerLink::OnConnect(std::uint64_t generation, const boost::system::error_code& error) {
+    if (generation != m_generation) {
+        return;
+    }
+    if (error) {
+        this->Disconnect(generation, error);
+        return;
+    }
+    auto onHandshake = asio::bind_executor(m_strand, 
+        [self = this->shared_from_this(), generation](const boost::system::error_code& error) {
+            if (generation != self->m_generation) {
+                return;
+            }
+            if (error) {
+                self->Disconnect(generation, error);
+                return;
+            }
+            const auto federation { self->m_federation.lock() };
+            if (!federation) {
+                return;
+            }
+            self->m_logger.Write(LogType::info, "Peer link connected to", self->m_host, self->m_port, '\n');
+            self->m_outbox.Enque(federation->MakeHello());
+            self->Write();
+            self->Read(generation);
+        }
+    );
+#ifdef CHAT_LOOPBACK_PLAINTEXT
+    // nothing to negotiate over the plaintext loopback
+    asio::post(std::bind(std::move(onHandshake), boost::system::error_code {}));
+#else
+    m_stream->async_handshake(asio::ssl::stream_base::client, std::move(onHandshake));
+#endif
+}
+
+void PeerLink::Read(std::uint64_t generation) {
+    asio::async_read_until(net::GetFrameLayer(*m_stream), m_inbox, Internal::MESSAGE_DELIMITER, asio::bind_executor(m_strand, 
+        [self = this->shared_from_this(), generation](const boost::system::error_code& error, std::size_t bytes) {
+            self->OnRead(generation, error, bytes);
+        }
+    ));
+}
+
+void PeerLink::OnRead(std::uint64_t generation, const boost::system::error_code& error, std::size_t bytes) {
+    if (generation != m_generation) {
+        return;
+    }
+    if (error) {
+        this->Disconnect(generation, error);
+        return;
+    }
+    const auto data { m_inbox.data() };
+    const std::string frame {
+        asio::buffers_begin(data), 
+        asio::buffers_begin(data) + bytes - Internal::MESSAGE_DELIMITER.size()
+    };
+    m_inbox.consume(bytes);
+    this->HandleFrame(frame);
+    this->Read(generation);
+}
+
+void PeerLink::HandleFrame(const std::string& frame) {
+    const auto federation { m_federation.lock() };
+    rapidjson::Document doc;
+    if (!federation || doc.Parse(frame.c_str()).HasParseError() || !doc.IsObject()) {
+        return;
+    }
+    if (doc.HasMember("status") && doc["status"].IsInt()) {
+        // reply to hello
+        if (doc["status"].GetInt() != 200) {
+            m_logger.Write(LogType::error, "Peer rejected the link:", frame, '\n');
+        }
+        else if (!m_isLinked) {
+            m_isLinked = true;
+            federation->AddLink(this->shared_from_this());
+        }
+    }
+    else if (m_isLinked && doc.HasMember("attachment") && doc["attachment"].IsObject()) {
+        rapidjson::StringBuffer attachment;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(attachment);
+        doc["attachment"].Accept(writer);
+        federation->Receive(*this, { attachment.GetString(), attachment.GetSize() });
+    }
+}
+
+void PeerLink::Write() {
+    m_isWriting = true;
+    m_outbox.SwapBuffers();
+    asio::async_write(net::GetFrameLayer(*m_stream), m_outbox.GetBufferSequence(), asio::bind_executor(m_strand, 
+        [self = this->shared_from_this(), generation = m_generation](const boost::system::error_code& error, std::size_t) {
+            self->OnWrite(generation, error);
+        }
+    ));
+}
+
+void PeerLink::OnWrite(std::uint64_t generation, const boost::system::error_code& error) {
+    if (generation != m_generation) {
+        return;
+    }
+    if (error) {
+        m_isWriting = false;
+        this->Disconnect(generation, error);
+    }
+    else if (m_outbox.GetQueueSize()) {
+        this->Write();
+    }
+    else {
+        m_isWriting = false;
+    }
+}
+
+void PeerLink::Disconnect(std::uint64_t generation, const boost::system::error_code& error) {
+    if (generation != m_generation) {
+        return;
+    }
+    m_generation++;
+    m_isLinked = false;
+    m_logger.Write(LogType::warning, "Peer link to", m_host, m_port, "is broken:", error.message(), '\n');
+    if (m_stream) {
+        boost::system::error_code ignored;
+        m_stream->lowest_layer().close(ignored);
+    }
+    if (m_isStopped) {
+        return;
+    }
+    m_retryTimer.expires_after(std::chrono::milliseconds(RETRY_DELAY_MS));
+    m_retryTimer.async_wait(asio::bind_executor(m_strand, 
+        [self = this->shared_from_this()](const boost::system::error_code& error) {
+            if (!error) {
+                self->Connect();
+            }
+        }
+    ));
+}
+
+} // namespace chat
\ No newline at end of file
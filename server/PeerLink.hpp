@@ -0,0 +1,132 @@
+#ifndef CHAT_PEER_LINK_HPP
+#define CHAT_PEER_LINK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "DoubleBuffer.hpp"
+#include "Federation.hpp"
+#include "Log.hpp"
+#include "Transport.hpp"
+
+namespace chat {
+
+namespace asio = boost::asio;
+
+/**
+ * Outgoing link to a peer node: connects to the peer's chat port, 
+ * sends hello and starts relaying once the peer accepts it.
+ * The link is established again after a delay when it's broken.
+ */
+class PeerLink final 
+    : public FederationLink
+    , public std::enable_shared_from_this<PeerLink> 
+{
+public:
+    /**
+     * Delay before the next attempt to connect.
+     */
+    static constexpr std::uint64_t RETRY_DELAY_MS { 200 };
+
+    PeerLink(
+        asio::io_context& context,
+        std::shared_ptr<asio::ssl::context> sslContext,
+        std::weak_ptr<Federation> federation,
+        std::string host,
+        std::string port
+    );
+
+    /**
+     * Start connecting to the peer.
+     */
+    void Connect();
+
+    /**
+     * Close the link for good.
+     */
+    void Close();
+
+    void Send(std::string frame) override;
+
+    /**
+     * Closed until the peer accepted the hello.
+     */
+    bool IsClosed() const noexcept override {
+        return !m_isLinked;
+    }
+
+private:
+    using Stream = asio::ssl::stream<net::Socket_t>;
+
+    void OnConnect(std::uint64_t generation, const boost::system::error_code& error);
+
+    void Read(std::uint64_t generation);
+
+    void OnRead(std::uint64_t generation, const boost::system::error_code& error, std::size_t bytes);
+
+    void Write();
+
+    void OnWrite(std::uint64_t generation, const boost::system::error_code& error);
+
+    /**
+     * Handle a complete frame from the peer.
+     */
+    void HandleFrame(const std::string& frame);
+
+    /**
+     * Drop the broken connection and schedule the next attempt.
+     * @note
+     *  Called through the strand.
+     */
+    void Disconnect(std::uint64_t generation, const boost::system::error_code& error);
+
+    asio::io_context& m_context;
+
+    std::shared_ptr<asio::ssl::context> m_sslContext;
+
+    std::weak_ptr<Federation> m_federation;
+
+    const std::string m_host;
+
+    const std::string m_port;
+
+    asio::strand<asio::io_context::executor_type> m_strand;
+
+    /**
+     * Created again for each connection attempt.
+     */
+    std::unique_ptr<Stream> m_stream { nullptr };
+
+    /**
+     * Incremented for each connection, so handlers 
+     * of the previous connection are ignored.
+     */
+    std::uint64_t m_generation { 0 };
+
+    asio::steady_timer m_retryTimer;
+
+    asio::streambuf m_inbox;
+
+    Buffers m_outbox;
+
+    bool m_isWriting { false };
+
+    /**
+     * The peer accepted the hello.
+     */
+    std::atomic<bool> m_isLinked { false };
+
+    std::atomic<bool> m_isStopped { false };
+
+    Log m_logger { "peer_link_log.txt" };
+};
+
+} // namespace chat
+
+#endif // CHAT_PEER_LINK_HPP
\ No newline at end of file
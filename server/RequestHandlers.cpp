@@ -1,10 +1,16 @@
 #include "RequestHandlers.hpp"
 #include "Session.hpp"
 #include "Chatroom.hpp"
+#include "RoomService.hpp"
 
 #include "Utility.hpp"
+#include "Compression.hpp"
+#include "Federation.hpp"
 
 #include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
 
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
@@ -18,19 +24,40 @@ std::string Serialize(const rapidjson::GenericValue<Encoding, Allocator>& value)
     return { buffer.GetString(), buffer.GetSize() };
 }
 
+/**
+ * Read the optional chatroom ID from the attachment: 
+ * @code
+ * {"chatroom":{"id":N},...}
+ * @endcode
+ */
+std::optional<std::uint64_t> ReadChatroomId(const rapidjson::Document& doc) {
+    if (doc.IsObject() && doc.HasMember("chatroom") && doc["chatroom"].IsObject()) {
+        const auto& chatroom = doc["chatroom"];
+        if (chatroom.HasMember("id") && chatroom["id"].IsUint64()) {
+            return chatroom["id"].GetUint64();
+        }
+    }
+    return std::nullopt;
+}
+
 /// Implementation  
 namespace RequestHandlers {
     
     Executor::Executor(const Request *request, Session *service) :
         m_request { request },
         m_service { service }
-    {}
+    {
+        // the client matches the reply by the ID of its request
+        m_reply.m_id = request->m_id;
+    }
 
     void Executor::Run() {
         if (this->IsValidRequest()) {
             this->ExecuteRequest();
         }
-        this->SendResponse();
+        if (m_isReplyRequired) {
+            this->SendResponse();
+        }
     }
 
     void Executor::SendResponse() {
@@ -38,9 +65,14 @@ namespace RequestHandlers {
         m_reply.m_timestamp = Utils::GetTimestamp();        
         // send
         std::string m_replyStr {};
-        m_reply.Write(m_replyStr);
+        if (m_sharedAttachment) {
+            m_reply.Write(m_replyStr, *m_sharedAttachment);
+        }
+        else {
+            m_reply.Write(m_replyStr);
+        }
         // que m_reply for send operation!
-        m_service->Write(m_replyStr);
+        m_service->Write(std::move(m_replyStr));
     }
 
     bool LeaveChatroom::IsValidRequest() {
@@ -57,8 +89,13 @@ namespace RequestHandlers {
     };
 
     void LeaveChatroom::ExecuteRequest() {
-        const auto leftRoom = m_service->LeaveChatroom();
-        if (leftRoom == chat::Chatroom::NO_ROOM) {
+        // leave the given chatroom or the current one
+        rapidjson::Document reader;
+        if (!m_request->m_attachment.empty()) {
+            reader.Parse(m_request->m_attachment.c_str());
+        }
+        const auto roomId = ::ReadChatroomId(reader).value_or(m_service->GetUser().m_chatroom);
+        if (roomId == chat::Chatroom::NO_ROOM || !m_service->LeaveChatroom(roomId)) {
             m_reply.m_status = 424;  // Failed Dependency
             m_reply.m_error = "Must belong to chatroom";
         }
@@ -71,13 +108,13 @@ namespace RequestHandlers {
             m_reply.m_status = 424; // Failed Dependency
             m_reply.m_error = "Require acknowledgement";
         }
-        else if (m_service->GetUser().m_chatroom == chat::Chatroom::NO_ROOM) {
-            // is in hall
-            m_reply.m_status = 200;
+        else if (m_service->ShedRequest()) {
+            m_reply.m_status = 503; // Service Unavailable
+            m_reply.m_error = "Server is busy";
         }
         else {
-            m_reply.m_status = 405; //  Method Not Allowed;
-            m_reply.m_error = "Already in the chatroom.";
+            // a session can be subscribed to several chatrooms
+            m_reply.m_status = 200;
         }
 
         return m_reply.m_status == 200;
@@ -87,14 +124,27 @@ namespace RequestHandlers {
         rapidjson::Document reader;
         reader.Parse(m_request->m_attachment.c_str());
         const auto roomId = reader["chatroom"]["id"].GetUint64();
+        const std::string username { reader["user"]["name"].GetString() };
 
-        if (m_service->AssignChatroom(static_cast<size_t>(roomId))) {
-            m_service->UpdateUsername(reader["user"]["name"].GetString());
+        // the name is claimed only after joining, a failed join keeps the old one
+        if (m_service->IsSubscribed(roomId)) {
+            m_reply.m_status = 405; //  Method Not Allowed;
+            m_reply.m_error = "Already in the chatroom.";
         }
-        else {
+        else if (!m_service->IsUsernameAvailable(username)) {
+            m_reply.m_status = 409; // Conflict
+            m_reply.m_error = "Username is already taken";
+        }
+        else if (!m_service->AssignChatroom(static_cast<size_t>(roomId))) {
             m_reply.m_status = 400;
             m_reply.m_error = "Can't join this room yet";
         }
+        else if (!m_service->UpdateUsername(username)) {
+            // another user has taken the name in the meantime
+            (void) m_service->LeaveChatroom(roomId);
+            m_reply.m_status = 409; // Conflict
+            m_reply.m_error = "Username is already taken";
+        }
     };
 
     bool CreateChatroom::IsValidRequest() {
@@ -104,13 +154,18 @@ namespace RequestHandlers {
             m_reply.m_status = 424; // Failed Dependency
             m_reply.m_error = "Require acknowledgement";
         }
-        else if (m_service->GetUser().m_chatroom == chat::Chatroom::NO_ROOM) {
-            // is in hall
-            m_reply.m_status = 200;
+        else if (m_service->ShedRequest()) {
+            m_reply.m_status = 503; // Service Unavailable
+            m_reply.m_error = "Server is busy";
+        }
+        else if (!m_service->CanSubscribe()) {
+            // don't create the chatroom the session can't join
+            m_reply.m_status = 403; // Forbidden
+            m_reply.m_error = "Too many chatrooms joined";
         }
         else {
-            m_reply.m_status = 405; //  Method Not Allowed;
-            m_reply.m_error = "Already in the chatroom.";
+            // a session can be subscribed to several chatrooms
+            m_reply.m_status = 200;
         }
 
         return m_reply.m_status == 200;
@@ -122,20 +177,37 @@ namespace RequestHandlers {
         auto& alloc = doc.GetAllocator();
         doc.Parse(m_request->m_attachment.c_str());
 
+        const std::string username { doc["user"]["name"].GetString() };
+        if (!m_service->IsUsernameAvailable(username)) {
+            m_reply.m_status = 409; // Conflict
+            m_reply.m_error = "Username is already taken";
+            return;
+        }
+
         const std::string roomName = doc["chatroom"]["name"].GetString();
         const auto roomId = m_service->CreateChatroom(roomName); 
-        if (m_service->AssignChatroom(roomId)) {
-            m_service->UpdateUsername(doc["user"]["name"].GetString());
-
+        if (roomId == chat::Chatroom::NO_ROOM) {
+            m_reply.m_status = 503; // Service Unavailable
+            m_reply.m_error = "Too many chatrooms";
+        }
+        else if (!m_service->AssignChatroom(roomId)) {
+            // e.g. a concurrent request has used the last subscription
+            m_service->RemoveEmptyChatroom(roomId);
+            m_reply.m_status = 403; // Forbidden
+            m_reply.m_error = "Too many chatrooms joined";
+        }
+        else if (!m_service->UpdateUsername(username)) {
+            // another user has taken the name in the meantime, the empty chatroom is removed
+            (void) m_service->LeaveChatroom(roomId);
+            m_reply.m_status = 409; // Conflict
+            m_reply.m_error = "Username is already taken";
+        }
+        else {
             rapidjson::Value value(rapidjson::kObjectType);
             value.AddMember("chatroom", rapidjson::Value(rapidjson::kObjectType), alloc);
             value["chatroom"].AddMember("id", roomId, alloc);
             m_reply.m_attachment = ::Serialize(value);
         }
-        else {
-            m_reply.m_status = 500;
-            m_reply.m_error = "Server error";
-        }
     };
 
     bool ListChatroom::IsValidRequest() {
@@ -153,16 +225,53 @@ namespace RequestHandlers {
     };
 
     void ListChatroom::ExecuteRequest() {
-        auto list = m_service->GetChatroomList(); 
-        m_reply.m_attachment = "{\"chatrooms\":[";
-        for(auto&& obj: list) {
-            m_reply.m_attachment += std::move(obj);
-            m_reply.m_attachment += ",";
+        if (m_request->m_attachment.empty()) {
+            // the list is cached and shared by all LIST_CHATROOM requests
+            m_sharedAttachment = m_service->GetChatroomList();
+            return;
+        }
+        // paginated request: 
+        // {"order":"id"|"name"|"users","prefix":"...","cursor":"...","limit":N}
+        rapidjson::Document reader;
+        reader.Parse(m_request->m_attachment.c_str());
+        if (!reader.IsObject()) {
+            m_reply.m_status = 400;
+            m_reply.m_error = "Invalid attachment";
+            return;
+        }
+        
+        chat::ChatroomQuery query {};
+        if (auto it = reader.FindMember("order"); it != reader.MemberEnd() && it->value.IsString()) {
+            const std::string order { it->value.GetString() };
+            if (order == "name") {
+                query.m_order = chat::ChatroomQuery::Order::NAME;
+            }
+            else if (order == "users") {
+                query.m_order = chat::ChatroomQuery::Order::USERS;
+            }
+            else if (order != "id") {
+                m_reply.m_status = 400;
+                m_reply.m_error = "Unknown order";
+                return;
+            }
+        }
+        if (auto it = reader.FindMember("prefix"); it != reader.MemberEnd() && it->value.IsString()) {
+            query.m_prefix = it->value.GetString();
         }
-        if (!list.empty()) {
-            m_reply.m_attachment.pop_back();
+        if (auto it = reader.FindMember("cursor"); it != reader.MemberEnd() && it->value.IsString()) {
+            query.m_cursor = it->value.GetString();
+        }
+        if (auto it = reader.FindMember("limit"); it != reader.MemberEnd() && it->value.IsUint64()) {
+            query.m_limit = static_cast<std::size_t>(it->value.GetUint64());
+        }
+
+        if (auto page = m_service->GetChatroomPage(query); page) {
+            m_reply.m_attachment = std::move(*page);
+        }
+        else {
+            m_reply.m_status = 400;
+            m_reply.m_error = "Invalid cursor";
         }
-        m_reply.m_attachment += "]}";
 
     };
 
@@ -186,22 +295,277 @@ namespace RequestHandlers {
 
     void ChatMessage::ExecuteRequest() {
         rapidjson::Document doc;
-        auto& alloc = doc.GetAllocator();
         doc.Parse(m_request->m_attachment.c_str());
 
-        const std::string message = doc["message"].GetString();
-        // build chat message for the other users
+        // the message goes to the given chatroom or the current one
+        const auto roomId = ::ReadChatroomId(doc).value_or(m_service->GetUser().m_chatroom);
+        if (!m_service->IsSubscribed(roomId)) {
+            m_reply.m_status = 403; // Forbidden
+            m_reply.m_error = "Must belong to chatroom";
+            return;
+        }
+
+        // build chat message for the other users tagged by the chatroom ID
+        // and the sequence number given by the chatroom: 
+        // {"message":"...","chatroom":{"id":N,"seq":S}}
+        rapidjson::Document attachment(rapidjson::kObjectType);
+        auto& alloc = attachment.GetAllocator();
+        attachment.AddMember("message", rapidjson::Value(doc["message"].GetString(), alloc), alloc);
+        attachment.AddMember("chatroom", rapidjson::Value(rapidjson::kObjectType), alloc);
+        attachment["chatroom"].AddMember("id", roomId, alloc);
+        attachment["chatroom"].AddMember("seq", std::uint64_t { 0 }, alloc);
+
         Response chatMessage {};
         chatMessage.m_query = QueryType::CHAT_MESSAGE;
         chatMessage.m_status = 200;
         chatMessage.m_timestamp = Utils::GetTimestamp();
-        chatMessage.m_attachment = "{\"message\":\""+ message +"\"}";
 
-        std::string serialized {};
-        chatMessage.Write(serialized);
-        // broadcast to every user in the chatroom
-        m_service->BroadcastOnly(serialized, [session = m_service](const Session& s){
+        // broadcast to every subscriber of the chatroom
+        m_service->Publish(roomId, [&](std::uint64_t sequence) {
+            attachment["chatroom"]["seq"].SetUint64(sequence);
+            chatMessage.m_attachment = ::Serialize(attachment);
+            std::string serialized {};
+            chatMessage.Write(serialized);
+            return serialized;
+        }, [session = m_service](const Session& s){
             return session != &s;
         });
     };
+
+    bool ListMembers::IsValidRequest() {
+        m_reply.m_query = QueryType::LIST_MEMBERS;
+
+        if (m_service->IsAcknowleged()) {
+            m_reply.m_status = 200;
+        }
+        else {
+            m_reply.m_status = 424; // Failed Dependency
+            m_reply.m_error = "Require acknowledgement";
+        }
+
+        return m_reply.m_status == 200;
+    };
+
+    void ListMembers::ExecuteRequest() {
+        // {"chatroom":{"id":N}} or the current chatroom
+        rapidjson::Document reader;
+        if (!m_request->m_attachment.empty()) {
+            reader.Parse(m_request->m_attachment.c_str());
+        }
+        const auto roomId = ::ReadChatroomId(reader).value_or(m_service->GetUser().m_chatroom);
+        const auto members { m_service->IsSubscribed(roomId)? m_service->GetMembers(roomId): std::nullopt };
+        if (!members) {
+            m_reply.m_status = 403; // Forbidden
+            m_reply.m_error = "Must belong to chatroom";
+            return;
+        }
+
+        // {"chatroom":{"id":N},"users":[{"id":U,"name":"..."}]}
+        rapidjson::Document attachment(rapidjson::kObjectType);
+        auto& alloc = attachment.GetAllocator();
+        attachment.AddMember("chatroom", rapidjson::Value(rapidjson::kObjectType), alloc);
+        attachment["chatroom"].AddMember("id", roomId, alloc);
+        rapidjson::Value users(rapidjson::kArrayType);
+        for (const auto& [id, name]: *members) {
+            rapidjson::Value user(rapidjson::kObjectType);
+            user.AddMember("id", id, alloc);
+            user.AddMember("name", rapidjson::Value(name.c_str(), alloc), alloc);
+            users.PushBack(user, alloc);
+        }
+        attachment.AddMember("users", users, alloc);
+        m_reply.m_attachment = ::Serialize(attachment);
+    };
+
+    bool DirectMessage::IsValidRequest() {
+        m_reply.m_query = QueryType::DIRECT_MESSAGE;
+
+        if (m_service->IsAcknowleged()) {
+            m_reply.m_status = 200;
+        }
+        else {
+            m_reply.m_status = 424; // Failed Dependency
+            m_reply.m_error = "Require acknowledgement";
+        }
+
+        return m_reply.m_status == 200;
+    };
+
+    void DirectMessage::ExecuteRequest() {
+        // {"user":{"id":N}|{"name":"..."},"message":"..."}
+        rapidjson::Document doc;
+        doc.Parse(m_request->m_attachment.c_str());
+        if (!doc.IsObject() || !doc.HasMember("user") || !doc["user"].IsObject() 
+            || !doc.HasMember("message") || !doc["message"].IsString()
+        ) {
+            m_reply.m_status = 400;
+            m_reply.m_error = "Invalid attachment";
+            return;
+        }
+
+        std::optional<std::uint64_t> recipient {};
+        const auto& user = doc["user"];
+        if (user.HasMember("id") && user["id"].IsUint64()) {
+            recipient = user["id"].GetUint64();
+        }
+        else if (user.HasMember("name") && user["name"].IsString()) {
+            recipient = m_service->FindUserId(user["name"].GetString());
+        }
+
+        // build direct message for the recipient
+        rapidjson::Document attachment(rapidjson::kObjectType);
+        auto& alloc = attachment.GetAllocator();
+        rapidjson::Value from(rapidjson::kObjectType);
+        from.AddMember("id", m_service->GetUser().m_id, alloc);
+        from.AddMember("name", rapidjson::Value(m_service->GetUser().m_username.c_str(), alloc), alloc);
+        attachment.AddMember("from", from, alloc);
+        attachment.AddMember("message", rapidjson::Value(doc["message"].GetString(), alloc), alloc);
+
+        Response directMessage {};
+        directMessage.m_query = QueryType::DIRECT_MESSAGE;
+        directMessage.m_status = 200;
+        directMessage.m_timestamp = Utils::GetTimestamp();
+        directMessage.m_attachment = ::Serialize(attachment);
+
+        std::string serialized {};
+        directMessage.Write(serialized);
+        if (!recipient || !m_service->SendDirectMessage(*recipient, std::move(serialized))) {
+            m_reply.m_status = 404;
+            m_reply.m_error = "User not found";
+        }
+    };
+
+    bool Synchronize::IsValidRequest() {
+        m_reply.m_query = QueryType::ACK;
+        m_reply.m_status = 200;
+        return true;
+    };
+
+    void Synchronize::ExecuteRequest() {
+        // {"compression":["deflate",...],"resume":{"token":"...","chatrooms":[{"id":N,"seq":S},...]},"presence":true}
+        rapidjson::Document doc;
+        const bool hasOptions { !m_request->m_attachment.empty() 
+            && !doc.Parse(m_request->m_attachment.c_str()).HasParseError() && doc.IsObject() 
+        };
+        rapidjson::Document attachment(rapidjson::kObjectType);
+        auto& alloc = attachment.GetAllocator();
+
+        const auto threshold { m_service->GetCompressionThreshold() };
+        if (hasOptions && threshold && doc.HasMember("compression") && doc["compression"].IsArray()) {
+            for (const auto& algorithm: doc["compression"].GetArray()) {
+                if (algorithm.IsString() && algorithm.GetString() == Internal::DEFLATE) {
+                    // the reply is queued after this, so it may be compressed as well
+                    m_service->EnableCompression(threshold);
+                    // {"compression":{"algorithm":"deflate","threshold":N}}
+                    rapidjson::Value compression(rapidjson::kObjectType);
+                    compression.AddMember("algorithm", rapidjson::Value(Internal::DEFLATE.c_str(), alloc), alloc);
+                    compression.AddMember("threshold", static_cast<std::uint64_t>(threshold), alloc);
+                    attachment.AddMember("compression", compression, alloc);
+                    break;
+                }
+            }
+        }
+
+        // {"presence":{"limit":N}}: chatrooms with more members send only the member count
+        if (hasOptions && doc.HasMember("presence") && doc["presence"].IsBool() && doc["presence"].GetBool()) {
+            if (const auto limit { m_service->EnablePresence() }; limit) {
+                rapidjson::Value presence(rapidjson::kObjectType);
+                presence.AddMember("limit", static_cast<std::uint64_t>(*limit), alloc);
+                attachment.AddMember("presence", presence, alloc);
+            }
+        }
+
+        // {"resume":{"token":"...","restored":true,"chatrooms":[{"id":N,"seq":S,"complete":true},...]}}
+        rapidjson::Value resume(rapidjson::kObjectType);
+        if (hasOptions && doc.HasMember("resume") && doc["resume"].IsObject()) {
+            const auto& request = doc["resume"];
+            std::unordered_map<std::uint64_t, std::uint64_t> sequences;
+            if (request.HasMember("chatrooms") && request["chatrooms"].IsArray()) {
+                for (const auto& chatroom: request["chatrooms"].GetArray()) {
+                    if (chatroom.IsObject() && chatroom.HasMember("id") && chatroom["id"].IsUint64()
+                        && chatroom.HasMember("seq") && chatroom["seq"].IsUint64()
+                    ) {
+                        sequences[chatroom["id"].GetUint64()] = chatroom["seq"].GetUint64();
+                    }
+                }
+            }
+            // the missed messages are queued before this reply
+            std::optional<std::vector<std::pair<std::uint64_t, chat::Chatroom::Replay>>> restored {};
+            if (request.HasMember("token") && request["token"].IsString()) {
+                restored = m_service->Resume(request["token"].GetString(), sequences);
+            }
+            resume.AddMember("restored", restored.has_value(), alloc);
+            if (restored) {
+                rapidjson::Value chatrooms(rapidjson::kArrayType);
+                for (const auto& [id, replay]: *restored) {
+                    rapidjson::Value chatroom(rapidjson::kObjectType);
+                    chatroom.AddMember("id", id, alloc);
+                    chatroom.AddMember("seq", replay.m_sequence, alloc);
+                    chatroom.AddMember("complete", replay.m_isComplete, alloc);
+                    chatrooms.PushBack(chatroom, alloc);
+                }
+                resume.AddMember("chatrooms", chatrooms, alloc);
+            }
+        }
+        if (const auto token { m_service->IssueResumeToken() }; !token.empty()) {
+            resume.AddMember("token", rapidjson::Value(token.c_str(), alloc), alloc);
+        }
+        if (resume.MemberCount()) {
+            attachment.AddMember("resume", resume, alloc);
+        }
+
+        if (attachment.MemberCount()) {
+            m_reply.m_attachment = ::Serialize(attachment);
+        }
+    };
+
+    bool Federate::IsValidRequest() {
+        m_reply.m_query = QueryType::FEDERATION;
+        if (m_service->GetFederation()) {
+            m_reply.m_status = 200;
+        }
+        else {
+            m_reply.m_status = 501; // Not Implemented
+            m_reply.m_error = "Federation is disabled";
+        }
+        return m_reply.m_status == 200;
+    };
+
+    void Federate::ExecuteRequest() {
+        const auto federation { m_service->GetFederation() };
+        rapidjson::Document doc;
+        if (doc.Parse(m_request->m_attachment.c_str()).HasParseError() || !doc.IsObject()
+            || !doc.HasMember("type") || !doc["type"].IsString()
+        ) {
+            m_reply.m_status = 400; // Bad Request
+            m_reply.m_error = "Malformed federation frame";
+            return;
+        }
+        // {"type":"hello","node":"<id>","secret":"<secret>"}
+        if (doc["type"].GetString() == std::string_view("hello")) {
+            if (!doc.HasMember("secret") || !doc["secret"].IsString() 
+                || !federation->Authenticate(doc["secret"].GetString())
+            ) {
+                m_reply.m_status = 403; // Forbidden
+                m_reply.m_error = "Wrong federation secret";
+                return;
+            }
+            // the peer starts to accept frames of the link with this reply
+            this->SendResponse();
+            m_isReplyRequired = false;
+            federation->AddLink(m_service->LinkFederation());
+            return;
+        }
+        const auto link { m_service->GetFederationLink() };
+        if (!link) {
+            m_reply.m_status = 403; // Forbidden
+            m_reply.m_error = "Require federation hello";
+        }
+        else if (!federation->Receive(*link, m_request->m_attachment)) {
+            m_reply.m_status = 400; // Bad Request
+            m_reply.m_error = "Malformed federation frame";
+        }
+        else {
+            m_isReplyRequired = false;
+        }
+    };
 }
\ No newline at end of file
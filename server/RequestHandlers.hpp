@@ -57,6 +57,15 @@ namespace RequestHandlers {
         const Request *m_request { nullptr };
         Session *m_service { nullptr };
         Response m_reply {};
+        /**
+         * Shared attachment written instead of m_reply.m_attachment if set.
+         * It isn't copied into the reply.
+         */
+        std::shared_ptr<const std::string> m_sharedAttachment {};
+        /**
+         * Requests which are notifications don't get the reply on success. 
+         */
+        bool m_isReplyRequired { true };
     };
 
     class LeaveChatroom : public Executor {
@@ -109,6 +118,57 @@ namespace RequestHandlers {
         void ExecuteRequest() override;
     };
 
+    class DirectMessage : public Executor {
+    public:
+        using Executor::Executor;
+        
+    private:
+        bool IsValidRequest() override;
+
+        void ExecuteRequest() override;
+    };
+
+    /**
+     * Reply with the members of the chatroom the session belongs to.
+     */
+    class ListMembers : public Executor {
+    public:
+        using Executor::Executor;
+        
+    private:
+        bool IsValidRequest() override;
+
+        void ExecuteRequest() override;
+    };
+
+    /**
+     * Negotiate connection options. Replies with ACK.
+     */
+    class Synchronize : public Executor {
+    public:
+        using Executor::Executor;
+        
+    private:
+        bool IsValidRequest() override;
+
+        void ExecuteRequest() override;
+    };
+
+    /**
+     * Link with the peer node: authenticate hello, 
+     * apply advertised chatrooms and relayed messages.
+     * Only hello and malformed frames are replied.
+     */
+    class Federate : public Executor {
+    public:
+        using Executor::Executor;
+        
+    private:
+        bool IsValidRequest() override;
+
+        void ExecuteRequest() override;
+    };
+
     /// Helper types
     namespace Traits {
 
@@ -141,6 +201,26 @@ namespace RequestHandlers {
         struct RequestExecutor<QueryType::CHAT_MESSAGE> {
             using Type = ChatMessage;
         };
+
+        template<>
+        struct RequestExecutor<QueryType::DIRECT_MESSAGE> {
+            using Type = DirectMessage;
+        };
+
+        template<>
+        struct RequestExecutor<QueryType::LIST_MEMBERS> {
+            using Type = ListMembers;
+        };
+
+        template<>
+        struct RequestExecutor<QueryType::SYN> {
+            using Type = Synchronize;
+        };
+
+        template<>
+        struct RequestExecutor<QueryType::FEDERATION> {
+            using Type = Federate;
+        };
     }
 }
 
@@ -0,0 +1,113 @@
+#include "ResumeRegistry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include <openssl/rand.h>
+
+namespace chat {
+
+ResumeRegistry::ResumeRegistry(std::chrono::milliseconds timeout, std::size_t capacity) 
+    : m_timeout { timeout }
+    , m_capacity { capacity? capacity: 1U }
+{
+}
+
+std::string ResumeRegistry::Issue() const {
+    std::array<unsigned char, 16> bytes {};
+    if (RAND_bytes(bytes.data(), static_cast<int>(bytes.size())) != 1) {
+        std::random_device device;
+        for (auto& byte: bytes) {
+            byte = static_cast<unsigned char>(device());
+        }
+    }
+    constexpr char digits[] { "0123456789abcdef" };
+    std::string token;
+    token.reserve(2 * bytes.size());
+    for (const auto byte: bytes) {
+        token += digits[byte >> 4];
+        token += digits[byte & 0xF];
+    }
+    return token;
+}
+
+void ResumeRegistry::Park(const std::string& token, State state) {
+    const auto now { Clock::now() };
+    const auto deadline { now + m_timeout };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    this->Expire(now);
+    while (m_states.size() >= m_capacity && !m_deadlines.empty()) {
+        const auto& [time, oldest] = m_deadlines.front();
+        if (const auto it = m_states.find(oldest); it != m_states.end() && it->second.second == time) {
+            m_states.erase(it);
+        }
+        m_deadlines.pop_front();
+    }
+    m_states[token] = { std::move(state), deadline };
+    m_deadlines.emplace_back(deadline, token);
+}
+
+std::optional<ResumeRegistry::State> ResumeRegistry::Take(const std::string& token) {
+    const auto now { Clock::now() };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    const auto it = m_states.find(token);
+    if (it == m_states.end()) {
+        return std::nullopt;
+    }
+    auto [state, deadline] = std::move(it->second);
+    m_states.erase(it);
+    if (deadline < now) {
+        return std::nullopt;
+    }
+    return std::move(state);
+}
+
+std::vector<ResumeRegistry::Parked> ResumeRegistry::Save() const {
+    const auto now { Clock::now() };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    std::vector<Parked> parked;
+    parked.reserve(m_states.size());
+    for (const auto& [token, kept]: m_states) {
+        const auto& [state, deadline] = kept;
+        if (deadline > now) {
+            const auto remaining { std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) };
+            parked.push_back({ token, state, remaining });
+        }
+    }
+    return parked;
+}
+
+void ResumeRegistry::Restore(std::vector<Parked> parked) {
+    std::sort(parked.begin(), parked.end(), [](const Parked& lhs, const Parked& rhs) {
+        return lhs.m_remaining < rhs.m_remaining;
+    });
+    if (parked.size() > m_capacity) {
+        // the ones which expire first are dropped
+        parked.erase(parked.begin(), parked.end() - static_cast<std::ptrdiff_t>(m_capacity));
+    }
+    const auto now { Clock::now() };
+    std::lock_guard<std::mutex> lock { m_mutex };
+    for (auto& [token, state, remaining]: parked) {
+        const auto deadline { now + std::min(remaining, m_timeout) };
+        m_states[token] = { std::move(state), deadline };
+        m_deadlines.emplace_back(deadline, std::move(token));
+    }
+}
+
+std::size_t ResumeRegistry::GetParkedCount() const {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    return m_states.size();
+}
+
+void ResumeRegistry::Expire(Clock::time_point now) {
+    while (!m_deadlines.empty() && m_deadlines.front().first < now) {
+        const auto& [time, token] = m_deadlines.front();
+        if (const auto it = m_states.find(token); it != m_states.end() && it->second.second == time) {
+            m_states.erase(it);
+        }
+        m_deadlines.pop_front();
+    }
+}
+
+} // namespace chat
\ No newline at end of file
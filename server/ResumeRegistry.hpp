@@ -0,0 +1,134 @@
+#ifndef CHAT_RESUME_REGISTRY_HPP
+#define CHAT_RESUME_REGISTRY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chat {
+
+/**
+ * States of the disconnected sessions kept by their resume tokens, 
+ * so a client which reconnects in time is restored into its chatrooms.
+ * A state can be taken only once and expires after the timeout.
+ */
+class ResumeRegistry final {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY { 65'536 };
+
+    struct State {
+        std::string m_username {};
+        /**
+         * Subscribed chatrooms: ID and the sequence number of the chatroom 
+         * when the session joined it. Messages before it aren't replayed.
+         */
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> m_chatrooms {};
+        /**
+         * The current chatroom (`User::m_chatroom`).
+         */
+        std::uint64_t m_current { 0 };
+    };
+
+    /**
+     * State kept by its token, e.g. handed over to the next server.
+     */
+    struct Parked {
+        std::string m_token {};
+        State m_state {};
+        /**
+         * Time left until the state expires.
+         */
+        std::chrono::milliseconds m_remaining { 0 };
+    };
+
+    /**
+     * @param timeout
+     *  Time the state of the disconnected session is kept.
+     * @param capacity
+     *  Maximum number of the kept states. The oldest one is dropped first.
+     */
+    explicit ResumeRegistry(
+        std::chrono::milliseconds timeout, 
+        std::size_t capacity = DEFAULT_CAPACITY
+    );
+
+    /**
+     * Make a new unguessable token.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::string Issue() const;
+
+    /**
+     * Keep @state of the disconnected session until the timeout.
+     * @note
+     *  Thread-safety: safe
+     */
+    void Park(const std::string& token, State state);
+
+    /**
+     * Remove the state kept by @token.
+     * @return 
+     *  Nothing if the token is unknown or expired.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::optional<State> Take(const std::string& token);
+
+    /**
+     * @return
+     *  The kept states which haven't expired yet.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::vector<Parked> Save() const;
+
+    /**
+     * Keep the @parked states until their time is left (the timeout at most).
+     * @note
+     *  Thread-safety: safe, but must be called before the sessions are parked: 
+     *  the deadlines are expected to come in order.
+     */
+    void Restore(std::vector<Parked> parked);
+
+    /**
+     * Number of the kept states (including the expired ones not removed yet).
+     * @note
+     *  Thread-safety: safe
+     */
+    std::size_t GetParkedCount() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Remove the expired states and the oldest ones over the capacity.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void Expire(Clock::time_point now);
+
+    const std::chrono::milliseconds m_timeout;
+
+    const std::size_t m_capacity;
+
+    mutable std::mutex m_mutex;
+
+    std::unordered_map<std::string, std::pair<State, Clock::time_point>> m_states;
+
+    /**
+     * Tokens in order of their deadlines. Taken tokens are skipped.
+     */
+    std::deque<std::pair<Clock::time_point, std::string>> m_deadlines;
+};
+
+} // namespace chat
+
+#endif // CHAT_RESUME_REGISTRY_HPP
\ No newline at end of file
@@ -1,22 +1,64 @@
 #include "RoomService.hpp"
 #include "Session.hpp"
+#include "Federation.hpp"
+#include "Message.hpp"
+#include "Utility.hpp"
 
 #include <cassert>
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
+namespace {
+    /**
+     * Parse unsigned number from the cursor part. 
+     */
+    std::optional<std::uint64_t> DecodeNumber(std::string_view text) noexcept {
+        std::uint64_t value { 0 };
+        const auto last { text.data() + text.size() };
+        const auto [ptr, error] = std::from_chars(text.data(), last, value);
+        if (text.empty() || error != std::errc{} || ptr != last) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    void WriteString(Writer& writer, const std::string& text) {
+        writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+    }
+}
 
 namespace chat {
 
 RoomService::RoomService() :
     m_hall { std::make_shared<Chatroom>( "Hall" ) }
 {
+    m_hall->SetCapacity(0);
     m_chatrooms.reserve(100);
 }
 
 void RoomService::Close() {
     std::lock_guard<std::mutex> lock(m_mutex);
     for (auto& [id, room]: m_chatrooms) {
+        m_handles.Release(id);
         room->Close();
     }
     m_chatrooms.clear();
+    m_serializedRooms.clear();
+    m_outdatedRooms.clear();
+    m_serializedList.reset();
+    m_indexKeys.clear();
+    m_nameIndex.clear();
+    m_occupancyIndex.clear();
+    m_abandoned.clear();
+    m_presenceChanged.clear();
+    m_users.Clear();
     if (!m_hall->IsEmpty()) {
         m_hall->Close();
     }
@@ -27,34 +69,52 @@ RoomService::~RoomService() {
 }
 
 bool RoomService::AddSession(const std::shared_ptr<Session>& session) noexcept {
-    return m_hall->AddSession(session);
+    if (m_hall->AddSession(session)) {
+        m_users.Add(session->GetUser().m_id, session);
+        return true;
+    }
+    return false;
 }
 
 void RoomService::RemoveSession(const std::shared_ptr<Session>& session) noexcept {
+    m_users.Remove(session->GetUser().m_id);
     // Try to remove session from the hall
     const auto isRemoved = m_hall->RemoveSession(session.get());
     if (!isRemoved) {
         // can't find session in chatroom for unAuth so look in rooms
-        const auto chatroomId = session->GetUser().m_chatroom;
+        const auto subscriptions = session->GetSubscriptions();
         // Critical section // 
         std::lock_guard<std::mutex> lock(m_mutex);
-        // Find chatroom with required id
-        // If chatroom is found then try to assign session to chatroom
-        if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
-            auto room = it->second;
-            // if chatroom was assigned successfully return true otherwise false
-            assert(room && "Room can't be nullptr");
-            (void) room->RemoveSession(session.get());
+        for (const auto chatroomId: subscriptions) {
+            // Find chatroom with required id
+            // If chatroom is found then remove session from it
+            if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
+                auto room = it->second;
+                assert(room && "Room can't be nullptr");
+                if (!room->RemoveSession(session.get())) {
+                    continue;
+                }
+                if (!room->IsEmpty()) {
+                    this->InvalidateChatroom(chatroomId);
+                    this->NotePresence(chatroomId);
+                }
+                else if (m_resumeRegistry) {
+                    // keep it for the parked session, it's removed later if nobody comes back
+                    this->InvalidateChatroom(chatroomId);
+                    m_abandoned.insert_or_assign(chatroomId, std::chrono::steady_clock::now());
+                }
+                else {
+                    this->RemoveChatroom(chatroomId);
+                }
+            }
         }
     }
 }
 
 bool RoomService::AssignChatroom(std::uint64_t chatroomId, const std::shared_ptr<Session>& session) {
-    // Remove session from the hall
+    // Remove session from the hall. 
+    // It isn't there if it's already subscribed to other chatrooms.
     const auto isRemoved = m_hall->RemoveSession(session.get());
-    if (!isRemoved) {
-        assert(false && "Can't find session in chatroom for unAuth");
-    }
 
     { // Block
         std::lock_guard<std::mutex> lock(m_mutex);
@@ -65,6 +125,8 @@ bool RoomService::AssignChatroom(std::uint64_t chatroomId, const std::shared_ptr
             // if chatroom was assigned successfully return true otherwise false
             assert(room && "Room can be nullptr");
             if (room->AddSession(session)) {
+                this->InvalidateChatroom(chatroomId);
+                this->NotePresence(chatroomId);
                 return true;
             } 
         }
@@ -72,26 +134,271 @@ bool RoomService::AssignChatroom(std::uint64_t chatroomId, const std::shared_ptr
 
     // failed to join chatroom or room doens't exist
     // assign session back to hall
-    (void) m_hall->AddSession(session);
+    if (isRemoved) {
+        (void) m_hall->AddSession(session);
+    }
     return false;
 }
 
 void RoomService::BroadcastOnly(
-    const Session* source, 
+    std::uint64_t chatroomId, 
     const std::string& message, 
     std::function<bool(const Session&)>&& condition
 ) {
-    const auto id = source->GetUser().m_chatroom;
+    // don't block the other chatrooms during delivery
+    if (const auto room { m_handles.Find(chatroomId) }; room) {
+        room->Broadcast(message, std::move(condition), this->MakeRelay());
+    }
+}
 
-    std::lock_guard<std::mutex> lock{ m_mutex };
-    if (auto it = m_chatrooms.find(id); it != m_chatrooms.end()) {
-        auto room = it->second;
-        assert(room && "Room can be nullptr");
-        room->Broadcast(message, condition);
+bool RoomService::Publish(
+    std::uint64_t chatroomId, 
+    const Chatroom::FrameBuilder& build, 
+    std::function<bool(const Session&)>&& condition
+) {
+    const auto room { m_handles.Find(chatroomId) };
+    if (!room) {
+        return false;
+    }
+    (void) room->Publish(build, std::move(condition), this->MakeRelay());
+    return true;
+}
+
+Chatroom::Relay RoomService::MakeRelay() const {
+    if (!m_federation) {
+        return nullptr;
+    }
+    // relayed by the chatroom in the order of its delivery
+    return [federation = m_federation](const std::string& room, const std::string& frame) {
+        federation->Relay(room, frame);
+    };
+}
+
+std::optional<Chatroom::Replay> RoomService::RejoinChatroom(
+    std::uint64_t chatroomId, 
+    const std::shared_ptr<Session>& session, 
+    std::uint64_t sequence
+) {
+    const auto isRemoved = m_hall->RemoveSession(session.get());
+    { // Block
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
+            if (auto replay = it->second->Rejoin(session, sequence); replay) {
+                this->InvalidateChatroom(chatroomId);
+                this->NotePresence(chatroomId);
+                return replay;
+            }
+        }
+    } // Release
+    if (isRemoved) {
+        (void) m_hall->AddSession(session);
+    }
+    return std::nullopt;
+}
+
+std::uint64_t RoomService::GetSequence(std::uint64_t chatroomId) const {
+    if (const auto room { m_handles.Find(chatroomId) }; room) {
+        return room->GetSequence();
+    }
+    return 0;
+}
+
+void RoomService::SetHistoryLimit(std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_historyLimit = capacity;
+    for (auto& [id, room]: m_chatrooms) {
+        room->SetHistory(m_historyLimit, m_memoryBudget);
+    }
+}
+
+void RoomService::TrimHistory() {
+    std::vector<std::shared_ptr<Chatroom>> rooms;
+    { // Block
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rooms.reserve(m_chatrooms.size());
+        for (const auto& [id, room]: m_chatrooms) {
+            rooms.push_back(room);
+        }
+    } // Release
+    // the chatrooms are trimmed one by one, the others keep working
+    for (const auto& room: rooms) {
+        room->TrimHistory(m_historyLimit / 2);
+    }
+}
+
+std::size_t RoomService::RemoveAbandonedChatrooms(std::chrono::milliseconds grace) {
+    const auto deadline { std::chrono::steady_clock::now() - grace };
+    std::size_t removed { 0 };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_abandoned.begin(); it != m_abandoned.end(); ) {
+        const auto [chatroomId, since] = *it;
+        if (since > deadline) {
+            ++it;
+            continue;
+        }
+        it = m_abandoned.erase(it);
+        // somebody could join it in the meantime
+        if (const auto room = m_chatrooms.find(chatroomId); room != m_chatrooms.end() && room->second->IsEmpty()) {
+            this->RemoveChatroom(chatroomId);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+void RoomService::NoteRename(const std::shared_ptr<Session>& session) {
+    if (!m_isPresenceEnabled) {
+        return;
+    }
+    const auto subscriptions { session->GetSubscriptions() };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto chatroomId: subscriptions) {
+        if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
+            it->second->NoteRename(*session);
+            this->NotePresence(chatroomId);
+        }
+    }
+}
+
+std::size_t RoomService::FlushPresence() {
+    std::unordered_set<std::uint64_t> changed;
+    { // Block
+        std::lock_guard<std::mutex> lock(m_mutex);
+        changed.swap(m_presenceChanged);
+    } // Release
+    std::size_t notified { 0 };
+    for (const auto chatroomId: changed) {
+        const auto room { m_handles.Find(chatroomId) };
+        if (!room) {
+            continue;
+        }
+        const auto presence { room->TakePresence() };
+        if (!presence) {
+            continue; // e.g. joined and left in between
+        }
+        // {"chatroom":{"id":N},"users":C,"joined":[{"id":U,"name":"..."}],"left":[U],"renamed":[...]}
+        // large chatrooms: {"chatroom":{"id":N},"users":C}
+        auto writeMembers = [](Writer& writer, const char *key, const std::vector<Chatroom::Member>& members) {
+            if (members.empty()) {
+                return;
+            }
+            writer.Key(key);
+            writer.StartArray();
+            for (const auto& [id, name]: members) {
+                writer.StartObject();
+                writer.Key("id");
+                writer.Uint64(id);
+                writer.Key("name");
+                ::WriteString(writer, name);
+                writer.EndObject();
+            }
+            writer.EndArray();
+        };
+        rapidjson::StringBuffer buffer;
+        Writer writer(buffer);
+        writer.StartObject();
+        writer.Key("chatroom");
+        writer.StartObject();
+        writer.Key("id");
+        writer.Uint64(chatroomId);
+        writer.EndObject();
+        writer.Key("users");
+        writer.Uint64(presence->m_users);
+        if (presence->m_users <= m_presenceLimit) {
+            writeMembers(writer, "joined", presence->m_joined);
+            if (!presence->m_left.empty()) {
+                writer.Key("left");
+                writer.StartArray();
+                for (const auto id: presence->m_left) {
+                    writer.Uint64(id);
+                }
+                writer.EndArray();
+            }
+            writeMembers(writer, "renamed", presence->m_renamed);
+        }
+        writer.EndObject();
+
+        Internal::Response frame {};
+        frame.m_query = Internal::QueryType::PRESENCE;
+        frame.m_status = 200;
+        frame.m_timestamp = Utils::GetTimestamp();
+        frame.m_attachment.assign(buffer.GetString(), buffer.GetSize());
+        std::string serialized;
+        frame.Write(serialized);
+        room->Broadcast(serialized, [](const Session& session) {
+            return session.IsPresenceEnabled();
+        });
+        notified++;
+    }
+    return notified;
+}
+
+std::optional<std::vector<Chatroom::Member>> RoomService::GetMembers(std::uint64_t chatroomId) const {
+    if (const auto room { m_handles.Find(chatroomId) }; room) {
+        return room->GetMembers();
+    }
+    return std::nullopt;
+}
+
+void RoomService::DeliverRelayed(const std::string& room, const std::string& message) {
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<Chatroom>>> rooms;
+    { // Block
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        for (auto it = m_nameIndex.lower_bound({ room, 0 }); 
+            it != m_nameIndex.end() && it->first == room; ++it
+        ) {
+            if (const auto found = m_chatrooms.find(it->second); found != m_chatrooms.end()) {
+                rooms.emplace_back(it->second, found->second);
+            }
+        }
+    } // Release
+    if (rooms.empty()) {
+        return;
+    }
+
+    rapidjson::Document doc;
+    if (doc.Parse(message.c_str()).HasParseError() || !doc.IsObject()) {
+        return;
+    }
+    // {...,"attachment":{"chatroom":{"id":N,"seq":S},...}}
+    rapidjson::Value* chatroomValue { nullptr };
+    if (doc.HasMember("attachment") && doc["attachment"].IsObject()) {
+        auto& attachment = doc["attachment"];
+        if (attachment.HasMember("chatroom") && attachment["chatroom"].IsObject()
+            && attachment["chatroom"].HasMember("id")
+        ) {
+            chatroomValue = &attachment["chatroom"];
+        }
+    }
+    for (const auto& [localId, chatroom]: rooms) {
+        if (!chatroomValue) {
+            chatroom->Broadcast(message + Internal::MESSAGE_DELIMITER, [](const Session&) { return true; });
+            continue;
+        }
+        // the local chatroom numbers the message on its own
+        (void) chatroom->Publish([&, localId = localId](std::uint64_t sequence) {
+            (*chatroomValue)["id"].SetUint64(localId);
+            if (auto it = chatroomValue->FindMember("seq"); it != chatroomValue->MemberEnd()) {
+                it->value.SetUint64(sequence);
+            }
+            else {
+                chatroomValue->AddMember("seq", sequence, doc.GetAllocator());
+            }
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            doc.Accept(writer);
+            std::string frame { buffer.GetString(), buffer.GetSize() };
+            frame += Internal::MESSAGE_DELIMITER;
+            return frame;
+        }, [](const Session&) { return true; });
     }
 }
 
-void RoomService::LeaveChatroom(std::uint64_t chatroomId, const std::shared_ptr<Session>& session) {
+void RoomService::LeaveChatroom(
+    std::uint64_t chatroomId, 
+    const std::shared_ptr<Session>& session, 
+    bool toHall
+) {
     // Check whether it's a hall chatroom
     if (chatroomId == m_hall->GetId()) {
         // user can't leave hall!
@@ -110,32 +417,340 @@ void RoomService::LeaveChatroom(std::uint64_t chatroomId, const std::shared_ptr<
         if (std::lock_guard<std::mutex> lock{ m_mutex }; room->IsEmpty()) {
             this->RemoveChatroom(chatroomId);
         } 
-        (void) m_hall->AddSession(session);
+        else {
+            this->InvalidateChatroom(chatroomId);
+            this->NotePresence(chatroomId);
+        }
+        if (toHall) {
+            (void) m_hall->AddSession(session);
+        }
     }
 }
 
-std::vector<std::string> RoomService::GetChatroomList() const noexcept {
+std::vector<std::string> RoomService::GetChatroomList() const {
     std::vector<std::string> list;
-    list.reserve(m_chatrooms.size());
 
-    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
-    for (const auto& [id, chatroom] : m_chatrooms) {
-        list.emplace_back(chatroom->AsJSON());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->UpdateChatroomList();
+    list.reserve(m_serializedRooms.size());
+    for (const auto& [id, serialized] : m_serializedRooms) {
+        list.emplace_back(serialized);
     }
-    lock.unlock();
     return list;
 }
 
+std::shared_ptr<const std::string> RoomService::GetSerializedChatroomList() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->UpdateChatroomList();
+    return m_serializedList;
+}
+
+std::uint64_t RoomService::GetChatroomListVersion() const noexcept {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_listVersion;
+}
+
+std::optional<std::string> RoomService::GetChatroomPage(const ChatroomQuery& query) const {
+    const auto limit { 
+        std::clamp<std::size_t>(query.m_limit? query.m_limit: MAX_PAGE_SIZE, 1, MAX_PAGE_SIZE) 
+    };
+    const auto& prefix { query.m_prefix };
+    auto hasPrefix = [&prefix](const std::string& name) {
+        return name.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->UpdateSerializedRooms();
+
+    rapidjson::StringBuffer buffer;
+    Writer writer(buffer);
+    writer.StartObject();
+    writer.Key("chatrooms");
+    writer.StartArray();
+    std::size_t count { 0 };
+    std::string next {};
+    // Append room to the page. Return false when the page is already full.
+    auto append = [&](std::uint64_t id) {
+        if (count == limit) {
+            return false;
+        }
+        // the rooms are serialized once and cached
+        const auto& room { m_serializedRooms.at(id) };
+        writer.RawValue(room.data(), room.size(), rapidjson::kObjectType);
+        count++;
+        return true;
+    };
+
+    switch (query.m_order) {
+        case ChatroomQuery::Order::ID: {
+            auto it { m_serializedRooms.begin() };
+            if (!query.m_cursor.empty()) {
+                const auto cursor { ::DecodeNumber(query.m_cursor) };
+                if (!cursor) {
+                    return std::nullopt;
+                }
+                it = m_serializedRooms.upper_bound(*cursor);
+            }
+            std::uint64_t last { 0 };
+            for (; it != m_serializedRooms.end(); ++it) {
+                if (!hasPrefix(m_indexKeys.at(it->first).m_name)) {
+                    continue;
+                }
+                if (!append(it->first)) {
+                    next = std::to_string(last);
+                    break;
+                }
+                last = it->first;
+            }
+        } break;
+        case ChatroomQuery::Order::NAME: {
+            // only rooms with the given prefix are visited
+            NameIndex::key_type from { prefix, 0 };
+            if (!query.m_cursor.empty()) {
+                // cursor: "<id>:<name>"
+                const auto separator { query.m_cursor.find(':') };
+                const auto id { ::DecodeNumber(query.m_cursor.substr(0, separator)) };
+                if (separator == std::string::npos || !id) {
+                    return std::nullopt;
+                }
+                from = std::max(from, NameIndex::key_type { query.m_cursor.substr(separator + 1), *id + 1 });
+            }
+            NameIndex::key_type last {};
+            for (auto it = m_nameIndex.lower_bound(from); it != m_nameIndex.end() && hasPrefix(it->first); ++it) {
+                if (!append(it->second)) {
+                    next = std::to_string(last.second) + ':' + last.first;
+                    break;
+                }
+                last = *it;
+            }
+        } break;
+        case ChatroomQuery::Order::USERS: {
+            auto it { m_occupancyIndex.begin() };
+            if (!query.m_cursor.empty()) {
+                // cursor: "<users>:<id>"
+                const auto separator { query.m_cursor.find(':') };
+                const auto users { ::DecodeNumber(query.m_cursor.substr(0, separator)) };
+                const auto id { separator == std::string::npos? 
+                    std::nullopt: ::DecodeNumber(query.m_cursor.substr(separator + 1)) 
+                };
+                if (!users || !id) {
+                    return std::nullopt;
+                }
+                it = m_occupancyIndex.upper_bound({ *users, *id });
+            }
+            OccupancyIndex::key_type last {};
+            for (; it != m_occupancyIndex.end(); ++it) {
+                if (!hasPrefix(m_indexKeys.at(it->second).m_name)) {
+                    continue;
+                }
+                if (!append(it->second)) {
+                    next = std::to_string(last.first) + ':' + std::to_string(last.second);
+                    break;
+                }
+                last = *it;
+            }
+        } break;
+    }
+
+    writer.EndArray();
+    if (!next.empty()) {
+        writer.Key("next");
+        ::WriteString(writer, next);
+    }
+    writer.EndObject();
+    return std::string { buffer.GetString(), buffer.GetSize() };
+}
+
+void RoomService::InvalidateChatroom(std::uint64_t chatroomId) {
+    m_outdatedRooms.insert(chatroomId);
+    m_isListOutdated = true;
+    // the name under which the chatroom had members before and after the update
+    std::optional<std::string> heldBefore;
+    std::optional<std::string> heldAfter;
+    // update sort keys of the chatroom
+    if (const auto it = m_indexKeys.find(chatroomId); it != m_indexKeys.end()) {
+        m_nameIndex.erase({ it->second.m_name, chatroomId });
+        m_occupancyIndex.erase({ it->second.m_users, chatroomId });
+        if (it->second.m_users) {
+            heldBefore = it->second.m_name;
+        }
+        m_indexKeys.erase(it);
+    }
+    if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
+        IndexKey key { it->second->GetName(), it->second->GetSessionCount() };
+        m_nameIndex.emplace(key.m_name, chatroomId);
+        m_occupancyIndex.emplace(key.m_users, chatroomId);
+        if (key.m_users) {
+            heldAfter = key.m_name;
+        }
+        m_indexKeys.emplace(chatroomId, std::move(key));
+    }
+    // peers are told only about the chatrooms which gained the first or lost the last member
+    if (m_federation && heldBefore != heldAfter) {
+        if (heldBefore) {
+            m_federation->ReleaseRoom(*heldBefore);
+        }
+        if (heldAfter) {
+            m_federation->HoldRoom(*heldAfter);
+        }
+    }
+}
+
+void RoomService::UpdateSerializedRooms() const {
+    for (const auto id: m_outdatedRooms) {
+        if (const auto it = m_chatrooms.find(id); it != m_chatrooms.end()) {
+            m_serializedRooms[id] = it->second->AsJSON();
+        }
+        else {
+            m_serializedRooms.erase(id);
+        }
+    }
+    m_outdatedRooms.clear();
+}
+
+void RoomService::UpdateChatroomList() const {
+    if (m_serializedList && !m_isListOutdated) {
+        return;
+    }
+    // serialize only outdated chatrooms
+    this->UpdateSerializedRooms();
+    // build the list from the serialized chatrooms
+    constexpr std::string_view prefix { "{\"chatrooms\":[" };
+    constexpr std::string_view suffix { "]}" };
+    std::size_t size { prefix.size() + suffix.size() + m_serializedRooms.size() };
+    for (const auto& [id, serialized]: m_serializedRooms) {
+        size += serialized.size();
+    }
+    std::string list;
+    list.reserve(size);
+    list += prefix;
+    for (const auto& [id, serialized]: m_serializedRooms) {
+        list += serialized;
+        list += ',';
+    }
+    if (!m_serializedRooms.empty()) {
+        list.pop_back();
+    }
+    list += suffix;
+    m_serializedList = std::make_shared<const std::string>(std::move(list));
+    m_isListOutdated = false;
+    m_listVersion++;
+}
+
+bool RoomService::ClaimUsername(std::uint64_t userId, const std::string& name) {
+    return m_users.ClaimName(userId, name);
+}
+
+std::shared_ptr<Session> RoomService::FindSession(std::uint64_t userId) const {
+    return m_users.Find(userId);
+}
+
+std::optional<std::uint64_t> RoomService::FindUserId(const std::string& name) const {
+    return m_users.FindId(name);
+}
+
+void RoomService::SetFanoutPolicy(FanoutPolicy policy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fanoutPolicy = std::move(policy);
+    for (auto& [id, room]: m_chatrooms) {
+        room->SetFanoutPolicy(m_fanoutPolicy);
+    }
+}
+
+void RoomService::SetChatroomCapacity(std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_chatroomCapacity = capacity;
+    for (auto& [id, room]: m_chatrooms) {
+        room->SetCapacity(m_chatroomCapacity);
+    }
+}
+
+void RoomService::SetHallCapacity(std::size_t capacity) {
+    m_hall->SetCapacity(capacity);
+}
+
 std::uint64_t RoomService::CreateChatroom(std::string name) {
-    auto room { std::make_shared<Chatroom>(name) };
-    const std::uint64_t id { room->GetId() };
+    const std::uint64_t id { m_handles.Allocate() };
+    if (id == rt::HandleTable<Chatroom>::NONE) {
+        return Chatroom::NO_ROOM;
+    }
+    auto room { std::make_shared<Chatroom>(id, name) };
+    if (m_isPresenceEnabled) {
+        room->EnablePresence();
+    }
     { // Block
         std::lock_guard<std::mutex> lock(m_mutex);
+        room->SetFanoutPolicy(m_fanoutPolicy);
+        room->SetCapacity(m_chatroomCapacity);
+        room->SetHistory(m_historyLimit, m_memoryBudget);
+        m_handles.Set(id, room);
         m_chatrooms.emplace(id, std::move(room));
+        this->InvalidateChatroom(id);
     } // Release
     return id;
 }
 
+std::vector<SavedChatroom> RoomService::SaveChatrooms() const {
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<Chatroom>>> rooms;
+    { // Block
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rooms.assign(m_chatrooms.begin(), m_chatrooms.end());
+    } // Release
+    std::vector<SavedChatroom> saved;
+    saved.reserve(rooms.size());
+    for (const auto& [id, room]: rooms) {
+        SavedChatroom chatroom {};
+        chatroom.m_id = id;
+        chatroom.m_name = room->GetName();
+        // the history first: it never runs ahead of the sequence number
+        chatroom.m_history = room->GetHistory();
+        chatroom.m_sequence = room->GetSequence();
+        saved.push_back(std::move(chatroom));
+    }
+    return saved;
+}
+
+std::size_t RoomService::RestoreChatrooms(std::vector<SavedChatroom> chatrooms) {
+    using Handles = rt::HandleTable<Chatroom>;
+    // the handles are adopted in order of their slots
+    std::sort(chatrooms.begin(), chatrooms.end(), [](const SavedChatroom& lhs, const SavedChatroom& rhs) {
+        return Handles::GetIndex(lhs.m_id) < Handles::GetIndex(rhs.m_id);
+    });
+    const auto now { std::chrono::steady_clock::now() };
+    std::size_t restored { 0 };
+    for (auto& chatroom: chatrooms) {
+        if (!m_handles.Adopt(chatroom.m_id)) {
+            m_logger.Write(LogType::warning, "Chatroom", chatroom.m_id, "can't be restored\n");
+            continue;
+        }
+        auto room { std::make_shared<Chatroom>(chatroom.m_id, chatroom.m_name) };
+        if (m_isPresenceEnabled) {
+            room->EnablePresence();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        room->SetFanoutPolicy(m_fanoutPolicy);
+        room->SetCapacity(m_chatroomCapacity);
+        room->SetHistory(m_historyLimit, m_memoryBudget);
+        room->RestoreHistory(chatroom.m_sequence, std::move(chatroom.m_history));
+        m_handles.Set(chatroom.m_id, room);
+        m_chatrooms.emplace(chatroom.m_id, std::move(room));
+        this->InvalidateChatroom(chatroom.m_id);
+        m_abandoned.insert_or_assign(chatroom.m_id, now);
+        restored++;
+    }
+    return restored;
+}
+
+bool RoomService::RenameChatroom(std::uint64_t chatroomId, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
+        it->second->Rename(name);
+        this->InvalidateChatroom(chatroomId);
+        return true;
+    }
+    return false;
+}
+
 std::uint64_t RoomService::GetChatroom(const Session* const session) const noexcept {
     // check the hall
     if (m_hall->Contains(session)) {
@@ -154,18 +769,28 @@ std::uint64_t RoomService::GetChatroom(const Session* const session) const noexc
 }
 
 bool RoomService::ExistChatroom(std::uint64_t id) const noexcept {
-    std::lock_guard<std::mutex> lock{ m_mutex };  
-    return (m_chatrooms.find(id) != m_chatrooms.cend());
+    return m_handles.Find(id) != nullptr;
 }
 
 void RoomService::RemoveChatroom(std::uint64_t chatroomId) {
     if (auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end()) {
         auto room = it->second;
         m_chatrooms.erase(it);
+        m_handles.Release(chatroomId);
+        this->InvalidateChatroom(chatroomId);
         room->Close();
     }
 }
 
+bool RoomService::RemoveEmptyChatroom(std::uint64_t chatroomId) {
+    std::lock_guard<std::mutex> lock{ m_mutex };  
+    if (const auto it = m_chatrooms.find(chatroomId); it != m_chatrooms.end() && it->second->IsEmpty()) {
+        this->RemoveChatroom(chatroomId);
+        return true;
+    }
+    return false;
+}
+
 bool RoomService::IsEmpty(std::uint64_t chatroomId) const noexcept {
     std::lock_guard<std::mutex> lock{ m_mutex };  
     const auto it = m_chatrooms.find(chatroomId);
@@ -1,24 +1,91 @@
 #ifndef CHAT_HALL_HPP
 #define CHAT_HALL_HPP
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <set>
 #include <optional>
 #include <tuple>
 #include <string>
 #include <vector>
+#include <utility>
 #include <cstddef>
 
 #include "Log.hpp"
 #include "Chatroom.hpp"
+#include "UserDirectory.hpp"
+#include "Fanout.hpp"
+#include "HandleTable.hpp"
 
 class Session;
 
+namespace net {
+    class MemoryBudget;
+}
+
 namespace chat {
 
+class Federation;
+class ResumeRegistry;
+
+/**
+ * Parameters of the paginated LIST_CHATROOM request.
+ */
+struct ChatroomQuery {
+    enum class Order: std::uint8_t {
+        ID,
+        NAME,
+        /**
+         * By member count: the most populated chatrooms go first.
+         */
+        USERS
+    };
+
+    Order m_order { Order::ID };
+
+    /**
+     * Only chatrooms which name starts with this prefix are listed.
+     */
+    std::string m_prefix {};
+
+    /**
+     * Opaque position returned as "next" by the previous page.
+     * Empty string requests the first page.
+     */
+    std::string m_cursor {};
+
+    /**
+     * Maximum number of chatrooms on the page. 
+     * Zero or a value above `RoomService::MAX_PAGE_SIZE` is clamped to it.
+     */
+    std::size_t m_limit { 0 };
+};
+
+/**
+ * Chatroom handed over to the next server (see `RoomService::SaveChatrooms`).
+ */
+struct SavedChatroom {
+    std::uint64_t m_id { 0 };
+
+    std::string m_name {};
+
+    /**
+     * Sequence number of the last published message.
+     */
+    std::uint64_t m_sequence { 0 };
+
+    std::vector<Chatroom::Kept> m_history {};
+};
+
 class RoomService final {
 public:
+
+    static constexpr std::size_t MAX_PAGE_SIZE { 100 };
     
     RoomService();
 
@@ -30,6 +97,191 @@ public:
 
     void RemoveSession(const std::shared_ptr<Session>& session) noexcept;
 
+    /**
+     * Reserve unique @name for the user with @userId.
+     * @return 
+     *  The indication whether the name isn't taken by another user.
+     * @note
+     *  Thread-safety: safe
+     */
+    bool ClaimUsername(std::uint64_t userId, const std::string& name);
+
+    /**
+     * Find session of the connected user. 
+     * The lookup doesn't lock any chatroom.
+     * @return
+     *  Return nullptr if there is no such user.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::shared_ptr<Session> FindSession(std::uint64_t userId) const;
+
+    /**
+     * Find ID of the connected user by it's name.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::optional<std::uint64_t> FindUserId(const std::string& name) const;
+
+    /**
+     * Define when broadcasts in large chatrooms are delivered in parallel chunks.
+     * Applied to the existing and future chatrooms.
+     * @note
+     *  Thread-safety: safe
+     */
+    void SetFanoutPolicy(FanoutPolicy policy);
+
+    /**
+     * Each chatroom accepts at most @capacity members. Zero means no limit. 
+     * Applied to the existing and future chatrooms, not to the hall.
+     * @note
+     *  Thread-safety: safe
+     */
+    void SetChatroomCapacity(std::size_t capacity);
+
+    /**
+     * The hall accepts at most @capacity sessions. Zero means no limit (the default): 
+     * the admission control limits the connections.
+     * @note
+     *  Thread-safety: safe
+     */
+    void SetHallCapacity(std::size_t capacity);
+
+    /**
+     * Frames of at least @threshold bytes are compressed for clients 
+     * which negotiated compression. Zero disables compression.
+     * @note
+     *  Thread-safety: safe
+     */
+    void SetCompressionThreshold(std::size_t threshold) noexcept {
+        m_compressionThreshold = threshold;
+    }
+
+    std::size_t GetCompressionThreshold() const noexcept {
+        return m_compressionThreshold;
+    }
+
+    /**
+     * Relay broadcasts to the peer nodes and advertise the chatrooms with members.
+     * @note
+     *  Thread-safety: NOT-safe, must be set before the chatrooms are populated.
+     */
+    void SetFederation(std::shared_ptr<Federation> federation) noexcept {
+        m_federation = std::move(federation);
+    }
+
+    std::shared_ptr<Federation> GetFederation() const noexcept {
+        return m_federation;
+    }
+
+    /**
+     * Account the memory of the sessions and shed load when it's over budget.
+     * @note
+     *  Thread-safety: NOT-safe, must be set before the sessions are added.
+     */
+    void SetMemoryBudget(std::shared_ptr<net::MemoryBudget> budget) noexcept {
+        m_memoryBudget = std::move(budget);
+    }
+
+    std::shared_ptr<net::MemoryBudget> GetMemoryBudget() const noexcept {
+        return m_memoryBudget;
+    }
+
+    /**
+     * Keep states of the disconnected sessions, so the clients can resume them.
+     * @note
+     *  Thread-safety: NOT-safe, must be set before the sessions are added.
+     */
+    void SetResumeRegistry(std::shared_ptr<ResumeRegistry> registry) noexcept {
+        m_resumeRegistry = std::move(registry);
+    }
+
+    std::shared_ptr<ResumeRegistry> GetResumeRegistry() const noexcept {
+        return m_resumeRegistry;
+    }
+
+    /**
+     * Each chatroom keeps its last @capacity messages for the resumed sessions. 
+     * Zero disables the history. Applied to the existing and future chatrooms.
+     * @note
+     *  Thread-safety: safe
+     */
+    void SetHistoryLimit(std::size_t capacity);
+
+    /**
+     * Release half of the history of every chatroom. 
+     * Used when the memory is over budget.
+     * @note
+     *  Thread-safety: safe
+     */
+    void TrimHistory();
+
+    /**
+     * Remove chatrooms left empty by the disconnected sessions at least @grace ago. 
+     * They're kept that long so the parked sessions can resume them.
+     * @return
+     *  Number of the removed chatrooms.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::size_t RemoveAbandonedChatrooms(std::chrono::milliseconds grace);
+
+    /**
+     * Chatrooms created later collect joins, leaves and renames, 
+     * and `FlushPresence` sends them to the members as one delta. 
+     * Chatrooms with more than @fullLimit members send only the member count, 
+     * the members ask for the list (`GetMembers`) on demand.
+     * @note
+     *  Thread-safety: NOT-safe, must be set before the chatrooms are created.
+     */
+    void EnablePresence(std::size_t fullLimit) noexcept {
+        m_isPresenceEnabled = true;
+        m_presenceLimit = fullLimit;
+    }
+
+    bool IsPresenceEnabled() const noexcept {
+        return m_isPresenceEnabled;
+    }
+
+    std::size_t GetPresenceLimit() const noexcept {
+        return m_presenceLimit;
+    }
+
+    /**
+     * Tell the chatrooms of the @session that its user has a new name.
+     * @note
+     *  Thread-safety: safe
+     */
+    void NoteRename(const std::shared_ptr<Session>& session);
+
+    /**
+     * Send the membership changes collected since the last call: 
+     * one `PRESENCE` frame to each member (which asked for them in SYN) 
+     * of every changed chatroom.
+     * @return
+     *  Number of the notified chatrooms.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::size_t FlushPresence();
+
+    /**
+     * @return
+     *  Nothing if the chatroom doesn't exist.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::optional<std::vector<Chatroom::Member>> GetMembers(std::uint64_t chatroomId) const;
+
+    /**
+     * Deliver @message relayed by the peer node to every member of the 
+     * local chatrooms named @room. The chatroom ID in the attachment 
+     * is replaced with the local one. It isn't relayed any further.
+     * @note
+     *  Thread-safety: safe
+     */
+    void DeliverRelayed(const std::string& room, const std::string& message);
+
     /**
      * Get list of all available chatrooms user can join.
      * @return 
@@ -37,7 +289,47 @@ public:
      * @note
      *  Thread-safety: safe
      */
-    std::vector<std::string> GetChatroomList() const noexcept;
+    std::vector<std::string> GetChatroomList() const;
+
+    /**
+     * Get serialized list of all available chatrooms, i.e. 
+     * the attachment of the LIST_CHATROOM response:
+     * @code 
+     * {"chatrooms":[{"id":1,"name":"...","users":0},...]}
+     * @endcode
+     * @return 
+     *  Return the cached list shared by all callers. 
+     *  It's rebuilt only after chatrooms were created, renamed, removed
+     *  or changed member count, and only these chatrooms are serialized again.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::shared_ptr<const std::string> GetSerializedChatroomList() const;
+
+    /**
+     * Get a single page of the chatrooms which meet the @query.
+     * @return 
+     *  Return the LIST_CHATROOM attachment:
+     * @code 
+     * {"chatrooms":[...],"next":"<cursor>"}
+     * @endcode
+     *  where "next" is present only if there are more chatrooms to list.
+     *  Return nothing if the cursor is malformed.
+     * @note
+     *  Pages are served from the ordered indexes, so the cost depends 
+     *  on the page size, not on the number of chatrooms. 
+     *  Rooms skipped by the prefix filter are visited for ID and USERS orders.
+     *  Thread-safety: safe
+     */
+    std::optional<std::string> GetChatroomPage(const ChatroomQuery& query) const;
+
+    /**
+     * Get version of the serialized chatroom list. 
+     * It's incremented each time the cached list is rebuilt.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::uint64_t GetChatroomListVersion() const noexcept;
 
     /**
      * Get chatroom information by it's ID.
@@ -74,14 +366,49 @@ public:
      *  This is the name of the future chat room. It may not be unique.
      * @return 
      *  Return ID of the created chat room on success, 
-     *  0 otherwise 
+     *  0 otherwise (too many chatrooms).
+     *  The ID is a handle {generation, index}: a stale ID of the removed chatroom 
+     *  never refers to the chatroom created later.
      * @note
      *  Thread-safety: safe
      */
     std::uint64_t CreateChatroom(std::string name);
 
     /**
-     * Move session from hall chatroom to the chatroom with required id. 
+     * @return
+     *  ID, name, sequence number and history of every chatroom.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::vector<SavedChatroom> SaveChatrooms() const;
+
+    /**
+     * Create the @chatrooms saved by the previous server under their IDs, 
+     * so the resumed sessions find them. They're empty: they're removed 
+     * with the abandoned ones (see `RemoveAbandonedChatrooms`) unless somebody joins.
+     * @return
+     *  Number of the restored chatrooms.
+     * @note
+     *  Thread-safety: NOT-safe, must be called before any chatroom is created.
+     */
+    std::size_t RestoreChatrooms(std::vector<SavedChatroom> chatrooms);
+
+    /**
+     * Rename chatroom with the given ID
+     * @param chatroomId
+     *  This is ID of the chatroom needed to be renamed.
+     * @param name
+     *  This is a new name of the chatroom.
+     * @return 
+     *  The indication whether the chatroom was found and renamed.
+     * @note
+     *  Thread-safety: safe
+     */
+    bool RenameChatroom(std::uint64_t chatroomId, const std::string& name);
+
+    /**
+     * Subscribe session to the chatroom with required id. 
+     * The session leaves the hall if it was there.
      * @param chatroomId
      *  This is ID of the chatroom needed to be joined.
      * @param session
@@ -90,22 +417,23 @@ public:
      *  The indication whether the session has joined chatroom successfully or not.
      *
      * @note 
-     *  Session can be only in the one chatroom at the same time
+     *  Session can be subscribed to several chatrooms at the same time
      *  Thread-safety: safe
      */
     bool AssignChatroom(std::uint64_t chatroomId, const std::shared_ptr<Session>& session);
 
     /**
-     * Move session from the current chatroom to the hall chatroom 
+     * Unsubscribe session from the chatroom. 
      * @param chatroomId
      *  This is ID of the chatroom needed to be left.
      * @param session
      *  This is session that is going to leave to the chatroom
+     * @param toHall
+     *  Move session to the hall, i.e. it was the last subscription. 
      * @note 
-     *  Session can be only in the one chatroom at the same time.
      *  Thread-safety: safe
      */
-    void LeaveChatroom(std::uint64_t chatroomId, const std::shared_ptr<Session>& session);
+    void LeaveChatroom(std::uint64_t chatroomId, const std::shared_ptr<Session>& session, bool toHall = true);
     
     /**
      * Get ID of the chatroom this session belong to.
@@ -120,10 +448,31 @@ public:
     std::uint64_t GetChatroom(const Session* const session) const noexcept;
 
     /**
-     * Conditional broadcast message to users in the chatroom which @source belongs.
+     * Subscribe the resumed session to the chatroom and replay 
+     * the messages after @sequence (see `Chatroom::Rejoin`).
+     * @return 
+     *  Nothing if the chatroom doesn't exist or is full.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::optional<Chatroom::Replay> RejoinChatroom(
+        std::uint64_t chatroomId, 
+        const std::shared_ptr<Session>& session, 
+        std::uint64_t sequence
+    );
+
+    /**
+     * Sequence number of the last message of the chatroom. Zero if it doesn't exist.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::uint64_t GetSequence(std::uint64_t chatroomId) const;
+
+    /**
+     * Conditional broadcast message to subscribers of the chatroom.
      * 
-     * @param source
-     *  Session which initiate a broadcast in chatroom it belongs
+     * @param chatroomId
+     *  ID of the chatroom
      * @param message
      *  Message which will be broadcasted
      * @param condition
@@ -131,11 +480,25 @@ public:
      * whether a message will be sent to the given user on not.
      */
     void BroadcastOnly(
-        const Session* source, 
+        std::uint64_t chatroomId, 
         const std::string& message, 
         std::function<bool(const Session&)>&& condition
     );
 
+    /**
+     * Publish the message made by @build with the next sequence number 
+     * of the chatroom (see `Chatroom::Publish`) and relay it to the peer nodes.
+     * @return 
+     *  The indication whether the chatroom exists.
+     * @note
+     *  Thread-safety: safe
+     */
+    bool Publish(
+        std::uint64_t chatroomId, 
+        const Chatroom::FrameBuilder& build, 
+        std::function<bool(const Session&)>&& condition
+    );
+
     /**
      * Check whether a chatroom with the given ID exist.
      * @param chatroomId
@@ -167,8 +530,56 @@ public:
      */
     bool IsEmpty(std::uint64_t chatroomId) const noexcept;
 
+    /**
+     * Remove the chatroom unless somebody has joined it.
+     * @return 
+     *  The indication whether the chatroom was removed.
+     * @note
+     *  Thread-safety: safe
+     */
+    bool RemoveEmptyChatroom(std::uint64_t chatroomId);
+
 private:
 
+    /**
+     * Relay of the broadcasts to the peer nodes, nothing without the federation.
+     * @note
+     *  Thread-safety: safe
+     */
+    Chatroom::Relay MakeRelay() const;
+
+    /**
+     * Mark serialized chatroom as outdated and update its sort keys.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void InvalidateChatroom(std::uint64_t chatroomId);
+
+    /**
+     * Remember that the chatroom has membership changes for `FlushPresence`.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void NotePresence(std::uint64_t chatroomId) {
+        if (m_isPresenceEnabled) {
+            m_presenceChanged.insert(chatroomId);
+        }
+    }
+
+    /**
+     * Serialize again all outdated chatrooms.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void UpdateSerializedRooms() const;
+
+    /**
+     * Serialize again all outdated chatrooms and rebuild the list.
+     * @note
+     *  Thread-safety: NOT-safe, require `m_mutex` to be locked
+     */
+    void UpdateChatroomList() const;
+
     mutable std::mutex m_mutex;
 
     /**
@@ -181,12 +592,111 @@ private:
      */
     std::unordered_map<std::uint64_t, std::shared_ptr<chat::Chatroom>> m_chatrooms;
 
+    /**
+     * The same chatrooms by their handle (ID). Chat messages resolve the chatroom 
+     * here without `m_mutex`, the map above keeps the ordered indexes and the listing.
+     */
+    rt::HandleTable<chat::Chatroom> m_handles;
+
     /**
      * Virtual chatroom which is just a hall to keep all connections
      * which hasn't joined any chatroom yet.
      * No chat interface provided in this room (it's virtual, i.e. container). 
      */
     std::shared_ptr<chat::Chatroom> m_hall { nullptr };
+
+    /**
+     * Connected users (in the hall or in any chatroom) by their ID and name.
+     */
+    UserDirectory m_users;
+
+    FanoutPolicy m_fanoutPolicy {};
+
+    std::size_t m_chatroomCapacity { Chatroom::DEFAULT_CAPACITY };
+
+    std::atomic<std::size_t> m_compressionThreshold { 0 };
+
+    std::shared_ptr<Federation> m_federation { nullptr };
+
+    std::shared_ptr<net::MemoryBudget> m_memoryBudget { nullptr };
+
+    std::shared_ptr<ResumeRegistry> m_resumeRegistry { nullptr };
+
+    /**
+     * Chatrooms left empty by the disconnected sessions (while the resumption is on) 
+     * and the time they became empty.
+     */
+    std::unordered_map<std::uint64_t, std::chrono::steady_clock::time_point> m_abandoned;
+
+    bool m_isPresenceEnabled { false };
+
+    /**
+     * Larger chatrooms report only the member count.
+     */
+    std::size_t m_presenceLimit { 0 };
+
+    /**
+     * Chatrooms with membership changes not sent yet.
+     */
+    std::unordered_set<std::uint64_t> m_presenceChanged;
+
+    /**
+     * Number of messages kept by each chatroom.
+     */
+    std::size_t m_historyLimit { 0 };
+
+    /**
+     * Serialized chatrooms (`Chatroom::AsJSON`) ordered by their ID.
+     */
+    mutable std::map<std::uint64_t, std::string> m_serializedRooms;
+
+    /**
+     * IDs of the chatrooms which serialized form is outdated.
+     */
+    mutable std::unordered_set<std::uint64_t> m_outdatedRooms;
+
+    /**
+     * Cached LIST_CHATROOM attachment built from `m_serializedRooms`.
+     */
+    mutable std::shared_ptr<const std::string> m_serializedList { nullptr };
+
+    mutable std::uint64_t m_listVersion { 0 };
+
+    mutable bool m_isListOutdated { true };
+
+    /**
+     * Sort keys of the chatroom kept by the indexes. 
+     */
+    struct IndexKey {
+        std::string m_name;
+        std::uint64_t m_users;
+    };
+
+    /**
+     * Order by member count (descending), then by ID.
+     */
+    struct OccupancyOrder {
+        using Key = std::pair<std::uint64_t, std::uint64_t>;
+        bool operator()(const Key& lhs, const Key& rhs) const noexcept {
+            return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+        }
+    };
+
+    using NameIndex = std::set<std::pair<std::string, std::uint64_t>>;
+
+    using OccupancyIndex = std::set<std::pair<std::uint64_t, std::uint64_t>, OccupancyOrder>;
+
+    std::unordered_map<std::uint64_t, IndexKey> m_indexKeys;
+
+    /**
+     * Chatrooms ordered by (name, ID).
+     */
+    NameIndex m_nameIndex;
+
+    /**
+     * Chatrooms ordered by (member count, ID). 
+     */
+    OccupancyIndex m_occupancyIndex;
 };
 
 } // namespace chat
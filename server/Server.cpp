@@ -1,12 +1,35 @@
 ﻿#include "Server.hpp"
 #include "RoomService.hpp"
 #include "Session.hpp"
+#include "ConnectionPool.hpp"
+#include "Federation.hpp"
+#include "PeerLink.hpp"
+#include "ResumeRegistry.hpp"
+#include "KernelTLS.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <exception>
 #include <fstream>
 #include <iostream>
 
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include <openssl/ssl.h>
+
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
+#include "rapidjson/document.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+
 namespace {
     template<class ...Args>
     void ConsoleLog([[maybe_unused]] Args&& ...args) {
@@ -16,11 +39,11 @@ namespace {
     }
 }
 
-void Server::Config::LoadConfig() {
-    ConsoleLog("Trying to load config file: <", Config::PATH, ">\n");
-    std::ifstream in(Config::PATH);
+void Server::Config::LoadConfig(const std::string& path) {
+    ConsoleLog("Trying to load config file: <", path, ">\n");
+    std::ifstream in(path);
     if (!in.is_open()) {
-        ConsoleLog("Can't open config file: <", Config::PATH, ">\n");
+        ConsoleLog("Can't open config file: <", path, ">\n");
         assert(false && "TODO: Handle situation when file is absent!");
         exit(1);
     }
@@ -28,7 +51,36 @@ void Server::Config::LoadConfig() {
         "password",
         "certificate_chain_file",
         "private_key_file",
-        "tmp_dh_file"
+        "tmp_dh_file",
+        "enable_ktls",
+        "fanout_threshold",
+        "fanout_chunk_size",
+        "connection_pool_size",
+        "connection_pool_buffer_bytes",
+        "compression_threshold",
+        "node_id",
+        "federation_secret",
+        "federation_peers",
+        "handoff_path",
+        "handoff_drain_timeout",
+        "accept_concurrency",
+        "listen_backlog",
+        "max_connections",
+        "listener_max_connections",
+        "max_handshakes",
+        "handshake_queue",
+        "handshake_timeout",
+        "handshake_threads",
+        "max_frame_size",
+        "frame_timeout",
+        "inbound_byte_rate",
+        "memory_budget",
+        "memory_check_interval",
+        "history_size",
+        "resume_timeout",
+        "presence_interval",
+        "presence_full_limit",
+        "chatroom_capacity"
     };
 
     std::string line;
@@ -52,6 +104,122 @@ void Server::Config::LoadConfig() {
             tmp_dh_file = std::move(value);
             ConsoleLog("\tread tmp dh file... ", tmp_dh_file, '\n');
         }
+        else if (key == keys[4]) {
+            enable_ktls = (value == "true");
+            ConsoleLog("\tread enable ktls... ", value, '\n');
+        }
+        else if (key == keys[5]) {
+            fanout_threshold = std::stoull(value);
+            ConsoleLog("\tread fanout threshold... ", fanout_threshold, '\n');
+        }
+        else if (key == keys[6]) {
+            fanout_chunk_size = std::stoull(value);
+            ConsoleLog("\tread fanout chunk size... ", fanout_chunk_size, '\n');
+        }
+        else if (key == keys[7]) {
+            connection_pool_size = std::stoull(value);
+            ConsoleLog("\tread connection pool size... ", connection_pool_size, '\n');
+        }
+        else if (key == keys[8]) {
+            connection_pool_buffer_bytes = std::stoull(value);
+            ConsoleLog("\tread connection pool buffer bytes... ", connection_pool_buffer_bytes, '\n');
+        }
+        else if (key == keys[9]) {
+            compression_threshold = std::stoull(value);
+            ConsoleLog("\tread compression threshold... ", compression_threshold, '\n');
+        }
+        else if (key == keys[10]) {
+            node_id = std::move(value);
+            ConsoleLog("\tread node id... ", node_id, '\n');
+        }
+        else if (key == keys[11]) {
+            federation_secret = std::move(value);
+            ConsoleLog("\tread federation secret... ***\n");
+        }
+        else if (key == keys[12]) {
+            federation_peers = std::move(value);
+            ConsoleLog("\tread federation peers... ", federation_peers, '\n');
+        }
+        else if (key == keys[13]) {
+            handoff_path = std::move(value);
+            ConsoleLog("\tread handoff path... ", handoff_path, '\n');
+        }
+        else if (key == keys[14]) {
+            handoff_drain_timeout = std::stoull(value);
+            ConsoleLog("\tread handoff drain timeout... ", handoff_drain_timeout, '\n');
+        }
+        else if (key == keys[15]) {
+            accept_concurrency = std::stoull(value);
+            ConsoleLog("\tread accept concurrency... ", accept_concurrency, '\n');
+        }
+        else if (key == keys[16]) {
+            listen_backlog = std::stoull(value);
+            ConsoleLog("\tread listen backlog... ", listen_backlog, '\n');
+        }
+        else if (key == keys[17]) {
+            max_connections = std::stoull(value);
+            ConsoleLog("\tread max connections... ", max_connections, '\n');
+        }
+        else if (key == keys[18]) {
+            listener_max_connections = std::stoull(value);
+            ConsoleLog("\tread listener max connections... ", listener_max_connections, '\n');
+        }
+        else if (key == keys[19]) {
+            max_handshakes = std::stoull(value);
+            ConsoleLog("\tread max handshakes... ", max_handshakes, '\n');
+        }
+        else if (key == keys[20]) {
+            handshake_queue = std::stoull(value);
+            ConsoleLog("\tread handshake queue... ", handshake_queue, '\n');
+        }
+        else if (key == keys[21]) {
+            handshake_timeout = std::stoull(value);
+            ConsoleLog("\tread handshake timeout... ", handshake_timeout, '\n');
+        }
+        else if (key == keys[22]) {
+            handshake_threads = std::stoull(value);
+            ConsoleLog("\tread handshake threads... ", handshake_threads, '\n');
+        }
+        else if (key == keys[23]) {
+            max_frame_size = std::stoull(value);
+            ConsoleLog("\tread max frame size... ", max_frame_size, '\n');
+        }
+        else if (key == keys[24]) {
+            frame_timeout = std::stoull(value);
+            ConsoleLog("\tread frame timeout... ", frame_timeout, '\n');
+        }
+        else if (key == keys[25]) {
+            inbound_byte_rate = std::stoull(value);
+            ConsoleLog("\tread inbound byte rate... ", inbound_byte_rate, '\n');
+        }
+        else if (key == keys[26]) {
+            memory_budget = std::stoull(value);
+            ConsoleLog("\tread memory budget... ", memory_budget, '\n');
+        }
+        else if (key == keys[27]) {
+            memory_check_interval = std::stoull(value);
+            ConsoleLog("\tread memory check interval... ", memory_check_interval, '\n');
+        }
+        else if (key == keys[28]) {
+            history_size = std::stoull(value);
+            ConsoleLog("\tread history size... ", history_size, '\n');
+        }
+        else if (key == keys[29]) {
+            resume_timeout = std::stoull(value);
+            ConsoleLog("\tread resume timeout... ", resume_timeout, '\n');
+        }
+        else if (key == keys[30]) {
+            presence_interval = std::stoull(value);
+            ConsoleLog("\tread presence interval... ", presence_interval, '\n');
+        }
+        else if (key == keys[31]) {
+            presence_full_limit = std::stoull(value);
+            ConsoleLog("\tread presence full limit... ", presence_full_limit, '\n');
+        }
+        else if (key == keys[32]) {
+            chatroom_capacity = std::stoull(value);
+            ConsoleLog("\tread chatroom capacity... ", chatroom_capacity, '\n');
+        }
         else {
             ConsoleLog("\t[WARNING] read: ", line, '\n');
         }
@@ -60,14 +228,98 @@ void Server::Config::LoadConfig() {
 
 Server::Server(
     std::shared_ptr<asio::io_context> context, 
-    std::uint16_t port
+    std::uint16_t port,
+    std::string config
 ) :
     m_context { context },
     m_sslContext { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23)  },
-    m_acceptor { *m_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port) },
-    m_service { std::make_shared<chat::RoomService>() }
+    m_drainTimer { *m_context },
+    m_memoryTimer { *m_context },
+    m_sweepTimer { *m_context },
+    m_presenceTimer { *m_context },
+    m_handshakeTimer { *m_context },
+    m_service { std::make_shared<chat::RoomService>() },
+    m_configPath { std::move(config) }
 {
     this->SetupSSL();
+    const auto handedOver { this->SetupAcceptor(port) };
+
+    if (m_config.max_connections) {
+        // the global limit is shared by all servers of the process, the first one sets it
+        net::Admission::Limits limits;
+        limits.m_maxConnections = m_config.max_connections;
+        const auto global { net::Admission::Global() };
+        if (!global->ClaimLimits(limits) && global->GetLimits().m_maxConnections != limits.m_maxConnections) {
+            this->Write(LogType::warning, 
+                "Server kept the process connection limit:", global->GetLimits().m_maxConnections, '\n'
+            );
+        }
+    }
+    net::Admission::Limits limits;
+    limits.m_maxConnections = m_config.listener_max_connections;
+    limits.m_maxHandshakes = m_config.max_handshakes;
+    limits.m_maxWaitingHandshakes = m_config.handshake_queue;
+    m_admission = std::make_shared<net::Admission>(limits, net::Admission::Global());
+    if (m_config.max_handshakes && m_config.handshake_queue && m_config.handshake_timeout) {
+        this->ExpireHandshakes();
+    }
+    if (m_config.handshake_threads) {
+        m_handshakePool = std::make_unique<asio::thread_pool>(m_config.handshake_threads);
+    }
+    m_inboundPolicy = std::make_shared<net::InboundPolicy>();
+    m_inboundPolicy->m_maxFrameSize = m_config.max_frame_size;
+    m_inboundPolicy->m_frameTimeout = m_config.frame_timeout;
+    m_inboundPolicy->m_byteRate = m_config.inbound_byte_rate;
+    m_memoryBudget = std::make_shared<net::MemoryBudget>(m_config.memory_budget);
+    m_service->SetMemoryBudget(m_memoryBudget);
+    m_service->SetHistoryLimit(m_config.history_size);
+    // history is the first to go when the memory is over budget
+    m_memoryBudget->SetTrimmer([service = std::weak_ptr<chat::RoomService>(m_service)]() {
+        if (const auto shared { service.lock() }; shared) {
+            shared->TrimHistory();
+        }
+    });
+    if (m_config.resume_timeout) {
+        m_service->SetResumeRegistry(std::make_shared<chat::ResumeRegistry>(
+            std::chrono::milliseconds(m_config.resume_timeout)
+        ));
+        this->SweepChatrooms();
+    }
+    if (m_config.memory_budget) {
+        this->WatchMemory();
+    }
+    if (m_config.presence_interval) {
+        m_service->EnablePresence(m_config.presence_full_limit);
+        this->FlushPresence();
+    }
+    
+    chat::FanoutPolicy fanout;
+    fanout.m_executor = m_context->get_executor();
+    fanout.m_threshold = m_config.fanout_threshold;
+    fanout.m_chunkSize = m_config.fanout_chunk_size;
+    m_service->SetFanoutPolicy(std::move(fanout));
+    m_service->SetChatroomCapacity(m_config.chatroom_capacity);
+    // every admitted connection waits in the hall: the admission limits it
+    m_service->SetHallCapacity(m_config.listener_max_connections);
+    m_service->SetCompressionThreshold(m_config.compression_threshold);
+
+    if (m_config.connection_pool_size) {
+        net::ConnectionPool::Limits limits;
+        limits.m_maxIdle = m_config.connection_pool_size;
+        limits.m_maxRetainedBytes = m_config.connection_pool_buffer_bytes;
+        m_pool = std::make_shared<net::ConnectionPool>(limits);
+    }
+    // the chatrooms are restored with the settings above
+    if (!handedOver.empty()) {
+        this->RestoreState(handedOver);
+    }
+
+    if (!m_config.node_id.empty()) {
+        this->SetupFederation();
+    }
+    if (!m_config.handoff_path.empty()) {
+        this->AcceptHandoff();
+    }
 }
 
 void Server::SetupSSL() {
@@ -86,7 +338,7 @@ void Server::SetupSSL() {
     );
 
     try {
-        m_config.LoadConfig();
+        m_config.LoadConfig(m_configPath);
         m_sslContext->use_certificate_chain_file(m_config.certificate_chain_file);
         m_sslContext->use_private_key_file(m_config.private_key_file, boost::asio::ssl::context::pem);
         m_sslContext->use_tmp_dh_file(m_config.tmp_dh_file);
@@ -96,6 +348,390 @@ void Server::SetupSSL() {
         this->Write(LogType::error, "SetupSSL failed:", e.what(), '\n'); 
         exit(1);
     }
+
+    if (m_config.enable_ktls) {
+        this->SetupKernelTLS();
+    }
+}
+
+void Server::SetupKernelTLS() {
+#ifdef CHAT_HAS_KERNEL_TLS
+    if (net::IsKernelTlsAvailable()) {
+        ConsoleLog("Enable kernel TLS offload\n");
+        net::EnableKernelTls(m_sslContext->native_handle());
+        return;
+    }
+    ConsoleLog("[WARNING] Kernel has no tls ULP, keep user space TLS\n");
+    this->Write(LogType::warning, "kTLS requested but the kernel module is missing\n");
+#else
+    ConsoleLog("[WARNING] kTLS isn't supported by this transport, keep user space TLS\n");
+    this->Write(LogType::warning, "kTLS requested but the transport doesn't support it\n");
+#endif
+}
+
+void Server::SetupFederation() {
+    if (m_config.federation_secret.empty()) {
+        // anybody could join the federation
+        ConsoleLog("[ERROR] Federation requires federation_secret, the node stays standalone\n");
+        this->Write(LogType::error, "Federation isn't enabled: the secret is empty\n");
+        return;
+    }
+    ConsoleLog("Join federation as node: ", m_config.node_id, '\n');
+    m_federation = std::make_shared<chat::Federation>(m_config.node_id, m_config.federation_secret);
+    m_federation->SetDelivery([service = std::weak_ptr<chat::RoomService>(m_service)](
+        const std::string& room, 
+        const std::string& message
+    ) {
+        if (auto shared = service.lock(); shared) {
+            shared->DeliverRelayed(room, message);
+        }
+    });
+    m_service->SetFederation(m_federation);
+
+    // peers present the same certificate as this node
+    m_peerSslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+    try {
+        m_peerSslContext->load_verify_file(m_config.certificate_chain_file);
+        m_peerSslContext->set_verify_mode(boost::asio::ssl::verify_peer);
+    }
+    catch (std::exception const & e) {
+        // don't send the secret to a peer which isn't verified
+        ConsoleLog("[ERROR] Peer links can't verify certificate, they aren't opened: ", e.what(), '\n');
+        this->Write(LogType::error, "Peer links can't verify certificate:", e.what(), '\n'); 
+        return;
+    }
+
+    std::string_view peers { m_config.federation_peers };
+    while (!peers.empty()) {
+        const auto separator { peers.find(',') };
+        auto peer { peers.substr(0, separator) };
+        peers.remove_prefix(separator == std::string_view::npos? peers.size(): separator + 1);
+        while (!peer.empty() && peer.front() == ' ') peer.remove_prefix(1);
+        while (!peer.empty() && peer.back() == ' ') peer.remove_suffix(1);
+        const auto colon { peer.rfind(':') };
+        if (colon == std::string_view::npos) {
+            ConsoleLog("[WARNING] Peer without port: ", peer, '\n');
+            continue;
+        }
+        auto link { std::make_shared<chat::PeerLink>(
+            *m_context
+            , m_peerSslContext
+            , m_federation
+            , std::string(peer.substr(0, colon))
+            , std::string(peer.substr(colon + 1))) 
+        };
+        link->Connect();
+        m_peers.push_back(std::move(link));
+    }
+}
+
+std::string Server::SetupAcceptor(std::uint16_t port) {
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+    if (!m_config.handoff_path.empty()) {
+        if (auto handoff = net::RequestHandoff(m_config.handoff_path); handoff) {
+            ConsoleLog("Took over the listening socket from the running server\n");
+            this->Write(LogType::info, "Took over the listening socket, state:", handoff->m_state.size(), "bytes\n");
+            m_acceptor.emplace(*m_context);
+            m_acceptor->assign(asio::ip::tcp::v4(), handoff->m_listener);
+            return std::move(handoff->m_state);
+        }
+    }
+#endif
+    const asio::ip::tcp::endpoint endpoint { asio::ip::tcp::v4(), port };
+#ifdef CHAT_LOOPBACK_TRANSPORT
+    m_acceptor.emplace(*m_context, endpoint);
+#else
+    m_acceptor.emplace(*m_context);
+    m_acceptor->open(endpoint.protocol());
+    // To avoid exception compiling with github actions:
+    // C++ exception with description "bind: Address already in use"
+    m_acceptor->set_option(asio::ip::tcp::acceptor::reuse_address(true));
+    m_acceptor->bind(endpoint);
+    // connect storms overflow the small backlog: SYNs are dropped and clients 
+    // retransmit after a second
+    m_acceptor->listen(m_config.listen_backlog? 
+        static_cast<int>(m_config.listen_backlog): 
+        asio::socket_base::max_listen_connections
+    );
+#endif
+    return {};
+}
+
+void Server::AcceptHandoff() {
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+    if (!m_handoffAcceptor) {
+        // the path is left by the previous server (or by the crashed one)
+        std::remove(m_config.handoff_path.c_str());
+        m_handoffAcceptor.emplace(*m_context, asio::local::stream_protocol::endpoint(m_config.handoff_path));
+        // the listening socket and the state go to the same user only
+        if (::chmod(m_config.handoff_path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+            this->Write(LogType::error, "Failed to restrict access to the handoff path\n");
+        }
+    }
+    m_handoffSocket.emplace(*m_context);
+    m_handoffAcceptor->async_accept(*m_handoffSocket, [this](const boost::system::error_code& code) {
+        if (code) {
+            return;
+        }
+        boost::system::error_code error;
+        ucred peer {};
+        socklen_t length { sizeof(peer) };
+        if (::getsockopt(m_handoffSocket->native_handle(), SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 
+            || peer.uid != ::geteuid()
+        ) {
+            this->Write(LogType::error, "Refused the handoff to another user\n");
+            m_handoffSocket->close(error);
+            this->AcceptHandoff();
+            return;
+        }
+        m_handoffSocket->native_non_blocking(false, error);
+        if (!net::SendHandoff(m_handoffSocket->native_handle(), m_acceptor->native_handle(), this->SaveState())) {
+            this->Write(LogType::error, "Failed to hand over the listening socket\n");
+            this->AcceptHandoff();
+            return;
+        }
+        m_handoffSocket->close(error);
+        this->Drain();
+    });
+#else
+    this->Write(LogType::warning, "Handoff of the listening socket isn't supported\n");
+#endif
+}
+
+void Server::WatchMemory() {
+    m_memoryTimer.expires_after(std::chrono::milliseconds(std::max<std::size_t>(m_config.memory_check_interval, 1)));
+    m_memoryTimer.async_wait([this](const boost::system::error_code& code) {
+        if (code) {
+            return;
+        }
+        if (m_memoryBudget->IsOverBudget()) {
+            const auto before { m_memoryBudget->GetStats() };
+            m_memoryBudget->Shed();
+            this->Write(LogType::warning, 
+                "Memory is over budget:", before.m_total, "of", before.m_budget, "bytes, shed load\n"
+            );
+        }
+        this->WatchMemory();
+    });
+}
+
+void Server::SweepChatrooms() {
+    m_sweepTimer.expires_after(std::chrono::milliseconds(m_config.resume_timeout));
+    m_sweepTimer.async_wait([this](const boost::system::error_code& code) {
+        if (code) {
+            return;
+        }
+        const auto timeout { std::chrono::milliseconds(m_config.resume_timeout) };
+        if (const auto removed { m_service->RemoveAbandonedChatrooms(timeout) }; removed) {
+            this->Write(LogType::info, "Removed", removed, "abandoned chatrooms\n");
+        }
+        this->SweepChatrooms();
+    });
+}
+
+void Server::FlushPresence() {
+    m_presenceTimer.expires_after(std::chrono::milliseconds(m_config.presence_interval));
+    m_presenceTimer.async_wait([this](const boost::system::error_code& code) {
+        if (code) {
+            return;
+        }
+        (void) m_service->FlushPresence();
+        this->FlushPresence();
+    });
+}
+
+void Server::ExpireHandshakes() {
+    // a queued handshake is dropped at most a quarter of the timeout late
+    m_handshakeTimer.expires_after(std::chrono::milliseconds(std::max<std::size_t>(m_config.handshake_timeout / 4, 1)));
+    m_handshakeTimer.async_wait([this](const boost::system::error_code& code) {
+        if (code) {
+            return;
+        }
+        if (const auto dropped { m_admission->DropExpiredHandshakes() }; dropped) {
+            this->Write(LogType::warning, "Server dropped", dropped, "handshakes expired in the queue\n");
+        }
+        this->ExpireHandshakes();
+    });
+}
+
+void Server::Drain() {
+    ConsoleLog("Handed over the listening socket, drain connections\n");
+    this->Write(LogType::info, "Handed over the listening socket, drain connections\n");
+    m_isDraining = true;
+    boost::system::error_code error;
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+    // The next server owns own descriptor of the socket. 
+    // `close()` would leave the socket registered in the reactor 
+    // while the descriptor in flight keeps it open.
+    if (const auto listener { m_acceptor->release(error) }; !error) {
+        ::close(listener);
+    }
+    else {
+        m_acceptor->close(error);
+    }
+    // the path belongs to the next server from now on
+    m_handoffAcceptor->close(error);
+#else
+    m_acceptor->close(error);
+#endif
+    if (m_config.handoff_drain_timeout) {
+        m_drainTimer.expires_after(std::chrono::seconds(m_config.handoff_drain_timeout));
+        m_drainTimer.async_wait([this](const boost::system::error_code& code) {
+            if (!code) {
+                // clients reconnect to the next server
+                m_service->Close();
+            }
+        });
+    }
+}
+
+std::string Server::SaveState() const {
+    using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+    const auto writeString = [](Writer& writer, const std::string& text) {
+        writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+    };
+    rapidjson::StringBuffer buffer;
+    Writer writer { buffer };
+    writer.StartObject();
+    writer.Key("chatrooms");
+    writer.StartArray();
+    for (const auto& chatroom: m_service->SaveChatrooms()) {
+        writer.StartObject();
+        writer.Key("id");
+        writer.Uint64(chatroom.m_id);
+        writer.Key("name");
+        writeString(writer, chatroom.m_name);
+        writer.Key("seq");
+        writer.Uint64(chatroom.m_sequence);
+        writer.Key("history");
+        writer.StartArray();
+        for (const auto& [sequence, frame]: chatroom.m_history) {
+            writer.StartObject();
+            writer.Key("seq");
+            writer.Uint64(sequence);
+            writer.Key("frame");
+            writeString(writer, frame);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    // the parked sessions resume on the next server
+    if (const auto registry { m_service->GetResumeRegistry() }; registry) {
+        writer.Key("sessions");
+        writer.StartArray();
+        for (const auto& [token, state, remaining]: registry->Save()) {
+            writer.StartObject();
+            writer.Key("token");
+            writeString(writer, token);
+            writer.Key("name");
+            writeString(writer, state.m_username);
+            writer.Key("current");
+            writer.Uint64(state.m_current);
+            writer.Key("remaining");
+            writer.Uint64(static_cast<std::uint64_t>(remaining.count()));
+            writer.Key("chatrooms");
+            writer.StartArray();
+            for (const auto& [id, sequence]: state.m_chatrooms) {
+                writer.StartObject();
+                writer.Key("id");
+                writer.Uint64(id);
+                writer.Key("seq");
+                writer.Uint64(sequence);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+        writer.EndArray();
+    }
+    // session tickets issued by this server stay valid for the next one
+    unsigned char keys[80] {};
+    if (SSL_CTX_get_tlsext_ticket_keys(m_sslContext->native_handle(), keys, sizeof(keys)) == 1) {
+        std::ostringstream hex;
+        hex << std::hex << std::setfill('0');
+        for (const auto byte: keys) {
+            hex << std::setw(2) << static_cast<int>(byte);
+        }
+        writer.Key("ticket_keys");
+        writeString(writer, hex.str());
+    }
+    writer.EndObject();
+    return { buffer.GetString(), buffer.GetSize() };
+}
+
+void Server::RestoreState(const std::string& state) {
+    rapidjson::Document doc;
+    if (doc.Parse(state.c_str()).HasParseError() || !doc.IsObject()) {
+        this->Write(LogType::error, "Handed over state is malformed\n");
+        return;
+    }
+    const auto getUint64 = [](const rapidjson::Value& value, const char* key) -> std::uint64_t {
+        return value.HasMember(key) && value[key].IsUint64()? value[key].GetUint64(): 0;
+    };
+    if (doc.HasMember("chatrooms") && doc["chatrooms"].IsArray()) {
+        std::vector<chat::SavedChatroom> chatrooms;
+        for (const auto& room: doc["chatrooms"].GetArray()) {
+            if (!room.IsObject() || !room.HasMember("name") || !room["name"].IsString()) {
+                continue;
+            }
+            chat::SavedChatroom chatroom {};
+            chatroom.m_id = getUint64(room, "id");
+            chatroom.m_name = room["name"].GetString();
+            chatroom.m_sequence = getUint64(room, "seq");
+            if (room.HasMember("history") && room["history"].IsArray()) {
+                for (const auto& entry: room["history"].GetArray()) {
+                    if (entry.IsObject() && entry.HasMember("frame") && entry["frame"].IsString()) {
+                        chatroom.m_history.emplace_back(getUint64(entry, "seq"), 
+                            std::string(entry["frame"].GetString(), entry["frame"].GetStringLength())
+                        );
+                    }
+                }
+            }
+            chatrooms.push_back(std::move(chatroom));
+        }
+        const auto count { chatrooms.size() };
+        const auto restored { m_service->RestoreChatrooms(std::move(chatrooms)) };
+        this->Write(LogType::info, "Restored", restored, "of", count, "chatrooms\n");
+    }
+    const auto registry { m_service->GetResumeRegistry() };
+    if (registry && doc.HasMember("sessions") && doc["sessions"].IsArray()) {
+        std::vector<chat::ResumeRegistry::Parked> sessions;
+        for (const auto& session: doc["sessions"].GetArray()) {
+            if (!session.IsObject() || !session.HasMember("token") || !session["token"].IsString()
+                || !session.HasMember("name") || !session["name"].IsString()
+            ) {
+                continue;
+            }
+            chat::ResumeRegistry::Parked parked {};
+            parked.m_token = session["token"].GetString();
+            parked.m_state.m_username = session["name"].GetString();
+            parked.m_state.m_current = getUint64(session, "current");
+            parked.m_remaining = std::chrono::milliseconds(getUint64(session, "remaining"));
+            if (session.HasMember("chatrooms") && session["chatrooms"].IsArray()) {
+                for (const auto& room: session["chatrooms"].GetArray()) {
+                    if (room.IsObject()) {
+                        parked.m_state.m_chatrooms.emplace_back(getUint64(room, "id"), getUint64(room, "seq"));
+                    }
+                }
+            }
+            sessions.push_back(std::move(parked));
+        }
+        registry->Restore(std::move(sessions));
+    }
+    if (doc.HasMember("ticket_keys") && doc["ticket_keys"].IsString()) {
+        const std::string hex { doc["ticket_keys"].GetString() };
+        unsigned char keys[80] {};
+        if (hex.size() == 2 * sizeof(keys)) {
+            for (std::size_t i = 0; i < sizeof(keys); i++) {
+                keys[i] = static_cast<unsigned char>(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+            }
+            if (SSL_CTX_set_tlsext_ticket_keys(m_sslContext->native_handle(), keys, sizeof(keys)) != 1) {
+                this->Write(LogType::warning, "Failed to restore session ticket keys\n");
+            }
+        }
+    }
 }
 
 std::string Server::PasswordCallback(
@@ -107,51 +743,144 @@ std::string Server::PasswordCallback(
 }
 
 void Server::Start() {
-    m_socket.emplace(*m_context);
-    m_acceptor.set_option(
-        // To avoid exception compiling with github actions:
-        // C++ exception with description "bind: Address already in use"
-        asio::ip::tcp::acceptor::reuse_address(true)
-    );
-
-    m_acceptor.async_accept(*m_socket, [this](const boost::system::error_code& code) {
-        if (!code) {
-            boost::system::error_code err; 
-            this->Write(LogType::info, 
-                "Server accepted connection on endpoint:", m_socket->remote_endpoint(err), '\n'
-            ); 
-
-            // Session won't live more than room service cuz service was destroyed or closed
-            // when all sessions had been closed.
-            const auto session { std::make_shared<Session>(
-                std::move(*m_socket)
-                , m_service
-                , m_context
-                , m_sslContext) };
-
-            if (m_service->AddSession(session)) {
-				session->Subscribe();
-				// if handshake failed the session will be closed 
-				// and removed from the room
-				session->Handshake();
-            }
-			else {
-				// TODO: failed to add new session most likely due to connection limit 
-			}
+    if (m_isDraining) {
+        return;
+    }
+    const std::size_t concurrency { std::max<std::size_t>(m_config.accept_concurrency, 1) };
+    for (std::size_t i = 0; i < concurrency; i++) {
+        this->Accept();
+    }
+}
 
-            // wait for the new connections again
-            this->Start();
+void Server::Accept() {
+    if (m_isDraining || !m_acceptor->is_open()) {
+        return;
+    }
+    auto socket { std::make_shared<net::Socket_t>(*m_context) };
+    m_acceptor->async_accept(*socket, [this, socket](const boost::system::error_code& code) {
+        if (code == asio::error::operation_aborted) {
+            // shutdown or handoff
+            return;
+        }
+        if (code) {
+            this->Write(LogType::error, 
+                "Server failed to accept connection:", code.message(), '\n'
+            );
+            // e.g. out of descriptors: give the closing sessions time
+            // instead of spinning on the failing accept
+            auto timer { std::make_shared<asio::steady_timer>(
+                *m_context, 
+                std::chrono::milliseconds(ACCEPT_RETRY_DELAY_MS)) 
+            };
+            timer->async_wait([this, timer](const boost::system::error_code& error) {
+                if (!error) {
+                    this->Accept();
+                }
+            });
+            return;
         }
+        boost::system::error_code err; 
+        this->Write(LogType::info, 
+            "Server accepted connection on endpoint:", socket->remote_endpoint(err), '\n'
+        ); 
+        this->Admit(std::move(*socket));
+        // wait for the new connections again
+        this->Accept();
     });
 }
 
+void Server::Admit(net::Socket_t&& socket) {
+    auto ticket { m_admission->Admit() };
+    if (!ticket) {
+        // refuse before any TLS work is spent on the connection
+        this->Write(LogType::warning, "Server refused connection: admission limit is reached\n");
+        boost::system::error_code error;
+        socket.close(error);
+        return;
+    }
+
+    // Session won't live more than room service cuz service was destroyed or closed
+    // when all sessions had been closed.
+    const auto session { m_pool? 
+        m_pool->MakeShared<Session>(
+            std::move(socket)
+            , m_service
+            , m_context
+            , m_sslContext
+            , m_pool) :
+        std::make_shared<Session>(
+            std::move(socket)
+            , m_service
+            , m_context
+            , m_sslContext) };
+    session->SetAdmissionTicket(std::move(ticket));
+    session->SetInboundPolicy(m_inboundPolicy);
+
+    if (!m_service->AddSession(session)) {
+        this->Write(LogType::error, "Server failed to add session, close it\n");
+        session->Close();
+        return;
+    }
+    session->Subscribe();
+    asio::any_io_executor executor {};
+    if (m_handshakePool) {
+        executor = m_handshakePool->get_executor();
+    }
+    // the time spent in the queue counts: the handshake is over by the deadline
+    const auto timeout { std::chrono::milliseconds(m_config.handshake_timeout) };
+    const auto deadline { timeout.count()? 
+        net::Admission::Clock::now() + timeout : net::Admission::Clock::time_point::max() 
+    };
+    const bool isQueued { m_admission->BeginHandshake(
+        [session, executor, admission = m_admission, timeout, deadline]() {
+            auto left { timeout };
+            if (timeout.count()) {
+                left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - net::Admission::Clock::now()
+                );
+                left = std::max(left, std::chrono::milliseconds(1));
+            }
+            // if handshake failed the session will be closed 
+            // and removed from the room
+            session->Handshake(left.count(), [admission](const boost::system::error_code&) {
+                admission->FinishHandshake();
+            }, executor);
+        }, 
+        deadline, 
+        [session]() {
+            session->Close();
+        }) 
+    };
+    if (!isQueued) {
+        this->Write(LogType::warning, "Server refused connection: handshake queue is full\n");
+        session->Close();
+        return;
+    }
+}
+
 void Server::Shutdown() {
     boost::system::error_code error;
-    m_acceptor.close(error);
+    m_acceptor->close(error);
     if (error) {
         this->Write(LogType::error, 
             "Server closed acceptor with error:", error.message(), '\n'
         );
     }
+    m_drainTimer.cancel();
+    m_memoryTimer.cancel();
+    m_sweepTimer.cancel();
+    m_presenceTimer.cancel();
+    m_handshakeTimer.cancel();
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+    if (m_handoffAcceptor) {
+        m_handoffAcceptor->close(error);
+    }
+#endif
+    for (auto& peer: m_peers) {
+        peer->Close();
+    }
+    if (m_federation) {
+        m_federation->Close();
+    }
     m_service->Close();
 }
\ No newline at end of file
@@ -1,24 +1,39 @@
 ﻿#ifndef SERVER_HPP
 #define SERVER_HPP
 
+#include <atomic>
 #include <memory>   // std::shared_ptr
 #include <optional>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
 #include "Log.hpp"
+#include "Transport.hpp"
+#include "Handoff.hpp"
+#include "Admission.hpp"
+#include "InboundPolicy.hpp"
+#include "MemoryAccount.hpp"
 
 namespace asio = boost::asio;
 
 namespace chat {
     class RoomService;
+    class Federation;
+    class PeerLink;
+}
+
+namespace net {
+    class ConnectionPool;
 }
 
 class Server final {
 public:
+
+    static constexpr const char * DEFAULT_CONFIG { "settings/server.cfg" };
     
     /**
      * Server's constructor with external io context;
@@ -26,10 +41,14 @@ public:
      *  Pointer to external io_context instance.
      * @param port
      *  This is a port the server will listen to.
+     * @param config
+     *  Path to the config file. Nodes of a federation run on the same host 
+     *  with the different configs.
      */
     Server(
         std::shared_ptr<asio::io_context> io, 
-        std::uint16_t port
+        std::uint16_t port,
+        std::string config = DEFAULT_CONFIG
     );
 
     /**
@@ -42,11 +61,45 @@ public:
      */
     void Shutdown();
 
+    /**
+     * The listening socket was handed over to the next server process.
+     * Accepted connections are still served until they're closed 
+     * or the drain timeout expired.
+     */
+    bool IsDraining() const noexcept {
+        return m_isDraining;
+    }
+
     /**
      * Used for testing 
      */
     std::shared_ptr<chat::RoomService> GetRoomService() const;
 
+    /**
+     * Used for testing. nullptr if `node_id` isn't configured.
+     */
+    std::shared_ptr<chat::Federation> GetFederation() const;
+
+    /**
+     * Used for testing. Admission control of this listener.
+     */
+    std::shared_ptr<net::Admission> GetAdmission() const;
+
+    /**
+     * Used for testing. Limits and violation counters of the inbound data.
+     */
+    std::shared_ptr<net::InboundPolicy> GetInboundPolicy() const;
+
+    /**
+     * Bytes held by the connections (by category) and the load shed so far.
+     */
+    net::MemoryBudget::Stats GetMemoryStats() const;
+
+    /**
+     * Delay before accepting again after the accept failed (e.g. out of descriptors).
+     */
+    static constexpr std::uint64_t ACCEPT_RETRY_DELAY_MS { 100 };
+
 private:
 
     struct Config final {
@@ -54,15 +107,218 @@ private:
         std::string certificate_chain_file;
         std::string private_key_file;
         std::string tmp_dh_file;
+        /**
+         * Opt-in: install the negotiated keys into the kernel (kTLS) after 
+         * the handshake and send plain data to the socket. Only TLS 1.3 
+         * connections are offloaded. Ignored when the kernel has no `tls` ULP.
+         */
+        bool enable_ktls { false };
+        /**
+         * Broadcasts to chatrooms with at least this number of subscribers
+         * are split into chunks posted across the io threads. Zero disables it.
+         */
+        std::size_t fanout_threshold { 1024 };
+        /**
+         * Number of subscribers delivered by one chunk.
+         */
+        std::size_t fanout_chunk_size { 256 };
+        /**
+         * Members each chatroom accepts. Zero means no limit.
+         */
+        std::size_t chatroom_capacity { 0 };
+        /**
+         * Number of closed connection shells kept for reuse. Zero disables the pool.
+         */
+        std::size_t connection_pool_size { 256 };
+        /**
+         * Buffers of a closed connection which grew beyond this number of bytes
+         * are released instead of kept in the pool.
+         */
+        std::size_t connection_pool_buffer_bytes { 64 * 1024 };
+        /**
+         * Frames of at least this size are compressed for the clients 
+         * which asked for it in SYN. Zero disables compression.
+         */
+        std::size_t compression_threshold { 1024 };
+        /**
+         * ID of this node in the federation. Empty disables federation.
+         */
+        std::string node_id;
+        /**
+         * Peer nodes must present the same secret in hello. 
+         * Federation isn't enabled while it's empty.
+         */
+        std::string federation_secret;
+        /**
+         * Comma separated `host:port` of the peer nodes this node connects to.
+         * Each pair of nodes is linked once, so list the peer on one side only.
+         */
+        std::string federation_peers;
+        /**
+         * Unix socket on which the server hands the listening socket over 
+         * to the next process started with the same path. Empty disables it.
+         */
+        std::string handoff_path;
+        /**
+         * Seconds the connections are served after the handoff. 
+         * Zero keeps them until the clients close them.
+         */
+        std::size_t handoff_drain_timeout { 0 };
+        /**
+         * Number of accept operations kept outstanding on the listening socket.
+         */
+        std::size_t accept_concurrency { 4 };
+        /**
+         * Backlog of the listening socket. Zero means the system maximum (SOMAXCONN).
+         */
+        std::size_t listen_backlog { 0 };
+        /**
+         * Connections of all listeners of the process, set by the first server 
+         * which has it. Zero means no limit.
+         */
+        std::size_t max_connections { 0 };
+        /**
+         * Connections of this listener, the hall's capacity as well. Zero means no limit.
+         */
+        std::size_t listener_max_connections { 0 };
+        /**
+         * TLS handshakes in progress at once. Zero means no limit.
+         */
+        std::size_t max_handshakes { 64 };
+        /**
+         * Accepted connections waiting for the handshake slot. 
+         * The rest are closed before any TLS work is done.
+         */
+        std::size_t handshake_queue { 1024 };
+        /**
+         * Milliseconds the client has to finish the handshake. Zero means no deadline.
+         */
+        std::size_t handshake_timeout { 10000 };
+        /**
+         * Threads doing the TLS key exchange of the accepted connections apart 
+         * from the io threads serving established ones. Zero runs handshakes on the io threads.
+         */
+        std::size_t handshake_threads { 2 };
+        /**
+         * Largest frame a client may send, in bytes. Zero means no limit.
+         */
+        std::size_t max_frame_size { 1024 * 1024 };
+        /**
+         * Milliseconds the rest of a started frame may take. Zero means no deadline.
+         */
+        std::size_t frame_timeout { 10000 };
+        /**
+         * Bytes per second a client may send on average. Zero means no budget.
+         */
+        std::size_t inbound_byte_rate { 0 };
+        /**
+         * Bytes the connections may hold together before the server sheds load. 
+         * Zero means no limit (memory is still accounted).
+         */
+        std::size_t memory_budget { 0 };
+        /**
+         * Milliseconds between the checks of the memory budget.
+         */
+        std::size_t memory_check_interval { 100 };
+        /**
+         * Messages each chatroom keeps for the resumed sessions.
+         */
+        std::size_t history_size { 256 };
+        /**
+         * Milliseconds the disconnected session can be resumed. Zero disables resumption.
+         */
+        std::size_t resume_timeout { 30000 };
+        /**
+         * Milliseconds the chatroom collects joins, leaves and renames 
+         * before it sends them to the members as one delta. Zero disables presence.
+         */
+        std::size_t presence_interval { 200 };
+        /**
+         * Chatrooms with more members send only the member count.
+         */
+        std::size_t presence_full_limit { 64 };
 
-        void LoadConfig();
-
-    private:
-        const char *PATH = "settings/server.cfg";
+        void LoadConfig(const std::string& path);
     };
 
     void SetupSSL();
 
+    /**
+     * Create federation and start connecting to the configured peers.
+     */
+    void SetupFederation();
+
+    /**
+     * Take over the listening socket from the running server if there is one,
+     * otherwise listen to the @port.
+     * @return
+     *  State handed over by the running server (see `RestoreState`), 
+     *  empty if there was none.
+     */
+    std::string SetupAcceptor(std::uint16_t port);
+
+    /**
+     * Keep one accept operation outstanding. 
+     * `Start` runs `accept_concurrency` of them.
+     */
+    void Accept();
+
+    /**
+     * Admit the accepted connection: refuse it over the connection limit, 
+     * otherwise create the session and queue its handshake.
+     */
+    void Admit(net::Socket_t&& socket);
+
+    /**
+     * Wait for the next server process asking for the listening socket. 
+     * Only the processes of the same user get it.
+     */
+    void AcceptHandoff();
+
+    /**
+     * Periodically shed load while the memory is over budget.
+     */
+    void WatchMemory();
+
+    /**
+     * Periodically remove chatrooms abandoned by the disconnected sessions 
+     * which didn't resume in time.
+     */
+    void SweepChatrooms();
+
+    /**
+     * Periodically send the collected membership changes of the chatrooms.
+     */
+    void FlushPresence();
+
+    /**
+     * Periodically close the queued handshakes whose deadline has passed 
+     * while no handshake slot was released.
+     */
+    void ExpireHandshakes();
+
+    /**
+     * Stop accepting connections after the handoff.
+     */
+    void Drain();
+
+    /**
+     * Serialize state passed to the next server process (see `net::Handoff`).
+     */
+    std::string SaveState() const;
+
+    /**
+     * Create the chatrooms under their IDs and park the sessions 
+     * saved by the previous server. Must be called before any chatroom is created.
+     */
+    void RestoreState(const std::string& state);
+
+    /**
+     * Make the connections ready for kTLS if the kernel supports it.
+     * Otherwise leave the record layer in user space.
+     */
+    void SetupKernelTLS();
+
     std::string PasswordCallback(
         std::size_t max_length,  // The maximum size for a password.
         // Whether password is for reading or writing.
@@ -90,16 +346,69 @@ private:
     
     std::shared_ptr<asio::ssl::context> m_sslContext;
 
-    asio::ip::tcp::acceptor m_acceptor;
-
     /**
-     * Optionality gives us a mechanism to create socket inplace after moving it 
-     * to accepter's handler.  
+     * Created after the config is loaded: either bound to the port 
+     * or taken over from the previous server process.
      */
-    std::optional<asio::ip::tcp::socket> m_socket;
+    std::optional<net::Acceptor_t> m_acceptor;
+
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+    std::optional<asio::local::stream_protocol::acceptor> m_handoffAcceptor;
+
+    std::optional<asio::local::stream_protocol::socket> m_handoffSocket;
+#endif
+
+    asio::steady_timer m_drainTimer;
+
+    asio::steady_timer m_memoryTimer;
+
+    asio::steady_timer m_sweepTimer;
+
+    asio::steady_timer m_presenceTimer;
+
+    asio::steady_timer m_handshakeTimer;
+
+    std::atomic<bool> m_isDraining { false };
 
     std::shared_ptr<chat::RoomService> m_service { nullptr };
 
+    /**
+     * Recycles session & connection shells between accepts. Can be nullptr.
+     */
+    std::shared_ptr<net::ConnectionPool> m_pool { nullptr };
+
+    std::shared_ptr<chat::Federation> m_federation { nullptr };
+
+    /**
+     * Limits connections and handshakes of this listener. 
+     * Its parent is `net::Admission::Global()`.
+     */
+    std::shared_ptr<net::Admission> m_admission { nullptr };
+
+    /**
+     * Runs handshakes of the accepted connections. Can be nullptr.
+     */
+    std::unique_ptr<asio::thread_pool> m_handshakePool { nullptr };
+
+    /**
+     * Shared by all accepted connections.
+     */
+    std::shared_ptr<net::InboundPolicy> m_inboundPolicy { nullptr };
+
+    /**
+     * Accounts memory of all accepted connections.
+     */
+    std::shared_ptr<net::MemoryBudget> m_memoryBudget { nullptr };
+
+    /**
+     * Client side ssl context of the outgoing peer links.
+     */
+    std::shared_ptr<asio::ssl::context> m_peerSslContext { nullptr };
+
+    std::vector<std::shared_ptr<chat::PeerLink>> m_peers;
+
+    const std::string m_configPath;
+
     Config m_config{};
 };
 
@@ -112,4 +421,20 @@ inline std::shared_ptr<chat::RoomService> Server::GetRoomService() const {
     return m_service;
 }
 
+inline std::shared_ptr<chat::Federation> Server::GetFederation() const {
+    return m_federation;
+}
+
+inline std::shared_ptr<net::Admission> Server::GetAdmission() const {
+    return m_admission;
+}
+
+inline std::shared_ptr<net::InboundPolicy> Server::GetInboundPolicy() const {
+    return m_inboundPolicy;
+}
+
+inline net::MemoryBudget::Stats Server::GetMemoryStats() const {
+    return m_memoryBudget->GetStats();
+}
+
 #endif // SERVER_HPP
\ No newline at end of file
@@ -7,25 +7,81 @@
 #include "Chatroom.hpp"
 #include "RequestHandlers.hpp"
 #include "Connection.hpp"
+#include "ConnectionPool.hpp"
+#include "Federation.hpp"
+#include "MemoryAccount.hpp"
+#include "ResumeRegistry.hpp"
+
+#include <algorithm>
+
+namespace {
+    /**
+     * Link from the peer node over the accepted session.
+     */
+    class SessionLink final : public chat::FederationLink {
+    public:
+        explicit SessionLink(std::weak_ptr<Session> session) 
+            : m_session { std::move(session) }
+        {}
+
+        void Send(std::string frame) override {
+            if (const auto session { m_session.lock() }; session && !session->IsClosed()) {
+                session->Write(std::move(frame));
+            }
+        }
+
+        bool IsClosed() const noexcept override {
+            const auto session { m_session.lock() };
+            return !session || session->IsClosed();
+        }
+
+    private:
+        std::weak_ptr<Session> m_session;
+    };
+}
 
 Session::Session( 
-    asio::ip::tcp::socket && socket, 
+    net::Socket_t && socket, 
     std::shared_ptr<chat::RoomService> service,
     std::shared_ptr<asio::io_context> context,
-    std::shared_ptr<asio::ssl::context> sslContext
+    std::shared_ptr<asio::ssl::context> sslContext,
+    std::shared_ptr<net::ConnectionPool> pool
 ) 
     : m_service { service }
-    , m_incommingRequests { std::make_shared<rt::RequestQueue>() }
     , m_context { context }
-    , m_connection { std::make_shared<net::Connection>(
-        m_user.m_id
-        , std::move(socket)
-        , m_context.get()
-        , sslContext.get()
-        , m_incommingRequests
-    )}
 {
     m_user.m_chatroom = chat::Chatroom::NO_ROOM;
+    if (pool) {
+        auto buffers { pool->AcquireBuffers() };
+        m_incommingRequests = std::shared_ptr<rt::RequestQueue>(buffers, &buffers->m_requests);
+        m_connection = pool->MakeShared<net::Connection>(
+            m_user.m_id
+            , std::move(socket)
+            , m_context.get()
+            , sslContext.get()
+            , std::move(buffers)
+            , pool->GetLogger()
+        );
+    }
+    else {
+        auto buffers { std::make_shared<net::IOBuffers>() };
+        m_incommingRequests = std::shared_ptr<rt::RequestQueue>(buffers, &buffers->m_requests);
+        m_connection = std::make_shared<net::Connection>(
+            m_user.m_id
+            , std::move(socket)
+            , m_context.get()
+            , sslContext.get()
+            , std::move(buffers)
+        );
+    }
+    if (const auto budget { m_service->GetMemoryBudget() }; budget) {
+        m_memory = budget->OpenAccount([connection = std::weak_ptr<net::Connection>(m_connection)]() {
+            if (const auto shared { connection.lock() }; shared) {
+                shared->Close();
+            }
+        });
+        m_connection->SetMemoryAccount(m_memory);
+    }
 }
 
 void Session::Close() {
@@ -34,6 +90,11 @@ void Session::Close() {
     // m_connection.reset();
 }
 
+void Session::SetInboundPolicy(std::shared_ptr<net::InboundPolicy> policy) {
+    assert(m_connection && "Connection can't be nullptr");
+    m_connection->SetInboundPolicy(std::move(policy));
+}
+
 void Session::Subscribe() {
     assert(m_connection && "Connection can't be nullptr");
     // Subscribe on connection
@@ -53,20 +114,39 @@ void Session::Subscribe() {
  * 
  * NOTE: `AcquireRequests` is NOT being posted through the `strand` of the Connection so this handler
  * can be executed at the same time with handlers called from the Connection.
+ * Only one handler drains the queue at a time, otherwise the requests 
+ * of the session (e.g. chat messages) could be handled out of order by different threads.
  */
 void Session::AcquireRequests() {
+    if (m_isAcquiring.exchange(true)) {
+        // the running handler picks up the new requests
+        return;
+    }
     asio::post(*m_context, [self = this->shared_from_this()]() {
-        rt::RequestQueue buffer{};
-        self->m_incommingRequests->Swap(buffer);
-        while (!buffer.IsEmpty()) {
-            self->HandleRequest(buffer.Extract());
-        }
-        if (!self->m_incommingRequests->IsEmpty()) {
-            self->AcquireRequests();
-        }
+        do {
+            rt::RequestQueue buffer{};
+            self->m_incommingRequests->Swap(buffer);
+            while (!buffer.IsEmpty()) {
+                auto request { buffer.Extract() };
+                if (self->m_memory) {
+                    self->m_memory->Add(
+                        net::MemoryCategory::REQUESTS, 
+                        -static_cast<std::int64_t>(net::MemoryAccount::SizeOf(request))
+                    );
+                }
+                self->HandleRequest(std::move(request));
+            }
+            self->m_isAcquiring = false;
+        } while (!self->m_incommingRequests->IsEmpty() && !self->m_isAcquiring.exchange(true));
     });
 }
 
+void Session::HandleRequests(std::vector<Internal::Request>&& batch) {
+    for (auto& request: batch) {
+        this->HandleRequest(std::move(request));
+    }
+}
+
 // void Session::Read() {
 //     m_connection->Read(m_timeout, 
 //         [self = this->shared_from_this()](const boost::system::error_code& error) {
@@ -83,46 +163,236 @@ void Session::AcquireRequests() {
 // }
 
 void Session::Handshake() {
+    // the handshake may complete (and acknowledge the client) on another thread
+    m_state = State::WAIT_SYN;
     m_connection->Handshake();
+}
+
+void Session::Handshake(
+    std::uint64_t ms, 
+    std::function<void(const boost::system::error_code&)>&& done,
+    asio::any_io_executor executor
+) {
     m_state = State::WAIT_SYN;
+    m_connection->Handshake(ms, std::move(done), std::move(executor));
 }
 
 void Session::Write(std::string text) {
-    assert(m_connection && !m_connection->IsClosed());
+    // a broadcast can still reach the session which is being closed, 
+    // the connection drops the text then
+    assert(m_connection);
     m_connection->Write(std::move(text));
 }
 
 void Session::RemoveFromService() {
     assert(m_connection);
-    if (m_user.m_chatroom != chat::Chatroom::NO_ROOM) {
-        m_service->RemoveSession(this->shared_from_this());
+    if (const auto registry { m_service->GetResumeRegistry() }; registry) {
+        chat::ResumeRegistry::State state {};
+        std::string token {};
+        { // Block
+            std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+            if (!m_federationLink) {
+                token = m_resumeToken;
+                state.m_chatrooms.assign(m_subscriptions.begin(), m_subscriptions.end());
+            }
+        } // Release
+        if (!token.empty() && !state.m_chatrooms.empty()) {
+            state.m_username = m_user.m_username;
+            state.m_current = m_user.m_chatroom;
+            registry->Park(token, std::move(state));
+        }
     }
+    { // Block
+        std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+        m_isRemoved = true;
+    } // Release
+    // remove from the hall or the chatroom, and from the user index
+    m_service->RemoveSession(this->shared_from_this());
     m_state = State::CLOSED;
+    m_admissionTicket.reset();
 }
 
-bool Session::AssignChatroom(std::uint64_t id) {
-    if (m_service->AssignChatroom(id, this->shared_from_this())) {
-        m_user.m_chatroom = id;
+bool Session::UpdateUsername(std::string name) {
+    if (!m_service->ClaimUsername(m_user.m_id, name)) {
+        return false;
+    }
+    if (m_user.m_username == name) {
         return true;
     }
-    return false;
+    m_user.m_username = std::move(name);
+    // the chatrooms this user is already in see the new name,
+    // including the one just joined before the name was claimed
+    m_service->NoteRename(this->shared_from_this());
+    return true;
+}
+
+bool Session::IsUsernameAvailable(const std::string& name) const {
+    const auto userId { m_service->FindUserId(name) };
+    return !userId || *userId == m_user.m_id;
+}
+
+bool Session::SendDirectMessage(std::uint64_t userId, std::string text) {
+    const auto session { m_service->FindSession(userId) };
+    if (!session || session->IsClosed()) {
+        return false;
+    }
+    session->Write(std::move(text));
+    return true;
+}
+
+std::optional<std::uint64_t> Session::FindUserId(const std::string& name) const {
+    return m_service->FindUserId(name);
+}
+
+std::size_t Session::GetCompressionThreshold() const noexcept {
+    return m_service->GetCompressionThreshold();
+}
+
+void Session::EnableCompression(std::size_t threshold) {
+    assert(m_connection);
+    m_connection->EnableCompression(threshold);
+}
+
+std::optional<std::size_t> Session::EnablePresence() {
+    if (!m_service->IsPresenceEnabled()) {
+        return std::nullopt;
+    }
+    m_isPresenceEnabled = true;
+    return m_service->GetPresenceLimit();
+}
+
+bool Session::AssignChatroom(std::uint64_t id) {
+    { // Block
+        std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+        if (m_subscriptions.count(id) || m_subscriptions.size() >= MAX_SUBSCRIPTIONS) {
+            return false;
+        }
+    } // Release
+    // read before joining: a resumed session may get one message more, never one less
+    const auto sequence { m_service->GetSequence(id) };
+    const auto self { this->shared_from_this() };
+    const bool isJoined { m_service->AssignChatroom(id, self) };
+    bool isRemoved { false };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+        if (isJoined) {
+            m_subscriptions.emplace(id, sequence);
+            m_user.m_chatroom = id;
+        }
+        isRemoved = m_isRemoved;
+    } // Release
+    if (isRemoved) {
+        // the removal didn't see this chatroom (or the hall a failed join returned to)
+        m_service->RemoveSession(self);
+        return false;
+    }
+    return isJoined;
+}
+
+bool Session::IsSubscribed(std::uint64_t id) const {
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    return m_subscriptions.count(id) > 0;
+}
+
+std::vector<std::uint64_t> Session::GetSubscriptions() const {
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    std::vector<std::uint64_t> subscriptions;
+    subscriptions.reserve(m_subscriptions.size());
+    for (const auto& [id, sequence]: m_subscriptions) {
+        subscriptions.push_back(id);
+    }
+    return subscriptions;
+}
+
+std::string Session::IssueResumeToken() {
+    const auto registry { m_service->GetResumeRegistry() };
+    if (!registry) {
+        return {};
+    }
+    auto token { registry->Issue() };
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    m_resumeToken = token;
+    return token;
+}
+
+std::optional<std::vector<std::pair<std::uint64_t, chat::Chatroom::Replay>>> Session::Resume(
+    const std::string& token, 
+    const std::unordered_map<std::uint64_t, std::uint64_t>& sequences
+) {
+    const auto registry { m_service->GetResumeRegistry() };
+    if (!registry) {
+        return std::nullopt;
+    }
+    auto state { registry->Take(token) };
+    if (!state || (!state->m_username.empty() && !this->UpdateUsername(state->m_username))) {
+        return std::nullopt;
+    }
+    std::vector<std::pair<std::uint64_t, chat::Chatroom::Replay>> restored;
+    for (const auto& [id, since]: state->m_chatrooms) {
+        { // Block
+            std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+            if (m_subscriptions.count(id) || m_subscriptions.size() >= MAX_SUBSCRIPTIONS) {
+                continue;
+            }
+        } // Release
+        auto sequence { since };
+        if (const auto it = sequences.find(id); it != sequences.end()) {
+            sequence = std::max(sequence, it->second);
+        }
+        if (const auto replay = m_service->RejoinChatroom(id, this->shared_from_this(), sequence); replay) {
+            std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+            m_subscriptions.emplace(id, since);
+            m_user.m_chatroom = id;
+            restored.emplace_back(id, *replay);
+        }
+    }
+    bool isRemoved { false };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+        if (m_subscriptions.count(state->m_current)) {
+            m_user.m_chatroom = state->m_current;
+        }
+        isRemoved = m_isRemoved;
+    } // Release
+    if (isRemoved) {
+        // see `AssignChatroom`
+        m_service->RemoveSession(this->shared_from_this());
+        return std::nullopt;
+    }
+    return restored;
 }
 
 void Session::BroadcastOnly(
+    std::uint64_t chatroomId,
     const std::string& message, 
     std::function<bool(const Session&)>&& condition
 ) {
-    m_service->BroadcastOnly(this, message, std::move(condition));
+    m_service->BroadcastOnly(chatroomId, message, std::move(condition));
 }
 
-bool Session::LeaveChatroom() {
-    // leave current chatroom if exist
-    if (m_user.m_chatroom != chat::Chatroom::NO_ROOM) {
-        m_service->LeaveChatroom(m_user.m_chatroom, shared_from_this());
-        m_user.m_chatroom = chat::Chatroom::NO_ROOM;
-        return true;
-    }
-    return false;
+bool Session::LeaveChatroom(std::uint64_t id) {
+    bool isLastRoom { false };
+    { // Block
+        std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+        if (m_subscriptions.erase(id) == 0) {
+            return false;
+        }
+        isLastRoom = m_subscriptions.empty();
+        if (m_user.m_chatroom == id) {
+            // switch to any other chatroom
+            m_user.m_chatroom = isLastRoom? chat::Chatroom::NO_ROOM: m_subscriptions.begin()->first;
+        }
+    } // Release
+    m_service->LeaveChatroom(id, shared_from_this(), isLastRoom);
+    return true;
+}
+
+bool Session::Publish(
+    std::uint64_t chatroomId,
+    const chat::Chatroom::FrameBuilder& build, 
+    std::function<bool(const Session&)>&& condition
+) {
+    return m_service->Publish(chatroomId, build, std::move(condition));
 }
 
 std::uint64_t Session::CreateChatroom(const std::string& chatroomName) {
@@ -130,8 +400,51 @@ std::uint64_t Session::CreateChatroom(const std::string& chatroomName) {
     return roomId;
 }
 
-std::vector<std::string> Session::GetChatroomList() const noexcept {
-    return m_service->GetChatroomList();
+void Session::RemoveEmptyChatroom(std::uint64_t id) {
+    (void) m_service->RemoveEmptyChatroom(id);
+}
+
+bool Session::CanSubscribe() const {
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    return m_subscriptions.size() < MAX_SUBSCRIPTIONS;
+}
+
+std::shared_ptr<const std::string> Session::GetChatroomList() const {
+    return m_service->GetSerializedChatroomList();
+}
+
+bool Session::ShedRequest() noexcept {
+    const auto budget { m_service->GetMemoryBudget() };
+    if (!budget || !budget->IsOverBudget()) {
+        return false;
+    }
+    budget->CountRejected();
+    return true;
+}
+
+std::shared_ptr<chat::Federation> Session::GetFederation() const {
+    return m_service->GetFederation();
+}
+
+std::shared_ptr<chat::FederationLink> Session::LinkFederation() {
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    if (!m_federationLink) {
+        m_federationLink = std::make_shared<SessionLink>(this->weak_from_this());
+    }
+    return m_federationLink;
+}
+
+std::shared_ptr<chat::FederationLink> Session::GetFederationLink() const {
+    std::lock_guard<std::mutex> lock { m_subscriptionsMutex };
+    return m_federationLink;
+}
+
+std::optional<std::string> Session::GetChatroomPage(const chat::ChatroomQuery& query) const {
+    return m_service->GetChatroomPage(query);
+}
+
+std::optional<std::vector<chat::Chatroom::Member>> Session::GetMembers(std::uint64_t chatroomId) const {
+    return m_service->GetMembers(chatroomId);
 }
 
 void Session::HandleRequest(Internal::Request&& request) {
@@ -153,6 +466,18 @@ void Session::HandleRequest(Internal::Request&& request) {
         case QueryType::CHAT_MESSAGE: {
             CreateExecutor<QueryType::CHAT_MESSAGE>(&request, this)->Run();
         } break;
+        case QueryType::DIRECT_MESSAGE: {
+            CreateExecutor<QueryType::DIRECT_MESSAGE>(&request, this)->Run();
+        } break;
+        case QueryType::LIST_MEMBERS: {
+            CreateExecutor<QueryType::LIST_MEMBERS>(&request, this)->Run();
+        } break;
+        case QueryType::SYN: {
+            CreateExecutor<QueryType::SYN>(&request, this)->Run();
+        } break;
+        case QueryType::FEDERATION: {
+            CreateExecutor<QueryType::FEDERATION>(&request, this)->Run();
+        } break;
     }
     /// TODO: handle unexpected request
 }
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include <memory>
 #include <cstddef>
 #include <functional>
+#include <optional>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -13,29 +18,42 @@
 #include "Message.hpp"
 #include "User.hpp"
 #include "Log.hpp"
+#include "Transport.hpp"
+#include "Chatroom.hpp"
+#include "InstanceCounter.hpp"
 
 namespace asio = boost::asio;
 
 namespace chat {
     class Chatroom;
     class RoomService;
+    class Federation;
+    class FederationLink;
+    struct ChatroomQuery;
 }
 namespace net {
     class Connection;
+    class ConnectionPool;
+    class MemoryAccount;
+    struct InboundPolicy;
 }
 namespace rt {
     class RequestQueue;
 }
 
 // TODO: try to remove the inheritance
-class Session final : public std::enable_shared_from_this<Session> {
+class Session final : 
+    public std::enable_shared_from_this<Session>, 
+    public rt::InstanceCounter<Session> 
+{
 public:
 
     Session( 
-        asio::ip::tcp::socket && socket, 
+        net::Socket_t && socket, 
         std::shared_ptr<chat::RoomService> service,
         std::shared_ptr<asio::io_context> context,
-        std::shared_ptr<asio::ssl::context> sslContext
+        std::shared_ptr<asio::ssl::context> sslContext,
+        std::shared_ptr<net::ConnectionPool> pool = nullptr
     );
 
     ~Session() {
@@ -49,6 +67,42 @@ public:
      */
     void Handshake();
 
+    /**
+     * Initiate handshake which must be over in @ms milliseconds.
+     * @done is called when it's over, successful or not.
+     * @executor runs the key exchange (see `net::Connection::Handshake`).
+     */
+    void Handshake(
+        std::uint64_t ms, 
+        std::function<void(const boost::system::error_code&)>&& done,
+        asio::any_io_executor executor = {}
+    );
+
+    /**
+     * Limits of the data the client sends (see `net::Connection::SetInboundPolicy`).
+     */
+    void SetInboundPolicy(std::shared_ptr<net::InboundPolicy> policy);
+
+    /**
+     * Memory held by the session's connection. nullptr if the service has no budget.
+     */
+    std::shared_ptr<net::MemoryAccount> GetMemoryAccount() const noexcept {
+        return m_memory;
+    }
+
+    /**
+     * Whether a request which takes more memory (new chatroom, join) 
+     * must be refused as the server is over its memory budget. The refusal is counted.
+     */
+    bool ShedRequest() noexcept;
+
+    /**
+     * Keep the @ticket given by the admission control until the session is removed.
+     */
+    void SetAdmissionTicket(std::shared_ptr<void> ticket) noexcept {
+        m_admissionTicket = std::move(ticket);
+    }
+
     /**
      * queue text for writing through connection
      */
@@ -68,6 +122,13 @@ public:
      */
     void AcquireRequests();
 
+    /**
+     * Handle a batch of requests right away, in order.
+     * Used by the connection's read loop when it's built with coroutines
+     * so requests skip the queue and the extra post. 
+     */
+    void HandleRequests(std::vector<Internal::Request>&& batch);
+
     const Internal::User& GetUser() const noexcept {
         return m_user;
     }
@@ -89,25 +150,147 @@ public:
         m_state = State::ACKNOWLEDGED;
     }
 
-    void UpdateUsername(std::string name) {
-        m_user.m_username = std::move(name);
+    /**
+     * Set name of the user if it isn't taken by another user.
+     * @return 
+     *  The indication whether the name was updated.
+     */
+    bool UpdateUsername(std::string name);
+
+    /**
+     * Check whether @name is free or already belongs to this user.
+     * It doesn't reserve the name (see `UpdateUsername`).
+     */
+    bool IsUsernameAvailable(const std::string& name) const;
+
+    /**
+     * Send @text to the connected user with @userId.
+     * @return 
+     *  The indication whether the user was found.
+     */
+    bool SendDirectMessage(std::uint64_t userId, std::string text);
+
+    std::optional<std::uint64_t> FindUserId(const std::string& name) const;
+
+    /**
+     * Server's threshold for compressed frames. Zero if compression is disabled.
+     */
+    std::size_t GetCompressionThreshold() const noexcept;
+
+    /**
+     * Compress the following large frames sent to the client. 
+     */
+    void EnableCompression(std::size_t threshold);
+
+    /**
+     * Receive the membership changes (`PRESENCE`) of the chatrooms.
+     * @return
+     *  Member count limit of the full deltas, nothing if the server doesn't send presence.
+     */
+    std::optional<std::size_t> EnablePresence();
+
+    bool IsPresenceEnabled() const noexcept {
+        return m_isPresenceEnabled;
     }
 
+    /**
+     * Subscribe to one more chatroom. 
+     * The last joined chatroom becomes the current one (`User::m_chatroom`).
+     */
     bool AssignChatroom(std::uint64_t id);
 
-    bool LeaveChatroom();
+    /**
+     * Unsubscribe from the chatroom with @id. 
+     * The session returns to the hall when it has no more subscriptions.
+     */
+    bool LeaveChatroom(std::uint64_t id);
+
+    bool IsSubscribed(std::uint64_t id) const;
+
+    /**
+     * Make the token the client presents to resume this session after reconnect. 
+     * @return 
+     *  Empty string if the sessions can't be resumed.
+     */
+    std::string IssueResumeToken();
+
+    /**
+     * Restore the state of the disconnected session which had the @token: 
+     * username and subscriptions. The messages of each chatroom after its 
+     * sequence number in @sequences are replayed (messages from before the 
+     * old session joined the chatroom never are).
+     * @return 
+     *  The restored chatrooms with their replays, 
+     *  nothing if the token is unknown, expired or the username is taken.
+     */
+    std::optional<std::vector<std::pair<std::uint64_t, chat::Chatroom::Replay>>> Resume(
+        const std::string& token, 
+        const std::unordered_map<std::uint64_t, std::uint64_t>& sequences
+    );
+
+    std::vector<std::uint64_t> GetSubscriptions() const;
 
     void RemoveFromService();
 
     std::uint64_t CreateChatroom(const std::string& chatroomName);
 
-    std::vector<std::string> GetChatroomList() const noexcept;
+    /**
+     * Remove the chatroom created by this session if it's still empty, 
+     * e.g. the session failed to join it.
+     */
+    void RemoveEmptyChatroom(std::uint64_t id);
+
+    /**
+     * Check whether the session can subscribe to one more chatroom (see `MAX_SUBSCRIPTIONS`).
+     */
+    bool CanSubscribe() const;
+
+    std::shared_ptr<const std::string> GetChatroomList() const;
+
+    std::optional<std::string> GetChatroomPage(const chat::ChatroomQuery& query) const;
+
+    /**
+     * Members of the chatroom (ID and name). Nothing if it doesn't exist.
+     */
+    std::optional<std::vector<chat::Chatroom::Member>> GetMembers(std::uint64_t chatroomId) const;
 
     void BroadcastOnly(
+        std::uint64_t chatroomId,
         const std::string& message, 
         std::function<bool(const Session&)>&& condition
     );
+
+    /**
+     * Publish message with the next sequence number of the chatroom 
+     * (see `chat::RoomService::Publish`).
+     */
+    bool Publish(
+        std::uint64_t chatroomId,
+        const chat::Chatroom::FrameBuilder& build, 
+        std::function<bool(const Session&)>&& condition
+    );
+
+    /**
+     * Federation of the server. nullptr if it's not configured.
+     */
+    std::shared_ptr<chat::Federation> GetFederation() const;
+
+    /**
+     * Turn this session into the link from the peer node 
+     * which has been authenticated by hello.
+     */
+    std::shared_ptr<chat::FederationLink> LinkFederation();
+
+    /**
+     * The link from the peer node or nullptr if the session is an ordinary client.
+     */
+    std::shared_ptr<chat::FederationLink> GetFederationLink() const;
     
+    /**
+     * Maximum number of chatrooms a session can be subscribed to at once.
+     */
+    static constexpr std::size_t MAX_SUBSCRIPTIONS { 32 };
+
 private:
     enum class State: std::uint8_t {
         /**
@@ -148,7 +331,51 @@ private:
 
     std::shared_ptr<net::Connection> m_connection { nullptr };
 
-    State m_state { State::CLOSED };
+    std::shared_ptr<net::MemoryAccount> m_memory { nullptr };
+
+    /**
+     * Read by the fan-out lanes and the chatroom snapshots on other threads.
+     */
+    std::atomic<State> m_state { State::CLOSED };
+
+    /**
+     * A handler posted by `AcquireRequests` is draining the queue.
+     */
+    std::atomic<bool> m_isAcquiring { false };
+
+    /**
+     * The client asked for `PRESENCE` frames in SYN.
+     */
+    std::atomic<bool> m_isPresenceEnabled { false };
+
+    mutable std::mutex m_subscriptionsMutex;
+
+    /**
+     * IDs of the chatrooms this session is subscribed to 
+     * and their sequence numbers when the session joined.
+     */
+    std::unordered_map<std::uint64_t, std::uint64_t> m_subscriptions;
+
+    /**
+     * Token the session is parked by when it's removed. Guarded by `m_subscriptionsMutex`.
+     */
+    std::string m_resumeToken {};
+
+    /**
+     * Set when the remote peer is a federated node. Guarded by `m_subscriptionsMutex`.
+     */
+    std::shared_ptr<chat::FederationLink> m_federationLink { nullptr };
+
+    /**
+     * `RemoveFromService` has run. A join which raced with it removes 
+     * the session from the service once more. Guarded by `m_subscriptionsMutex`.
+     */
+    bool m_isRemoved { false };
+
+    /**
+     * Connection slot of the admission control. Released with the session.
+     */
+    std::shared_ptr<void> m_admissionTicket { nullptr };
 
     /**
      * Time in milliseconds the session is ready to wait for the SYN request 
@@ -0,0 +1,28 @@
+#ifndef NET_TRANSPORT_HPP
+#define NET_TRANSPORT_HPP
+
+#include <boost/asio.hpp>
+
+#include "FrameLayer.hpp"
+
+#ifdef CHAT_LOOPBACK_TRANSPORT
+#include "MockStream.hpp"
+#endif
+
+namespace net {
+
+#ifndef CHAT_LOOPBACK_TRANSPORT
+    using Socket_t = boost::asio::ip::tcp::socket;
+    using Acceptor_t = boost::asio::ip::tcp::acceptor;
+#else
+    /**
+     * In-memory transport: server and clients of the same process
+     * are connected without sockets or ports.
+     */
+    using Socket_t = MockSocket;
+    using Acceptor_t = MockAcceptor;
+#endif
+
+} // namespace net
+
+#endif // NET_TRANSPORT_HPP
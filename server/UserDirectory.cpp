@@ -0,0 +1,61 @@
+#include "UserDirectory.hpp"
+
+#include <mutex>
+
+namespace chat {
+
+void UserDirectory::Add(std::uint64_t userId, std::weak_ptr<Session> session) {
+    std::unique_lock<std::shared_mutex> lock { m_mutex };
+    m_users[userId].m_session = std::move(session);
+}
+
+void UserDirectory::Remove(std::uint64_t userId) {
+    std::unique_lock<std::shared_mutex> lock { m_mutex };
+    if (auto it = m_users.find(userId); it != m_users.end()) {
+        if (!it->second.m_name.empty()) {
+            m_ids.erase(it->second.m_name);
+        }
+        m_users.erase(it);
+    }
+}
+
+bool UserDirectory::ClaimName(std::uint64_t userId, const std::string& name) {
+    std::unique_lock<std::shared_mutex> lock { m_mutex };
+    const auto user = m_users.find(userId);
+    if (user == m_users.end()) {
+        return false;
+    }
+    if (const auto it = m_ids.find(name); it != m_ids.end()) {
+        return it->second == userId;
+    }
+    if (!user->second.m_name.empty()) {
+        m_ids.erase(user->second.m_name);
+    }
+    user->second.m_name = name;
+    m_ids.emplace(name, userId);
+    return true;
+}
+
+std::shared_ptr<Session> UserDirectory::Find(std::uint64_t userId) const {
+    std::shared_lock<std::shared_mutex> lock { m_mutex };
+    if (const auto it = m_users.find(userId); it != m_users.end()) {
+        return it->second.m_session.lock();
+    }
+    return nullptr;
+}
+
+std::optional<std::uint64_t> UserDirectory::FindId(const std::string& name) const {
+    std::shared_lock<std::shared_mutex> lock { m_mutex };
+    if (const auto it = m_ids.find(name); it != m_ids.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void UserDirectory::Clear() {
+    std::unique_lock<std::shared_mutex> lock { m_mutex };
+    m_users.clear();
+    m_ids.clear();
+}
+
+} // namespace chat
\ No newline at end of file
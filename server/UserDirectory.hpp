@@ -0,0 +1,85 @@
+#ifndef CHAT_USER_DIRECTORY_HPP
+#define CHAT_USER_DIRECTORY_HPP
+
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <optional>
+#include <string>
+#include <cstdint>
+
+class Session;
+
+namespace chat {
+
+/**
+ * Index of the connected users: user ID -> session and username -> user ID.
+ * It has its own lock, so a lookup doesn't touch chatroom locks.
+ */
+class UserDirectory final {
+public:
+    
+    /**
+     * Register session of the user with @userId.
+     * @note
+     *  Thread-safety: safe
+     */
+    void Add(std::uint64_t userId, std::weak_ptr<Session> session);
+
+    /**
+     * Unregister user and release its name.
+     * @note
+     *  Thread-safety: safe
+     */
+    void Remove(std::uint64_t userId);
+
+    /**
+     * Reserve @name for the user with @userId. 
+     * The previous name of this user is released.
+     * @return 
+     *  The indication whether the name was free (or already belongs to this user)
+     *  and the user is registered.
+     * @note
+     *  Thread-safety: safe
+     */
+    bool ClaimName(std::uint64_t userId, const std::string& name);
+
+    /**
+     * Find session of the user by it's ID.
+     * @return 
+     *  Return nullptr if the user isn't connected.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::shared_ptr<Session> Find(std::uint64_t userId) const;
+
+    /**
+     * Find ID of the user by it's name.
+     * @note
+     *  Thread-safety: safe
+     */
+    std::optional<std::uint64_t> FindId(const std::string& name) const;
+
+    /**
+     * Remove all users.
+     * @note
+     *  Thread-safety: safe
+     */
+    void Clear();
+
+private:
+    struct Entry {
+        std::weak_ptr<Session> m_session;
+        std::string m_name;
+    };
+
+    mutable std::shared_mutex m_mutex;
+
+    std::unordered_map<std::uint64_t, Entry> m_users;
+
+    std::unordered_map<std::string, std::uint64_t> m_ids;
+};
+
+} // namespace chat
+
+#endif // CHAT_USER_DIRECTORY_HPP
\ No newline at end of file
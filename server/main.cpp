@@ -2,6 +2,7 @@
 #include <memory>
 #include <thread>
 #include <exception>
+#include <string>
 #include <vector>
 
 #include <boost/asio.hpp>
@@ -9,12 +10,14 @@
 
 #include "Server.hpp"
 
-int main() {
+int main(int argc, char *argv[]) {
 	std::shared_ptr<boost::asio::io_context> io { 
 		std::make_shared<boost::asio::io_context>() 
 	};
 
-	Server server { io, 15001 };
+	// nodes of a federation on the same host: `server <port> <config>`
+	const auto port { argc > 1? static_cast<std::uint16_t>(std::stoul(argv[1])): std::uint16_t { 15001 } };
+	Server server { io, port, argc > 2? argv[2]: Server::DEFAULT_CONFIG };
 	server.Start();
 	std::vector<std::thread> ts;
 	for (int i = 0; i < 4; i++) {
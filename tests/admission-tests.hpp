@@ -0,0 +1,289 @@
+#ifndef ADMISSION_TESTS_HPP
+#define ADMISSION_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Admission.hpp"
+#include "Message.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+TEST(AdmissionTest, RefusesOverConnectionLimit) {
+    auto global { std::make_shared<net::Admission>(net::Admission::Limits{ 3, 0, 0 }) };
+    auto listener { std::make_shared<net::Admission>(net::Admission::Limits{ 2, 0, 0 }, global) };
+
+    auto first { listener->Admit() };
+    auto second { listener->Admit() };
+    ASSERT_TRUE(first && second);
+    EXPECT_FALSE(listener->Admit());
+    // the parent's slot taken for the refused one is released
+    auto other { global->Admit() };
+    EXPECT_TRUE(other);
+    EXPECT_FALSE(global->Admit());
+
+    first.reset();
+    EXPECT_EQ(listener->GetStats().m_connections, 1);
+    EXPECT_EQ(global->GetStats().m_connections, 2);
+    EXPECT_TRUE(listener->Admit());
+    EXPECT_EQ(listener->GetStats().m_refusedConnections, 1);
+}
+
+TEST(AdmissionTest, FirstOwnerClaimsLimits) {
+    auto global { std::make_shared<net::Admission>(net::Admission::Limits{}) };
+    EXPECT_TRUE(global->ClaimLimits(net::Admission::Limits{ 2, 0, 0 }));
+    // another listener doesn't override it
+    EXPECT_FALSE(global->ClaimLimits(net::Admission::Limits{ 5, 0, 0 }));
+    EXPECT_EQ(global->GetLimits().m_maxConnections, 2);
+    auto first { global->Admit() };
+    auto second { global->Admit() };
+    EXPECT_TRUE(first && second);
+    EXPECT_FALSE(global->Admit());
+}
+
+TEST(AdmissionTest, QueuesHandshakesOverLimit) {
+    auto admission { std::make_shared<net::Admission>(net::Admission::Limits{ 0, 1, 1 }) };
+    std::vector<int> started;
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(1); }));
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(2); }));
+    EXPECT_FALSE(admission->BeginHandshake([&]() { started.push_back(3); }));
+    ASSERT_EQ(started, std::vector<int>({ 1 }));
+
+    // the slot passes to the waiting handshake
+    admission->FinishHandshake();
+    ASSERT_EQ(started, std::vector<int>({ 1, 2 }));
+    admission->FinishHandshake();
+    const auto stats { admission->GetStats() };
+    EXPECT_EQ(stats.m_handshakes, 0);
+    EXPECT_EQ(stats.m_waitingHandshakes, 0);
+    EXPECT_EQ(stats.m_delayedHandshakes, 1);
+    EXPECT_EQ(stats.m_refusedHandshakes, 1);
+}
+
+TEST(AdmissionTest, DropsExpiredWaitingHandshakes) {
+    auto admission { std::make_shared<net::Admission>(net::Admission::Limits{ 0, 1, 2 }) };
+    const auto now { net::Admission::Clock::now() };
+    std::vector<int> started;
+    std::vector<int> expired;
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(1); }));
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(2); }, 
+        now + std::chrono::milliseconds(10), [&]() { expired.push_back(2); }
+    ));
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(3); }, 
+        now + std::chrono::hours(1), [&]() { expired.push_back(3); }
+    ));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(admission->DropExpiredHandshakes(), 1);
+    EXPECT_EQ(expired, std::vector<int>({ 2 }));
+
+    // the expired one leaves room in the queue
+    EXPECT_TRUE(admission->BeginHandshake([&]() { started.push_back(4); }, 
+        now - std::chrono::milliseconds(1), [&]() { expired.push_back(4); }
+    ));
+    // the slot passes over the expired one
+    admission->FinishHandshake();
+    EXPECT_EQ(started, std::vector<int>({ 1, 3 }));
+    EXPECT_EQ(expired, std::vector<int>({ 2, 4 }));
+    admission->FinishHandshake();
+    const auto stats { admission->GetStats() };
+    EXPECT_EQ(stats.m_handshakes, 0);
+    EXPECT_EQ(stats.m_waitingHandshakes, 0);
+    EXPECT_EQ(stats.m_expiredHandshakes, 2);
+}
+
+#ifndef CHAT_LOOPBACK_TRANSPORT
+
+/**
+ * Established client keeps being served while the listener is flooded with connects
+ * which never finish the handshake.
+ */
+class ConnectFloodTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15031 };
+    static constexpr std::size_t LISTENER_LIMIT { 256 };
+    static constexpr std::size_t FLOOD_RATE { 10'000 }; // per second
+    static constexpr std::size_t FLOOD_OPEN { 512 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_config.emplace("admission.cfg", Testing::ConfigFile::Overrides {
+            { "listener_max_connections", std::to_string(LISTENER_LIMIT) },
+            { "max_handshakes", "16" },
+            { "handshake_queue", "64" },
+            { "handshake_timeout", "500" }
+        });
+        m_server = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+        m_server->Start();
+        for (int i = 0; i < 4; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        m_config.reset();
+    }
+
+    /**
+     * List the chatrooms and wait for the reply. 
+     * @return 
+     *  Round trip in microseconds, or nothing if the reply didn't come.
+     */
+    static std::optional<double> RoundTrip(Client& client) {
+        const auto responses { client.GetResponseCount() };
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::LIST_CHATROOM;
+        request.m_timestamp = Utils::GetTimestamp();
+        std::string serialized;
+        request.Write(serialized);
+        const auto start { std::chrono::steady_clock::now() };
+        client.Write(std::move(serialized));
+        if (!Testing::SpinUntil([&]() { return client.GetResponseCount() > responses; })) {
+            return std::nullopt;
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct FloodResult {
+        std::size_t m_connected { 0 };
+        std::size_t m_peak { 0 };
+        /// Round trips of the established client during the flood.
+        std::vector<double> m_roundTrips;
+    };
+
+    /**
+     * Flood the listener with @connects at @FLOOD_RATE while the @client 
+     * keeps listing the chatrooms. 
+     */
+    FloodResult Flood(Client& client, std::size_t connects) {
+        std::atomic<bool> isFlooding { true };
+        std::atomic<std::size_t> connected { 0 };
+        std::atomic<std::size_t> peak { 0 };
+        std::thread flood([&]() {
+            boost::asio::io_context io;
+            const boost::asio::ip::tcp::endpoint endpoint { boost::asio::ip::make_address("127.0.0.1"), PORT };
+            // the clients hold the connections open but never start TLS
+            std::deque<boost::asio::ip::tcp::socket> open;
+            const auto start { std::chrono::steady_clock::now() };
+            for (std::size_t i = 0; i < connects; i++) {
+                boost::asio::ip::tcp::socket socket { io };
+                boost::system::error_code error;
+                socket.connect(endpoint, error);
+                if (!error) {
+                    connected++;
+                    open.push_back(std::move(socket));
+                    if (open.size() > FLOOD_OPEN) {
+                        open.pop_front();
+                    }
+                }
+                if (i % 64 == 0) {
+                    peak = std::max<std::size_t>(peak, m_server->GetAdmission()->GetStats().m_connections);
+                }
+                std::this_thread::sleep_until(start + std::chrono::microseconds(i * 1'000'000 / FLOOD_RATE));
+            }
+            isFlooding = false;
+        });
+
+        FloodResult result;
+        while (isFlooding) {
+            const auto rtt { RoundTrip(client) };
+            EXPECT_TRUE(rtt) << "established client wasn't served during the flood";
+            if (!rtt) {
+                break;
+            }
+            result.m_roundTrips.push_back(*rtt);
+        }
+        flood.join();
+        result.m_connected = connected;
+        result.m_peak = peak;
+        return result;
+    }
+
+    static double Percentile(std::vector<double> samples, double p) {
+        std::sort(samples.begin(), samples.end());
+        return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::optional<Testing::ConfigFile> m_config;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(ConnectFloodTest, EstablishedClientIsServedDuringFlood) {
+    auto client { std::make_shared<Client>(m_context, m_sslContext) };
+    client->Connect("127.0.0.1", std::to_string(PORT));
+    ASSERT_TRUE(Testing::SpinUntil([&client]() { return client->GetState() == Client::State::RECEIVE_ACK; }));
+
+    const auto result { Flood(*client, 1'000) };
+    const auto stats { m_server->GetAdmission()->GetStats() };
+    EXPECT_FALSE(result.m_roundTrips.empty());
+    EXPECT_LE(result.m_peak, LISTENER_LIMIT);
+    EXPECT_GT(stats.m_refusedConnections + stats.m_refusedHandshakes, 0);
+    EXPECT_EQ(client->GetState(), Client::State::RECEIVE_ACK);
+}
+
+/**
+ * Round trips of the established client before and during a long flood.
+ */
+TEST_F(ConnectFloodTest, DISABLED_ConnectFloodBenchmark) {
+    auto client { std::make_shared<Client>(m_context, m_sslContext) };
+    client->Connect("127.0.0.1", std::to_string(PORT));
+    ASSERT_TRUE(Testing::SpinUntil([&client]() { return client->GetState() == Client::State::RECEIVE_ACK; }));
+
+    std::vector<double> idle;
+    for (int i = 0; i < 200; i++) {
+        const auto rtt { RoundTrip(*client) };
+        ASSERT_TRUE(rtt);
+        idle.push_back(*rtt);
+    }
+    const auto result { Flood(*client, 10'000) };
+    ASSERT_FALSE(result.m_roundTrips.empty());
+
+    const auto stats { m_server->GetAdmission()->GetStats() };
+    std::cout << "[ BENCH    ] connect flood of " << result.m_connected << " connects at " << FLOOD_RATE << "/s: "
+        << "round trip p50 " << Percentile(idle, 0.5) << " -> " << Percentile(result.m_roundTrips, 0.5) << " us, "
+        << "p99 " << Percentile(idle, 0.99) << " -> " << Percentile(result.m_roundTrips, 0.99) << " us ("
+        << result.m_roundTrips.size() << " samples); admitted " << stats.m_admitted 
+        << ", refused " << stats.m_refusedConnections << " + " << stats.m_refusedHandshakes 
+        << " handshakes, peak " << result.m_peak << " connections\n";
+}
+
+#endif // CHAT_LOOPBACK_TRANSPORT
+
+#endif // ADMISSION_TESTS_HPP
\ No newline at end of file
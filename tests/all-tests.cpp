@@ -1,6 +1,26 @@
 #include "gtest/gtest.h"
 #include "message-tests.hpp"
 #include "single-client-messaging-tests.hpp"
+#include "kernel-tls-tests.hpp"
+#include "network-conditions-tests.hpp"
+#include "frame-scanner-tests.hpp"
+#include "room-service-tests.hpp"
+#include "fanout-tests.hpp"
+#include "pipeline-tests.hpp"
+#include "handler-allocator-tests.hpp"
+#include "connection-pool-tests.hpp"
+#include "compression-tests.hpp"
+#include "federation-tests.hpp"
+#include "handoff-tests.hpp"
+#include "admission-tests.hpp"
+#include "handshake-pool-tests.hpp"
+#include "inbound-limits-tests.hpp"
+#include "memory-tests.hpp"
+#include "resume-tests.hpp"
+#include "pipelined-client-tests.hpp"
+#include "ring-buffer-tests.hpp"
+#include "handle-table-tests.hpp"
+#include "presence-tests.hpp"
 
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,39 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replace the global allocation functions to count how many times
+ * the whole test process (server and client together) calls `operator new`.
+ * NOTE: include it only from `all-tests.cpp`, 
+ * replacement functions can be defined only once.
+ */
+namespace Testing {
+    inline std::atomic<std::size_t> g_allocations { 0 };
+
+    inline std::size_t GetAllocationCount() noexcept {
+        return g_allocations.load(std::memory_order_relaxed);
+    }
+}
+
+void* operator new(std::size_t size) {
+    Testing::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1); ptr) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+#endif // ALLOCATION_COUNTER_HPP
\ No newline at end of file
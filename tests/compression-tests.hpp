@@ -0,0 +1,195 @@
+#ifndef COMPRESSION_TESTS_HPP
+#define COMPRESSION_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Compression.hpp"
+#include "FrameScanner.hpp"
+#include "Message.hpp"
+#include "RoomService.hpp"
+#include "single-client-messaging-tests.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::string MakeListResponse(std::size_t rooms) {
+    chat::RoomService service;
+    for (std::size_t i = 0; i < rooms; i++) {
+        service.CreateChatroom("Chatroom #" + std::to_string(i));
+    }
+    Internal::Response response{};
+    response.m_query = Internal::QueryType::LIST_CHATROOM;
+    response.m_status = 200;
+    response.m_timestamp = Utils::GetTimestamp();
+    response.m_attachment = *service.GetSerializedChatroomList();
+    std::string serialized;
+    response.Write(serialized);
+    return serialized;
+}
+
+std::string_view WithoutDelimiter(std::string_view frame) {
+    frame.remove_suffix(Internal::MESSAGE_DELIMITER.size());
+    return frame;
+}
+
+}
+
+TEST(CompressionTest, FramesShareHistory) {
+    Internal::FrameDeflater deflater;
+    Internal::FrameInflater inflater;
+    const std::vector<std::string> payloads {
+        R"({"query":"chat-message","timestamp":1,"status":200,"attachment":{"message":"hello"}})",
+        R"({"query":"chat-message","timestamp":2,"status":200,"attachment":{"message":"hello"}})",
+        std::string(3000, 'x'),
+        "",
+        R"({"query":"chat-message","timestamp":3,"status":200,"attachment":{"message":"hello"}})"
+    };
+    std::vector<std::size_t> sizes;
+    for (const auto& payload: payloads) {
+        std::string frame;
+        ASSERT_TRUE(deflater.Compress(payload, frame));
+        ASSERT_TRUE(Internal::IsCompressedFrame(frame));
+        // framing stays intact
+        const auto body { WithoutDelimiter(frame) };
+        EXPECT_EQ(Internal::FindDelimiter(body), std::string_view::npos);
+        sizes.push_back(frame.size());
+
+        std::string restored;
+        ASSERT_TRUE(inflater.Decompress(body, restored));
+        EXPECT_EQ(restored, payload);
+    }
+    // the second message refers to the first one
+    EXPECT_LT(sizes[1], sizes[0]);
+}
+
+TEST(CompressionTest, CorruptedFrameIsRejected) {
+    Internal::FrameDeflater deflater;
+    std::string frame;
+    ASSERT_TRUE(deflater.Compress(std::string(100, 'a'), frame));
+    std::string restored;
+    {
+        Internal::FrameInflater inflater;
+        // not base64
+        EXPECT_FALSE(inflater.Decompress("~abc*", restored));
+    }
+    {
+        Internal::FrameInflater inflater;
+        EXPECT_FALSE(inflater.Decompress("~////////", restored));
+    }
+    {
+        Internal::FrameInflater inflater;
+        EXPECT_FALSE(inflater.Decompress(R"({"query":"ack"})", restored));
+        EXPECT_TRUE(inflater.Decompress(WithoutDelimiter(frame), restored));
+        EXPECT_EQ(restored, std::string(100, 'a'));
+        EXPECT_FALSE(inflater.IsOverLimit());
+    }
+    {
+        Internal::FrameInflater inflater;
+        EXPECT_FALSE(inflater.Decompress(WithoutDelimiter(frame), restored, 10));
+        EXPECT_TRUE(inflater.IsOverLimit());
+    }
+}
+
+TEST(CompressionTest, RepeatedListResponseShrinks) {
+    const auto response { MakeListResponse(100) };
+    const auto payload { WithoutDelimiter(response) };
+    Internal::FrameDeflater deflater;
+    Internal::FrameInflater inflater;
+    std::string frame;
+    std::string restored;
+    ASSERT_TRUE(deflater.Compress(payload, frame));
+    ASSERT_TRUE(inflater.Decompress(WithoutDelimiter(frame), restored));
+    const auto first { frame.size() };
+    EXPECT_LT(first, response.size());
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(deflater.Compress(payload, frame));
+        ASSERT_TRUE(inflater.Decompress(WithoutDelimiter(frame), restored));
+        // the same list is in the history
+        EXPECT_LT(frame.size(), first);
+    }
+    EXPECT_EQ(restored, payload);
+}
+
+TEST(CompressionTest, DISABLED_ListResponseBenchmark) {
+    constexpr std::size_t FRAMES { 500 };
+    for (const std::size_t rooms: { 10U, 100U, 1000U }) {
+        const auto response { MakeListResponse(rooms) };
+        const auto payload { WithoutDelimiter(response) };
+        Internal::FrameDeflater deflater;
+        Internal::FrameInflater inflater;
+        std::string frame;
+        std::string restored;
+        std::size_t sent { 0 };
+        std::size_t first { 0 };
+        using Clock = std::chrono::steady_clock;
+        Clock::duration compressing {};
+        Clock::duration decompressing {};
+        for (std::size_t i = 0; i < FRAMES; i++) {
+            const auto start { Clock::now() };
+            ASSERT_TRUE(deflater.Compress(payload, frame));
+            const auto compressed { Clock::now() };
+            ASSERT_TRUE(inflater.Decompress(WithoutDelimiter(frame), restored));
+            decompressing += Clock::now() - compressed;
+            compressing += compressed - start;
+            sent += frame.size();
+            if (i == 0) {
+                // nothing to refer to in the history yet
+                first = frame.size();
+            }
+        }
+        ASSERT_EQ(restored, payload);
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        std::cout << "[ BENCH    ] list of " << rooms << " rooms (" << response.size() << " bytes): "
+            << "first frame " << first << " bytes, "
+            << "sent " << sent / FRAMES << " bytes/frame (" 
+            << 100.0 * static_cast<double>(sent) / static_cast<double>(response.size() * FRAMES) << "%), "
+            << "deflate " << duration_cast<microseconds>(compressing).count() / static_cast<double>(FRAMES) << " us, "
+            << "inflate " << duration_cast<microseconds>(decompressing).count() / static_cast<double>(FRAMES) << " us\n";
+    }
+}
+
+TEST_F(BasicInteractionTest, CompressedChatroomList) {
+    this->ConfirmHandshake();
+    for (std::size_t i = 0; i < 200; i++) {
+        m_server->GetRoomService()->CreateChatroom("Compressed #" + std::to_string(i));
+    }
+    m_client->RequestCompression();
+    this->WaitFor(m_waitTimeout);
+    ASSERT_TRUE(m_client->IsCompressionEnabled());
+    EXPECT_EQ(m_client->GetLastResponse().m_query, Internal::QueryType::ACK);
+
+    Internal::Request listRequest{};
+    listRequest.m_query = Internal::QueryType::LIST_CHATROOM;
+    listRequest.m_timestamp = Utils::GetTimestamp();
+    listRequest.m_timeout = m_waitTimeout;
+    std::string serialized {};
+    listRequest.Write(serialized);
+    // the same request twice: the second reply refers to the first one
+    m_client->Write(serialized);
+    m_client->Write(std::move(serialized));
+    this->WaitFor(m_waitTimeout);
+
+    const auto reply { m_client->GetLastResponse() };
+    EXPECT_EQ(reply.m_query, Internal::QueryType::LIST_CHATROOM);
+    EXPECT_EQ(reply.m_status, 200);
+    EXPECT_EQ(reply.m_attachment, *m_server->GetRoomService()->GetSerializedChatroomList());
+}
+
+TEST_F(BasicInteractionTest, CorruptedCompressedFrameClosesConnection) {
+    this->ConfirmHandshake();
+    // the inflate stream is broken: the following frames can't be decompressed
+    m_client->Write("~////////" + Internal::MESSAGE_DELIMITER);
+    EXPECT_TRUE(Testing::WaitUntil([this]() { 
+        return m_client->GetState() == Client::State::CLOSED; 
+    }));
+}
+
+#endif // COMPRESSION_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef CONNECTION_POOL_TESTS_HPP
+#define CONNECTION_POOL_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "allocation-counter.hpp"
+#include "ConnectionPool.hpp"
+#include "RoomService.hpp"
+#include "Session.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+TEST(ConnectionPoolTest, BuffersKeepCapacity) {
+    auto pool { std::make_shared<net::ConnectionPool>(net::ConnectionPool::Limits{}) };
+    net::IOBuffers *address { nullptr };
+    std::size_t capacity { 0 };
+    {
+        auto buffers { pool->AcquireBuffers() };
+        buffers->m_inbox.commit(boost::asio::buffer_copy(
+            buffers->m_inbox.prepare(4096), boost::asio::buffer(std::string(4096, 'a'))
+        ));
+        buffers->m_outbox.Enque(std::string(16, 'b'));
+        address = buffers.get();
+        capacity = buffers->m_inbox.capacity();
+    }
+    EXPECT_EQ(pool->GetStats().m_idleBuffers, 1U);
+
+    auto reused { pool->AcquireBuffers() };
+    EXPECT_EQ(reused.get(), address);
+    EXPECT_EQ(reused->m_inbox.size(), 0U);
+    EXPECT_EQ(reused->m_inbox.capacity(), capacity);
+    EXPECT_EQ(reused->m_outbox.GetQueueSize(), 0U);
+    EXPECT_EQ(pool->GetStats().m_reusedBuffers, 1U);
+}
+
+TEST(ConnectionPoolTest, RetainedMemoryIsCapped) {
+    net::ConnectionPool::Limits limits;
+    limits.m_maxIdle = 1;
+    limits.m_maxRetainedBytes = 8 * 1024;
+    auto pool { std::make_shared<net::ConnectionPool>(limits) };
+    {
+        // grew beyond the limit
+        auto buffers { pool->AcquireBuffers() };
+        buffers->m_inbox.prepare(64 * 1024);
+    }
+    EXPECT_EQ(pool->GetStats().m_idleBuffers, 0U);
+    {
+        // only one of them fits into the pool
+        auto first { pool->AcquireBuffers() };
+        auto second { pool->AcquireBuffers() };
+    }
+    EXPECT_EQ(pool->GetStats().m_idleBuffers, 1U);
+}
+
+TEST(ConnectionPoolTest, ShellMemoryIsRecycled) {
+    auto pool { std::make_shared<net::ConnectionPool>(net::ConnectionPool::Limits{}) };
+    auto first { pool->MakeShared<std::string>(64, 'a') };
+    const void *address { first.get() };
+    first.reset();
+    EXPECT_EQ(pool->GetStats().m_idleBlocks, 1U);
+    auto second { pool->MakeShared<std::string>("b") };
+    EXPECT_EQ(second.get(), address);
+    EXPECT_EQ(pool->GetStats().m_idleBlocks, 0U);
+}
+
+namespace {
+
+/**
+ * Emulate the accept path under churn: a session is created, registered, 
+ * closed and destroyed again and again.
+ * @return Number of allocations and the elapsed time in seconds.
+ */
+std::pair<std::size_t, double> ChurnSessions(
+    std::size_t count, 
+    std::shared_ptr<net::ConnectionPool> pool
+) {
+    auto io { std::make_shared<boost::asio::io_context>() };
+    auto ssl { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+    auto service { std::make_shared<chat::RoomService>() };
+
+    const auto churn = [&]() {
+        net::Socket_t socket { *io };
+        auto session { pool? 
+            pool->MakeShared<Session>(std::move(socket), service, io, ssl, pool) :
+            std::make_shared<Session>(std::move(socket), service, io, ssl) 
+        };
+        service->AddSession(session);
+        session->Subscribe();
+        session->Close();
+        io->poll();
+        session.reset();
+        io->poll();
+        io->restart();
+    };
+    // warm up the pool & the service
+    for (std::size_t i = 0; i < 16; i++) {
+        churn();
+    }
+    const auto allocations { Testing::GetAllocationCount() };
+    const auto start { std::chrono::steady_clock::now() };
+    for (std::size_t i = 0; i < count; i++) {
+        churn();
+    }
+    const std::chrono::duration<double> elapsed { std::chrono::steady_clock::now() - start };
+    return { Testing::GetAllocationCount() - allocations, elapsed.count() };
+}
+
+}
+
+TEST(ConnectionPoolTest, ChurnReusesPooledMemory) {
+    constexpr std::size_t SESSIONS { 200 };
+    const auto freshAllocations { ChurnSessions(SESSIONS, nullptr).first };
+    auto pool { std::make_shared<net::ConnectionPool>(
+        net::ConnectionPool::Limits{}, "connection_pool_churn_log.txt"
+    ) };
+    const auto pooledAllocations { ChurnSessions(SESSIONS, pool).first };
+    EXPECT_LT(pooledAllocations, freshAllocations);
+    EXPECT_GT(pool->GetStats().m_reusedBuffers, 0U);
+}
+
+TEST(ConnectionPoolTest, DISABLED_AcceptChurnBenchmark) {
+    constexpr std::size_t SESSIONS { 2000 };
+    const auto [freshAllocations, freshTime] = ChurnSessions(SESSIONS, nullptr);
+    auto pool { std::make_shared<net::ConnectionPool>(
+        net::ConnectionPool::Limits{}, "connection_pool_bench_log.txt"
+    ) };
+    const auto [pooledAllocations, pooledTime] = ChurnSessions(SESSIONS, pool);
+
+    std::cout << "[ BENCH    ] accept churn of " << SESSIONS << " sessions: "
+        << "fresh " << static_cast<std::size_t>(SESSIONS / freshTime) << " accepts/s, "
+        << static_cast<double>(freshAllocations) / SESSIONS << " allocs/accept; "
+        << "pooled " << static_cast<std::size_t>(SESSIONS / pooledTime) << " accepts/s, "
+        << static_cast<double>(pooledAllocations) / SESSIONS << " allocs/accept\n";
+}
+
+#endif // CONNECTION_POOL_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,468 @@
+#ifndef FANOUT_TESTS_HPP
+#define FANOUT_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Fanout.hpp"
+#include "Chatroom.hpp"
+#include "RoomService.hpp"
+#include "Session.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <numeric>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+/// Helper functions:
+
+/**
+ * Simulate the per-recipient cost of `Session::Write` 
+ * (a copy of the message and a post to the connection's strand).
+ */
+inline void SimulateDelivery() {
+    volatile std::size_t sink { 0 };
+    for (std::size_t i = 0; i < 200; i++) {
+        sink = sink + i;
+    }
+}
+
+TEST(FanoutTest, SmallListIsDeliveredInline) {
+    boost::asio::thread_pool pool { 2 };
+    chat::Fanout fanout;
+    chat::FanoutPolicy policy;
+    policy.m_executor = pool.get_executor();
+    policy.m_threshold = 100;
+    fanout.SetPolicy(policy);
+
+    auto recipients { std::make_shared<const std::vector<int>>(10, 1) };
+    int delivered { 0 };
+    EXPECT_FALSE(fanout.Run(recipients, [&delivered](int value) { delivered += value; }));
+    EXPECT_EQ(delivered, 10);
+    pool.join();
+}
+
+TEST(FanoutTest, ListWithoutPolicyIsDeliveredInline) {
+    chat::Fanout fanout;
+    auto recipients { std::make_shared<const std::vector<int>>(20'000, 1) };
+    int delivered { 0 };
+    EXPECT_FALSE(fanout.Run(recipients, [&delivered](int value) { delivered += value; }));
+    EXPECT_EQ(delivered, 20'000);
+}
+
+TEST(FanoutTest, LargeListKeepsOrderPerRecipient) {
+    constexpr std::size_t RECIPIENTS { 5'000 };
+    constexpr int MESSAGES { 8 };
+
+    boost::asio::thread_pool pool { 4 };
+    chat::Fanout fanout;
+    chat::FanoutPolicy policy;
+    policy.m_executor = pool.get_executor();
+    policy.m_threshold = 1024;
+    policy.m_chunkSize = 128;
+    fanout.SetPolicy(policy);
+
+    std::vector<std::size_t> indexes(RECIPIENTS);
+    for (std::size_t i = 0; i < RECIPIENTS; i++) {
+        indexes[i] = i;
+    }
+    auto recipients { std::make_shared<const std::vector<std::size_t>>(std::move(indexes)) };
+    // last message received by each recipient
+    auto received { std::make_shared<std::vector<std::atomic<int>>>(RECIPIENTS) };
+    std::atomic<std::size_t> outOfOrder { 0 };
+    std::atomic<std::size_t> delivered { 0 };
+
+    for (int message = 1; message <= MESSAGES; message++) {
+        EXPECT_TRUE(fanout.Run(recipients, [=, &outOfOrder, &delivered](std::size_t recipient) {
+            auto& last { (*received)[recipient] };
+            if (last.load() != message - 1) {
+                outOfOrder++;
+            }
+            last = message;
+            delivered++;
+        }));
+    }
+    pool.join();
+
+    EXPECT_EQ(delivered.load(), RECIPIENTS * MESSAGES);
+    EXPECT_EQ(outOfOrder.load(), 0U);
+}
+
+TEST(FanoutTest, SmallListWaitsForPendingChunks) {
+    // not run until both broadcasts are made, so the chunks stay queued
+    boost::asio::io_context context;
+    chat::Fanout fanout;
+    chat::FanoutPolicy policy;
+    policy.m_executor = context.get_executor();
+    policy.m_threshold = 100;
+    policy.m_chunkSize = 16;
+    fanout.SetPolicy(policy);
+
+    std::vector<std::size_t> members(200);
+    std::iota(members.begin(), members.end(), 0);
+    auto large { std::make_shared<const std::vector<std::size_t>>(members) };
+    // the room shrank below the threshold
+    members.resize(50);
+    auto small { std::make_shared<const std::vector<std::size_t>>(std::move(members)) };
+
+    std::vector<int> received(200, 0);
+    std::size_t outOfOrder { 0 };
+    auto deliver = [&](int message) {
+        return [&, message](std::size_t member) {
+            if (received[member] != message - 1) {
+                outOfOrder++;
+            }
+            received[member] = message;
+        };
+    };
+    EXPECT_TRUE(fanout.Run(large, deliver(1)));
+    EXPECT_TRUE(fanout.Run(small, deliver(2)));
+    context.run();
+    EXPECT_EQ(outOfOrder, 0U);
+    EXPECT_EQ(received[0], 2);
+    EXPECT_EQ(received[199], 1);
+
+    // nothing is pending anymore: back to inline delivery
+    EXPECT_FALSE(fanout.Run(small, deliver(3)));
+    EXPECT_EQ(received[0], 3);
+}
+
+/**
+ * Several senders broadcast to a room while members leave (swap-remove) 
+ * and rejoin, so its size crosses the threshold back and forth. 
+ * The senders take the sequence number and run the fan-out 
+ * under the room's lock, so the calls are serialized.
+ */
+TEST(FanoutTest, ConcurrentBroadcastsKeepOrderWhileMembersChurn) {
+    constexpr std::size_t MEMBERS { 1'200 };
+    constexpr std::size_t MIN_MEMBERS { 900 };
+    constexpr int SENDERS { 4 };
+    constexpr int MESSAGES { 150 };
+
+    boost::asio::thread_pool pool { 4 };
+    chat::Fanout fanout;
+    chat::FanoutPolicy policy;
+    policy.m_executor = pool.get_executor();
+    policy.m_threshold = 1024;
+    policy.m_chunkSize = 64;
+    fanout.SetPolicy(policy);
+
+    struct Room {
+        std::mutex m_mutex;
+        std::vector<std::size_t> m_members;
+        std::vector<std::size_t> m_left;
+        std::shared_ptr<const std::vector<std::size_t>> m_snapshot;
+        std::uint64_t m_sequence { 0 };
+    } room;
+    room.m_members.resize(MEMBERS);
+    std::iota(room.m_members.begin(), room.m_members.end(), 0);
+
+    // last sequence number received by each member
+    auto received { std::make_shared<std::vector<std::atomic<std::uint64_t>>>(MEMBERS) };
+    auto outOfOrder { std::make_shared<std::atomic<std::size_t>>(0) };
+    auto delivered { std::make_shared<std::atomic<std::size_t>>(0) };
+    std::atomic<bool> isSending { true };
+
+    std::thread churn { [&]() {
+        std::mt19937 random { 42 };
+        bool isShrinking { true };
+        while (isSending) {
+            { // Block
+                std::lock_guard<std::mutex> lock { room.m_mutex };
+                auto& members { room.m_members };
+                if (isShrinking) {
+                    const auto i { random() % members.size() };
+                    room.m_left.push_back(members[i]);
+                    members[i] = members.back();
+                    members.pop_back();
+                    isShrinking = members.size() > MIN_MEMBERS;
+                }
+                else {
+                    const auto i { random() % room.m_left.size() };
+                    members.push_back(room.m_left[i]);
+                    room.m_left[i] = room.m_left.back();
+                    room.m_left.pop_back();
+                    isShrinking = room.m_left.empty();
+                }
+                room.m_snapshot.reset();
+            } // Release
+            std::this_thread::yield();
+        }
+    } };
+
+    std::vector<std::thread> senders;
+    for (int sender = 0; sender < SENDERS; sender++) {
+        senders.emplace_back([&]() {
+            for (int message = 0; message < MESSAGES; message++) {
+                std::lock_guard<std::mutex> lock { room.m_mutex };
+                const auto sequence { ++room.m_sequence };
+                if (!room.m_snapshot) {
+                    room.m_snapshot = std::make_shared<const std::vector<std::size_t>>(room.m_members);
+                }
+                fanout.Run(room.m_snapshot, [=](std::size_t member) {
+                    auto& last { (*received)[member] };
+                    SimulateDelivery();
+                    if (last.load() >= sequence) {
+                        (*outOfOrder)++;
+                    }
+                    last = sequence;
+                    (*delivered)++;
+                });
+            }
+        });
+    }
+    for (auto& sender: senders) {
+        sender.join();
+    }
+    isSending = false;
+    churn.join();
+    pool.join();
+
+    EXPECT_GE(delivered->load(), MIN_MEMBERS * SENDERS * MESSAGES);
+    EXPECT_EQ(outOfOrder->load(), 0U);
+}
+
+/**
+ * Compare how long the broadcasting thread is busy for a 20k-member room:
+ * inline delivery versus chunks posted to the pool.
+ */
+TEST(FanoutTest, DISABLED_LargeRoomBroadcastBenchmark) {
+    constexpr std::size_t RECIPIENTS { 20'000 };
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    std::vector<int> members(RECIPIENTS);
+    std::iota(members.begin(), members.end(), 0);
+    auto recipients { std::make_shared<const std::vector<int>>(std::move(members)) };
+    std::atomic<std::size_t> delivered { 0 };
+    auto deliver = [&delivered](int) {
+        SimulateDelivery();
+        delivered++;
+    };
+
+    /// #1 Inline: the caller delivers everything
+    chat::Fanout serial;
+    auto start { Clock::now() };
+    EXPECT_FALSE(serial.Run(recipients, deliver));
+    const auto serialBlocked { duration_cast<microseconds>(Clock::now() - start).count() };
+    EXPECT_EQ(delivered.load(), RECIPIENTS);
+
+    /// #2 Parallel: the caller only posts chunks
+    delivered = 0;
+    boost::asio::thread_pool pool { 4 };
+    chat::Fanout parallel;
+    chat::FanoutPolicy policy;
+    policy.m_executor = pool.get_executor();
+    policy.m_threshold = 1024;
+    policy.m_chunkSize = 256;
+    parallel.SetPolicy(policy);
+
+    start = Clock::now();
+    EXPECT_TRUE(parallel.Run(recipients, deliver));
+    const auto parallelBlocked { duration_cast<microseconds>(Clock::now() - start).count() };
+    pool.join();
+    const auto parallelTotal { duration_cast<microseconds>(Clock::now() - start).count() };
+    EXPECT_EQ(delivered.load(), RECIPIENTS);
+
+    std::cout << "[ BENCH    ] broadcast to " << RECIPIENTS << " members: "
+        << "inline blocks caller " << serialBlocked << " us, "
+        << "chunked blocks caller " << parallelBlocked << " us "
+        << "(delivered in " << parallelTotal << " us on " << std::thread::hardware_concurrency() << " cpu)\n";
+}
+
+namespace {
+
+/**
+ * Chatroom of @count real sessions (not connected, their writes stay queued).
+ */
+struct ChatroomFixture {
+    std::shared_ptr<boost::asio::io_context> m_io { std::make_shared<boost::asio::io_context>() };
+    std::shared_ptr<boost::asio::ssl::context> m_ssl { 
+        std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) 
+    };
+    std::shared_ptr<chat::RoomService> m_service { std::make_shared<chat::RoomService>() };
+    std::shared_ptr<chat::Chatroom> m_room { std::make_shared<chat::Chatroom>("fanout") };
+    std::vector<std::shared_ptr<Session>> m_sessions;
+
+    explicit ChatroomFixture(std::size_t count) {
+        // far above the default capacity
+        m_room->SetCapacity(0);
+        m_sessions.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            net::Socket_t socket { *m_io };
+            m_sessions.push_back(std::make_shared<Session>(std::move(socket), m_service, m_io, m_ssl));
+            // as if it has shaken hands: the closed sessions are skipped
+            m_sessions.back()->AcknowledgeClient();
+            EXPECT_TRUE(m_room->AddSession(m_sessions.back()));
+        }
+    }
+
+    ~ChatroomFixture() {
+        m_room->Close();
+        m_io->poll();
+    }
+};
+
+}
+
+/**
+ * Several threads publish to a chatroom above the threshold while members 
+ * leave and rejoin. Every member must see the sequence numbers growing.
+ */
+TEST(FanoutTest, ChatroomKeepsSequenceOrderWithConcurrentPublishers) {
+    constexpr std::size_t MEMBERS { 1'200 };
+    constexpr int PUBLISHERS { 4 };
+    constexpr int MESSAGES { 100 };
+
+    // outlives the chatroom's strands
+    boost::asio::thread_pool pool { 4 };
+    ChatroomFixture fixture { MEMBERS };
+    chat::FanoutPolicy policy;
+    policy.m_executor = pool.get_executor();
+    policy.m_threshold = 1024;
+    policy.m_chunkSize = 64;
+    fixture.m_room->SetFanoutPolicy(policy);
+
+    std::unordered_map<const Session*, std::size_t> indexes;
+    for (std::size_t i = 0; i < MEMBERS; i++) {
+        indexes.emplace(fixture.m_sessions[i].get(), i);
+    }
+    // last sequence number seen by each member
+    auto received { std::make_shared<std::vector<std::atomic<std::uint64_t>>>(MEMBERS) };
+    auto outOfOrder { std::make_shared<std::atomic<std::size_t>>(0) };
+    auto delivered { std::make_shared<std::atomic<std::size_t>>(0) };
+    std::atomic<bool> isPublishing { true };
+
+    std::thread churn { [&]() {
+        std::mt19937 random { 7 };
+        while (isPublishing) {
+            const auto& session { fixture.m_sessions[random() % (MEMBERS / 4)] };
+            if (fixture.m_room->RemoveSession(session.get())) {
+                std::this_thread::yield();
+                EXPECT_TRUE(fixture.m_room->AddSession(session));
+            }
+        }
+    } };
+
+    std::vector<std::thread> publishers;
+    for (int publisher = 0; publisher < PUBLISHERS; publisher++) {
+        publishers.emplace_back([&]() {
+            for (int message = 0; message < MESSAGES; message++) {
+                // stamped by the builder under the room's lock
+                auto sequence { std::make_shared<std::uint64_t>(0) };
+                fixture.m_room->Publish(
+                    [sequence](std::uint64_t value) {
+                        *sequence = value;
+                        return std::string {};
+                    }, 
+                    [=, &indexes](const Session& session) {
+                        auto& last { (*received)[indexes.at(&session)] };
+                        if (last.load() >= *sequence) {
+                            (*outOfOrder)++;
+                        }
+                        last = *sequence;
+                        (*delivered)++;
+                        // nothing is written, only the order is checked
+                        return false;
+                    }
+                );
+            }
+        });
+    }
+    for (auto& publisher: publishers) {
+        publisher.join();
+    }
+    isPublishing = false;
+    churn.join();
+    pool.join();
+
+    EXPECT_EQ(fixture.m_room->GetSequence(), static_cast<std::uint64_t>(PUBLISHERS * MESSAGES));
+    EXPECT_GE(delivered->load(), (MEMBERS - MEMBERS / 4) * PUBLISHERS * MESSAGES);
+    EXPECT_EQ(outOfOrder->load(), 0U);
+}
+
+/**
+ * How long `Chatroom::Publish` keeps the caller busy in a 20k-member room 
+ * of real sessions: inline delivery versus chunks posted to the pool, 
+ * for one publisher and for several at once.
+ */
+TEST(FanoutTest, DISABLED_LargeChatroomPublishBenchmark) {
+    constexpr std::size_t MEMBERS { 20'000 };
+    constexpr int PUBLISHERS { 4 };
+    constexpr int MESSAGES { 4 };
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    const auto build = [](std::uint64_t sequence) {
+        return "{\"seq\":" + std::to_string(sequence) + "}";
+    };
+    const auto everyone = [](const Session&) { return true; };
+    // mean time a publisher is blocked when @PUBLISHERS publish at once
+    const auto publishConcurrently = [&](chat::Chatroom& room) {
+        std::atomic<std::int64_t> blocked { 0 };
+        std::vector<std::thread> publishers;
+        for (int publisher = 0; publisher < PUBLISHERS; publisher++) {
+            publishers.emplace_back([&]() {
+                for (int message = 0; message < MESSAGES; message++) {
+                    const auto start { Clock::now() };
+                    room.Publish(build, everyone);
+                    blocked += duration_cast<microseconds>(Clock::now() - start).count();
+                }
+            });
+        }
+        for (auto& publisher: publishers) {
+            publisher.join();
+        }
+        return blocked.load() / (PUBLISHERS * MESSAGES);
+    };
+
+    std::int64_t serialBlocked { 0 };
+    std::int64_t serialConcurrent { 0 };
+    { /// #1 Inline: the publisher writes to every session
+        ChatroomFixture fixture { MEMBERS };
+        const auto start { Clock::now() };
+        fixture.m_room->Publish(build, everyone);
+        serialBlocked = duration_cast<microseconds>(Clock::now() - start).count();
+        serialConcurrent = publishConcurrently(*fixture.m_room);
+    }
+
+    std::int64_t parallelBlocked { 0 };
+    std::int64_t parallelConcurrent { 0 };
+    { /// #2 Parallel: the publisher only posts chunks
+        boost::asio::thread_pool pool { 4 };
+        ChatroomFixture fixture { MEMBERS };
+        chat::FanoutPolicy policy;
+        policy.m_executor = pool.get_executor();
+        policy.m_threshold = 1024;
+        policy.m_chunkSize = 256;
+        fixture.m_room->SetFanoutPolicy(policy);
+        const auto start { Clock::now() };
+        fixture.m_room->Publish(build, everyone);
+        parallelBlocked = duration_cast<microseconds>(Clock::now() - start).count();
+        parallelConcurrent = publishConcurrently(*fixture.m_room);
+        pool.join();
+        EXPECT_EQ(fixture.m_room->GetSequence(), static_cast<std::uint64_t>(1 + PUBLISHERS * MESSAGES));
+    }
+
+    std::cout << "[ BENCH    ] publish to " << MEMBERS << " sessions: "
+        << "inline blocks caller " << serialBlocked << " us "
+        << "(" << serialConcurrent << " us with " << PUBLISHERS << " publishers), "
+        << "chunked blocks caller " << parallelBlocked << " us "
+        << "(" << parallelConcurrent << " us with " << PUBLISHERS << " publishers) "
+        << "on " << std::thread::hardware_concurrency() << " cpu\n";
+}
+
+#endif // FANOUT_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,365 @@
+#ifndef FEDERATION_TESTS_HPP
+#define FEDERATION_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Federation.hpp"
+#include "Message.hpp"
+#include "RoomService.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "single-client-messaging-tests.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+namespace {
+
+/**
+ * Keeps the frames sent over the link instead of writing them.
+ */
+class CapturingLink final : public chat::FederationLink {
+public:
+    void Send(std::string frame) override {
+        m_frames.push_back(std::move(frame));
+    }
+
+    bool IsClosed() const noexcept override {
+        return false;
+    }
+
+    /**
+     * Pass the captured frames to @federation as received over @link.
+     */
+    void DeliverTo(chat::Federation& federation, chat::FederationLink& link, bool reversed = false) {
+        std::vector<std::string> frames;
+        frames.swap(m_frames);
+        if (reversed) {
+            std::reverse(frames.begin(), frames.end());
+        }
+        for (const auto& frame: frames) {
+            Internal::Request request {};
+            request.Read(frame.substr(0, frame.size() - Internal::MESSAGE_DELIMITER.size()));
+            ASSERT_EQ(request.m_query, Internal::QueryType::FEDERATION);
+            ASSERT_TRUE(federation.Receive(link, request.m_attachment));
+        }
+    }
+
+    std::vector<std::string> m_frames;
+};
+
+std::string MakeChatFrame(const std::string& message, std::uint64_t chatroomId) {
+    Internal::Response response {};
+    response.m_query = Internal::QueryType::CHAT_MESSAGE;
+    response.m_status = 200;
+    response.m_attachment = "{\"message\":\"" + message + 
+        "\",\"chatroom\":{\"id\":" + std::to_string(chatroomId) + "}}";
+    std::string frame;
+    response.Write(frame);
+    return frame;
+}
+
+}
+
+TEST(FederationTest, RelaysOncePerNodeInOrder) {
+    chat::Federation first { "first", "secret" };
+    chat::Federation second { "second", "secret" };
+    std::vector<std::pair<std::string, std::string>> delivered;
+    second.SetDelivery([&delivered](const std::string& room, const std::string& message) {
+        delivered.emplace_back(room, message);
+    });
+    EXPECT_TRUE(second.Authenticate("secret"));
+    EXPECT_FALSE(second.Authenticate("secreT"));
+    EXPECT_FALSE(second.Authenticate("secret!"));
+    EXPECT_FALSE(chat::Federation("open", "").Authenticate(""));
+
+    // the first node has two links to the second one
+    auto firstToSecond { std::make_shared<CapturingLink>() };
+    auto firstToSecondAgain { std::make_shared<CapturingLink>() };
+    auto secondToFirst { std::make_shared<CapturingLink>() };
+    auto secondToFirstAgain { std::make_shared<CapturingLink>() };
+    first.AddLink(firstToSecond);
+    first.AddLink(firstToSecondAgain);
+    second.AddLink(secondToFirst);
+    second.AddLink(secondToFirstAgain);
+    second.HoldRoom("lobby");
+    second.HoldRoom("lobby");
+    secondToFirst->DeliverTo(first, *firstToSecond);
+    secondToFirstAgain->DeliverTo(first, *firstToSecondAgain);
+    firstToSecond->DeliverTo(second, *secondToFirst);
+    firstToSecondAgain->DeliverTo(second, *secondToFirstAgain);
+    EXPECT_EQ(first.GetPeers(), (std::vector<std::string>{ "second", "second" }));
+
+    constexpr std::size_t MESSAGES { 10 };
+    for (std::size_t i = 0; i < MESSAGES; i++) {
+        first.Relay("lobby", MakeChatFrame("message #" + std::to_string(i), 7));
+    }
+    // nobody is in this chatroom on the second node
+    first.Relay("kitchen", MakeChatFrame("unheard", 8));
+    EXPECT_EQ(firstToSecond->m_frames.size() + firstToSecondAgain->m_frames.size(), MESSAGES);
+    EXPECT_EQ(first.GetStats().m_relayed, MESSAGES);
+
+    // frames handled in the reverse order are still applied in the sent one
+    firstToSecond->DeliverTo(second, *secondToFirst, true);
+    firstToSecondAgain->DeliverTo(second, *secondToFirstAgain, true);
+    ASSERT_EQ(delivered.size(), MESSAGES);
+    for (std::size_t i = 0; i < MESSAGES; i++) {
+        EXPECT_EQ(delivered[i].first, "lobby");
+        EXPECT_NE(delivered[i].second.find("message #" + std::to_string(i) + "\""), std::string::npos);
+        EXPECT_EQ(delivered[i].second.find(Internal::MESSAGE_DELIMITER), std::string::npos);
+    }
+    EXPECT_EQ(second.GetStats().m_delivered, MESSAGES);
+
+    // the last member left (one of two chatrooms with this name is still held)
+    second.ReleaseRoom("lobby");
+    EXPECT_TRUE(secondToFirst->m_frames.empty());
+    second.ReleaseRoom("lobby");
+    secondToFirst->DeliverTo(first, *firstToSecond);
+    secondToFirstAgain->DeliverTo(first, *firstToSecondAgain);
+    first.Relay("lobby", MakeChatFrame("unheard", 7));
+    EXPECT_TRUE(firstToSecond->m_frames.empty());
+    EXPECT_TRUE(firstToSecondAgain->m_frames.empty());
+}
+
+TEST(FederationTest, RelayedMessageGetsLocalChatroomId) {
+    chat::RoomService service;
+    const auto other { service.CreateChatroom("other") };
+    const auto lobby { service.CreateChatroom("lobby") };
+    ASSERT_NE(other, lobby);
+    // nothing to deliver to, just make sure unknown chatrooms are ignored
+    service.DeliverRelayed("kitchen", R"({"query":"chat-message","timestamp":0,"status":200})");
+    service.DeliverRelayed("lobby", R"({"query":"chat-message","timestamp":0,"status":200,)"
+        R"("attachment":{"message":"hi","chatroom":{"id":12345}}})"
+    );
+    service.DeliverRelayed("lobby", "not json");
+}
+
+TEST(FederationTest, ConcurrentPublishersAreRelayedInSequenceOrder) {
+    constexpr int PUBLISHERS { 4 };
+    constexpr int MESSAGES { 50 };
+
+    chat::RoomService service;
+    auto first { std::make_shared<chat::Federation>("first", "secret") };
+    chat::Federation second { "second", "secret" };
+    service.SetFederation(first);
+    std::vector<std::string> delivered;
+    second.SetDelivery([&delivered](const std::string&, const std::string& message) {
+        delivered.push_back(message);
+    });
+    auto firstToSecond { std::make_shared<CapturingLink>() };
+    auto secondToFirst { std::make_shared<CapturingLink>() };
+    first->AddLink(firstToSecond);
+    second.AddLink(secondToFirst);
+    second.HoldRoom("lobby");
+    secondToFirst->DeliverTo(*first, *firstToSecond);
+    firstToSecond->DeliverTo(second, *secondToFirst);
+
+    const auto lobby { service.CreateChatroom("lobby") };
+    std::vector<std::thread> publishers;
+    for (int publisher = 0; publisher < PUBLISHERS; publisher++) {
+        publishers.emplace_back([&]() {
+            for (int message = 0; message < MESSAGES; message++) {
+                EXPECT_TRUE(service.Publish(lobby, [lobby](std::uint64_t sequence) {
+                    Internal::Response response {};
+                    response.m_query = Internal::QueryType::CHAT_MESSAGE;
+                    response.m_status = 200;
+                    response.m_attachment = "{\"message\":\"hi\",\"chatroom\":{\"id\":" 
+                        + std::to_string(lobby) + ",\"seq\":" + std::to_string(sequence) + "}}";
+                    std::string frame;
+                    response.Write(frame);
+                    return frame;
+                }, [](const Session&) { return true; }));
+            }
+        });
+    }
+    for (auto& publisher: publishers) {
+        publisher.join();
+    }
+
+    // the second node applies the frames in the order of the link's sequence
+    firstToSecond->DeliverTo(second, *secondToFirst);
+    ASSERT_EQ(delivered.size(), static_cast<std::size_t>(PUBLISHERS * MESSAGES));
+    for (std::size_t i = 0; i < delivered.size(); i++) {
+        rapidjson::Document doc;
+        doc.Parse(delivered[i].c_str());
+        ASSERT_TRUE(doc.IsObject());
+        EXPECT_EQ(doc["attachment"]["chatroom"]["seq"].GetUint64(), i + 1);
+    }
+}
+
+TEST(FederationTest, EmptySecretKeepsNodeStandalone) {
+    constexpr std::uint16_t PORT { 15013 };
+    auto context { std::make_shared<boost::asio::io_context>() };
+    const Testing::ConfigFile config { "federation-open.cfg", {
+        { "node_id", "open" },
+        { "federation_secret", "" },
+        { "federation_peers", "127.0.0.1:15011" }
+    } };
+    Server server { context, PORT, config.GetPath() };
+    EXPECT_EQ(server.GetFederation(), nullptr);
+    EXPECT_EQ(server.GetRoomService()->GetFederation(), nullptr);
+    server.Shutdown();
+}
+
+/**
+ * Two nodes on localhost: the second one connects to the first one. 
+ */
+class FederationNodesTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t FIRST_PORT { 15011 };
+    static constexpr std::uint16_t SECOND_PORT { 15012 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_firstConfig.emplace("federation-first.cfg", MakeOverrides("first", ""));
+        m_secondConfig.emplace("federation-second.cfg", 
+            MakeOverrides("second", "127.0.0.1:" + std::to_string(FIRST_PORT))
+        );
+        m_first = std::make_unique<Server>(m_context, FIRST_PORT, m_firstConfig->GetPath());
+        m_second = std::make_unique<Server>(m_context, SECOND_PORT, m_secondConfig->GetPath());
+        m_first->Start();
+        m_second->Start();
+        for (int i = 0; i < 4; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_second->Shutdown();
+        m_first->Shutdown();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        m_secondConfig.reset();
+        m_firstConfig.reset();
+    }
+
+    /**
+     * Federation settings of the node.
+     */
+    static Testing::ConfigFile::Overrides MakeOverrides(const std::string& node, const std::string& peers) {
+        return {
+            { "node_id", node },
+            { "federation_secret", "test-secret" },
+            { "federation_peers", peers }
+        };
+    }
+
+    std::shared_ptr<Client> Connect(std::uint16_t port) {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(port));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    }
+
+    void Send(Client& client, Internal::QueryType query, const std::string& attachment) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_attachment = attachment;
+        std::string serialized;
+        request.Write(serialized);
+        client.Write(std::move(serialized));
+    }
+
+    /**
+     * Join the chatroom and wait for the reply.
+     */
+    void Join(Client& client, const std::string& user, std::uint64_t chatroomId) {
+        const auto responses { client.GetResponseCount() };
+        this->Send(client, Internal::QueryType::JOIN_CHATROOM, 
+            "{\"user\":{\"name\":\"" + user + "\"},\"chatroom\":{\"id\":" + std::to_string(chatroomId) + "}}"
+        );
+        ASSERT_TRUE(Testing::WaitUntil([&]() { return client.GetResponseCount() > responses; }));
+        ASSERT_EQ(client.GetLastResponse().m_status, 200);
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<Testing::ConfigFile> m_firstConfig;
+    std::optional<Testing::ConfigFile> m_secondConfig;
+    std::unique_ptr<Server> m_first {};
+    std::unique_ptr<Server> m_second {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(FederationNodesTest, BroadcastReachesPeerNodeOnce) {
+    const auto first { m_first->GetFederation() };
+    const auto second { m_second->GetFederation() };
+    ASSERT_TRUE(first && second);
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return first->GetStats().m_links == 1 && second->GetStats().m_links == 1; 
+    }));
+
+    // the chatroom is the same across nodes by name, IDs differ
+    const auto firstLobby { m_first->GetRoomService()->CreateChatroom("lobby") };
+    m_second->GetRoomService()->CreateChatroom("decoy");
+    const auto secondLobby { m_second->GetRoomService()->CreateChatroom("lobby") };
+    ASSERT_NE(firstLobby, secondLobby);
+
+    auto sender { this->Connect(FIRST_PORT) };
+    auto reader { this->Connect(SECOND_PORT) };
+    auto anotherReader { this->Connect(SECOND_PORT) };
+    this->Join(*sender, "sender", firstLobby);
+    this->Join(*reader, "reader", secondLobby);
+    this->Join(*anotherReader, "another", secondLobby);
+    // the second node advertised the chatroom
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return first->GetPeers() == std::vector<std::string>{ "second" }; 
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    constexpr std::size_t MESSAGES { 20 };
+    const auto readerResponses { reader->GetResponseCount() };
+    const auto anotherResponses { anotherReader->GetResponseCount() };
+    for (std::size_t i = 0; i < MESSAGES; i++) {
+        this->Send(*sender, Internal::QueryType::CHAT_MESSAGE, 
+            "{\"message\":\"message #" + std::to_string(i) + "\",\"chatroom\":{\"id\":" + std::to_string(firstLobby) + "}}"
+        );
+    }
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return reader->GetResponseCount() == readerResponses + MESSAGES
+            && anotherReader->GetResponseCount() == anotherResponses + MESSAGES; 
+    }));
+    // relayed once for the node with two members
+    EXPECT_EQ(first->GetStats().m_relayed, MESSAGES);
+    EXPECT_EQ(second->GetStats().m_delivered, MESSAGES);
+
+    for (const auto& client: { reader, anotherReader }) {
+        const auto response { client->GetLastResponse() };
+        EXPECT_EQ(response.m_query, Internal::QueryType::CHAT_MESSAGE);
+        rapidjson::Document doc;
+        doc.Parse(response.m_attachment.c_str());
+        ASSERT_TRUE(doc.IsObject());
+        EXPECT_STREQ(doc["message"].GetString(), ("message #" + std::to_string(MESSAGES - 1)).c_str());
+        EXPECT_EQ(doc["chatroom"]["id"].GetUint64(), secondLobby);
+    }
+}
+
+#endif // FEDERATION_TESTS_HPP
\ No newline at end of file
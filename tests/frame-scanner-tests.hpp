@@ -0,0 +1,228 @@
+#ifndef FRAME_SCANNER_TESTS_HPP
+#define FRAME_SCANNER_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "FrameScanner.hpp"
+#include "RequestQueue.hpp"
+#include "Message.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+
+TEST(FrameScannerTest, FindDelimiter) {
+    EXPECT_EQ(Internal::FindDelimiter(""), std::string_view::npos);
+    EXPECT_EQ(Internal::FindDelimiter("\r\n\r"), std::string_view::npos);
+    EXPECT_EQ(Internal::FindDelimiter("\r\n\r\n"), 0U);
+    EXPECT_EQ(Internal::FindDelimiter("abc\r\n\r\n"), 3U);
+    // false candidates
+    EXPECT_EQ(Internal::FindDelimiter("a\rb\r\nc\r\n\r\r\n\r\n"), 9U);
+    EXPECT_EQ(Internal::FindDelimiter("abc\r\n\r\ndef\r\n\r\n", 4), 10U);
+}
+
+TEST(FrameScannerTest, ExtractAllFramesAndKeepPartial) {
+    const std::string data { "first\r\n\r\nsecond\r\n\r\n\r\n\r\nthi" };
+    std::vector<std::string> frames;
+    const auto consumed = Internal::ExtractFrames(data, [&](std::string_view frame) {
+        frames.emplace_back(frame);
+    });
+    
+    const std::vector<std::string> expected { "first", "second", "" };
+    EXPECT_EQ(frames, expected);
+    EXPECT_EQ(data.substr(consumed), "thi");
+}
+
+TEST(FrameScannerTest, FrameSplitAcrossReads) {
+    std::string frame;
+    Internal::Request request;
+    request.m_query = Internal::QueryType::LIST_CHATROOM;
+    request.m_timestamp = 1;
+    request.Write(frame);
+
+    /// Deliver byte by byte like the inbox of the `net::Connection`
+    std::string inbox;
+    std::size_t extracted { 0 };
+    for (char byte: frame) {
+        inbox.push_back(byte);
+        const auto consumed = Internal::ExtractFrames(inbox, [&](std::string_view received) {
+            Internal::Request parsed;
+            parsed.Read(std::string{ received });
+            EXPECT_EQ(parsed.m_query, request.m_query);
+            extracted++;
+        });
+        inbox.erase(0, consumed);
+    }
+    EXPECT_EQ(extracted, 1U);
+    EXPECT_TRUE(inbox.empty());
+}
+
+TEST(FrameScannerTest, PartialFrameIsSearchedOnce) {
+    const std::string data { "first\r\n\r\nsecond\r\n\r\n" };
+    // every split, the delimiter may straddle the reads
+    for (std::size_t split = 0; split <= data.size(); split++) {
+        std::vector<std::string> frames;
+        auto collect = [&frames](std::string_view frame) { frames.emplace_back(frame); };
+        std::string inbox { data.substr(0, split) };
+        std::size_t scanned { 0 };
+        inbox.erase(0, Internal::ExtractFrames(inbox, scanned, collect));
+        EXPECT_EQ(scanned, inbox.size());
+        inbox += data.substr(split);
+        inbox.erase(0, Internal::ExtractFrames(inbox, scanned, collect));
+        EXPECT_EQ(frames, (std::vector<std::string> { "first", "second" })) << "split at " << split;
+        EXPECT_TRUE(inbox.empty());
+        EXPECT_EQ(scanned, 0U);
+    }
+
+    /// A large frame comes in chunks: only the new bytes are searched
+    constexpr std::size_t FRAME_SIZE { 1024 * 1024 };
+    constexpr std::size_t CHUNK { 16 * 1024 };
+    const std::string large { std::string(FRAME_SIZE, 'x') + Internal::MESSAGE_DELIMITER };
+    std::string inbox;
+    std::size_t scanned { 0 };
+    std::size_t extracted { 0 };
+    for (std::size_t offset = 0; offset < large.size(); offset += CHUNK) {
+        inbox.append(large, offset, CHUNK);
+        inbox.erase(0, Internal::ExtractFrames(inbox, scanned, [&](std::string_view frame) {
+            EXPECT_EQ(frame.size(), FRAME_SIZE);
+            extracted++;
+        }));
+        // the next search starts where this one stopped
+        EXPECT_EQ(scanned, inbox.size());
+    }
+    EXPECT_EQ(extracted, 1U);
+    EXPECT_TRUE(inbox.empty());
+}
+
+namespace {
+    /**
+     * @count list requests as the client pipelines them.
+     */
+    std::string MakePipelinedStream(std::size_t count) {
+        std::string stream;
+        std::string frame;
+        for (std::size_t i = 0; i < count; i++) {
+            Internal::Request request;
+            request.m_query = Internal::QueryType::LIST_CHATROOM;
+            request.m_timestamp = static_cast<long long>(i);
+            request.Write(frame);
+            stream += frame;
+        }
+        return stream;
+    }
+
+    /**
+     * Push every complete frame of a @chunk sized read to the @queue in one batch.
+     * @return 
+     *  Number of the pushed batches (wake-ups of the session) and of the requests.
+     */
+    std::pair<std::size_t, std::size_t> PushInBatches(
+        const std::string& stream, 
+        std::size_t chunk, 
+        rt::RequestQueue& queue
+    ) {
+        std::size_t wakeups { 0 };
+        std::size_t extracted { 0 };
+        std::string inbox;
+        for (std::size_t offset = 0; offset < stream.size(); offset += chunk) {
+            inbox.append(stream, offset, chunk);
+            std::vector<Internal::Request> batch;
+            const auto consumed = Internal::ExtractFrames(inbox, [&](std::string_view frame) {
+                Internal::Request request;
+                request.Read(std::string{ frame });
+                batch.emplace_back(std::move(request));
+            });
+            inbox.erase(0, consumed);
+            if (!batch.empty()) {
+                extracted += batch.size();
+                queue.Push(std::move(batch));
+                wakeups++;
+            }
+        }
+        EXPECT_TRUE(inbox.empty());
+        return { wakeups, extracted };
+    }
+}
+
+TEST(FrameScannerTest, PipelinedRequestsArePushedPerRead) {
+    constexpr std::size_t FRAMES { 2'000 };
+    constexpr std::size_t CHUNK { 16 * 1024 };
+    const auto stream { MakePipelinedStream(FRAMES) };
+    rt::RequestQueue queue;
+    const auto [wakeups, extracted] = PushInBatches(stream, CHUNK, queue);
+    EXPECT_EQ(extracted, FRAMES);
+    EXPECT_LE(wakeups, stream.size() / CHUNK + 1);
+}
+
+/**
+ * Compare the old path (a frame per read completion and a push per frame)
+ * with batch extraction of the pipelined requests from large reads.
+ */
+TEST(FrameScannerTest, DISABLED_PipelinedRequestsBenchmark) {
+    constexpr std::size_t FRAMES { 20'000 };
+    constexpr std::size_t CHUNK { 16 * 1024 };
+    const auto stream { MakePipelinedStream(FRAMES) };
+
+    using Clock = std::chrono::steady_clock;
+
+    /// #1 One frame per read
+    rt::RequestQueue single;
+    const auto singleStart { Clock::now() };
+    for (std::size_t offset = 0; offset < stream.size(); ) {
+        const auto pos { stream.find(Internal::MESSAGE_DELIMITER, offset) };
+        Internal::Request request;
+        request.Read(stream.substr(offset, pos - offset));
+        single.Push(std::move(request));
+        offset = pos + Internal::MESSAGE_DELIMITER.size();
+    }
+    const auto singleTime { Clock::now() - singleStart };
+
+    /// #2 Every complete frame of a chunk in one batch
+    rt::RequestQueue batched;
+    const auto batchedStart { Clock::now() };
+    const auto [wakeups, extracted] = PushInBatches(stream, CHUNK, batched);
+    const auto batchedTime { Clock::now() - batchedStart };
+    ASSERT_EQ(extracted, FRAMES);
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    const auto singleUs = std::max<long long>(1, duration_cast<microseconds>(singleTime).count());
+    const auto batchedUs = std::max<long long>(1, duration_cast<microseconds>(batchedTime).count());
+    std::cout << "[ BENCH    ] pipelined " << FRAMES << " requests: "
+        << "single " << FRAMES * 1'000'000 / singleUs << " req/s (" << FRAMES << " wakeups), "
+        << "batched " << FRAMES * 1'000'000 / batchedUs << " req/s (" << wakeups << " wakeups)\n";
+}
+
+/**
+ * Search of a large frame coming in chunks: from the start of the inbox 
+ * on every read or only through the new bytes.
+ */
+TEST(FrameScannerTest, DISABLED_LargeFrameScanBenchmark) {
+    constexpr std::size_t FRAME_SIZE { 1024 * 1024 };
+    constexpr std::size_t CHUNK { 16 * 1024 };
+    const std::string large { std::string(FRAME_SIZE, 'x') + Internal::MESSAGE_DELIMITER };
+    using Clock = std::chrono::steady_clock;
+    auto feed = [&](bool isResumed) {
+        std::string inbox;
+        std::size_t scanned { 0 };
+        const auto start { Clock::now() };
+        for (std::size_t offset = 0; offset < large.size(); offset += CHUNK) {
+            inbox.append(large, offset, CHUNK);
+            if (!isResumed) {
+                scanned = 0;
+            }
+            inbox.erase(0, Internal::ExtractFrames(inbox, scanned, [](std::string_view) {}));
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    };
+    const auto rescanned { feed(false) };
+    const auto resumed { feed(true) };
+    std::cout << "[ BENCH    ] " << FRAME_SIZE << " bytes frame in " << CHUNK << " bytes reads: "
+        << "rescanned " << rescanned << " us, resumed " << resumed << " us\n";
+}
+
+#endif // FRAME_SCANNER_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,160 @@
+#ifndef HANDLE_TABLE_TESTS_HPP
+#define HANDLE_TABLE_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "HandleTable.hpp"
+#include "Chatroom.hpp"
+#include "RoomService.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(HandleTableTest, StaleHandleIsRejected) {
+    rt::HandleTable<int> table;
+    const auto first { table.Allocate() };
+    EXPECT_NE(first, rt::HandleTable<int>::NONE);
+    EXPECT_TRUE(table.IsValid(first));
+    EXPECT_EQ(table.Find(first), nullptr); // nothing is set yet
+    EXPECT_TRUE(table.Set(first, std::make_shared<int>(1)));
+    ASSERT_NE(table.Find(first), nullptr);
+    EXPECT_EQ(*table.Find(first), 1);
+    EXPECT_EQ(table.GetSize(), 1U);
+
+    EXPECT_TRUE(table.Release(first));
+    EXPECT_FALSE(table.Release(first));
+    EXPECT_FALSE(table.IsValid(first));
+    EXPECT_EQ(table.Find(first), nullptr);
+
+    // the slot is reused with the next generation
+    const auto second { table.Allocate() };
+    EXPECT_EQ(rt::HandleTable<int>::GetIndex(second), rt::HandleTable<int>::GetIndex(first));
+    EXPECT_NE(rt::HandleTable<int>::GetGeneration(second), rt::HandleTable<int>::GetGeneration(first));
+    EXPECT_TRUE(table.Set(second, std::make_shared<int>(2)));
+    EXPECT_FALSE(table.Set(first, std::make_shared<int>(3)));
+    EXPECT_EQ(table.Find(first), nullptr);
+    EXPECT_EQ(*table.Find(second), 2);
+    // forged handles
+    EXPECT_EQ(table.Find(rt::HandleTable<int>::NONE), nullptr);
+    EXPECT_EQ(table.Find(second + 1U), nullptr);
+    EXPECT_EQ(table.Find(second + (std::uint64_t { 1 } << 32U)), nullptr);
+}
+
+TEST(HandleTableTest, AdoptedHandlesKeepTheirIds) {
+    using Table = rt::HandleTable<int>;
+    // handles of the previous table: {generation, index}
+    const Table::Handle second { (3ULL << 32U) | 1U };
+    const Table::Handle fifth { (1ULL << 32U) | 4U };
+    Table table;
+    EXPECT_TRUE(table.Adopt(second));
+    EXPECT_TRUE(table.Adopt(fifth));
+    EXPECT_FALSE(table.Adopt((1ULL << 32U) | 2U)); // out of order
+    EXPECT_FALSE(table.Adopt((2ULL << 32U) | 7U)); // released handle
+    EXPECT_EQ(table.GetSize(), 2U);
+    EXPECT_TRUE(table.Set(second, std::make_shared<int>(2)));
+    EXPECT_TRUE(table.Set(fifth, std::make_shared<int>(5)));
+    ASSERT_NE(table.Find(second), nullptr);
+    EXPECT_EQ(*table.Find(second), 2);
+
+    // the skipped slots are allocated first
+    std::vector<std::uint32_t> indexes;
+    for (int i = 0; i < 4; i++) {
+        const auto handle { table.Allocate() };
+        EXPECT_NE(handle, second);
+        EXPECT_NE(handle, fifth);
+        indexes.push_back(Table::GetIndex(handle));
+    }
+    std::sort(indexes.begin(), indexes.end());
+    EXPECT_EQ(indexes, (std::vector<std::uint32_t>{ 0, 2, 3, 5 }));
+    EXPECT_EQ(table.GetSize(), 6U);
+}
+
+TEST(HandleTableTest, ConcurrentChurnKeepsHandlesUnique) {
+    constexpr std::size_t THREADS { 4 };
+    constexpr std::size_t ROUNDS { 20'000 };
+    constexpr std::size_t KEEP { 16 };
+
+    rt::HandleTable<std::size_t> table;
+    std::atomic<std::size_t> mismatches { 0 };
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([&table, &mismatches, t]() {
+            std::vector<std::pair<rt::HandleTable<std::size_t>::Handle, std::size_t>> live;
+            for (std::size_t i = 0; i < ROUNDS; i++) {
+                const auto handle { table.Allocate() };
+                const auto value { t * ROUNDS + i };
+                table.Set(handle, std::make_shared<std::size_t>(value));
+                live.emplace_back(handle, value);
+                if (live.size() > KEEP) {
+                    const auto [oldest, expected] = live.front();
+                    live.erase(live.begin());
+                    const auto found { table.Find(oldest) };
+                    if (!found || *found != expected || !table.Release(oldest) || table.Find(oldest)) {
+                        mismatches++;
+                    }
+                }
+            }
+            for (const auto& [handle, value]: live) {
+                table.Release(handle);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0U);
+    EXPECT_EQ(table.GetSize(), 0U);
+}
+
+TEST(HandleTableTest, ChatroomIdsAreUniqueAcrossThreads) {
+    constexpr std::size_t THREADS { 4 };
+    constexpr std::size_t ROOMS { 2'000 };
+
+    std::vector<std::vector<std::size_t>> ids(THREADS);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([&ids, t]() {
+            for (std::size_t i = 0; i < ROOMS; i++) {
+                ids[t].push_back(chat::Chatroom { "room" }.GetId());
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    std::vector<std::size_t> all;
+    for (const auto& part: ids) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+}
+
+TEST(HandleTableTest, RemovedChatroomIdIsNotReused) {
+    using Table = rt::HandleTable<chat::Chatroom>;
+    chat::RoomService service;
+    const auto first { service.CreateChatroom("first") };
+    ASSERT_NE(first, chat::Chatroom::NO_ROOM);
+    EXPECT_TRUE(service.ExistChatroom(first));
+    service.RemoveChatroom(first); // no other thread uses the service
+    EXPECT_FALSE(service.ExistChatroom(first));
+
+    // the slot is reused, the ID isn't
+    const auto second { service.CreateChatroom("second") };
+    EXPECT_EQ(Table::GetIndex(second), Table::GetIndex(first));
+    EXPECT_NE(second, first);
+    EXPECT_FALSE(service.ExistChatroom(first));
+    EXPECT_TRUE(service.ExistChatroom(second));
+    const auto data { service.GetChatroomData(second) };
+    ASSERT_TRUE(data);
+    EXPECT_EQ(std::get<0>(*data), second);
+    EXPECT_EQ(std::get<2>(*data), "second");
+}
+
+#endif // HANDLE_TABLE_TESTS_HPP
\ No newline at end of file
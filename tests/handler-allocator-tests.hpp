@@ -0,0 +1,159 @@
+#ifndef HANDLER_ALLOCATOR_TESTS_HPP
+#define HANDLER_ALLOCATOR_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "allocation-counter.hpp"
+#include "HandlerAllocator.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+
+#include <boost/asio.hpp>
+
+namespace {
+
+/**
+ * Two peers bounce a line over a socket pair using the same composition
+ * as the connections: `bind_executor(strand, handler)` around `async_read_until`
+ * and `async_write`, with a read always pending on both peers.
+ * @tparam Recycle 
+ *  Whether handlers are wrapped with `MakeAllocatingHandler`.
+ */
+template<bool Recycle>
+class PingPong {
+public:
+    using Socket = boost::asio::local::stream_protocol::socket;
+
+    PingPong(boost::asio::io_context& io) 
+        : m_strand { boost::asio::make_strand(io) }
+        , m_peers { Peer{ Socket{ io } }, Peer{ Socket{ io } } }
+    {
+        boost::asio::local::connect_pair(m_peers[0].m_socket, m_peers[1].m_socket);
+        for (auto& peer: m_peers) {
+            // allocate the inbox storage up front
+            peer.m_inbox.prepare(512);
+        }
+    }
+
+    void Start(std::size_t rounds) {
+        m_rounds = rounds;
+        this->Read(0);
+        this->Read(1);
+        this->Write(0);
+    }
+
+private:
+
+    struct Peer {
+        Socket m_socket;
+        boost::asio::streambuf m_inbox {};
+        Internal::HandlerMemory m_readMemory {};
+        Internal::HandlerMemory m_writeMemory {};
+    };
+
+    template<class Handler>
+    auto Bind(Internal::HandlerMemory& memory, Handler&& handler) {
+        if constexpr (Recycle) {
+            return boost::asio::bind_executor(m_strand, 
+                Internal::MakeAllocatingHandler(memory, std::forward<Handler>(handler))
+            );
+        }
+        else {
+            return boost::asio::bind_executor(m_strand, std::forward<Handler>(handler));
+        }
+    }
+
+    void Read(std::size_t peer) {
+        auto& self { m_peers[peer] };
+        boost::asio::async_read_until(self.m_socket, self.m_inbox, '\n', 
+            this->Bind(self.m_readMemory, [this, peer](const boost::system::error_code& error, std::size_t bytes) {
+                if (error) {
+                    return;
+                }
+                m_peers[peer].m_inbox.consume(bytes);
+                if (peer == 0 && --m_rounds == 0) {
+                    // stop the exchange: close both sockets to cancel reads
+                    m_peers[0].m_socket.close();
+                    m_peers[1].m_socket.close();
+                    return;
+                }
+                this->Write(peer);
+                this->Read(peer);
+            })
+        );
+    }
+
+    void Write(std::size_t peer) {
+        auto& self { m_peers[peer] };
+        boost::asio::async_write(self.m_socket, boost::asio::buffer(LINE, sizeof(LINE) - 1),
+            this->Bind(self.m_writeMemory, [](const boost::system::error_code&, std::size_t) {})
+        );
+    }
+
+    static constexpr char LINE[] { "ping\n" };
+
+    boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
+    Peer m_peers[2];
+    std::size_t m_rounds { 0 };
+};
+
+/**
+ * @return Number of allocations made by @rounds of exchange
+ *  after a short warm up.
+ */
+template<bool Recycle>
+std::size_t CountExchangeAllocations(std::size_t rounds) {
+    boost::asio::io_context io;
+    {
+        // warm up the reactor and the strand
+        PingPong<Recycle> warmup { io };
+        warmup.Start(16);
+        io.run();
+        io.restart();
+    }
+    PingPong<Recycle> exchange { io };
+    io.poll();
+    io.restart();
+    const auto before { Testing::GetAllocationCount() };
+    exchange.Start(rounds);
+    io.run();
+    return Testing::GetAllocationCount() - before;
+}
+
+}
+
+TEST(HandlerAllocatorTest, RecyclesSingleBlock) {
+    Internal::HandlerMemory memory;
+    void *first = memory.Allocate(64);
+    // the block is busy, so it falls back to the heap
+    void *second = memory.Allocate(64);
+    EXPECT_NE(first, second);
+    memory.Deallocate(second);
+    memory.Deallocate(first);
+    EXPECT_EQ(memory.Allocate(128), first);
+    memory.Deallocate(first);
+    // too big for the block
+    void *big = memory.Allocate(64 * 1024);
+    EXPECT_NE(big, first);
+    memory.Deallocate(big);
+}
+
+TEST(HandlerAllocatorTest, SteadyStateIODoesNotAllocate) {
+    EXPECT_EQ(CountExchangeAllocations<true>(1000), 0U);
+}
+
+/**
+ * Compare the allocations of the default handlers with the recycled memory.
+ */
+TEST(HandlerAllocatorTest, DISABLED_ExchangeAllocationsBenchmark) {
+    constexpr std::size_t ROUNDS { 1000 };
+    const auto defaultAllocations { CountExchangeAllocations<false>(ROUNDS) };
+    const auto recycledAllocations { CountExchangeAllocations<true>(ROUNDS) };
+    std::cout << "[ BENCH    ] " << ROUNDS << " round trips: "
+        << defaultAllocations << " allocations with default handlers, "
+        << recycledAllocations << " with recycled handler memory\n";
+}
+
+#endif // HANDLER_ALLOCATOR_TESTS_HPP
\ No newline at end of file
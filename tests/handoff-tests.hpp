@@ -0,0 +1,202 @@
+#ifndef HANDOFF_TESTS_HPP
+#define HANDOFF_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Handoff.hpp"
+#include "Message.hpp"
+#include "RoomService.hpp"
+#include "ResumeRegistry.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#ifdef CHAT_HAS_SOCKET_HANDOFF
+
+/**
+ * The next server takes over the port from the running one in the same process. 
+ */
+class HandoffTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15021 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_channel = (Testing::GetTempDirectory() / "handoff-test.sock").string();
+        m_config.emplace("handoff.cfg", Testing::ConfigFile::Overrides {
+            { "handoff_path", m_channel }
+        });
+        m_previous = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+        m_previous->Start();
+        for (int i = 0; i < 4; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        if (m_next) {
+            m_next->Shutdown();
+        }
+        m_previous->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        // the listening Unix socket isn't removed by the server
+        std::error_code ignore;
+        std::filesystem::remove(m_channel, ignore);
+        m_config.reset();
+    }
+
+    std::shared_ptr<Client> Connect() {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    }
+
+    /**
+     * List the chatrooms and wait for the reply.
+     */
+    std::string ListChatrooms(Client& client) {
+        const auto responses { client.GetResponseCount() };
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::LIST_CHATROOM;
+        request.m_timestamp = Utils::GetTimestamp();
+        std::string serialized;
+        request.Write(serialized);
+        client.Write(std::move(serialized));
+        EXPECT_TRUE(Testing::WaitUntil([&]() { return client.GetResponseCount() > responses; }));
+        return client.GetLastResponse().m_attachment;
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::string m_channel {};
+    std::optional<Testing::ConfigFile> m_config;
+    std::unique_ptr<Server> m_previous {};
+    std::unique_ptr<Server> m_next {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(HandoffTest, NextServerTakesOverListener) {
+    m_previous->GetRoomService()->CreateChatroom("kept");
+    auto connected { this->Connect() };
+
+    // binding the same port would fail, the socket is taken over instead
+    m_next = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+    ASSERT_TRUE(Testing::WaitUntil([this]() { return m_previous->IsDraining(); }));
+    m_next->Start();
+    m_next->GetRoomService()->CreateChatroom("fresh");
+    const auto nextRooms { *m_next->GetRoomService()->GetSerializedChatroomList() };
+    EXPECT_NE(nextRooms.find("\"kept\""), std::string::npos) << nextRooms;
+
+    // the established connection stays with the previous server
+    const auto previousRooms { this->ListChatrooms(*connected) };
+    EXPECT_EQ(connected->GetState(), Client::State::RECEIVE_ACK);
+    EXPECT_NE(previousRooms.find("\"kept\""), std::string::npos) << previousRooms;
+    EXPECT_EQ(previousRooms.find("\"fresh\""), std::string::npos);
+
+    // the new one is accepted by the next server
+    auto reconnected { this->Connect() };
+    const auto rooms { this->ListChatrooms(*reconnected) };
+    EXPECT_NE(rooms.find("\"fresh\""), std::string::npos) << rooms;
+    EXPECT_NE(rooms.find("\"kept\""), std::string::npos) << rooms;
+}
+
+TEST_F(HandoffTest, NextServerKeepsChatroomsAndParkedSessions) {
+    const auto service { m_previous->GetRoomService() };
+    const auto kept { service->CreateChatroom("kept") };
+    const auto busy { service->CreateChatroom("busy") };
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(service->Publish(busy, [i](std::uint64_t sequence) {
+            return "frame " + std::to_string(i) + " #" + std::to_string(sequence);
+        }, [](const Session&) { return true; }));
+    }
+    chat::ResumeRegistry::State parked {};
+    parked.m_username = "alice";
+    parked.m_chatrooms = { { busy, 2 } };
+    parked.m_current = busy;
+    ASSERT_NE(service->GetResumeRegistry(), nullptr);
+    service->GetResumeRegistry()->Park("token", parked);
+
+    m_next = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+    ASSERT_TRUE(Testing::WaitUntil([this]() { return m_previous->IsDraining(); }));
+    m_next->Start();
+    const auto nextService { m_next->GetRoomService() };
+
+    // the chatrooms keep their IDs, sequence numbers and histories
+    const auto byId { [](const chat::SavedChatroom& lhs, const chat::SavedChatroom& rhs) { 
+        return lhs.m_id < rhs.m_id; 
+    } };
+    auto saved { service->SaveChatrooms() };
+    auto restored { nextService->SaveChatrooms() };
+    std::sort(saved.begin(), saved.end(), byId);
+    std::sort(restored.begin(), restored.end(), byId);
+    ASSERT_EQ(restored.size(), saved.size());
+    for (std::size_t i = 0; i < saved.size(); i++) {
+        EXPECT_EQ(restored[i].m_id, saved[i].m_id);
+        EXPECT_EQ(restored[i].m_name, saved[i].m_name);
+        EXPECT_EQ(restored[i].m_sequence, saved[i].m_sequence);
+        EXPECT_EQ(restored[i].m_history, saved[i].m_history);
+    }
+    const auto isBusy { [busy](const chat::SavedChatroom& chatroom) { return chatroom.m_id == busy; } };
+    const auto found { std::find_if(restored.cbegin(), restored.cend(), isBusy) };
+    ASSERT_NE(found, restored.cend());
+    EXPECT_EQ(found->m_sequence, 3u);
+    EXPECT_EQ(found->m_history.size(), 3u);
+    // a new chatroom doesn't take a restored ID
+    const auto fresh { nextService->CreateChatroom("fresh") };
+    EXPECT_NE(fresh, kept);
+    EXPECT_NE(fresh, busy);
+
+    // the parked session resumes on the next server
+    ASSERT_NE(nextService->GetResumeRegistry(), nullptr);
+    const auto resumed { nextService->GetResumeRegistry()->Take("token") };
+    ASSERT_TRUE(resumed.has_value());
+    EXPECT_EQ(resumed->m_username, "alice");
+    EXPECT_EQ(resumed->m_current, busy);
+    EXPECT_EQ(resumed->m_chatrooms, parked.m_chatrooms);
+
+    // nobody joined the restored chatrooms: they're abandoned
+    EXPECT_EQ(nextService->RemoveAbandonedChatrooms(std::chrono::milliseconds(0)), 2u);
+}
+
+TEST(HandoffChannelTest, NothingToTakeOver) {
+    EXPECT_FALSE(net::RequestHandoff((Testing::GetTempDirectory() / "no-such-server.sock").string(), 100));
+}
+
+#endif // CHAT_HAS_SOCKET_HANDOFF
+
+#endif // HANDOFF_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,172 @@
+#ifndef HANDSHAKE_POOL_TESTS_HPP
+#define HANDSHAKE_POOL_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Message.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#ifndef CHAT_LOOPBACK_TRANSPORT
+
+/**
+ * Established client is served while thousands of clients reconnect (full TLS handshakes),
+ * with the handshakes on the io threads and on the separate pool.
+ */
+class HandshakePoolTest : public ::testing::Test {
+protected:
+    static constexpr std::size_t STORM_THREADS { 4 };
+
+    struct Result {
+        double m_p50 { 0.0 };
+        double m_p99 { 0.0 };
+        std::size_t m_samples { 0 };
+        std::size_t m_handshakes { 0 };
+        double m_seconds { 0.0 };
+    };
+
+    /**
+     * List the chatrooms and wait for the reply. 
+     * @return 
+     *  Round trip in microseconds, or nothing if the reply didn't come.
+     */
+    static std::optional<double> RoundTrip(Client& client) {
+        const auto responses { client.GetResponseCount() };
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::LIST_CHATROOM;
+        request.m_timestamp = Utils::GetTimestamp();
+        std::string serialized;
+        request.Write(serialized);
+        const auto start { std::chrono::steady_clock::now() };
+        client.Write(std::move(serialized));
+        if (!Testing::SpinUntil([&]() { return client.GetResponseCount() > responses; })) {
+            return std::nullopt;
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static double Percentile(std::vector<double> samples, double p) {
+        std::sort(samples.begin(), samples.end());
+        return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+    }
+
+    /**
+     * Measure round trips of the established client during a storm of @reconnects.
+     */
+    static Result Measure(std::uint16_t port, std::size_t handshakeThreads, std::size_t reconnects) {
+        auto context { std::make_shared<boost::asio::io_context>() };
+        auto sslContext { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work { context->get_executor() };
+        const Testing::ConfigFile config { 
+            "handshake-pool-" + std::to_string(handshakeThreads) + ".cfg", 
+            { { "handshake_threads", std::to_string(handshakeThreads) } } 
+        };
+        auto server { std::make_unique<Server>(context, port, config.GetPath()) };
+        server->Start();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 2; i++) {
+            threads.emplace_back([context]() { context->run(); });
+        }
+
+        Result result;
+        auto client { std::make_shared<Client>(context, sslContext) };
+        client->Connect("127.0.0.1", std::to_string(port));
+        EXPECT_TRUE(Testing::SpinUntil([&client]() { return client->GetState() == Client::State::RECEIVE_ACK; }));
+
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<std::size_t> handshakes { 0 };
+        std::atomic<std::size_t> running { STORM_THREADS };
+        std::vector<std::thread> storm;
+        const auto start { std::chrono::steady_clock::now() };
+        for (std::size_t i = 0; i < STORM_THREADS; i++) {
+            storm.emplace_back([&]() {
+                boost::asio::io_context io;
+                boost::asio::ssl::context ssl { boost::asio::ssl::context::sslv23 };
+                const boost::asio::ip::tcp::endpoint endpoint { boost::asio::ip::make_address("127.0.0.1"), port };
+                while (next++ < reconnects) {
+                    boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream { io, ssl };
+                    boost::system::error_code error;
+                    stream.next_layer().connect(endpoint, error);
+                    if (!error) {
+                        stream.handshake(boost::asio::ssl::stream_base::client, error);
+                    }
+                    if (!error) {
+                        handshakes++;
+                    }
+                    stream.next_layer().close(error);
+                }
+                running--;
+            });
+        }
+
+        std::vector<double> samples;
+        while (running) {
+            const auto rtt { RoundTrip(*client) };
+            EXPECT_TRUE(rtt) << "established client wasn't served during the storm";
+            if (!rtt) {
+                break;
+            }
+            samples.push_back(*rtt);
+        }
+        for (auto& t: storm) {
+            t.join();
+        }
+        result.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.m_handshakes = handshakes;
+        result.m_samples = samples.size();
+        if (!samples.empty()) {
+            result.m_p50 = Percentile(samples, 0.5);
+            result.m_p99 = Percentile(samples, 0.99);
+        }
+        EXPECT_EQ(client->GetState(), Client::State::RECEIVE_ACK);
+
+        server->Shutdown();
+        work.reset();
+        context->stop();
+        for (auto& t: threads) {
+            t.join();
+        }
+        return result;
+    }
+};
+
+TEST_F(HandshakePoolTest, EstablishedClientIsServedDuringReconnectStorm) {
+    constexpr std::size_t RECONNECTS { 200 };
+    const auto inline_ { Measure(15041, 0, RECONNECTS) };
+    const auto pooled { Measure(15042, 2, RECONNECTS) };
+    EXPECT_EQ(inline_.m_handshakes, RECONNECTS);
+    EXPECT_EQ(pooled.m_handshakes, RECONNECTS);
+    EXPECT_GT(pooled.m_samples, 0);
+}
+
+TEST_F(HandshakePoolTest, DISABLED_ReconnectStormBenchmark) {
+    constexpr std::size_t RECONNECTS { 1'000 };
+    const auto inline_ { Measure(15043, 0, RECONNECTS) };
+    const auto pooled { Measure(15044, 2, RECONNECTS) };
+    for (const auto& [name, result]: { std::make_pair("io threads", inline_), std::make_pair("pool", pooled) }) {
+        std::cout << "[ BENCH    ] " << RECONNECTS << " reconnects, handshakes on " << name << ": "
+            << result.m_handshakes / result.m_seconds << " handshakes/s, round trip p50 " 
+            << result.m_p50 << " us, p99 " << result.m_p99 << " us (" << result.m_samples << " samples, "
+            << std::thread::hardware_concurrency() << " cpu)\n";
+    }
+}
+
+#endif // CHAT_LOOPBACK_TRANSPORT
+
+#endif // HANDSHAKE_POOL_TESTS_HPP
\ No newline at end of file
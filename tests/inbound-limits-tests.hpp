@@ -0,0 +1,167 @@
+#ifndef INBOUND_LIMITS_TESTS_HPP
+#define INBOUND_LIMITS_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Compression.hpp"
+#include "InboundPolicy.hpp"
+#include "Message.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+/**
+ * Clients which send oversized frames, never finish a frame 
+ * or exceed the byte budget are closed and counted.
+ */
+class InboundLimitsTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15051 };
+    static constexpr std::size_t MAX_FRAME_SIZE { 1024 };
+    static constexpr std::size_t FRAME_TIMEOUT_MS { 200 };
+    static constexpr std::size_t BYTE_RATE { 8192 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_config.emplace("inbound-limits.cfg", Testing::ConfigFile::Overrides {
+            { "max_frame_size", std::to_string(MAX_FRAME_SIZE) },
+            { "frame_timeout", std::to_string(FRAME_TIMEOUT_MS) },
+            { "inbound_byte_rate", std::to_string(BYTE_RATE) }
+        });
+        m_server = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+        m_server->Start();
+        for (int i = 0; i < 4; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        m_config.reset();
+    }
+
+    std::shared_ptr<Client> Connect() {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    }
+
+    static std::string MakeListRequest() {
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::LIST_CHATROOM;
+        request.m_timestamp = Utils::GetTimestamp();
+        std::string serialized;
+        request.Write(serialized);
+        return serialized;
+    }
+
+    /**
+     * The client is served: the list request gets the reply.
+     */
+    static bool IsServed(Client& client) {
+        const auto responses { client.GetResponseCount() };
+        client.Write(MakeListRequest());
+        return Testing::WaitUntil([&]() { return client.GetResponseCount() > responses; });
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::optional<Testing::ConfigFile> m_config;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(InboundLimitsTest, OversizedFrameClosesConnection) {
+    const auto policy { m_server->GetInboundPolicy() };
+    auto violator { this->Connect() };
+    // no delimiter: the server would wait for the rest forever
+    violator->Write(std::string(4 * MAX_FRAME_SIZE, 'x'));
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return policy->m_oversizedFrames == 1; }));
+
+    auto client { this->Connect() };
+    EXPECT_TRUE(IsServed(*client));
+    EXPECT_EQ(policy->m_oversizedFrames, 1);
+}
+
+TEST_F(InboundLimitsTest, DecompressedFrameOverLimitClosesConnection) {
+    const auto policy { m_server->GetInboundPolicy() };
+    auto violator { this->Connect() };
+    // a small frame which inflates far past the limit
+    Internal::FrameDeflater deflater;
+    std::string frame;
+    ASSERT_TRUE(deflater.Compress(std::string(64 * MAX_FRAME_SIZE, 'x'), frame));
+    ASSERT_LT(frame.size(), MAX_FRAME_SIZE);
+    violator->Write(std::move(frame));
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return policy->m_oversizedFrames == 1; }));
+    EXPECT_TRUE(Testing::WaitUntil([&]() { 
+        return violator->GetState() == Client::State::CLOSED; 
+    }));
+}
+
+TEST_F(InboundLimitsTest, PartialFrameDeadline) {
+    const auto policy { m_server->GetInboundPolicy() };
+    auto violator { this->Connect() };
+    auto client { this->Connect() };
+    const auto start { std::chrono::steady_clock::now() };
+    violator->Write("{\"type\":\"request\"");
+    // completed frames don't leave the deadline armed
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(IsServed(*client));
+    }
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return policy->m_expiredFrames == 1; }));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(FRAME_TIMEOUT_MS));
+    EXPECT_TRUE(IsServed(*client));
+    EXPECT_EQ(policy->m_expiredFrames, 1);
+}
+
+TEST_F(InboundLimitsTest, ExceededByteBudgetClosesConnection) {
+    const auto policy { m_server->GetInboundPolicy() };
+    auto violator { this->Connect() };
+    // valid small frames, but much more than a second's worth at once
+    std::string burst;
+    while (burst.size() < 4 * BYTE_RATE) {
+        burst += MakeListRequest();
+    }
+    violator->Write(std::move(burst));
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return policy->m_exceededBudgets == 1; }));
+
+    auto client { this->Connect() };
+    EXPECT_TRUE(IsServed(*client));
+    EXPECT_EQ(policy->m_oversizedFrames, 0);
+}
+
+#endif // INBOUND_LIMITS_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,364 @@
+#ifndef KERNEL_TLS_TESTS_HPP
+#define KERNEL_TLS_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "KernelTLS.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include <openssl/evp.h>
+
+/// Helper functions:
+
+namespace {
+
+    using TlsStream = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
+
+    std::vector<unsigned char> FromHex(const std::string& hex) {
+        std::vector<unsigned char> bytes;
+        for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+            bytes.push_back(static_cast<unsigned char>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+        }
+        return bytes;
+    }
+
+    const EVP_CIPHER * GetCipher(std::uint16_t suite) {
+        switch (suite) {
+            case 0x1301: return EVP_aes_128_gcm();
+            case 0x1302: return EVP_aes_256_gcm();
+            case 0x1303: return EVP_chacha20_poly1305();
+            default: return nullptr;
+        }
+    }
+
+    constexpr std::size_t TAG_SIZE { 16 };
+    constexpr std::size_t HEADER_SIZE { 5 };
+
+    /**
+     * Protect one TLS 1.3 record the way the kernel does it (RFC 8446, 5.2-5.3).
+     * @param open
+     *  Decrypt the @record (header included) instead.
+     */
+    bool Crypt(
+        std::uint16_t suite, const net::TrafficKey& key, std::uint64_t sequence, 
+        bool open, const std::string& input, std::string& output
+    ) {
+        std::vector<unsigned char> nonce { key.m_iv };
+        for (std::size_t i = 0; i < 8; i++) {
+            nonce[nonce.size() - 1 - i] ^= static_cast<unsigned char>(sequence >> (8 * i));
+        }
+        std::string header;
+        std::string payload;
+        if (open) {
+            if (input.size() < HEADER_SIZE + TAG_SIZE) {
+                return false;
+            }
+            header = input.substr(0, HEADER_SIZE);
+            payload = input.substr(HEADER_SIZE, input.size() - HEADER_SIZE - TAG_SIZE);
+        }
+        else {
+            // application data is the inner content type
+            payload = input + '\x17';
+            const auto length { payload.size() + TAG_SIZE };
+            header = { '\x17', '\x03', '\x03', static_cast<char>(length >> 8), static_cast<char>(length & 0xFF) };
+        }
+        std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> context { EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free };
+        auto * const ctx { context.get() };
+        std::string result(payload.size(), '\0');
+        int length { 0 };
+        int ignore { 0 };
+        const auto data = [](const std::string& s) { return reinterpret_cast<const unsigned char *>(s.data()); };
+        if (open) {
+            std::string tag { input.substr(input.size() - TAG_SIZE) };
+            const bool isOpened { 
+                EVP_DecryptInit_ex(ctx, GetCipher(suite), nullptr, key.m_key.data(), nonce.data()) == 1
+                && EVP_DecryptUpdate(ctx, nullptr, &ignore, data(header), static_cast<int>(header.size())) == 1
+                && EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char *>(result.data()), &length, 
+                    data(payload), static_cast<int>(payload.size())) == 1
+                && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, TAG_SIZE, tag.data()) == 1
+                && EVP_DecryptFinal_ex(ctx, nullptr, &ignore) == 1
+            };
+            if (!isOpened || result.empty() || result.back() != '\x17') {
+                return false;
+            }
+            result.pop_back();
+            output = std::move(result);
+            return true;
+        }
+        char tag[TAG_SIZE] {};
+        const bool isSealed {
+            EVP_EncryptInit_ex(ctx, GetCipher(suite), nullptr, key.m_key.data(), nonce.data()) == 1
+            && EVP_EncryptUpdate(ctx, nullptr, &ignore, data(header), static_cast<int>(header.size())) == 1
+            && EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char *>(result.data()), &length, 
+                data(payload), static_cast<int>(payload.size())) == 1
+            && EVP_EncryptFinal_ex(ctx, nullptr, &ignore) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, TAG_SIZE, tag) == 1
+        };
+        output = header + result + std::string(tag, TAG_SIZE);
+        return isSealed;
+    }
+
+}
+
+/**
+ * Server & client ends of a TLS connection over the loopback interface.
+ * The server's context keeps the traffic secrets (see `net::EnableKernelTls`).
+ */
+class KernelTlsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_serverContext.set_password_callback([](std::size_t, auto) { return std::string("dummypassword"); });
+        m_serverContext.use_certificate_chain_file("settings/server.crt");
+        m_serverContext.use_private_key_file("settings/server.key", boost::asio::ssl::context::pem);
+        net::EnableKernelTls(m_serverContext.native_handle());
+        // the connections take the certificate & callbacks of the context when they are made
+        m_server = std::make_unique<TlsStream>(m_io, m_serverContext);
+        m_client = std::make_unique<TlsStream>(m_io, m_clientContext);
+
+        boost::asio::ip::tcp::acceptor acceptor { m_io, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+        std::thread client { [this, endpoint = acceptor.local_endpoint()]() {
+            boost::system::error_code error;
+            m_client->next_layer().connect(endpoint, error);
+            if (!error) {
+                m_client->handshake(boost::asio::ssl::stream_base::client, error);
+            }
+            m_clientError = error;
+        } };
+        acceptor.accept(m_server->next_layer());
+        m_server->handshake(boost::asio::ssl::stream_base::server, m_serverError);
+        client.join();
+        ASSERT_FALSE(m_serverError) << m_serverError.message();
+        ASSERT_FALSE(m_clientError) << m_clientError.message();
+    }
+
+    std::string ReadRecord() {
+        std::string record(HEADER_SIZE, '\0');
+        boost::asio::read(m_server->next_layer(), boost::asio::buffer(record));
+        const auto length { 
+            static_cast<std::size_t>((static_cast<unsigned char>(record[3]) << 8U) | static_cast<unsigned char>(record[4])) 
+        };
+        record.resize(HEADER_SIZE + length);
+        boost::asio::read(m_server->next_layer(), boost::asio::buffer(&record[HEADER_SIZE], length));
+        return record;
+    }
+
+    boost::asio::io_context m_io;
+    boost::asio::ssl::context m_serverContext { boost::asio::ssl::context::sslv23 };
+    boost::asio::ssl::context m_clientContext { boost::asio::ssl::context::sslv23 };
+    std::unique_ptr<TlsStream> m_server { nullptr };
+    std::unique_ptr<TlsStream> m_client { nullptr };
+    boost::system::error_code m_serverError;
+    boost::system::error_code m_clientError;
+};
+
+TEST(KernelTlsKeysTest, TrafficKeysMatchRfc8448) {
+    // "Simple 1-RTT Handshake", TLS_AES_128_GCM_SHA256
+    net::TrafficKey handshake;
+    ASSERT_TRUE(net::DeriveTrafficKey(EVP_sha256(), 
+        FromHex("b67b7d690cc16c4e75e54213cb2d37b4e9c912bcded9105d42befd59d391ad38"), 16, handshake
+    ));
+    EXPECT_EQ(handshake.m_key, FromHex("3fce516009c21727d0f2e4e86ee403bc"));
+    EXPECT_EQ(handshake.m_iv, FromHex("5d313eb2671276ee13000b30"));
+
+    net::TrafficKey application;
+    ASSERT_TRUE(net::DeriveTrafficKey(EVP_sha256(), 
+        FromHex("a11af9f05531f856ad47116b45a950328204b4f44bfb6b3a4b4f1f3fcb631643"), 16, application
+    ));
+    EXPECT_EQ(application.m_key, FromHex("9f02283b6c9c07efc26bb9f2ac92e356"));
+    EXPECT_EQ(application.m_iv, FromHex("cf782b88dd83549aadf1e984"));
+}
+
+/**
+ * Seal & open the records in user space with the exported keys and sequence numbers 
+ * exactly as the kernel would, so the hand-over is checked without the `tls` module.
+ */
+TEST_F(KernelTlsTest, ExportedKeysProtectRecordsAfterHandover) {
+    ASSERT_TRUE(net::IsKernelTlsEnabled(m_server->native_handle()));
+    net::TrafficKeys keys;
+    std::string reason;
+    ASSERT_TRUE(net::ExportTrafficKeys(m_server->native_handle(), keys, reason)) << reason;
+    // the session tickets were the only records sent with the application key
+    EXPECT_EQ(keys.m_writeSequence, 2U);
+    EXPECT_EQ(keys.m_readSequence, 0U);
+
+    /// #1 Server -> client
+    const std::string ping { "ping from the kernel" };
+    for (std::uint64_t i = 0; i < 3; i++) {
+        std::string record;
+        ASSERT_TRUE(Crypt(keys.m_suite, keys.m_write, keys.m_writeSequence + i, false, ping, record));
+        boost::asio::write(m_server->next_layer(), boost::asio::buffer(record));
+        std::string received(ping.size(), '\0');
+        boost::asio::read(*m_client, boost::asio::buffer(received));
+        EXPECT_EQ(received, ping);
+    }
+
+    /// #2 Client -> server
+    const std::string pong { "pong to the kernel" };
+    for (std::uint64_t i = 0; i < 3; i++) {
+        boost::asio::write(*m_client, boost::asio::buffer(pong));
+        std::string opened;
+        ASSERT_TRUE(Crypt(keys.m_suite, keys.m_read, keys.m_readSequence + i, true, this->ReadRecord(), opened));
+        EXPECT_EQ(opened, pong);
+    }
+}
+
+TEST_F(KernelTlsTest, BufferedRecordsKeepUserSpace) {
+    // two records arrive together, the engine takes both from the socket
+    boost::asio::write(*m_client, boost::asio::buffer(std::string("first")));
+    boost::asio::write(*m_client, boost::asio::buffer(std::string("second")));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::string received(5, '\0');
+    boost::asio::read(*m_server, boost::asio::buffer(received));
+    ASSERT_EQ(received, "first");
+
+    // the second one would be lost by the kernel
+    net::TrafficKeys keys;
+    std::string reason;
+    EXPECT_FALSE(net::ExportTrafficKeys(m_server->native_handle(), keys, reason));
+    EXPECT_FALSE(reason.empty());
+}
+
+#ifdef CHAT_HAS_KERNEL_TLS
+
+inline double GetThreadCpuMicroseconds() {
+    timespec time {};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1e6 + time.tv_nsec / 1e3;
+}
+
+/**
+ * Offload if the kernel has the `tls` module, otherwise check the fallback.
+ * In both cases the connection keeps working.
+ */
+TEST_F(KernelTlsTest, InstallOrFallBack) {
+    std::string reason;
+    const auto result { net::InstallKernelTls(m_server->next_layer().native_handle(), m_server->native_handle(), reason) };
+    const std::string ping { "ping" };
+    const std::string pong { "pong" };
+    std::string received(ping.size(), '\0');
+    if (!net::IsKernelTlsAvailable()) {
+        ASSERT_EQ(result, net::KernelTls::USER_SPACE);
+        EXPECT_FALSE(reason.empty());
+        boost::asio::write(*m_server, boost::asio::buffer(ping));
+        boost::asio::read(*m_client, boost::asio::buffer(received));
+        EXPECT_EQ(received, ping);
+        boost::asio::write(*m_client, boost::asio::buffer(pong));
+        boost::asio::read(*m_server, boost::asio::buffer(received));
+        EXPECT_EQ(received, pong);
+        return;
+    }
+    ASSERT_EQ(result, net::KernelTls::OFFLOADED) << reason;
+    boost::asio::write(m_server->next_layer(), boost::asio::buffer(ping));
+    boost::asio::read(*m_client, boost::asio::buffer(received));
+    EXPECT_EQ(received, ping);
+    boost::asio::write(*m_client, boost::asio::buffer(pong));
+    boost::asio::read(m_server->next_layer(), boost::asio::buffer(received));
+    EXPECT_EQ(received, pong);
+}
+
+/**
+ * Send @messages of 1 KiB through the @sender while the @receiver drains them.
+ * @return 
+ *  CPU time of the sending thread per message, in microseconds.
+ */
+template<typename Sender>
+double SendMessages(Sender& sender, TlsStream& receiver, std::size_t messages) {
+    const std::string message(1024, 'x');
+    const auto total { messages * message.size() };
+    std::size_t received { 0 };
+    std::thread reader { [&receiver, &received, total]() {
+        std::string sink(16 * 1024, '\0');
+        boost::system::error_code error;
+        while (received < total && !error) {
+            received += receiver.read_some(boost::asio::buffer(sink), error);
+        }
+    } };
+    const auto start { GetThreadCpuMicroseconds() };
+    for (std::size_t i = 0; i < messages; i++) {
+        boost::asio::write(sender, boost::asio::buffer(message));
+    }
+    const auto spent { GetThreadCpuMicroseconds() - start };
+    reader.join();
+    EXPECT_EQ(received, total);
+    return spent / messages;
+}
+
+/**
+ * Bulk writes arrive whole both before and after the record layer is installed.
+ */
+TEST_F(KernelTlsTest, BulkWritesSurviveInstall) {
+    constexpr std::size_t MESSAGES { 64 };
+    SendMessages(*m_server, *m_client, MESSAGES);
+    std::string reason;
+    const auto result { net::InstallKernelTls(m_server->next_layer().native_handle(), m_server->native_handle(), reason) };
+    ASSERT_NE(result, net::KernelTls::BROKEN) << reason;
+    if (result == net::KernelTls::OFFLOADED) {
+        SendMessages(m_server->next_layer(), *m_client, MESSAGES);
+    }
+    else {
+        SendMessages(*m_server, *m_client, MESSAGES);
+    }
+}
+
+/**
+ * CPU time of the sending thread per 1 KiB message: 
+ * user space TLS versus the record layer in the kernel.
+ */
+TEST_F(KernelTlsTest, DISABLED_CpuPerMessageBenchmark) {
+    constexpr std::size_t MESSAGES { 4'000 };
+    const auto userSpace { SendMessages(*m_server, *m_client, MESSAGES) };
+    std::string reason;
+    const auto result { net::InstallKernelTls(m_server->next_layer().native_handle(), m_server->native_handle(), reason) };
+    ASSERT_NE(result, net::KernelTls::BROKEN) << reason;
+    std::cout << "[ BENCH    ] cpu per 1 KiB message: user space TLS " << userSpace << " us, ";
+    if (result == net::KernelTls::OFFLOADED) {
+        std::cout << "kTLS " << SendMessages(m_server->next_layer(), *m_client, MESSAGES) << " us\n";
+    }
+    else {
+        std::cout << "kTLS not available (" << reason << ")\n";
+    }
+}
+
+#endif // CHAT_HAS_KERNEL_TLS
+
+/**
+ * `enable_ktls` never breaks the connections: they are offloaded 
+ * or stay in user space.
+ */
+TEST(KernelTlsServerTest, ClientIsServedWithKtlsEnabled) {
+    constexpr std::uint16_t PORT { 15121 };
+    auto context { std::make_shared<boost::asio::io_context>() };
+    auto sslContext { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work { context->get_executor() };
+    const Testing::ConfigFile config { "kernel-tls.cfg", { { "enable_ktls", "true" } } };
+    auto server { std::make_unique<Server>(context, PORT, config.GetPath()) };
+    server->Start();
+    std::thread thread { [context]() { context->run(); } };
+
+    auto client { std::make_shared<Client>(context, sslContext) };
+    client->Connect("127.0.0.1", std::to_string(PORT));
+    EXPECT_TRUE(Testing::WaitUntil([&client]() { return client->GetState() == Client::State::RECEIVE_ACK; }));
+
+    client->CloseConnection();
+    server->Shutdown();
+    work.reset();
+    context->stop();
+    thread.join();
+}
+
+#endif // KERNEL_TLS_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef MEMORY_TESTS_HPP
+#define MEMORY_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "MemoryAccount.hpp"
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+TEST(MemoryBudgetTest, AccountsAreChargedToBudget) {
+    auto budget { std::make_shared<net::MemoryBudget>(1000) };
+    auto first { budget->OpenAccount(nullptr) };
+    auto second { budget->OpenAccount(nullptr) };
+
+    first->Set(net::MemoryCategory::INBOX, 300);
+    first->Set(net::MemoryCategory::INBOX, 200);
+    second->Add(net::MemoryCategory::REQUESTS, 500);
+    EXPECT_EQ(first->GetTotal(), 200U);
+    EXPECT_EQ(budget->GetTotal(), 700U);
+    EXPECT_FALSE(budget->IsOverBudget());
+
+    second->Add(net::MemoryCategory::OUTBOX, 400);
+    EXPECT_TRUE(budget->IsOverBudget());
+    const auto stats { budget->GetStats() };
+    EXPECT_EQ(stats.m_accounts, 2U);
+    EXPECT_EQ(stats.m_bytes[static_cast<std::size_t>(net::MemoryCategory::OUTBOX)], 400U);
+
+    // the account returns everything it held
+    second.reset();
+    EXPECT_EQ(budget->GetTotal(), 200U);
+    first->Clear();
+    EXPECT_EQ(budget->GetTotal(), 0U);
+}
+
+TEST(MemoryBudgetTest, ClearedAccountIgnoresLateChanges) {
+    auto budget { std::make_shared<net::MemoryBudget>() };
+    auto idle { budget->OpenAccount(nullptr) };
+    idle->Set(net::MemoryCategory::INBOX, 100);
+    auto closed { budget->OpenAccount(nullptr) };
+    closed->Add(net::MemoryCategory::REQUESTS, 300);
+    ASSERT_EQ(budget->GetTotal(), 400U);
+
+    closed->Clear();
+    // the session releases the requests which were queued when the connection was closed
+    closed->Add(net::MemoryCategory::REQUESTS, -300);
+    closed->Set(net::MemoryCategory::OUTBOX, 50);
+    EXPECT_EQ(closed->GetTotal(), 0U);
+    EXPECT_EQ(budget->GetTotal(), 100U);
+    closed.reset();
+    EXPECT_EQ(budget->GetTotal(), 100U);
+}
+
+TEST(MemoryBudgetTest, ShedTrimsHistoryThenClosesLargestOutbox) {
+    auto budget { std::make_shared<net::MemoryBudget>(1000) };
+    std::vector<int> closed;
+    std::vector<std::shared_ptr<net::MemoryAccount>> accounts;
+    const std::size_t outboxes[] { 100, 900, 0, 300 };
+    for (int i = 0; i < 4; i++) {
+        accounts.push_back(budget->OpenAccount([&closed, &accounts, i]() {
+            closed.push_back(i);
+            accounts[i]->Clear();
+        }));
+        accounts.back()->Set(net::MemoryCategory::INBOX, 100);
+        accounts.back()->Set(net::MemoryCategory::OUTBOX, outboxes[i]);
+    }
+    auto history { budget->OpenAccount(nullptr) };
+    history->Set(net::MemoryCategory::HISTORY, 500);
+    budget->SetTrimmer([&history]() {
+        history->Set(net::MemoryCategory::HISTORY, 100);
+    });
+    // 400 (inboxes) + 1300 (outboxes) + 500 (history)
+    ASSERT_EQ(budget->GetTotal(), 2200U);
+
+    budget->Shed();
+    // trimming released 400, the largest outbox is enough for the rest
+    EXPECT_EQ(closed, std::vector<int>({ 1 }));
+    EXPECT_FALSE(budget->IsOverBudget());
+    const auto stats { budget->GetStats() };
+    EXPECT_EQ(stats.m_trims, 1U);
+    EXPECT_EQ(stats.m_disconnected, 1U);
+
+    // under budget nothing happens
+    budget->Shed();
+    EXPECT_EQ(budget->GetStats().m_trims, 1U);
+}
+
+/**
+ * A server over its memory budget refuses new chatrooms 
+ * but keeps serving the requests which don't allocate.
+ */
+class MemoryBudgetServerTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15061 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        // a budget every connection exceeds, checked rarely so the client isn't shed during the test
+        m_config.emplace("memory-budget.cfg", Testing::ConfigFile::Overrides {
+            { "memory_budget", "1" },
+            { "memory_check_interval", "600000" }
+        });
+        m_server = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+        m_server->Start();
+        for (int i = 0; i < 2; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        m_config.reset();
+    }
+
+    /**
+     * Send request and wait for its reply.
+     */
+    static std::optional<Internal::Response> Ask(Client& client, Internal::QueryType query, std::string attachment = {}) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = std::move(attachment);
+        std::string serialized;
+        request.Write(serialized);
+        const auto responses { client.GetResponseCount() };
+        client.Write(std::move(serialized));
+        if (!Testing::WaitUntil([&]() { return client.GetResponseCount() > responses; })) {
+            return std::nullopt;
+        }
+        return client.GetLastResponse();
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::optional<Testing::ConfigFile> m_config;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(MemoryBudgetServerTest, RefusesChatroomsOverBudget) {
+    auto client { std::make_shared<Client>(m_context, m_sslContext) };
+    client->Connect("127.0.0.1", std::to_string(PORT));
+    ASSERT_TRUE(Testing::WaitUntil([&client]() { 
+        return client->GetState() == Client::State::RECEIVE_ACK; 
+    }));
+
+    const auto list { Ask(*client, Internal::QueryType::LIST_CHATROOM) };
+    ASSERT_TRUE(list);
+    EXPECT_EQ(list->m_status, 200);
+
+    const auto create { Ask(*client, Internal::QueryType::CREATE_CHATROOM, 
+        R"({"user":{"name":"random username"},"chatroom":{"name":"heavy"}})"
+    ) };
+    ASSERT_TRUE(create);
+    EXPECT_EQ(create->m_query, Internal::QueryType::CREATE_CHATROOM);
+    EXPECT_EQ(create->m_status, 503);
+
+    const auto stats { m_server->GetMemoryStats() };
+    EXPECT_EQ(stats.m_budget, 1U);
+    EXPECT_GE(stats.m_rejectedRequests, 1U);
+    EXPECT_GE(stats.m_accounts, 1U);
+    EXPECT_GT(stats.m_bytes[static_cast<std::size_t>(net::MemoryCategory::INBOX)], 0U);
+}
+
+TEST_F(MemoryBudgetServerTest, DisconnectReleasesQueuedRequestsOnce) {
+    auto connect = [this]() {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    };
+    for (std::size_t i = 0; i < 500; i++) {
+        // the list is long, so the requests are still queued when the client is gone
+        m_server->GetRoomService()->CreateChatroom("Room #" + std::to_string(i));
+    }
+    // the idle client keeps the total above zero, so an under-count isn't clamped
+    auto idle { connect() };
+    ASSERT_TRUE(Ask(*idle, Internal::QueryType::LIST_CHATROOM));
+    const auto before { m_server->GetMemoryStats() };
+    ASSERT_GT(before.m_total, 0U);
+
+    Internal::Request request {};
+    request.m_query = Internal::QueryType::LIST_CHATROOM;
+    request.m_timestamp = Utils::GetTimestamp();
+    std::string serialized;
+    request.Write(serialized);
+    std::string burst;
+    for (int i = 0; i < 200; i++) {
+        burst += serialized;
+    }
+    for (int round = 0; round < 5; round++) {
+        auto client { connect() };
+        client->Write(burst);
+        client->CloseConnection();
+        ASSERT_TRUE(Testing::WaitUntil([&]() { 
+            return m_server->GetMemoryStats().m_accounts == before.m_accounts; 
+        }));
+    }
+    // the closed accounts returned everything, nothing was released twice
+    EXPECT_EQ(m_server->GetMemoryStats().m_total, before.m_total);
+}
+
+#endif // MEMORY_TESTS_HPP
\ No newline at end of file
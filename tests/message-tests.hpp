@@ -115,6 +115,26 @@ TEST(RequestTest, ParseChatMessageRequest) {
     EXPECT_FALSE(request.m_attachment.empty());
 }
 
+TEST(RequestTest, RequestIdRoundTrip) {
+    Internal::Request request{};
+    request.m_query = Internal::QueryType::LIST_CHATROOM;
+    request.m_timestamp = 344678435266LL;
+    request.m_id = 42;
+    std::string serialized;
+    request.Write(serialized);
+
+    Internal::Request parsed{};
+    parsed.Read(serialized);
+    EXPECT_EQ(parsed.m_id, 42U);
+
+    // untracked requests don't carry the ID
+    request.m_id = 0;
+    request.Write(serialized);
+    EXPECT_EQ(serialized.find("\"id\""), std::string::npos);
+    parsed.Read(serialized);
+    EXPECT_EQ(parsed.m_id, 0U);
+}
+
 // ========== Response ========= //
 TEST(ResponseTest, ParseLeaveChatroomResponse) {
     
@@ -149,4 +169,20 @@ TEST(ResponseTest, BuildListChatroomResponse) {
     
 }
 
+TEST(ResponseTest, ResponseIdRoundTrip) {
+    Internal::Response response{};
+    response.m_query = Internal::QueryType::JOIN_CHATROOM;
+    response.m_status = 200;
+    response.m_id = 7;
+    response.m_attachment = R"({"chatroom":{"id":3}})";
+    std::string serialized;
+    response.Write(serialized);
+
+    Internal::Response parsed{};
+    parsed.Read(serialized);
+    EXPECT_EQ(parsed.m_id, 7U);
+    EXPECT_EQ(parsed.m_status, 200);
+    EXPECT_EQ(parsed.m_attachment, response.m_attachment);
+}
+
 #endif // REQUEST_TESTS_HPP
\ No newline at end of file
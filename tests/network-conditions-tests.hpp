@@ -0,0 +1,413 @@
+#ifndef NETWORK_CONDITIONS_TESTS_HPP
+#define NETWORK_CONDITIONS_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "MockStream.hpp"
+#include "NetworkConditions.hpp"
+#include "DoubleBuffer.hpp"
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <boost/asio.hpp>
+
+/// Helper functions:
+
+/**
+ * Run every handler which is ready at the current virtual time.
+ */
+inline void PollDue(VirtualClock& clock, boost::asio::io_context& io) {
+    do {
+        clock.Advance(0);
+        io.restart();
+    } while (io.poll() > 0);
+}
+
+/**
+ * Move the virtual clock by @ms one millisecond at a time
+ * running all handlers that became ready.
+ */
+inline void RunFor(VirtualClock& clock, boost::asio::io_context& io, VirtualClock::Time ms) {
+    for (VirtualClock::Time i = 0; i < ms; i++) {
+        PollDue(clock, io);
+        clock.Advance(1);
+    }
+    PollDue(clock, io);
+}
+
+/**
+ * Mimic the write path of the `net::Connection`:
+ * queue text to the `Buffers` and keep at most one `async_write` in flight.
+ * Track the outbox size and the time each message waited for the write completion.
+ */
+class EmulatedOutbox {
+public:
+    EmulatedOutbox(
+        boost::asio::io_context& io,
+        VirtualClock& clock,
+        const NetworkConditions& conditions
+    )
+        : m_executor { io.get_executor() }
+        , m_clock { clock }
+        , m_sink(1 << 20)
+        , m_stream { m_executor, m_sink.data(), m_sink.size() }
+    {
+        m_stream.SetNetworkConditions(clock, conditions);
+    }
+
+    void Write(std::string text) {
+        m_outbox.Enque(std::move(text));
+        m_queued.push_back(m_clock.Now());
+        m_maxQueuedBytes = std::max(m_maxQueuedBytes, m_outbox.GetQueueBytes());
+        if (!m_isWriting) {
+            this->Write();
+        }
+    }
+
+    std::size_t GetMaxQueuedBytes() const noexcept {
+        return m_maxQueuedBytes;
+    }
+
+    VirtualClock::Time GetMaxLatency() const noexcept {
+        return m_maxLatency;
+    }
+
+    std::size_t GetDelivered() const noexcept {
+        return m_delivered;
+    }
+
+private:
+    void Write() {
+        m_isWriting = true;
+        m_outbox.SwapBuffers();
+        m_inFlight.swap(m_queued);
+        m_queued.clear();
+        boost::asio::async_write(m_stream, m_outbox.GetBufferSequence(),
+            [this](const boost::system::error_code& error, std::size_t) {
+                ASSERT_FALSE(error) << error.message();
+                for (auto enqueued: m_inFlight) {
+                    m_maxLatency = std::max(m_maxLatency, m_clock.Now() - enqueued);
+                }
+                m_delivered += m_inFlight.size();
+                m_inFlight.clear();
+                if (m_outbox.GetQueueSize()) {
+                    this->Write();
+                }
+                else {
+                    m_isWriting = false;
+                }
+            }
+        );
+    }
+
+    boost::asio::io_context::executor_type m_executor;
+    VirtualClock& m_clock;
+    std::vector<std::byte> m_sink;
+    MockAsyncWriteStream m_stream;
+    Buffers m_outbox;
+    bool m_isWriting { false };
+    std::deque<VirtualClock::Time> m_queued;
+    std::deque<VirtualClock::Time> m_inFlight;
+    std::size_t m_maxQueuedBytes { 0 };
+    VirtualClock::Time m_maxLatency { 0 };
+    std::size_t m_delivered { 0 };
+};
+
+TEST(NetworkConditionsTest, BandwidthAndLatencyDelayWrite) {
+    boost::asio::io_context io;
+    auto executor { io.get_executor() };
+    VirtualClock clock;
+    std::vector<std::byte> sink(4096);
+    MockAsyncWriteStream stream { executor, sink.data(), sink.size() };
+
+    NetworkConditions conditions;
+    conditions.m_bandwidth = 100;
+    conditions.m_latency = 5;
+    stream.SetNetworkConditions(clock, conditions);
+
+    const std::string data(1000, 'x');
+    VirtualClock::Time completedAt { 0 };
+    bool isCompleted { false };
+    boost::asio::async_write(stream, boost::asio::buffer(data),
+        [&](const boost::system::error_code& error, std::size_t bytes) {
+            EXPECT_FALSE(error);
+            EXPECT_EQ(bytes, data.size());
+            completedAt = clock.Now();
+            isCompleted = true;
+        }
+    );
+    RunFor(clock, io, 100);
+
+    ASSERT_TRUE(isCompleted);
+    // 1000 bytes at 100 B/ms + 5 ms of latency
+    EXPECT_EQ(completedAt, 15U);
+}
+
+TEST(NetworkConditionsTest, PartialWritesDeliverWholeMessage) {
+    boost::asio::io_context io;
+    auto executor { io.get_executor() };
+    VirtualClock clock;
+    std::vector<std::byte> sink(4096);
+    MockAsyncWriteStream stream { executor, sink.data(), sink.size() };
+
+    NetworkConditions conditions;
+    conditions.m_maxChunk = 64;
+    stream.SetNetworkConditions(clock, conditions);
+
+    /// #1 Single operation is cut by the chunk size
+    std::string data(1000, '\0');
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    std::size_t written { 0 };
+    stream.async_write_some(boost::asio::buffer(data),
+        [&](const boost::system::error_code& error, std::size_t bytes) {
+            EXPECT_FALSE(error);
+            written = bytes;
+        }
+    );
+    RunFor(clock, io, 1);
+    EXPECT_EQ(written, 64U);
+
+    /// #2 Composed operation still writes everything
+    boost::asio::async_write(stream, boost::asio::buffer(data.data() + written, data.size() - written),
+        [&](const boost::system::error_code& error, std::size_t bytes) {
+            EXPECT_FALSE(error);
+            written += bytes;
+        }
+    );
+    RunFor(clock, io, 1);
+    ASSERT_EQ(written, data.size());
+    EXPECT_EQ(0, std::memcmp(sink.data(), data.data(), data.size()));
+}
+
+TEST(NetworkConditionsTest, StallPostponesWrite) {
+    boost::asio::io_context io;
+    auto executor { io.get_executor() };
+    VirtualClock clock;
+    std::vector<std::byte> sink(64);
+    MockAsyncWriteStream stream { executor, sink.data(), sink.size() };
+
+    NetworkConditions conditions;
+    // link is down within [50, 100) of every 100 ms
+    conditions.m_stallPeriod = 100;
+    conditions.m_stallDuration = 50;
+    stream.SetNetworkConditions(clock, conditions);
+
+    RunFor(clock, io, 60);
+    VirtualClock::Time completedAt { 0 };
+    stream.async_write_some(boost::asio::buffer("stalled", 7),
+        [&](const boost::system::error_code& error, std::size_t) {
+            EXPECT_FALSE(error);
+            completedAt = clock.Now();
+        }
+    );
+    RunFor(clock, io, 100);
+    EXPECT_EQ(completedAt, 100U);
+}
+
+TEST(NetworkConditionsTest, JitterIsDeterministic) {
+    NetworkConditions conditions;
+    conditions.m_latency = 10;
+    conditions.m_jitter = 20;
+    conditions.m_seed = 42;
+
+    auto measure = [&conditions]() {
+        boost::asio::io_context io;
+        auto executor { io.get_executor() };
+        VirtualClock clock;
+        std::vector<std::byte> sink(1024);
+        MockAsyncWriteStream stream { executor, sink.data(), sink.size() };
+        stream.SetNetworkConditions(clock, conditions);
+
+        std::vector<VirtualClock::Time> delays;
+        for (int i = 0; i < 16; i++) {
+            const auto start { clock.Now() };
+            stream.async_write_some(boost::asio::buffer("ping", 4),
+                [&, start](const boost::system::error_code&, std::size_t) {
+                    delays.push_back(clock.Now() - start);
+                }
+            );
+            RunFor(clock, io, 64);
+        }
+        return delays;
+    };
+
+    const auto first { measure() };
+    const auto second { measure() };
+    ASSERT_EQ(first.size(), 16U);
+    EXPECT_EQ(first, second);
+    for (auto delay: first) {
+        EXPECT_GE(delay, conditions.m_latency);
+        EXPECT_LE(delay, conditions.m_latency + conditions.m_jitter);
+    }
+}
+
+TEST(NetworkConditionsTest, ReadIsLimitedByBandwidth) {
+    boost::asio::io_context io;
+    auto executor { io.get_executor() };
+    VirtualClock clock;
+    const std::string source(100, 'r');
+    MockAsyncReadStream stream { executor, boost::asio::buffer(source) };
+
+    NetworkConditions conditions;
+    conditions.m_bandwidth = 10;
+    conditions.m_maxChunk = 10;
+    stream.SetNetworkConditions(clock, conditions);
+
+    std::string received(source.size(), '\0');
+    VirtualClock::Time completedAt { 0 };
+    boost::asio::async_read(stream, boost::asio::buffer(received),
+        [&](const boost::system::error_code& error, std::size_t bytes) {
+            EXPECT_FALSE(error);
+            EXPECT_EQ(bytes, source.size());
+            completedAt = clock.Now();
+        }
+    );
+    RunFor(clock, io, 50);
+    EXPECT_EQ(received, source);
+    EXPECT_EQ(completedAt, 10U);
+
+    /// Source is exhausted
+    boost::system::error_code lastError;
+    char byte;
+    stream.async_read_some(boost::asio::buffer(&byte, 1),
+        [&](const boost::system::error_code& error, std::size_t) {
+            lastError = error;
+        }
+    );
+    RunFor(clock, io, 1);
+    EXPECT_EQ(lastError, boost::asio::error::eof);
+}
+
+TEST(MockAcceptorTest, PendingAcceptsAreQueued) {
+    boost::asio::io_context io;
+    const boost::asio::ip::tcp::endpoint endpoint { boost::asio::ip::make_address("127.0.0.1"), 15131 };
+    MockAcceptor acceptor { io, endpoint };
+    std::deque<MockSocket> peers;
+    std::vector<boost::system::error_code> accepted;
+    for (int i = 0; i < 3; i++) {
+        peers.emplace_back(io);
+        acceptor.async_accept(peers.back(), [&accepted](const boost::system::error_code& error) {
+            accepted.push_back(error);
+        });
+    }
+
+    std::vector<MockSocket> clients;
+    for (int i = 0; i < 2; i++) {
+        clients.emplace_back(io);
+        clients.back().async_connect(std::vector { endpoint }, [](const auto&, const auto&) {});
+    }
+    // the accept left pending keeps the context busy
+    io.poll();
+    ASSERT_EQ(accepted.size(), 2U);
+    EXPECT_FALSE(accepted[0]);
+    EXPECT_FALSE(accepted[1]);
+    EXPECT_TRUE(peers[0].is_open());
+    EXPECT_TRUE(peers[1].is_open());
+
+    // the one left is aborted, not dropped
+    acceptor.close();
+    io.run();
+    ASSERT_EQ(accepted.size(), 3U);
+    EXPECT_EQ(accepted[2], boost::asio::error::operation_aborted);
+    EXPECT_FALSE(peers[2].is_open());
+}
+
+TEST(BackpressureTest, FastConsumerKeepsOutboxBounded) {
+    boost::asio::io_context io;
+    VirtualClock clock;
+    NetworkConditions conditions;
+    conditions.m_bandwidth = 1000;
+    conditions.m_latency = 2;
+    EmulatedOutbox outbox { io, clock, conditions };
+
+    // 100 B/ms are produced while the link transmits 1000 B/ms
+    for (int i = 0; i < 1000; i++) {
+        outbox.Write(std::string(100, 'x'));
+        RunFor(clock, io, 1);
+    }
+    RunFor(clock, io, 100);
+
+    EXPECT_EQ(outbox.GetDelivered(), 1000U);
+    EXPECT_LE(outbox.GetMaxQueuedBytes(), 500U);
+    EXPECT_LE(outbox.GetMaxLatency(), 8U);
+}
+
+TEST(BackpressureTest, SlowConsumerOutboxGrowsWithBacklog) {
+    boost::asio::io_context io;
+    VirtualClock clock;
+    NetworkConditions conditions;
+    conditions.m_bandwidth = 50;
+    conditions.m_latency = 2;
+    EmulatedOutbox outbox { io, clock, conditions };
+
+    // 100 B/ms are produced while the link transmits only 50 B/ms
+    for (int i = 0; i < 1000; i++) {
+        outbox.Write(std::string(100, 'x'));
+        RunFor(clock, io, 1);
+    }
+    const auto backlogLatency { outbox.GetMaxLatency() };
+    RunFor(clock, io, 3000);
+
+    EXPECT_EQ(outbox.GetDelivered(), 1000U);
+    // the outbox holds the whole backlog: ~50 B of every ms
+    EXPECT_GE(outbox.GetMaxQueuedBytes(), 10'000U);
+    EXPECT_LE(outbox.GetMaxQueuedBytes(), 60'000U);
+    // messages wait for the backlog ahead of them and for the rest of their batch
+    EXPECT_GE(outbox.GetMaxLatency(), 900U);
+    EXPECT_LE(outbox.GetMaxLatency(), 1500U);
+    EXPECT_LE(backlogLatency, outbox.GetMaxLatency());
+}
+
+TEST(BackpressureTest, SlowRecipientDoesNotDelayOthers) {
+    boost::asio::io_context io;
+    VirtualClock clock;
+
+    NetworkConditions fast;
+    fast.m_bandwidth = 1000;
+    fast.m_latency = 1;
+    fast.m_jitter = 2;
+
+    NetworkConditions slow;
+    slow.m_bandwidth = 10;
+    slow.m_latency = 50;
+    slow.m_stallPeriod = 200;
+    slow.m_stallDuration = 100;
+
+    constexpr std::size_t RECIPIENTS { 8 };
+    std::vector<std::unique_ptr<EmulatedOutbox>> recipients;
+    for (std::size_t i = 0; i < RECIPIENTS; i++) {
+        fast.m_seed = static_cast<std::uint32_t>(i + 1);
+        recipients.emplace_back(std::make_unique<EmulatedOutbox>(io, clock, i == 0? slow: fast));
+    }
+
+    /// #1 Broadcast 100 B/ms to every recipient
+    for (int i = 0; i < 500; i++) {
+        for (auto& recipient: recipients) {
+            recipient->Write(std::string(100, 'b'));
+        }
+        RunFor(clock, io, 1);
+    }
+    RunFor(clock, io, 100);
+
+    /// #2 Fast recipients receive everything in time with small outbox
+    for (std::size_t i = 1; i < RECIPIENTS; i++) {
+        EXPECT_EQ(recipients[i]->GetDelivered(), 500U);
+        EXPECT_LE(recipients[i]->GetMaxLatency(), 10U);
+        EXPECT_LE(recipients[i]->GetMaxQueuedBytes(), 1000U);
+    }
+
+    /// #3 Slow recipient accumulates the backlog
+    EXPECT_LT(recipients[0]->GetDelivered(), 500U);
+    EXPECT_GT(recipients[0]->GetMaxQueuedBytes(), 10'000U);
+}
+
+#endif // NETWORK_CONDITIONS_TESTS_HPP
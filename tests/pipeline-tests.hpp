@@ -0,0 +1,93 @@
+#ifndef PIPELINE_TESTS_HPP
+#define PIPELINE_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "allocation-counter.hpp"
+#include "single-client-messaging-tests.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+    struct PipelineRun {
+        std::size_t m_responses { 0 };
+        std::size_t m_allocations { 0 };
+        double m_seconds { 0.0 };
+    };
+
+    /**
+     * Pipeline @requests list requests at once and wait for all responses.
+     * Allocations are counted on both sides, client and server.
+     */
+    PipelineRun RunPipeline(Client& client, std::size_t requests, std::uint64_t timeout) {
+        Internal::Request listRequest{};
+        listRequest.m_query = Internal::QueryType::LIST_CHATROOM;
+        listRequest.m_timestamp = Utils::GetTimestamp();
+        listRequest.m_timeout = timeout;
+        std::string frame;
+        listRequest.Write(frame);
+        std::string pipelined;
+        pipelined.reserve(frame.size() * requests);
+        for (std::size_t i = 0; i < requests; i++) {
+            pipelined += frame;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        const auto deadline { Clock::now() + std::chrono::seconds(30) };
+        const auto initial { client.GetResponseCount() };
+        const auto allocations { Testing::GetAllocationCount() };
+        const auto start { Clock::now() };
+        client.Write(std::move(pipelined));
+        while (client.GetResponseCount() < initial + requests && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        PipelineRun run;
+        run.m_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        run.m_allocations = Testing::GetAllocationCount() - allocations;
+        run.m_responses = client.GetResponseCount() - initial;
+        return run;
+    }
+}
+
+/**
+ * The connection pipeline of the current build (callbacks or coroutines, 
+ * see `CHAT_USE_COROUTINES`) recycles its handler memory and buffers: 
+ * a request costs a bounded number of allocations (about 30 today).
+ */
+TEST_F(BasicInteractionTest, PipelinedRequestsStayWithinAllocationBound) {
+    constexpr std::size_t REQUESTS { 2000 };
+    constexpr double MAX_ALLOCATIONS_PER_REQUEST { 48.0 };
+    this->ConfirmHandshake();
+    m_server->GetRoomService()->CreateChatroom("Pipeline");
+
+    const auto run { RunPipeline(*m_client, REQUESTS, m_waitTimeout) };
+    ASSERT_EQ(run.m_responses, REQUESTS);
+    EXPECT_LE(static_cast<double>(run.m_allocations) / REQUESTS, MAX_ALLOCATIONS_PER_REQUEST);
+}
+
+/**
+ * Throughput of the connection pipeline in the current mode. 
+ * Run by the `bench` target.
+ */
+TEST_F(BasicInteractionTest, DISABLED_PipelinedRequestsBenchmark) {
+    constexpr std::size_t REQUESTS { 2000 };
+    this->ConfirmHandshake();
+    m_server->GetRoomService()->CreateChatroom("Benchmark");
+
+    const auto run { RunPipeline(*m_client, REQUESTS, m_waitTimeout) };
+    ASSERT_EQ(run.m_responses, REQUESTS);
+
+#ifdef CHAT_USE_COROUTINES
+    const char *mode { "coroutines" };
+#else
+    const char *mode { "callbacks" };
+#endif
+    std::cout << "[ BENCH    ] mode=" << mode << ": " << REQUESTS << " requests, "
+        << static_cast<double>(run.m_allocations) / REQUESTS << " allocs/request (client + server), "
+        << static_cast<std::size_t>(REQUESTS / run.m_seconds) << " requests/s\n";
+}
+
+#endif // PIPELINE_TESTS_HPP
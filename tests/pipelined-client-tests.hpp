@@ -0,0 +1,175 @@
+#ifndef PIPELINED_CLIENT_TESTS_HPP
+#define PIPELINED_CLIENT_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+/**
+ * Many requests in flight on one connection: 
+ * each reply reaches its own callback, pushed messages go to the message handler.
+ */
+class PipelinedClientTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15081 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_server = std::make_unique<Server>(m_context, PORT);
+        m_server->Start();
+        for (int i = 0; i < 2; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    std::shared_ptr<Client> Connect() {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    }
+
+    static Internal::Request MakeRequest(Internal::QueryType query, std::string attachment = {}) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = std::move(attachment);
+        return request;
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(PipelinedClientTest, RepliesAreMatchedById) {
+    constexpr std::size_t REQUESTS { 64 };
+    auto client { this->Connect() };
+
+    std::mutex mutex;
+    std::set<std::uint64_t> sent;
+    std::set<std::uint64_t> replied;
+    std::atomic<std::size_t> mismatched { 0 };
+    for (std::size_t i = 0; i < REQUESTS; i++) {
+        // nothing is awaited between the requests
+        std::lock_guard<std::mutex> lock { mutex };
+        sent.insert(client->Send(MakeRequest(Internal::QueryType::LIST_CHATROOM), 
+            [&](const Internal::Response& response) {
+                if (response.m_query != Internal::QueryType::LIST_CHATROOM || response.m_status != 200) {
+                    mismatched++;
+                }
+                std::lock_guard<std::mutex> lock { mutex };
+                replied.insert(response.m_id);
+            }
+        ));
+    }
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return client->GetPendingCount() == 0; }));
+    std::lock_guard<std::mutex> lock { mutex };
+    EXPECT_EQ(sent.size(), REQUESTS);
+    EXPECT_EQ(replied, sent);
+    EXPECT_EQ(mismatched.load(), 0U);
+}
+
+TEST_F(PipelinedClientTest, PushedMessagesUseSeparateStream) {
+    auto listener { this->Connect() };
+    auto speaker { this->Connect() };
+    std::atomic<std::size_t> pushed { 0 };
+    listener->SetMessageHandler([&pushed](const Internal::Response& response) {
+        EXPECT_EQ(response.m_id, 0U);
+        EXPECT_EQ(response.m_query, Internal::QueryType::CHAT_MESSAGE);
+        pushed++;
+    });
+
+    auto created { listener->Send(MakeRequest(Internal::QueryType::CREATE_CHATROOM, 
+        R"({"user":{"name":"listener"},"chatroom":{"name":"pipelined"}})"
+    )) };
+    ASSERT_EQ(created.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    const auto reply { created.get() };
+    ASSERT_EQ(reply.m_status, 200);
+    rapidjson::Document reader;
+    reader.Parse(reply.m_attachment.c_str());
+    const auto roomId { std::to_string(reader["chatroom"]["id"].GetUint64()) };
+
+    auto joined { speaker->Send(MakeRequest(Internal::QueryType::JOIN_CHATROOM, 
+        R"({"user":{"name":"speaker"},"chatroom":{"id":)" + roomId + "}}"
+    )) };
+    ASSERT_EQ(joined.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    ASSERT_EQ(joined.get().m_status, 200);
+
+    // the speaker's own replies don't go to its message handler
+    std::vector<std::future<Internal::Response>> said;
+    for (int i = 0; i < 3; i++) {
+        said.push_back(speaker->Send(MakeRequest(Internal::QueryType::CHAT_MESSAGE, 
+            R"({"message":"hello","chatroom":{"id":)" + roomId + "}}"
+        )));
+    }
+    for (auto& future: said) {
+        ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        EXPECT_EQ(future.get().m_status, 200);
+    }
+    EXPECT_TRUE(Testing::WaitUntil([&pushed]() { return pushed == 3; }));
+}
+
+TEST_F(PipelinedClientTest, PendingRequestsFailOnClose) {
+    auto client { this->Connect() };
+    client->CloseConnection();
+    ASSERT_TRUE(Testing::WaitUntil([&client]() { return client->GetState() == Client::State::CLOSED; }));
+    // the request isn't sent, it fails right away
+    auto failed { client->Send(MakeRequest(Internal::QueryType::LIST_CHATROOM)) };
+    ASSERT_EQ(failed.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    const auto reply { failed.get() };
+    EXPECT_EQ(reply.m_status, 0);
+    EXPECT_FALSE(reply.m_error.empty());
+    EXPECT_EQ(client->GetPendingCount(), 0U);
+}
+
+#endif // PIPELINED_CLIENT_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,250 @@
+#ifndef PRESENCE_TESTS_HPP
+#define PRESENCE_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "RoomService.hpp"
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+/**
+ * Membership changes are sent as one coalesced `PRESENCE` frame per window 
+ * to the clients which asked for them. The window is flushed by the test.
+ */
+class PresenceTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15111 };
+    static constexpr std::size_t FULL_LIMIT { 3 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        // the timer never fires during the test, the window is flushed explicitly
+        m_config.emplace("presence.cfg", Testing::ConfigFile::Overrides {
+            { "presence_interval", "600000" },
+            { "presence_full_limit", std::to_string(FULL_LIMIT) }
+        });
+        m_server = std::make_unique<Server>(m_context, PORT, m_config->GetPath());
+        m_server->Start();
+        for (int i = 0; i < 2; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        m_config.reset();
+    }
+
+    std::shared_ptr<Client> Connect() {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        const auto ack { Ask(*client, Internal::QueryType::SYN, "{}") };
+        EXPECT_TRUE(ack);
+        return client;
+    }
+
+    /**
+     * Send request and wait for the reply of the same query.
+     */
+    static std::optional<Internal::Response> Ask(
+        Client& client, 
+        Internal::QueryType query, 
+        std::string attachment = {}
+    ) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = std::move(attachment);
+        std::string serialized;
+        request.Write(serialized);
+        const auto responses { client.GetResponseCount() };
+        client.Write(std::move(serialized));
+        const auto reply { query == Internal::QueryType::SYN? Internal::QueryType::ACK: query };
+        if (!Testing::WaitUntil([&]() { 
+            return client.GetResponseCount() > responses && client.GetLastResponse().m_query == reply; 
+        })) {
+            return std::nullopt;
+        }
+        return client.GetLastResponse();
+    }
+
+    static std::optional<Internal::Response> Join(Client& client, const std::string& name, std::uint64_t roomId) {
+        return Ask(client, Internal::QueryType::JOIN_CHATROOM, 
+            R"({"user":{"name":")" + name + R"("},"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+        );
+    }
+
+    /**
+     * Collector of the `PRESENCE` frames pushed to the client.
+     */
+    struct Observer {
+        void Attach(Client& client) {
+            client.SetMessageHandler([this](const Internal::Response& response) {
+                if (response.m_query == Internal::QueryType::PRESENCE) {
+                    std::lock_guard<std::mutex> lock { m_mutex };
+                    m_frames.push_back(response.m_attachment);
+                }
+            });
+        }
+
+        std::vector<std::string> Get() const {
+            std::lock_guard<std::mutex> lock { m_mutex };
+            return m_frames;
+        }
+
+        mutable std::mutex m_mutex;
+        std::vector<std::string> m_frames;
+    };
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::optional<Testing::ConfigFile> m_config;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(PresenceTest, BurstOfChangesIsCoalesced) {
+    auto owner { this->Connect() };
+    Observer observer;
+    observer.Attach(*owner);
+    owner->RequestPresence();
+    ASSERT_TRUE(Testing::WaitUntil([&owner]() { return owner->IsPresenceEnabled(); }));
+    // the client which didn't ask for presence doesn't receive it
+    auto legacy { this->Connect() };
+    Observer ignored;
+    ignored.Attach(*legacy);
+
+    const auto created { Ask(*owner, Internal::QueryType::CREATE_CHATROOM, 
+        R"({"user":{"name":"owner"},"chatroom":{"name":"presence"}})"
+    ) };
+    ASSERT_TRUE(created && created->m_status == 200);
+    rapidjson::Document reader;
+    reader.Parse(created->m_attachment.c_str());
+    const auto roomId { reader["chatroom"]["id"].GetUint64() };
+    auto service { m_server->GetRoomService() };
+    // the creator is reported too
+    EXPECT_EQ(service->FlushPresence(), 1U);
+    ASSERT_TRUE(Testing::WaitUntil([&observer]() { return observer.Get().size() == 1; }));
+
+    /// #1 Joined and left within the window: nothing to tell
+    auto visitor { this->Connect() };
+    ASSERT_TRUE(Join(*visitor, "visitor", roomId));
+    ASSERT_TRUE(Ask(*visitor, Internal::QueryType::LEAVE_CHATROOM, 
+        R"({"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+    ));
+    EXPECT_EQ(service->FlushPresence(), 0U);
+
+    /// #2 Burst of joins: one frame with all of them
+    auto first { this->Connect() };
+    ASSERT_TRUE(Join(*first, "first", roomId));
+    ASSERT_TRUE(Join(*legacy, "legacy", roomId));
+    EXPECT_EQ(service->FlushPresence(), 1U);
+    ASSERT_TRUE(Testing::WaitUntil([&observer]() { return observer.Get().size() == 2; }));
+    reader.Parse(observer.Get().back().c_str());
+    ASSERT_TRUE(reader.IsObject());
+    EXPECT_EQ(reader["chatroom"]["id"].GetUint64(), roomId);
+    EXPECT_EQ(reader["users"].GetUint64(), 3U);
+    ASSERT_TRUE(reader.HasMember("joined"));
+    std::vector<std::string> names;
+    for (const auto& user: reader["joined"].GetArray()) {
+        names.emplace_back(user["name"].GetString());
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names, (std::vector<std::string> { "first", "legacy" }));
+    EXPECT_FALSE(reader.HasMember("left"));
+
+    /// #3 Over the limit: only the member count
+    auto second { this->Connect() };
+    ASSERT_TRUE(Join(*second, "second", roomId));
+    ASSERT_TRUE(Ask(*first, Internal::QueryType::LEAVE_CHATROOM, 
+        R"({"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+    ));
+    auto third { this->Connect() };
+    ASSERT_TRUE(Join(*third, "third", roomId));
+    EXPECT_EQ(service->FlushPresence(), 1U);
+    ASSERT_TRUE(Testing::WaitUntil([&observer]() { return observer.Get().size() == 3; }));
+    reader.Parse(observer.Get().back().c_str());
+    EXPECT_EQ(reader["users"].GetUint64(), FULL_LIMIT + 1);
+    EXPECT_FALSE(reader.HasMember("joined"));
+    EXPECT_FALSE(reader.HasMember("left"));
+
+    EXPECT_TRUE(ignored.Get().empty());
+}
+
+TEST_F(PresenceTest, MembersAreListedOnlyToMembers) {
+    auto owner { this->Connect() };
+    auto guest { this->Connect() };
+    auto stranger { this->Connect() };
+    const auto created { Ask(*owner, Internal::QueryType::CREATE_CHATROOM, 
+        R"({"user":{"name":"owner"},"chatroom":{"name":"members"}})"
+    ) };
+    ASSERT_TRUE(created && created->m_status == 200);
+    rapidjson::Document reader;
+    reader.Parse(created->m_attachment.c_str());
+    const auto roomId { reader["chatroom"]["id"].GetUint64() };
+    ASSERT_TRUE(Join(*guest, "guest", roomId));
+
+    const auto listed { Ask(*guest, Internal::QueryType::LIST_MEMBERS, 
+        R"({"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+    ) };
+    ASSERT_TRUE(listed);
+    EXPECT_EQ(listed->m_status, 200);
+    reader.Parse(listed->m_attachment.c_str());
+    EXPECT_EQ(reader["chatroom"]["id"].GetUint64(), roomId);
+    std::vector<std::string> names;
+    for (const auto& user: reader["users"].GetArray()) {
+        names.emplace_back(user["name"].GetString());
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names, (std::vector<std::string> { "guest", "owner" }));
+
+    const auto refused { Ask(*stranger, Internal::QueryType::LIST_MEMBERS, 
+        R"({"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+    ) };
+    ASSERT_TRUE(refused);
+    EXPECT_EQ(refused->m_status, 403);
+}
+
+#endif // PRESENCE_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,252 @@
+#ifndef RESUME_TESTS_HPP
+#define RESUME_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "Chatroom.hpp"
+#include "MemoryAccount.hpp"
+#include "ResumeRegistry.hpp"
+#include "RoomService.hpp"
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+TEST(ResumeRegistryTest, StateIsTakenOnce) {
+    chat::ResumeRegistry registry { std::chrono::milliseconds(10'000) };
+    const auto token { registry.Issue() };
+    EXPECT_EQ(token.size(), 32U);
+    EXPECT_NE(token, registry.Issue());
+
+    chat::ResumeRegistry::State state {};
+    state.m_username = "user";
+    state.m_chatrooms.emplace_back(7, 41);
+    state.m_current = 7;
+    registry.Park(token, std::move(state));
+    EXPECT_FALSE(registry.Take("unknown"));
+
+    const auto taken { registry.Take(token) };
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(taken->m_username, "user");
+    ASSERT_EQ(taken->m_chatrooms.size(), 1U);
+    EXPECT_EQ(taken->m_chatrooms.front().second, 41U);
+    EXPECT_FALSE(registry.Take(token));
+}
+
+TEST(ResumeRegistryTest, StateExpires) {
+    chat::ResumeRegistry registry { std::chrono::milliseconds(20), 2 };
+    registry.Park("expired", {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_FALSE(registry.Take("expired"));
+
+    // the oldest state is dropped over the capacity
+    registry.Park("first", {});
+    registry.Park("second", {});
+    registry.Park("third", {});
+    EXPECT_EQ(registry.GetParkedCount(), 2U);
+    EXPECT_FALSE(registry.Take("first"));
+    EXPECT_TRUE(registry.Take("third"));
+}
+
+TEST(ChatroomHistoryTest, HistoryIsBoundedAndCharged) {
+    auto budget { std::make_shared<net::MemoryBudget>() };
+    chat::Chatroom room { "history" };
+    room.SetHistory(3, budget);
+    std::size_t bytes { 0 };
+    for (int i = 0; i < 5; i++) {
+        const auto frame { room.Publish([](std::uint64_t sequence) { 
+            return "message #" + std::to_string(sequence); 
+        }, [](const Session&) { return true; }) };
+        EXPECT_EQ(frame, "message #" + std::to_string(i + 1));
+        if (i >= 2) {
+            bytes += frame.size();
+        }
+    }
+    EXPECT_EQ(room.GetSequence(), 5U);
+    const auto history { static_cast<std::size_t>(net::MemoryCategory::HISTORY) };
+    EXPECT_EQ(budget->GetStats().m_bytes[history], bytes);
+
+    room.TrimHistory(1);
+    EXPECT_EQ(budget->GetStats().m_bytes[history], std::string("message #5").size());
+    room.SetHistory(0, budget);
+    EXPECT_EQ(budget->GetTotal(), 0U);
+}
+
+/**
+ * A client which reconnects with its resume token is back 
+ * in its chatroom and receives only the messages it missed.
+ */
+class ResumeTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15071 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_server = std::make_unique<Server>(m_context, PORT);
+        m_server->Start();
+        for (int i = 0; i < 2; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    void Connect(Client& client) {
+        client.Connect("127.0.0.1", std::to_string(PORT));
+        ASSERT_TRUE(Testing::WaitUntil([&client]() { 
+            return client.GetState() == Client::State::RECEIVE_ACK; 
+        }));
+    }
+
+    /**
+     * Send request and wait for the reply of the same query.
+     */
+    static std::optional<Internal::Response> Ask(
+        Client& client, 
+        Internal::QueryType query, 
+        std::string attachment = {}
+    ) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = std::move(attachment);
+        std::string serialized;
+        request.Write(serialized);
+        const auto responses { client.GetResponseCount() };
+        client.Write(std::move(serialized));
+        const auto reply { query == Internal::QueryType::SYN? Internal::QueryType::ACK: query };
+        if (!Testing::WaitUntil([&]() { 
+            return client.GetResponseCount() > responses && client.GetLastResponse().m_query == reply; 
+        })) {
+            return std::nullopt;
+        }
+        return client.GetLastResponse();
+    }
+
+    static void Say(Client& client, std::uint64_t chatroomId, const std::string& text) {
+        Internal::Request request {};
+        request.m_query = Internal::QueryType::CHAT_MESSAGE;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = R"({"message":")" + text + R"(","chatroom":{"id":)" + std::to_string(chatroomId) + "}}";
+        std::string serialized;
+        request.Write(serialized);
+        client.Write(std::move(serialized));
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(ResumeTest, ReplaysMissedMessagesAfterReconnect) {
+    auto listener { std::make_shared<Client>(m_context, m_sslContext) };
+    auto speaker { std::make_shared<Client>(m_context, m_sslContext) };
+    this->Connect(*listener);
+    this->Connect(*speaker);
+
+    const auto ack { Ask(*listener, Internal::QueryType::SYN, "{}") };
+    ASSERT_TRUE(ack);
+    const auto token { listener->GetResumeToken() };
+    ASSERT_FALSE(token.empty());
+
+    const auto created { Ask(*listener, Internal::QueryType::CREATE_CHATROOM, 
+        R"({"user":{"name":"listener"},"chatroom":{"name":"resumable"}})"
+    ) };
+    ASSERT_TRUE(created && created->m_status == 200);
+    rapidjson::Document reader;
+    reader.Parse(created->m_attachment.c_str());
+    const auto roomId { reader["chatroom"]["id"].GetUint64() };
+    const auto joined { Ask(*speaker, Internal::QueryType::JOIN_CHATROOM, 
+        R"({"user":{"name":"speaker"},"chatroom":{"id":)" + std::to_string(roomId) + "}}"
+    ) };
+    ASSERT_TRUE(joined && joined->m_status == 200);
+
+    Say(*speaker, roomId, "before");
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return listener->GetLastSequence(roomId) == 1; }));
+
+    // network blip: the session is parked by its token
+    listener->CloseConnection();
+    const auto registry { m_server->GetRoomService()->GetResumeRegistry() };
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return registry->GetParkedCount() == 1; }));
+    Say(*speaker, roomId, "missed #1");
+    Say(*speaker, roomId, "missed #2");
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return m_server->GetRoomService()->GetSequence(roomId) == 3; 
+    }));
+
+    this->Connect(*listener);
+    const auto responses { listener->GetResponseCount() };
+    listener->RequestResume();
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return listener->GetResponseCount() >= responses + 3
+            && listener->GetLastResponse().m_query == Internal::QueryType::ACK; 
+    }));
+    // two replayed messages and ACK
+    EXPECT_EQ(listener->GetResponseCount(), responses + 3);
+    EXPECT_EQ(listener->GetLastSequence(roomId), 3U);
+    reader.Parse(listener->GetLastResponse().m_attachment.c_str());
+    ASSERT_TRUE(reader.IsObject() && reader.HasMember("resume"));
+    const auto& resume = reader["resume"];
+    EXPECT_TRUE(resume["restored"].GetBool());
+    ASSERT_EQ(resume["chatrooms"].Size(), 1U);
+    const auto& chatroom = resume["chatrooms"][0U];
+    EXPECT_EQ(chatroom["id"].GetUint64(), roomId);
+    EXPECT_EQ(chatroom["seq"].GetUint64(), 3U);
+    EXPECT_TRUE(chatroom["complete"].GetBool());
+    EXPECT_NE(listener->GetResumeToken(), token);
+
+    // subscribed again without JOIN
+    Say(*speaker, roomId, "after");
+    EXPECT_TRUE(Testing::WaitUntil([&]() { return listener->GetLastSequence(roomId) == 4; }));
+
+    // the token is used up
+    auto stranger { std::make_shared<Client>(m_context, m_sslContext) };
+    this->Connect(*stranger);
+    const auto refused { Ask(*stranger, Internal::QueryType::SYN, 
+        R"({"resume":{"token":")" + token + R"(","chatrooms":[]}})"
+    ) };
+    ASSERT_TRUE(refused);
+    reader.Parse(refused->m_attachment.c_str());
+    EXPECT_FALSE(reader["resume"]["restored"].GetBool());
+}
+
+#endif // RESUME_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,338 @@
+#ifndef RING_BUFFER_TESTS_HPP
+#define RING_BUFFER_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "RingBuffer.hpp"
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "ResumeRegistry.hpp"
+#include "RoomService.hpp"
+#include "Server.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+TEST(RingBufferTest, BoundedFifo) {
+    rt::RingBuffer<int> ring { 3 };
+    EXPECT_EQ(ring.GetCapacity(), 4U);
+    for (int i = 0; i < 4; i++) {
+        int value { i };
+        EXPECT_TRUE(ring.TryPush(value));
+    }
+    int rejected { 4 };
+    EXPECT_FALSE(ring.TryPush(rejected));
+    EXPECT_EQ(rejected, 4);
+    EXPECT_EQ(ring.GetSize(), 4U);
+
+    std::vector<int> batch;
+    EXPECT_EQ(ring.PopBatch(batch, 3), 3U);
+    EXPECT_EQ(batch, std::vector<int>({ 0, 1, 2 }));
+    // the freed cells are reused on the next lap
+    EXPECT_TRUE(ring.TryPush(rejected));
+    int value { -1 };
+    EXPECT_TRUE(ring.TryPop(value));
+    EXPECT_EQ(value, 3);
+    EXPECT_TRUE(ring.TryPop(value));
+    EXPECT_EQ(value, 4);
+    EXPECT_FALSE(ring.TryPop(value));
+}
+
+TEST(RingBufferTest, ProducersKeepOrder) {
+    constexpr std::size_t PRODUCERS { 4 };
+    constexpr std::size_t ITEMS { 50'000 };
+    rt::RingBuffer<std::pair<std::size_t, std::size_t>> ring { 1024 };
+
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&ring, p]() {
+            for (std::size_t i = 0; i < ITEMS; i++) {
+                std::pair<std::size_t, std::size_t> item { p, i };
+                while (!ring.TryPush(item)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    std::vector<std::size_t> next(PRODUCERS, 0);
+    std::size_t outOfOrder { 0 };
+    std::size_t received { 0 };
+    std::vector<std::pair<std::size_t, std::size_t>> batch;
+    while (received < PRODUCERS * ITEMS) {
+        batch.clear();
+        if (!ring.PopBatch(batch, 256)) {
+            std::this_thread::yield();
+        }
+        for (const auto& [producer, item]: batch) {
+            if (next[producer] != item) {
+                outOfOrder++;
+            }
+            next[producer] = item + 1;
+        }
+        received += batch.size();
+    }
+    for (auto& producer: producers) {
+        producer.join();
+    }
+    EXPECT_EQ(outOfOrder, 0U);
+    EXPECT_EQ(ring.GetSize(), 0U);
+}
+
+/**
+ * A client which drains its event queue in batches follows a busy chatroom 
+ * without losing messages.
+ */
+class EventQueueTest : public ::testing::Test {
+protected:
+    static constexpr std::uint16_t PORT { 15091 };
+    static constexpr std::size_t MESSAGES { 2'000 };
+    static constexpr std::chrono::seconds FLOOD_TIMEOUT { 10 };
+
+    void SetUp() override {
+        m_context = std::make_shared<boost::asio::io_context>();
+        m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+        m_work.emplace(m_context->get_executor());
+        m_server = std::make_unique<Server>(m_context, PORT);
+        m_server->Start();
+        for (int i = 0; i < 2; i++) {
+            m_threads.emplace_back([io = m_context]() {
+                for (;;) {
+                    try {
+                        io->run();
+                        break; // run() exited normally
+                    }
+                    catch (...) {
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown() override {
+        m_server->Shutdown();
+        m_work.reset();
+        m_context->stop();
+        for (auto& t: m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    std::shared_ptr<Client> Connect(std::optional<std::pair<std::size_t, Client::OverflowPolicy>> queue = std::nullopt) {
+        auto client { std::make_shared<Client>(m_context, m_sslContext) };
+        if (queue) {
+            client->EnableEventQueue(queue->first, queue->second);
+        }
+        client->Connect("127.0.0.1", std::to_string(PORT));
+        EXPECT_TRUE(Testing::WaitUntil([&client]() { 
+            return client->GetState() == Client::State::RECEIVE_ACK; 
+        }));
+        return client;
+    }
+
+    static Internal::Request MakeRequest(Internal::QueryType query, std::string attachment) {
+        Internal::Request request {};
+        request.m_query = query;
+        request.m_timestamp = Utils::GetTimestamp();
+        request.m_timeout = 1000;
+        request.m_attachment = std::move(attachment);
+        return request;
+    }
+
+    /**
+     * The listener creates a chatroom, the speaker joins it.
+     * @return
+     *  ID of the chatroom.
+     */
+    static std::string MakeRoom(Client& listener, Client& speaker) {
+        auto created { listener.Send(MakeRequest(Internal::QueryType::CREATE_CHATROOM, 
+            R"({"user":{"name":"listener"},"chatroom":{"name":"busy"}})"
+        )) };
+        EXPECT_EQ(created.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        rapidjson::Document reader;
+        reader.Parse(created.get().m_attachment.c_str());
+        const auto roomId { std::to_string(reader["chatroom"]["id"].GetUint64()) };
+        auto joined { speaker.Send(MakeRequest(Internal::QueryType::JOIN_CHATROOM, 
+            R"({"user":{"name":"speaker"},"chatroom":{"id":)" + roomId + "}}"
+        )) };
+        EXPECT_EQ(joined.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        EXPECT_EQ(joined.get().m_status, 200);
+        return roomId;
+    }
+
+    static void Flood(Client& speaker, const std::string& roomId) {
+        for (std::size_t i = 0; i < MESSAGES; i++) {
+            speaker.Send(MakeRequest(Internal::QueryType::CHAT_MESSAGE, 
+                R"({"message":"burst","chatroom":{"id":)" + roomId + "}}"
+            ), nullptr);
+        }
+    }
+
+    static std::uint64_t ReadSequence(const Internal::Response& response) {
+        rapidjson::Document reader;
+        reader.Parse(response.m_attachment.c_str());
+        return reader["chatroom"]["seq"].GetUint64();
+    }
+
+    struct FollowResult {
+        bool m_isReceived { false };
+        std::size_t m_received { 0 };
+        std::size_t m_outOfOrder { 0 };
+        std::int64_t m_microseconds { 0 };
+    };
+
+    /**
+     * Flood the chatroom while the @listener drains its event queue in batches.
+     */
+    FollowResult Follow(Client& listener, Client& speaker, const std::string& roomId) {
+        FollowResult result;
+        std::atomic<bool> isDone { false };
+        std::thread consumer([&]() {
+            std::uint64_t last { 0 };
+            std::vector<Internal::Response> batch;
+            while (!isDone) {
+                batch.clear();
+                if (!listener.PollEvents(batch)) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    continue;
+                }
+                for (const auto& response: batch) {
+                    if (response.m_query != Internal::QueryType::CHAT_MESSAGE) {
+                        continue;
+                    }
+                    const auto sequence { ReadSequence(response) };
+                    if (sequence != last + 1) {
+                        result.m_outOfOrder++;
+                    }
+                    last = sequence;
+                    result.m_received++;
+                }
+            }
+        });
+
+        const auto start { std::chrono::steady_clock::now() };
+        Flood(speaker, roomId);
+        result.m_isReceived = Testing::WaitUntil([&]() { 
+            return listener.GetEventStats().m_received >= MESSAGES && listener.GetEventStats().m_queued == 0; 
+        }, FLOOD_TIMEOUT);
+        result.m_microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        isDone = true;
+        consumer.join();
+        return result;
+    }
+
+    std::shared_ptr<boost::asio::io_context> m_context {};
+    std::shared_ptr<boost::asio::ssl::context> m_sslContext {};
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_work;
+    std::unique_ptr<Server> m_server {};
+    std::vector<std::thread> m_threads {};
+};
+
+TEST_F(EventQueueTest, ConsumerFollowsBusyRoom) {
+    auto listener { this->Connect(std::make_pair(std::size_t { 1024 }, Client::OverflowPolicy::DROP_NEWEST)) };
+    auto speaker { this->Connect() };
+    const auto result { Follow(*listener, *speaker, MakeRoom(*listener, *speaker)) };
+
+    ASSERT_TRUE(result.m_isReceived);
+    EXPECT_EQ(listener->GetEventStats().m_dropped, 0U);
+    EXPECT_EQ(result.m_received, MESSAGES);
+    EXPECT_EQ(result.m_outOfOrder, 0U);
+}
+
+TEST_F(EventQueueTest, DISABLED_BusyRoomBenchmark) {
+    auto listener { this->Connect(std::make_pair(std::size_t { 1024 }, Client::OverflowPolicy::DROP_NEWEST)) };
+    auto speaker { this->Connect() };
+    const auto result { Follow(*listener, *speaker, MakeRoom(*listener, *speaker)) };
+    ASSERT_TRUE(result.m_isReceived);
+    const auto elapsed { result.m_microseconds };
+    std::cout << "[ BENCH    ] " << MESSAGES << " room messages followed in " << elapsed << " us ("
+        << (elapsed? MESSAGES * 1'000'000 / static_cast<std::size_t>(elapsed): 0) << " msg/s), " 
+        << listener->GetEventStats().m_overflows << " overflows\n";
+}
+
+TEST_F(EventQueueTest, DropOldestKeepsLatest) {
+    constexpr std::size_t CAPACITY { 8 };
+    auto listener { this->Connect(std::make_pair(CAPACITY, Client::OverflowPolicy::DROP_OLDEST)) };
+    auto speaker { this->Connect() };
+    const auto roomId { MakeRoom(*listener, *speaker) };
+
+    // nobody drains the queue during the flood
+    Flood(*speaker, roomId);
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return listener->GetEventStats().m_received >= MESSAGES; }, FLOOD_TIMEOUT));
+
+    const auto stats { listener->GetEventStats() };
+    EXPECT_EQ(stats.m_queued, CAPACITY);
+    EXPECT_EQ(stats.m_dropped, MESSAGES - CAPACITY);
+    EXPECT_GT(stats.m_overflows, 0U);
+    std::vector<Internal::Response> batch;
+    EXPECT_EQ(listener->PollEvents(batch), CAPACITY);
+    EXPECT_EQ(ReadSequence(batch.front()), MESSAGES - CAPACITY + 1);
+    EXPECT_EQ(ReadSequence(batch.back()), MESSAGES);
+}
+
+TEST_F(EventQueueTest, DisconnectReplaysDroppedMessage) {
+    constexpr std::size_t CAPACITY { 8 };
+    constexpr std::size_t SENT { 12 };
+    auto listener { this->Connect(std::make_pair(CAPACITY, Client::OverflowPolicy::DISCONNECT)) };
+    auto speaker { this->Connect() };
+    auto ack { listener->Send(MakeRequest(Internal::QueryType::SYN, "{}")) };
+    ASSERT_EQ(ack.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    ASSERT_FALSE(listener->GetResumeToken().empty());
+    const auto roomId { MakeRoom(*listener, *speaker) };
+
+    // nobody drains the queue, the first message over the capacity closes the connection
+    for (std::size_t i = 0; i < SENT; i++) {
+        speaker->Send(MakeRequest(Internal::QueryType::CHAT_MESSAGE, 
+            R"({"message":"burst","chatroom":{"id":)" + roomId + "}}"
+        ), nullptr);
+    }
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return listener->GetState() == Client::State::CLOSED; }));
+    const auto registry { m_server->GetRoomService()->GetResumeRegistry() };
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return registry->GetParkedCount() == 1; }));
+    // the dropped message isn't counted as received
+    EXPECT_EQ(listener->GetLastSequence(std::stoull(roomId)), CAPACITY);
+
+    std::vector<Internal::Response> batch;
+    ASSERT_EQ(listener->PollEvents(batch), CAPACITY);
+    listener->Connect("127.0.0.1", std::to_string(PORT));
+    ASSERT_TRUE(Testing::WaitUntil([&]() { return listener->GetState() == Client::State::RECEIVE_ACK; }));
+    listener->RequestResume();
+    ASSERT_TRUE(Testing::WaitUntil([&]() { 
+        return listener->GetLastSequence(std::stoull(roomId)) == SENT; 
+    }));
+
+    // the replay starts with the dropped message
+    EXPECT_TRUE(Testing::WaitUntil([&]() { 
+        listener->PollEvents(batch);
+        return batch.size() >= SENT + 1; // and ACK of the resume
+    }));
+    std::uint64_t expected { 1 };
+    for (const auto& response: batch) {
+        if (response.m_query == Internal::QueryType::CHAT_MESSAGE) {
+            EXPECT_EQ(ReadSequence(response), expected++);
+        }
+    }
+    EXPECT_EQ(expected, SENT + 1);
+}
+
+#endif // RING_BUFFER_TESTS_HPP
\ No newline at end of file
@@ -0,0 +1,223 @@
+#ifndef ROOM_SERVICE_TESTS_HPP
+#define ROOM_SERVICE_TESTS_HPP
+
+#include "gtest/gtest.h"
+
+#include "RoomService.hpp"
+#include "Chatroom.hpp"
+#include "Session.hpp"
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+TEST(RoomServiceTest, SerializedChatroomListIsShared) {
+    chat::RoomService service;
+    service.CreateChatroom("First");
+    service.CreateChatroom("Second");
+
+    const auto first { service.GetSerializedChatroomList() };
+    const auto version { service.GetChatroomListVersion() };
+    const auto second { service.GetSerializedChatroomList() };
+
+    // nothing has changed: the same list is returned
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(version, service.GetChatroomListVersion());
+
+    rapidjson::Document reader;
+    reader.Parse(first->c_str());
+    ASSERT_TRUE(reader.HasMember("chatrooms"));
+    EXPECT_EQ(reader["chatrooms"].GetArray().Size(), 2U);
+}
+
+TEST(RoomServiceTest, SerializedChatroomListFollowsChanges) {
+    chat::RoomService service;
+    const auto empty { service.GetSerializedChatroomList() };
+    EXPECT_EQ(*empty, R"({"chatrooms":[]})");
+
+    /// #1 Create
+    const auto id { service.CreateChatroom("Original") };
+    const auto created { service.GetSerializedChatroomList() };
+    EXPECT_NE(created.get(), empty.get());
+    EXPECT_NE(created->find("Original"), std::string::npos);
+
+    /// #2 Rename
+    const auto version { service.GetChatroomListVersion() };
+    EXPECT_TRUE(service.RenameChatroom(id, "Renamed"));
+    EXPECT_FALSE(service.RenameChatroom(id + 1000, "Missing"));
+    const auto renamed { service.GetSerializedChatroomList() };
+    EXPECT_EQ(service.GetChatroomListVersion(), version + 1);
+    EXPECT_EQ(renamed->find("Original"), std::string::npos);
+    EXPECT_NE(renamed->find("Renamed"), std::string::npos);
+    // previous snapshot isn't affected
+    EXPECT_NE(created->find("Original"), std::string::npos);
+
+    /// #3 Remove
+    service.RemoveChatroom(id);
+    EXPECT_EQ(*service.GetSerializedChatroomList(), R"({"chatrooms":[]})");
+    EXPECT_TRUE(service.GetChatroomList().empty());
+}
+
+namespace {
+    /**
+     * Collect IDs of the chatrooms from the page and its "next" cursor.
+     */
+    std::pair<std::vector<std::uint64_t>, std::string> ReadPage(const std::string& page) {
+        rapidjson::Document reader;
+        reader.Parse(page.c_str());
+        std::vector<std::uint64_t> ids;
+        for (const auto& room: reader["chatrooms"].GetArray()) {
+            ids.push_back(room["id"].GetUint64());
+        }
+        std::string next {};
+        if (reader.HasMember("next")) {
+            next = reader["next"].GetString();
+        }
+        return { ids, next };
+    }
+}
+
+TEST(RoomServiceTest, PaginateChatroomsById) {
+    chat::RoomService service;
+    std::vector<std::uint64_t> expected;
+    for (int i = 0; i < 25; i++) {
+        expected.push_back(service.CreateChatroom("Room #" + std::to_string(i)));
+    }
+
+    chat::ChatroomQuery query;
+    query.m_limit = 10;
+    std::vector<std::uint64_t> received;
+    std::size_t pages { 0 };
+    do {
+        const auto page { service.GetChatroomPage(query) };
+        ASSERT_TRUE(page.has_value());
+        auto [ids, next] = ReadPage(*page);
+        EXPECT_LE(ids.size(), query.m_limit);
+        received.insert(received.end(), ids.begin(), ids.end());
+        query.m_cursor = next;
+        pages++;
+    } while (!query.m_cursor.empty());
+
+    EXPECT_EQ(pages, 3U);
+    EXPECT_EQ(received, expected);
+}
+
+TEST(RoomServiceTest, PaginateChatroomsByNamePrefix) {
+    chat::RoomService service;
+    const auto delta { service.CreateChatroom("games/delta") };
+    const auto alpha { service.CreateChatroom("games/alpha") };
+    service.CreateChatroom("music/jazz");
+    const auto charlie { service.CreateChatroom("games/charlie") };
+    const auto bravo { service.CreateChatroom("games/bravo") };
+    service.CreateChatroom("gam");
+
+    chat::ChatroomQuery query;
+    query.m_order = chat::ChatroomQuery::Order::NAME;
+    query.m_prefix = "games/";
+    query.m_limit = 3;
+
+    /// #1 First page
+    auto [first, next] = ReadPage(*service.GetChatroomPage(query));
+    const std::vector<std::uint64_t> expectedFirst { alpha, bravo, charlie };
+    EXPECT_EQ(first, expectedFirst);
+    ASSERT_FALSE(next.empty());
+
+    /// #2 Rename moves the room within the index
+    EXPECT_TRUE(service.RenameChatroom(alpha, "games/echo"));
+    query.m_cursor = next;
+    auto [second, last] = ReadPage(*service.GetChatroomPage(query));
+    const std::vector<std::uint64_t> expectedSecond { delta, alpha };
+    EXPECT_EQ(second, expectedSecond);
+    EXPECT_TRUE(last.empty());
+
+    /// #3 Malformed cursor
+    query.m_cursor = "not a cursor";
+    EXPECT_FALSE(service.GetChatroomPage(query).has_value());
+}
+
+TEST(RoomServiceTest, NameCursorIsEscaped) {
+    chat::RoomService service;
+    service.CreateChatroom("say \"hi\"");
+    const auto second { service.CreateChatroom("say \\bye") };
+
+    chat::ChatroomQuery query;
+    query.m_order = chat::ChatroomQuery::Order::NAME;
+    query.m_limit = 1;
+    auto [first, next] = ReadPage(*service.GetChatroomPage(query));
+    ASSERT_EQ(first.size(), 1U);
+    EXPECT_NE(next.find("say \"hi\""), std::string::npos);
+
+    query.m_cursor = next;
+    auto [rest, last] = ReadPage(*service.GetChatroomPage(query));
+    EXPECT_EQ(rest, std::vector<std::uint64_t>({ second }));
+    EXPECT_TRUE(last.empty());
+}
+
+TEST(RoomServiceTest, PaginateChatroomsByUsers) {
+    chat::RoomService service;
+    std::vector<std::uint64_t> expected;
+    for (int i = 0; i < 5; i++) {
+        expected.push_back(service.CreateChatroom("Room #" + std::to_string(i)));
+    }
+
+    // all rooms are empty: order by ID within the same member count
+    chat::ChatroomQuery query;
+    query.m_order = chat::ChatroomQuery::Order::USERS;
+    query.m_limit = 2;
+    std::vector<std::uint64_t> received;
+    do {
+        auto [ids, next] = ReadPage(*service.GetChatroomPage(query));
+        received.insert(received.end(), ids.begin(), ids.end());
+        query.m_cursor = next;
+    } while (!query.m_cursor.empty());
+    EXPECT_EQ(received, expected);
+}
+
+TEST(RoomServiceTest, HallIsLimitedByItsCapacityOnly) {
+    constexpr std::size_t CONNECTIONS { 2 * chat::Chatroom::DEFAULT_CAPACITY };
+    const auto io { std::make_shared<boost::asio::io_context>() };
+    const auto ssl { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+    const auto service { std::make_shared<chat::RoomService>() };
+    std::vector<std::shared_ptr<Session>> sessions;
+    const auto add = [&]() {
+        sessions.push_back(std::make_shared<Session>(net::Socket_t { *io }, service, io, ssl));
+        return service->AddSession(sessions.back());
+    };
+    // the admission limits the connections, not the hall
+    for (std::size_t i = 0; i < CONNECTIONS; i++) {
+        ASSERT_TRUE(add()) << i;
+    }
+    service->SetHallCapacity(CONNECTIONS + 1);
+    EXPECT_TRUE(add());
+    EXPECT_FALSE(add());
+
+    service->Close();
+    io->poll();
+}
+
+TEST(RoomServiceTest, JoinRacingWithRemovalLeavesTheChatroom) {
+    const auto io { std::make_shared<boost::asio::io_context>() };
+    const auto ssl { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+    const auto service { std::make_shared<chat::RoomService>() };
+    const auto id { service->CreateChatroom("late") };
+    const auto session { std::make_shared<Session>(net::Socket_t { *io }, service, io, ssl) };
+    ASSERT_TRUE(service->AddSession(session));
+
+    // the connection was closed while the join request was being handled
+    session->RemoveFromService();
+    EXPECT_FALSE(session->AssignChatroom(id));
+    // nobody is left: the chatroom is removed as after any last member
+    EXPECT_EQ(*service->GetSerializedChatroomList(), R"({"chatrooms":[]})");
+
+    service->Close();
+    io->poll();
+}
+
+#endif // ROOM_SERVICE_TESTS_HPP
\ No newline at end of file
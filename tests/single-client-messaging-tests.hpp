@@ -283,7 +283,7 @@ TEST_F(BasicInteractionTest, CreateChatroomRequest) {
     for (const auto& room: currentChatroomList) {
         EXPECT_TRUE(std::regex_match(room, match, rx));
 
-        if (static_cast<std::uint64_t>(std::stoi(match[1].str())) == id) {
+        if (static_cast<std::uint64_t>(std::stoull(match[1].str())) == id) {
             EXPECT_FALSE(foundMatchRoom) << "Room with ID = " << id << " already exist.";
             foundMatchRoom = true;
             EXPECT_EQ(desiredChatroomName, match[2].str());
@@ -403,6 +403,174 @@ TEST_F(BasicInteractionTest, ChatMessageRequest) {
     EXPECT_EQ(msg, std::string(attachment["message"].GetString()));
 }
 
+TEST_F(BasicInteractionTest, DirectMessageRequest) {
+    // #0 Confirm handshake
+    this->ConfirmHandshake();
+    const auto roomId = m_server->GetRoomService()->CreateChatroom("Direct messages");
+    this->JoinChatroom(roomId, "sender", *m_client);
+    ASSERT_EQ(m_client->GetLastResponse().m_status, 200);
+
+    // #1 Connect recipient
+    auto sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+    auto recipient = std::make_shared<Client>(m_context, sslContext);
+    recipient->Connect("127.0.0.1", "15001");
+    this->WaitFor(m_waitTimeout);
+    ASSERT_TRUE(recipient->GetState() == Client::State::RECEIVE_ACK) << "Client hasn't been acknowleged";
+    
+    const std::string msg { "Only for you!" };
+    auto sendDirect = [&](const std::string& name) {
+        Internal::Request request{};
+        request.m_query = Internal::QueryType::DIRECT_MESSAGE;
+        request.m_timeout = m_waitTimeout;
+        request.m_timestamp = Utils::GetTimestamp();
+        rapidjson::Document doc(rapidjson::kObjectType);
+        auto& alloc = doc.GetAllocator();
+        doc.AddMember("user", rapidjson::Value(rapidjson::kObjectType), alloc);
+        doc["user"].AddMember("name", rapidjson::Value(name.c_str(), alloc), alloc);
+        doc.AddMember("message", rapidjson::Value(msg.c_str(), alloc), alloc);
+        request.m_attachment = ::Serialize(doc);
+        std::string serialized{};
+        request.Write(serialized);
+        m_client->Write(std::move(serialized));
+        this->WaitFor(request.m_timeout);
+    };
+
+    // #2 The name is already taken
+    this->JoinChatroom(roomId, "sender", *recipient);
+    EXPECT_EQ(recipient->GetLastResponse().m_query, Internal::QueryType::JOIN_CHATROOM);
+    EXPECT_EQ(recipient->GetLastResponse().m_status, 409);
+    // the failed join doesn't claim the name
+    this->JoinChatroom(chat::Chatroom::NO_ROOM, "recipient", *recipient);
+    EXPECT_EQ(recipient->GetLastResponse().m_status, 400);
+    sendDirect("recipient");
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 404);
+    this->JoinChatroom(roomId, "recipient", *recipient);
+    ASSERT_EQ(recipient->GetLastResponse().m_status, 200);
+
+    // #3 Send direct message by name
+    sendDirect("recipient");
+
+    // #4 Confirm response to the sender and delivery
+    const auto reply = m_client->GetLastResponse();
+    EXPECT_EQ(reply.m_query, Internal::QueryType::DIRECT_MESSAGE);
+    EXPECT_EQ(reply.m_status, 200);
+
+    const auto incoming = recipient->GetLastResponse();
+    EXPECT_EQ(incoming.m_query, Internal::QueryType::DIRECT_MESSAGE);
+    ASSERT_FALSE(incoming.m_attachment.empty());
+    rapidjson::Document attachment;
+    attachment.Parse(incoming.m_attachment.c_str());
+    EXPECT_EQ(msg, std::string(attachment["message"].GetString()));
+    EXPECT_EQ(std::string("sender"), std::string(attachment["from"]["name"].GetString()));
+
+    // #5 Unknown user
+    sendDirect("nobody");
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 404);
+}
+
+TEST_F(BasicInteractionTest, MultiRoomSubscription) {
+    // #0 Confirm handshake
+    this->ConfirmHandshake();
+    auto service = m_server->GetRoomService();
+    const auto first = service->CreateChatroom("First");
+    const auto second = service->CreateChatroom("Second");
+
+    // #1 Subscribe to both rooms over the same connection
+    this->JoinChatroom(first, "subscriber", *m_client);
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 200);
+    this->JoinChatroom(second, "subscriber", *m_client);
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 200);
+    this->JoinChatroom(second, "subscriber", *m_client);
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 405);
+    EXPECT_EQ(std::get<1>(*service->GetChatroomData(first)), 1U);
+    EXPECT_EQ(std::get<1>(*service->GetChatroomData(second)), 1U);
+
+    // #2 Another client follows only the second room
+    auto sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23);
+    auto client = std::make_shared<Client>(m_context, sslContext);
+    client->Connect("127.0.0.1", "15001");
+    this->WaitFor(m_waitTimeout);
+    ASSERT_TRUE(client->GetState() == Client::State::RECEIVE_ACK) << "Client hasn't been acknowleged";
+    this->JoinChatroom(second, "follower", *client);
+    EXPECT_EQ(client->GetLastResponse().m_status, 200);
+
+    auto sendChat = [&](std::uint64_t roomId, const std::string& msg) {
+        Internal::Request chat{};
+        chat.m_query = Internal::QueryType::CHAT_MESSAGE;
+        chat.m_timeout = m_waitTimeout;
+        chat.m_timestamp = Utils::GetTimestamp();
+        chat.m_attachment = "{\"message\":\"" + msg + "\",\"chatroom\":{\"id\":" + std::to_string(roomId) + "}}";
+        std::string serialized{};
+        chat.Write(serialized);
+        m_client->Write(std::move(serialized));
+        this->WaitFor(chat.m_timeout);
+    };
+
+    // #3 Message to the first room doesn't reach the follower 
+    sendChat(first, "to the first room");
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 200);
+    EXPECT_EQ(client->GetLastResponse().m_query, Internal::QueryType::JOIN_CHATROOM);
+
+    // #4 Message to the second room is tagged by the room ID
+    sendChat(second, "to the second room");
+    const auto incoming = client->GetLastResponse();
+    ASSERT_EQ(incoming.m_query, Internal::QueryType::CHAT_MESSAGE);
+    rapidjson::Document attachment;
+    attachment.Parse(incoming.m_attachment.c_str());
+    EXPECT_EQ(std::string("to the second room"), std::string(attachment["message"].GetString()));
+    EXPECT_EQ(second, attachment["chatroom"]["id"].GetUint64());
+
+    // #5 Leave the first room, the second subscription is kept
+    Internal::Request leave{};
+    leave.m_query = Internal::QueryType::LEAVE_CHATROOM;
+    leave.m_timeout = m_waitTimeout;
+    leave.m_timestamp = Utils::GetTimestamp();
+    leave.m_attachment = "{\"chatroom\":{\"id\":" + std::to_string(first) + "}}";
+    std::string serialized{};
+    leave.Write(serialized);
+    m_client->Write(std::move(serialized));
+    this->WaitFor(leave.m_timeout);
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 200);
+    EXPECT_EQ(service->GetChatroomData(first), std::nullopt);
+    EXPECT_EQ(std::get<1>(*service->GetChatroomData(second)), 2U);
+
+    sendChat(first, "not subscribed");
+    EXPECT_EQ(m_client->GetLastResponse().m_status, 403);
+}
+
+TEST_F(BasicInteractionTest, CreateChatroomOverSubscriptionLimit) {
+    // #0 Confirm handshake
+    this->ConfirmHandshake();
+    auto service = m_server->GetRoomService();
+
+    // #1 Subscribe to as many chatrooms as a session can
+    std::vector<std::uint64_t> rooms;
+    for (std::size_t i = 0; i < Session::MAX_SUBSCRIPTIONS; i++) {
+        rooms.push_back(service->CreateChatroom("Room #" + std::to_string(i)));
+    }
+    for (const auto id: rooms) {
+        this->JoinChatroom(id, "collector", *m_client);
+        ASSERT_EQ(m_client->GetLastResponse().m_status, 200);
+    }
+    const auto roomsBefore { service->GetChatroomList().size() };
+
+    // #2 The new chatroom isn't created, the client gets 4xx instead of the server error
+    Internal::Request request{};
+    request.m_query = Internal::QueryType::CREATE_CHATROOM;
+    request.m_timeout = m_waitTimeout;
+    request.m_timestamp = Utils::GetTimestamp();
+    request.m_attachment = "{\"user\":{\"name\":\"collector\"},\"chatroom\":{\"name\":\"One too many\"}}";
+    std::string serialized;
+    request.Write(serialized);
+    m_client->Write(std::move(serialized));   
+    this->WaitFor(request.m_timeout);
+
+    const auto reply = m_client->GetLastResponse();
+    EXPECT_EQ(reply.m_query, Internal::QueryType::CREATE_CHATROOM);
+    EXPECT_EQ(reply.m_status, 403);
+    EXPECT_EQ(service->GetChatroomList().size(), roomsBefore);
+}
+
 /** TODO:
  * Thread safety tests:
  * - [ ] Multiply clients trying to create the chatroom (maybe with the same name);
@@ -0,0 +1,517 @@
+/**
+ * Churn soak test: random clients connect, create/join/leave chatrooms, 
+ * chat and disconnect against an in-process server for a long time. 
+ * The resident memory, the live sessions/connections/chatrooms and 
+ * the outbox bytes are sampled periodically. The test fails when 
+ * the steady state keeps growing or the objects outlive the clients.
+ * 
+ * Usage: soak [--duration=SEC] [--sample=SEC] [--clients=N] [--seed=N] 
+ *             [--port=N] [--tolerance=PERCENT]
+ */
+#include "Message.hpp"
+#include "QueryType.hpp"
+#include "Server.hpp"
+#include "Session.hpp"
+#include "Connection.hpp"
+#include "Chatroom.hpp"
+#include "MemoryAccount.hpp"
+#include "Client.hpp"
+#include "Utility.hpp"
+#include "test-helpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "rapidjson/document.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::chrono::seconds m_duration { 2 * 60 * 60 };
+    std::chrono::seconds m_sample { 10 };
+    std::size_t m_clients { 32 };
+    std::uint32_t m_seed { 0 };
+    std::uint16_t m_port { 15101 };
+    /**
+     * Allowed growth of the late steady state over the early one.
+     */
+    double m_tolerance { 0.10 };
+};
+
+struct Sample {
+    std::chrono::seconds m_elapsed { 0 };
+    std::size_t m_rssKb { 0 };
+    std::size_t m_sessions { 0 };
+    std::size_t m_connections { 0 };
+    std::size_t m_chatrooms { 0 };
+    std::size_t m_outbox { 0 };
+    std::size_t m_history { 0 };
+};
+
+struct Traffic {
+    std::uint64_t m_requests { 0 };
+    std::uint64_t m_rejected { 0 };
+    std::uint64_t m_timeouts { 0 };
+    std::uint64_t m_connects { 0 };
+    std::uint64_t m_disconnects { 0 };
+};
+
+/**
+ * Parse `--name=value` arguments. 
+ * @return
+ *  std::nullopt if an argument is unknown or malformed.
+ */
+std::optional<Options> ParseOptions(int argc, char *argv[]) {
+    Options options {};
+    options.m_seed = std::random_device{}();
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg { argv[i] };
+            const auto eq { arg.find('=') };
+            if (arg.rfind("--", 0) != 0 || eq == std::string_view::npos) {
+                return std::nullopt;
+            }
+            const auto name { arg.substr(2, eq - 2) };
+            const std::string value { arg.substr(eq + 1) };
+            if (name == "duration") {
+                options.m_duration = std::chrono::seconds(std::stoul(value));
+            }
+            else if (name == "sample") {
+                options.m_sample = std::chrono::seconds(std::max(1UL, std::stoul(value)));
+            }
+            else if (name == "clients") {
+                options.m_clients = std::max(1UL, std::stoul(value));
+            }
+            else if (name == "seed") {
+                options.m_seed = static_cast<std::uint32_t>(std::stoul(value));
+            }
+            else if (name == "port") {
+                options.m_port = static_cast<std::uint16_t>(std::stoul(value));
+            }
+            else if (name == "tolerance") {
+                options.m_tolerance = std::stod(value) / 100.0;
+            }
+            else {
+                return std::nullopt;
+            }
+        }
+    }
+    catch (const std::exception&) {
+        return std::nullopt;
+    }
+    return options;
+}
+
+std::size_t GetResidentKb() {
+#ifdef __linux__
+    std::ifstream statm { "/proc/self/statm" };
+    std::size_t pages { 0 };
+    std::size_t resident { 0 };
+    if (statm >> pages >> resident) {
+        return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)) / 1024U;
+    }
+#endif
+    return 0;
+}
+
+Sample TakeSample(const Server& server, Clock::time_point start) {
+    const auto stats { server.GetMemoryStats() };
+    Sample sample {};
+    sample.m_elapsed = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - start);
+    sample.m_rssKb = GetResidentKb();
+    sample.m_sessions = Session::GetLiveCount();
+    sample.m_connections = net::Connection::GetLiveCount();
+    sample.m_chatrooms = chat::Chatroom::GetLiveCount();
+    sample.m_outbox = stats.m_bytes[static_cast<std::size_t>(net::MemoryCategory::OUTBOX)];
+    sample.m_history = stats.m_bytes[static_cast<std::size_t>(net::MemoryCategory::HISTORY)];
+    return sample;
+}
+
+void Print(const Sample& sample) {
+    std::cout << "[ SOAK     ] t=" << sample.m_elapsed.count() << "s"
+        << " rss=" << sample.m_rssKb << "kB"
+        << " sessions=" << sample.m_sessions
+        << " connections=" << sample.m_connections
+        << " chatrooms=" << sample.m_chatrooms
+        << " outbox=" << sample.m_outbox
+        << " history=" << sample.m_history << std::endl;
+}
+
+Internal::Request MakeRequest(Internal::QueryType query, std::string attachment) {
+    Internal::Request request {};
+    request.m_query = query;
+    request.m_timestamp = Utils::GetTimestamp();
+    request.m_timeout = 1000;
+    request.m_attachment = std::move(attachment);
+    return request;
+}
+
+/**
+ * One simulated user. It's driven by a single thread.
+ */
+class Bot final {
+public:
+    Bot(std::size_t index, 
+        std::uint16_t port,
+        std::shared_ptr<boost::asio::io_context> io, 
+        std::shared_ptr<boost::asio::ssl::context> ssl, 
+        Traffic& traffic
+    ) 
+        : m_index { index }
+        , m_port { port }
+        , m_io { std::move(io) }
+        , m_ssl { std::move(ssl) }
+        , m_traffic { traffic }
+    {}
+
+    /**
+     * Perform one random action.
+     */
+    void Step(std::mt19937& random) {
+        if (!m_client) {
+            this->Connect(random);
+            return;
+        }
+        if (m_client->GetState() == Client::State::CLOSED) {
+            this->Disconnect();
+            return;
+        }
+        const auto dice { std::uniform_int_distribution<int>(0, 99)(random) };
+        if (dice < 5) {
+            // abrupt disconnect, maybe with a message still in flight
+            if (m_current) {
+                (void) m_client->Send(this->MakeMessage(m_current), nullptr);
+            }
+            this->Disconnect();
+        }
+        else if (dice < 15 || (m_chatrooms.empty() && dice < 40)) {
+            this->CreateChatroom();
+        }
+        else if (dice < 30) {
+            this->JoinChatroom(random);
+        }
+        else if (dice < 38 && !m_chatrooms.empty()) {
+            this->LeaveChatroom(random);
+        }
+        else if (m_current) {
+            this->Call(this->MakeMessage(m_current));
+        }
+    }
+
+    void Disconnect() {
+        if (m_client) {
+            m_client->CloseConnection();
+            m_client.reset();
+            m_traffic.m_disconnects++;
+        }
+        m_chatrooms.clear();
+        m_current = 0;
+    }
+
+    bool IsConnected() const noexcept {
+        return m_client != nullptr;
+    }
+
+private:
+    void Connect(std::mt19937& random) {
+        m_client = std::make_shared<Client>(m_io, m_ssl);
+        m_client->Connect("127.0.0.1", std::to_string(m_port));
+        const bool isAcknowledged { Testing::WaitUntil([this]() { 
+            return m_client->GetState() == Client::State::RECEIVE_ACK;
+        }, std::chrono::seconds(5)) };
+        if (!isAcknowledged) {
+            m_traffic.m_timeouts++;
+            this->Disconnect();
+            return;
+        }
+        m_traffic.m_connects++;
+        m_name = "bot-" + std::to_string(m_index) + "-" + std::to_string(m_traffic.m_connects);
+        if (random() % 2) {
+            // the session is parked when this client disconnects
+            m_client->RequestResume();
+        }
+    }
+
+    void CreateChatroom() {
+        const auto reply { this->Call(MakeRequest(Internal::QueryType::CREATE_CHATROOM, 
+            R"({"user":{"name":")" + m_name + R"("},"chatroom":{"name":")" + m_name + R"("}})"
+        )) };
+        if (reply && reply->m_status == 200) {
+            rapidjson::Document reader;
+            reader.Parse(reply->m_attachment.c_str());
+            m_current = reader["chatroom"]["id"].GetUint64();
+            m_chatrooms.push_back(m_current);
+        }
+    }
+
+    void JoinChatroom(std::mt19937& random) {
+        const auto list { this->Call(MakeRequest(Internal::QueryType::LIST_CHATROOM, "")) };
+        if (!list || list->m_status != 200) {
+            return;
+        }
+        rapidjson::Document reader;
+        reader.Parse(list->m_attachment.c_str());
+        if (!reader.IsObject() || !reader.HasMember("chatrooms") || reader["chatrooms"].Empty()) {
+            return;
+        }
+        const auto& chatrooms { reader["chatrooms"] };
+        const auto pick { std::uniform_int_distribution<rapidjson::SizeType>(0, chatrooms.Size() - 1)(random) };
+        const auto id { chatrooms[pick]["id"].GetUint64() };
+        const auto reply { this->Call(MakeRequest(Internal::QueryType::JOIN_CHATROOM, 
+            R"({"user":{"name":")" + m_name + R"("},"chatroom":{"id":)" + std::to_string(id) + "}}"
+        )) };
+        if (reply && reply->m_status == 200) {
+            m_current = id;
+            m_chatrooms.push_back(id);
+        }
+    }
+
+    void LeaveChatroom(std::mt19937& random) {
+        const auto pick { std::uniform_int_distribution<std::size_t>(0, m_chatrooms.size() - 1)(random) };
+        const auto id { m_chatrooms[pick] };
+        (void) this->Call(MakeRequest(Internal::QueryType::LEAVE_CHATROOM, 
+            R"({"chatroom":{"id":)" + std::to_string(id) + "}}"
+        ));
+        m_chatrooms.erase(m_chatrooms.begin() + static_cast<std::ptrdiff_t>(pick));
+        if (m_current == id) {
+            m_current = m_chatrooms.empty()? 0: m_chatrooms.back();
+        }
+    }
+
+    Internal::Request MakeMessage(std::uint64_t chatroomId) const {
+        return MakeRequest(Internal::QueryType::CHAT_MESSAGE, 
+            R"({"message":"soak message from )" + m_name + R"(","chatroom":{"id":)" 
+            + std::to_string(chatroomId) + "}}"
+        );
+    }
+
+    /**
+     * Send the request and wait for the reply. 
+     * @return
+     *  std::nullopt if the reply didn't come in time.
+     */
+    std::optional<Internal::Response> Call(Internal::Request request) {
+        m_traffic.m_requests++;
+        auto reply { m_client->Send(std::move(request)) };
+        if (reply.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+            m_traffic.m_timeouts++;
+            this->Disconnect();
+            return std::nullopt;
+        }
+        auto response { reply.get() };
+        if (response.m_status != 200) {
+            m_traffic.m_rejected++;
+        }
+        return response;
+    }
+
+    const std::size_t m_index { 0 };
+    const std::uint16_t m_port { 0 };
+    std::shared_ptr<boost::asio::io_context> m_io { nullptr };
+    std::shared_ptr<boost::asio::ssl::context> m_ssl { nullptr };
+    Traffic& m_traffic;
+    std::shared_ptr<Client> m_client { nullptr };
+    std::string m_name {};
+    std::vector<std::uint64_t> m_chatrooms {};
+    std::uint64_t m_current { 0 };
+};
+
+/**
+ * Median of @field over the samples [@first, @last).
+ */
+std::size_t Median(
+    const std::vector<Sample>& samples, 
+    std::size_t first, 
+    std::size_t last, 
+    std::size_t Sample::*field
+) {
+    std::vector<std::size_t> values;
+    for (auto i = first; i < last; i++) {
+        values.push_back(samples[i].*field);
+    }
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+/**
+ * Maximum of @field over the samples [@first, @last).
+ */
+std::size_t Peak(
+    const std::vector<Sample>& samples, 
+    std::size_t first, 
+    std::size_t last, 
+    std::size_t Sample::*field
+) {
+    std::size_t peak { 0 };
+    for (auto i = first; i < last; i++) {
+        peak = std::max(peak, samples[i].*field);
+    }
+    return peak;
+}
+
+/**
+ * Compare the late steady state (median of the last fifth of the samples) 
+ * with the early one (peak of the first half, except the warm-up fifth). 
+ * @return
+ *  Number of the metrics which grew.
+ */
+std::size_t CheckGrowth(const std::vector<Sample>& samples, double tolerance) {
+    struct Metric {
+        const char *m_name;
+        std::size_t Sample::*m_field;
+        /**
+         * Absolute growth which is ignored (allocator noise, load bursts).
+         */
+        std::size_t m_slack;
+    };
+    static const Metric metrics[] {
+        { "rss (kB)", &Sample::m_rssKb, 4096 },
+        { "sessions", &Sample::m_sessions, 4 },
+        { "connections", &Sample::m_connections, 4 },
+        { "chatrooms", &Sample::m_chatrooms, 8 },
+        { "outbox (bytes)", &Sample::m_outbox, 256 * 1024 },
+        { "history (bytes)", &Sample::m_history, 256 * 1024 },
+    };
+    const auto window { std::max<std::size_t>(1U, samples.size() / 5) };
+    if (samples.size() < 3 * window) {
+        std::cout << "[ SOAK     ] too few samples to compare the steady state\n";
+        return 0;
+    }
+    std::size_t grown { 0 };
+    for (const auto& metric: metrics) {
+        const auto early { Peak(samples, window, samples.size() / 2, metric.m_field) };
+        const auto late { Median(samples, samples.size() - window, samples.size(), metric.m_field) };
+        const auto limit { static_cast<std::size_t>(early * (1.0 + tolerance)) + metric.m_slack };
+        if (late > limit) {
+            std::cout << "[  FAILED  ] " << metric.m_name << " grew from " << early 
+                << " to " << late << " (limit " << limit << ")\n";
+            grown++;
+        }
+    }
+    return grown;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const auto options { ParseOptions(argc, argv) };
+    if (!options) {
+        std::cerr << "Usage: soak [--duration=SEC] [--sample=SEC] [--clients=N] [--seed=N] "
+            "[--port=N] [--tolerance=PERCENT]\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "[ SOAK     ] duration=" << options->m_duration.count() << "s"
+        << " clients=" << options->m_clients << " seed=" << options->m_seed << std::endl;
+
+    auto io { std::make_shared<boost::asio::io_context>() };
+    auto ssl { std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23) };
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+    work.emplace(io->get_executor());
+    // parked sessions expire quickly so the drain at the end doesn't take long
+    const Testing::ConfigFile config { "soak.cfg", { { "resume_timeout", "2000" } } };
+    Server server { io, options->m_port, config.GetPath() };
+    server.Start();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; i++) {
+        threads.emplace_back([io]() {
+            for (;;) {
+                try {
+                    io->run();
+                    break; // run() exited normally
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "ERROR: " << e.what() << '\n';
+                }
+            }
+        });
+    }
+    // objects which exist without any client (e.g. the hall)
+    const auto baselineSessions { Session::GetLiveCount() };
+    const auto baselineConnections { net::Connection::GetLiveCount() };
+    const auto baselineChatrooms { chat::Chatroom::GetLiveCount() };
+
+    Traffic traffic {};
+    std::vector<Bot> bots;
+    bots.reserve(options->m_clients);
+    for (std::size_t i = 0; i < options->m_clients; i++) {
+        bots.emplace_back(i, options->m_port, io, ssl, traffic);
+    }
+    std::mt19937 random { options->m_seed };
+    std::vector<Sample> samples;
+    const auto start { Clock::now() };
+    auto nextSample { start + options->m_sample };
+    while (Clock::now() - start < options->m_duration) {
+        auto& bot { bots[std::uniform_int_distribution<std::size_t>(0, bots.size() - 1)(random)] };
+        bot.Step(random);
+        if (Clock::now() >= nextSample) {
+            samples.push_back(TakeSample(server, start));
+            Print(samples.back());
+            nextSample += options->m_sample;
+        }
+    }
+
+    // all clients leave: every object of theirs must go away
+    for (auto& bot: bots) {
+        bot.Disconnect();
+    }
+    const bool isDrained { Testing::WaitUntil([&]() {
+        return Session::GetLiveCount() == baselineSessions
+            && net::Connection::GetLiveCount() == baselineConnections
+            && chat::Chatroom::GetLiveCount() == baselineChatrooms;
+    }, std::chrono::seconds(30)) };
+    const auto drained { TakeSample(server, start) };
+    Print(drained);
+
+    server.Shutdown();
+    work.reset();
+    io->stop();
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    std::cout << "[ SOAK     ] requests=" << traffic.m_requests 
+        << " rejected=" << traffic.m_rejected
+        << " timeouts=" << traffic.m_timeouts
+        << " connects=" << traffic.m_connects
+        << " disconnects=" << traffic.m_disconnects << std::endl;
+
+    std::size_t failures { CheckGrowth(samples, options->m_tolerance) };
+    if (!isDrained) {
+        std::cout << "[  FAILED  ] objects outlived the clients: "
+            << "sessions " << drained.m_sessions << " (" << baselineSessions << " expected), "
+            << "connections " << drained.m_connections << " (" << baselineConnections << " expected), "
+            << "chatrooms " << drained.m_chatrooms << " (" << baselineChatrooms << " expected)\n";
+        failures++;
+    }
+    if (traffic.m_timeouts) {
+        std::cout << "[  FAILED  ] " << traffic.m_timeouts << " requests weren't answered in time\n";
+        failures++;
+    }
+    if (failures) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "[  PASSED  ] steady state didn't grow\n";
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
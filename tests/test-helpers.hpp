@@ -0,0 +1,115 @@
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Server.hpp"
+
+namespace Testing {
+
+    /**
+     * Wait until @condition is met or @timeout passed, checking it every few milliseconds.
+     */
+    inline bool WaitUntil(
+        const std::function<bool()>& condition, 
+        std::chrono::milliseconds timeout = std::chrono::seconds(5)
+    ) {
+        const auto deadline { std::chrono::steady_clock::now() + timeout };
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    /**
+     * Same as `WaitUntil` but only yields between the checks.
+     * For the tests which measure latency.
+     */
+    inline bool SpinUntil(
+        const std::function<bool()>& condition, 
+        std::chrono::milliseconds timeout = std::chrono::seconds(5)
+    ) {
+        const auto deadline { std::chrono::steady_clock::now() + timeout };
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    /**
+     * Directory of the files made by the tests of this process.
+     * It's outside of the source tree, so nothing is left in `settings/`.
+     */
+    inline std::filesystem::path GetTempDirectory() {
+        const auto directory { 
+            std::filesystem::temp_directory_path() / ("chat-tests-" + std::to_string(::getpid())) 
+        };
+        std::filesystem::create_directories(directory);
+        return directory;
+    }
+
+    /**
+     * Copy of the default server config with the @overrides {key, value} applied, 
+     * written to the temporary directory. The file is removed with the object.
+     */
+    class ConfigFile final {
+    public:
+        using Overrides = std::vector<std::pair<std::string, std::string>>;
+
+        ConfigFile(const std::string& name, const Overrides& overrides)
+            : m_path { (GetTempDirectory() / name).string() }
+        {
+            std::ifstream in { Server::DEFAULT_CONFIG };
+            std::ofstream out { m_path };
+            std::string line;
+            while (std::getline(in, line)) {
+                const auto key { line.substr(0, line.find_first_of(" =")) };
+                bool isReplaced { false };
+                for (const auto& [overridden, value]: overrides) {
+                    isReplaced = isReplaced || key == overridden;
+                }
+                if (!isReplaced) {
+                    out << line << '\n';
+                }
+            }
+            for (const auto& [key, value]: overrides) {
+                out << key << " = \"" << value << "\"\n";
+            }
+        }
+
+        ConfigFile(const ConfigFile&) = delete;
+        ConfigFile& operator=(const ConfigFile&) = delete;
+
+        ~ConfigFile() {
+            std::error_code ignore;
+            std::filesystem::remove(m_path, ignore);
+            // the last one takes the directory
+            std::filesystem::remove(std::filesystem::path(m_path).parent_path(), ignore);
+        }
+
+        const std::string& GetPath() const noexcept {
+            return m_path;
+        }
+
+    private:
+        const std::string m_path;
+    };
+
+}
+
+#endif // TEST_HELPERS_HPP
\ No newline at end of file